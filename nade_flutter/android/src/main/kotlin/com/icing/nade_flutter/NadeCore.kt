@@ -1,6 +1,8 @@
 package com.icing.nade_flutter
 
 import android.util.Log
+import java.nio.ByteBuffer
+import kotlin.concurrent.thread
 
 /**
  * Thin JNI wrapper around the native NADE core implementation.
@@ -19,6 +21,7 @@ internal object NadeCore {
     external fun nativeStartServer(peerKey: ByteArray): Int
     external fun nativeStartClient(peerKey: ByteArray): Int
     external fun nativeStopSession(): Int
+    external fun nativePrepareEphemerals(): Int
     external fun nativeFeedMicFrame(samples: ShortArray, sampleCount: Int): Int
     external fun nativePullSpeakerFrame(buffer: ShortArray, maxSamples: Int): Int
     external fun nativeHandleIncoming(data: ByteArray, length: Int): Int
@@ -27,6 +30,15 @@ internal object NadeCore {
     external fun nativeDerivePublicKey(seed: ByteArray): ByteArray?
     external fun nativeSendHangupSignal(): Int
     external fun nativeConsumeRemoteHangup(): Boolean
+    external fun nativeWaitOutgoing(timeoutMs: Int): Int
+    external fun nativeWaitSpeaker(minSamples: Int, timeoutMs: Int): Int
+    external fun nativeGetMetrics(reset: Boolean): LongArray?
+    external fun nativeTraceDump(clear: Boolean): LongArray?
+    external fun nativeCaptureStart(path: String, maxBytes: Int, lineAudio: Boolean): Int
+    external fun nativeCaptureStop(): Int
+    external fun nativeAudioOpen(preferredRate: Int): Int
+    external fun nativeAudioStart(): Int
+    external fun nativeAudioClose()
 
     // 4-FSK Modulation JNI declarations
     external fun nativeFskSetEnabled(enabled: Boolean): Int
@@ -36,7 +48,28 @@ internal object NadeCore {
     external fun nativeFskPullDemodulated(out: ByteArray, maxLen: Int): Int
     external fun nativeFskSamplesForBytes(byteCount: Int): Int
 
-    fun initialize(seed: ByteArray): Boolean = nativeInit(seed) == 0
+    // Direct ByteBuffer variants: buffers must come from ByteBuffer.allocateDirect
+    // with ByteOrder.nativeOrder(); PCM is 16-bit samples, lengths are in samples.
+    external fun nativeFeedMicFrameDirect(samples: ByteBuffer, sampleCount: Int): Int
+    external fun nativePullSpeakerFrameDirect(buffer: ByteBuffer, maxSamples: Int): Int
+    external fun nativeHandleIncomingDirect(data: ByteBuffer, length: Int): Int
+    external fun nativeGenerateOutgoingDirect(buffer: ByteBuffer, maxLength: Int): Int
+    external fun nativeFskModulateDirect(data: ByteBuffer, dataLen: Int, pcmOut: ByteBuffer, maxSamples: Int): Int
+    external fun nativeFskFeedAudioDirect(pcm: ByteBuffer, samples: Int): Int
+    external fun nativeFskPullDemodulatedDirect(out: ByteBuffer, maxLen: Int): Int
+
+    // Audio-channel pipeline JNI declarations
+    external fun nativePipelineTxMaxBytes(): Int
+    external fun nativePipelineTxPcm(out: ByteArray, maxBytes: Int): Int
+    external fun nativePipelineRxPcm(data: ByteArray, length: Int): Int
+
+    fun initialize(seed: ByteArray): Boolean {
+        val ok = nativeInit(seed) == 0
+        if (ok) {
+            prepareEphemerals()
+        }
+        return ok
+    }
 
     fun startServer(peerKey: ByteArray): Boolean = nativeStartServer(peerKey) == 0
 
@@ -44,24 +77,127 @@ internal object NadeCore {
 
     fun stopSession() {
         nativeStopSession()
+        prepareEphemerals()
+    }
+
+    /**
+     * Refill the native pool of ephemeral keypairs so the next call starts
+     * without generating one. Key generation is slow, so it runs off the
+     * caller's thread.
+     */
+    private fun prepareEphemerals() {
+        thread(name = "nade-keygen", isDaemon = true) {
+            nativePrepareEphemerals()
+        }
     }
 
     fun feedMicFrame(samples: ShortArray, sampleCount: Int) {
         nativeFeedMicFrame(samples, sampleCount)
     }
 
+    /**
+     * Feed mic PCM from a direct buffer without a JNI array copy.
+     */
+    fun feedMicFrame(samples: ByteBuffer, sampleCount: Int) {
+        nativeFeedMicFrameDirect(samples, sampleCount)
+    }
+
     fun pullSpeakerFrame(buffer: ShortArray, maxSamples: Int): Int {
         return nativePullSpeakerFrame(buffer, maxSamples)
     }
 
+    /**
+     * Pull speaker PCM straight into a direct buffer.
+     * @return Number of samples written (the buffer position is not changed)
+     */
+    fun pullSpeakerFrame(buffer: ByteBuffer, maxSamples: Int): Int {
+        return nativePullSpeakerFrameDirect(buffer, maxSamples)
+    }
+
+    /**
+     * Block until outgoing data is ready, serving handshake and keepalive
+     * timers meanwhile.
+     * @return true when data is ready, false on timeout or session stop
+     */
+    fun waitOutgoing(timeoutMs: Int): Boolean {
+        return nativeWaitOutgoing(timeoutMs) == 1
+    }
+
+    /**
+     * Block until [minSamples] of speaker audio can be pulled.
+     * @return true when ready, false on timeout or session stop
+     */
+    fun waitSpeaker(minSamples: Int, timeoutMs: Int): Boolean {
+        return nativeWaitSpeaker(minSamples, timeoutMs) == 1
+    }
+
+    /**
+     * Open the native AAudio engine, whose stream callbacks feed the mic ring
+     * and drain the speaker ring directly. Streams open at the device's native
+     * rate when possible, [preferredRate] otherwise.
+     * @return The rate the streams opened at, to pass as "audio_rate", or -1
+     * if AAudio is unavailable (API < 26) or the streams failed to open
+     */
+    fun openNativeAudio(preferredRate: Int): Int {
+        return nativeAudioOpen(preferredRate)
+    }
+
+    fun startNativeAudio(): Boolean {
+        return nativeAudioStart() == 0
+    }
+
+    fun closeNativeAudio() {
+        nativeAudioClose()
+    }
+
+    /**
+     * Snapshot of the native metrics, flattened as laid out in nade_metrics.h
+     * (element 0 is the layout version). Optionally restarts the counters.
+     */
+    fun getMetrics(reset: Boolean = false): LongArray {
+        return nativeGetMetrics(reset) ?: LongArray(0)
+    }
+
+    /**
+     * Native event trace as (timeNs, event, arg0, arg1) quadruples, oldest
+     * first; event ids are listed in nade_trace.h. Optionally clears it.
+     */
+    fun dumpTrace(clear: Boolean = false): LongArray {
+        return nativeTraceDump(clear) ?: LongArray(0)
+    }
+
+    /**
+     * Record the call into a capture file of at most maxBytes for offline
+     * replay (format in nade_capture.h; handshake keys are zeroed). Received
+     * FSK line audio is left out unless lineAudio is set, which records it
+     * as heard, handshake keys included. Returns false if a capture is
+     * already running or the file cannot be created.
+     */
+    fun startCapture(path: String, maxBytes: Int = 64 * 1024 * 1024, lineAudio: Boolean = false): Boolean {
+        return nativeCaptureStart(path, maxBytes, lineAudio) == 0
+    }
+
+    /** Close the running capture; false if there was none. */
+    fun stopCapture(): Boolean {
+        return nativeCaptureStop() == 0
+    }
+
     fun handleIncoming(data: ByteArray, length: Int) {
         nativeHandleIncoming(data, length)
     }
 
+    fun handleIncoming(data: ByteBuffer, length: Int) {
+        nativeHandleIncomingDirect(data, length)
+    }
+
     fun generateOutgoing(buffer: ByteArray, maxLength: Int): Int {
         return nativeGenerateOutgoing(buffer, maxLength)
     }
 
+    fun generateOutgoing(buffer: ByteBuffer, maxLength: Int): Int {
+        return nativeGenerateOutgoingDirect(buffer, maxLength)
+    }
+
     fun setConfig(configJson: String) {
         nativeSetConfig(configJson)
     }
@@ -108,6 +244,16 @@ internal object NadeCore {
         return nativeFskModulate(data, data.size, pcmOut, pcmOut.size)
     }
 
+    /**
+     * Direct buffer variant of [fskModulate].
+     * @param dataLen Number of bytes to modulate from the start of [data]
+     * @param pcmOut Output buffer, holds pcmOut.capacity() / 2 samples
+     * @return Number of PCM samples written
+     */
+    fun fskModulate(data: ByteBuffer, dataLen: Int, pcmOut: ByteBuffer): Int {
+        return nativeFskModulateDirect(data, dataLen, pcmOut, pcmOut.capacity() / 2)
+    }
+
     /**
      * Feed received PCM audio for demodulation.
      * Call fskPullDemodulated() after to retrieve decoded bytes.
@@ -117,6 +263,10 @@ internal object NadeCore {
         nativeFskFeedAudio(pcm, sampleCount)
     }
 
+    fun fskFeedAudio(pcm: ByteBuffer, sampleCount: Int) {
+        nativeFskFeedAudioDirect(pcm, sampleCount)
+    }
+
     /**
      * Pull demodulated bytes after feeding audio.
      * @param out Output buffer for decoded bytes
@@ -126,6 +276,10 @@ internal object NadeCore {
         return nativeFskPullDemodulated(out, out.size)
     }
 
+    fun fskPullDemodulated(out: ByteBuffer): Int {
+        return nativeFskPullDemodulatedDirect(out, out.capacity())
+    }
+
     /**
      * Calculate PCM samples needed to modulate given number of bytes.
      * (320 samples per byte = 4 symbols * 80 samples/symbol)
@@ -134,6 +288,33 @@ internal object NadeCore {
         return nativeFskSamplesForBytes(byteCount)
     }
 
+    // -------------------------------------------------------------------------
+    // Audio-channel pipeline API
+    // Framing, Reed-Solomon, 4-FSK and PCM packing in a single native call
+
+    /**
+     * Size of the largest PCM burst [pipelineTxPcm] can produce, in bytes.
+     */
+    fun pipelineTxMaxBytes(): Int {
+        return nativePipelineTxMaxBytes()
+    }
+
+    /**
+     * Produce the next outgoing burst as 16-bit little-endian PCM bytes.
+     * @return Number of bytes written to [out], 0 when nothing is queued
+     */
+    fun pipelineTxPcm(out: ByteArray): Int {
+        return nativePipelineTxPcm(out, out.size)
+    }
+
+    /**
+     * Demodulate received 16-bit little-endian PCM bytes and parse the frames.
+     * @return Number of frame bytes recovered, or -1 on error
+     */
+    fun pipelineRxPcm(data: ByteArray, length: Int): Int {
+        return nativePipelineRxPcm(data, length)
+    }
+
     // -------------------------------------------------------------------------
     // Reed-Solomon Error Correction API
     // RS(255, 223) - can correct up to 16 byte errors per 255-byte block
@@ -146,6 +327,8 @@ internal object NadeCore {
     external fun nativeRsEncodedLen(dataLen: Int): Int
     external fun nativeRsDataLen(encodedLen: Int): Int
     external fun nativeRsGetStats(): String
+    external fun nativeRsEncodeDirect(data: ByteBuffer, dataLen: Int, out: ByteBuffer, maxOut: Int): Int
+    external fun nativeRsDecodeDirect(codeword: ByteBuffer, len: Int): Int
 
     /**
      * Enable or disable Reed-Solomon error correction.
@@ -200,6 +383,13 @@ internal object NadeCore {
         return nativeRsEncode(data, data.size, out, out.size)
     }
 
+    /**
+     * Direct buffer variant of [rsEncode] for [dataLen] bytes of [data].
+     */
+    fun rsEncode(data: ByteBuffer, dataLen: Int, out: ByteBuffer): Int {
+        return nativeRsEncodeDirect(data, dataLen, out, out.capacity())
+    }
+
     /**
      * Decode and correct errors in Reed-Solomon codeword.
      * Corrects data in-place.
@@ -210,6 +400,13 @@ internal object NadeCore {
         return nativeRsDecode(codeword, codeword.size)
     }
 
+    /**
+     * Direct buffer variant of [rsDecode] for the first [len] bytes of [codeword].
+     */
+    fun rsDecode(codeword: ByteBuffer, len: Int): Int {
+        return nativeRsDecodeDirect(codeword, len)
+    }
+
     /**
      * Get encoded length for given data length (data_len + 32 parity bytes).
      */
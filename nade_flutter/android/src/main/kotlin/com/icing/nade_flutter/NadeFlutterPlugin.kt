@@ -55,6 +55,8 @@ class NadeFlutterPlugin : FlutterPlugin, MethodCallHandler {
             "rsIsEnabled" -> handleRsIsEnabled(result)
             "rsEncode" -> handleRsEncode(call, result)
             "rsDecode" -> handleRsDecode(call, result)
+            // Diagnostics
+            "dumpTrace" -> handleDumpTrace(call, result)
             else -> result.notImplemented()
         }
     }
@@ -280,6 +282,15 @@ class NadeFlutterPlugin : FlutterPlugin, MethodCallHandler {
         }
     }
 
+    // -------------------------------------------------------------------------
+    // Diagnostics Handlers
+    // -------------------------------------------------------------------------
+
+    private fun handleDumpTrace(call: MethodCall, result: Result) {
+        val clear = call.argument<Boolean>("clear") ?: false
+        result.success(NadeCore.dumpTrace(clear))
+    }
+
     private fun ensureSession(ctx: Context) {
         if (session != null) return
         val created = NadeSession(ctx, ::emitEvent)
@@ -18,6 +18,8 @@ import org.json.JSONObject
 import java.io.IOException
 import java.io.InputStream
 import java.io.OutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.util.concurrent.atomic.AtomicBoolean
 import kotlin.concurrent.thread
 
@@ -27,19 +29,29 @@ internal class NadeSession(
 ) {
     private val sampleRate = 16_000
     private val frameSamples = 320 // 20 ms @ 16 kHz
+    // Upper bound on a native wait, so the loops re-check `running` promptly
+    private val waitTimeoutMs = 50
+    // How often native metrics are posted to the event channel
+    private val metricsIntervalMs = 1000L
+    // Transport streams are array based; the native side pins these with
+    // GetPrimitiveArrayCritical instead of copying them.
     private val outgoingBuffer = ByteArray(2048)
     private val incomingBuffer = ByteArray(2048)
-    private val speakerBuffer = ShortArray(frameSamples)
-    private val micBuffer = ShortArray(frameSamples)
+    // Direct buffers shared with native code so the audio loops never copy
+    // through JNI or allocate per frame. Native order is little-endian on Android.
+    private val speakerBuffer = allocateDirect(frameSamples * 2)
+    private val micBuffer = allocateDirect(frameSamples * 2)
 
     // 4-FSK Audio Transport Mode
     // When enabled, encrypted data is modulated to audio tones for "audio over audio" transmission
     // Use ONLY when transport is an actual audio channel (phone call, radio, etc.)
     // For Bluetooth RFCOMM (direct data), keep disabled - data is already sent as bytes
     @Volatile private var fskModeEnabled = false
-    private val fskSamplesPerByte = 320 // 4 symbols * 80 samples/symbol at 8kHz
-    private val fskModulatedBuffer = ShortArray(2048 * fskSamplesPerByte) // PCM output for modulated data
-    private val fskDemodulatedBuffer = ByteArray(4096) // Demodulated bytes from received audio
+    // Mic and speaker run on native AAudio callbacks instead of the
+    // AudioRecord/AudioTrack loops; requested with the "native_audio" config key
+    private var nativeAudioActive = false
+    // Little-endian PCM produced by the native TX pipeline, sized for its largest burst
+    private val fskTxPcmBuffer by lazy { ByteArray(NadeCore.pipelineTxMaxBytes()) }
 
     private val running = AtomicBoolean(false)
     private val transportReady = AtomicBoolean(false)
@@ -51,6 +63,13 @@ internal class NadeSession(
     private val recorder: AudioRecord
     private val player: AudioTrack
     private val mainHandler = Handler(Looper.getMainLooper())
+    private val metricsTask = object : Runnable {
+        override fun run() {
+            if (!running.get()) return
+            emitMetrics()
+            mainHandler.postDelayed(this, metricsIntervalMs)
+        }
+    }
 
     private var micThread: Thread? = null
     private var txThread: Thread? = null
@@ -101,6 +120,9 @@ internal class NadeSession(
             AudioTrack.MODE_STREAM,
             AudioManager.AUDIO_SESSION_ID_GENERATE
         )
+        // The native core resamples between the device rate and its codecs
+        configState.put("audio_rate", sampleRate)
+        NadeCore.setConfig(configState.toString())
     }
 
     fun startServerSession(peerKeyBase64: String): Boolean {
@@ -226,6 +248,7 @@ internal class NadeSession(
             waitForHangupDrain()
         }
         running.set(false)
+        mainHandler.removeCallbacks(metricsTask)
         transportReady.set(false)
         detachTransport()
         try {
@@ -243,6 +266,10 @@ internal class NadeSession(
             player.stop()
         } catch (_: Exception) {
         }
+        if (nativeAudioActive) {
+            stopNativeAudio()
+            nativeAudioActive = false
+        }
         try {
             audioManager.mode = AudioManager.MODE_NORMAL
         } catch (_: Exception) {
@@ -253,6 +280,7 @@ internal class NadeSession(
         speakerThread?.interrupt()
         NadeCore.stopSession()
         hangupSent = false
+        emitMetrics()
         emitState("stopped")
     }
 
@@ -308,25 +336,60 @@ internal class NadeSession(
         } catch (_: Exception) {
         }
         
-        if (recorder.state == AudioRecord.STATE_INITIALIZED) {
-            recorder.startRecording()
-            Log.d("NadeSession", "AudioRecord started")
-        } else {
-            emitError("mic_init", Exception("AudioRecord not initialized"))
-        }
-        
-        if (player.state == AudioTrack.STATE_INITIALIZED) {
-            player.play()
-            Log.d("NadeSession", "AudioTrack started")
-        } else {
-            emitError("spk_init", Exception("AudioTrack not initialized"))
+        nativeAudioActive = configState.optBoolean("native_audio", false) && startNativeAudio()
+        if (!nativeAudioActive) {
+            if (recorder.state == AudioRecord.STATE_INITIALIZED) {
+                recorder.startRecording()
+                Log.d("NadeSession", "AudioRecord started")
+            } else {
+                emitError("mic_init", Exception("AudioRecord not initialized"))
+            }
+
+            if (player.state == AudioTrack.STATE_INITIALIZED) {
+                player.play()
+                Log.d("NadeSession", "AudioTrack started")
+            } else {
+                emitError("spk_init", Exception("AudioTrack not initialized"))
+            }
         }
 
         setSpeakerEnabled(configState.optBoolean("speaker", false))
-        micThread = thread(name = "nade-mic") { captureMicLoop() }
+        if (!nativeAudioActive) {
+            micThread = thread(name = "nade-mic") { captureMicLoop() }
+            speakerThread = thread(name = "nade-spk") { playbackLoop() }
+        }
         txThread = thread(name = "nade-tx") { transmitLoop() }
         rxThread = thread(name = "nade-rx") { receiveLoop() }
-        speakerThread = thread(name = "nade-spk") { playbackLoop() }
+        mainHandler.removeCallbacks(metricsTask)
+        mainHandler.postDelayed(metricsTask, metricsIntervalMs)
+    }
+
+    /**
+     * Start the native AAudio engine at the device's rate, telling the core
+     * that rate. Returns false, leaving the core at [sampleRate], if AAudio
+     * is unavailable or fails, so the Java audio path takes over.
+     */
+    private fun startNativeAudio(): Boolean {
+        val rate = NadeCore.openNativeAudio(sampleRate)
+        if (rate <= 0) {
+            Log.i("NadeSession", "Native audio unavailable, using AudioRecord/AudioTrack")
+            return false
+        }
+        configState.put("audio_rate", rate)
+        NadeCore.setConfig(configState.toString())
+        if (!NadeCore.startNativeAudio()) {
+            Log.w("NadeSession", "Native audio failed to start, using AudioRecord/AudioTrack")
+            stopNativeAudio()
+            return false
+        }
+        Log.d("NadeSession", "Native audio started at $rate Hz")
+        return true
+    }
+
+    private fun stopNativeAudio() {
+        NadeCore.closeNativeAudio()
+        configState.put("audio_rate", sampleRate)
+        NadeCore.setConfig(configState.toString())
     }
 
     private fun requestAudioFocus() {
@@ -368,14 +431,11 @@ internal class NadeSession(
 
     private fun captureMicLoop() {
         Log.d("NadeSession", "captureMicLoop started")
-        var frames = 0
         try {
             while (running.get()) {
-                val read = recorder.read(micBuffer, 0, micBuffer.size)
+                val read = recorder.read(micBuffer, micBuffer.capacity())
                 if (read > 0) {
-                    NadeCore.feedMicFrame(micBuffer, read)
-                    frames++
-                    if (frames % 100 == 0) Log.d("NadeSession", "Mic captured $frames frames")
+                    NadeCore.feedMicFrame(micBuffer, read / 2)
                 } else if (read < 0) {
                     Log.w("NadeSession", "AudioRecord read error: $read")
                     Thread.sleep(10)
@@ -388,18 +448,6 @@ internal class NadeSession(
 
     private fun transmitLoop() {
         Log.d("NadeSession", "transmitLoop started (FSK mode: $fskModeEnabled)")
-        
-        // Log RS status on start
-        if (fskModeEnabled && NadeCore.isRsEnabled()) {
-            Log.i("NadeSession", "╔══════════════════════════════════════════════════════════╗")
-            Log.i("NadeSession", "║  Reed-Solomon FEC: ACTIVE in transmit pipeline          ║")
-            Log.i("NadeSession", "║  RS(255,223) - 32 parity bytes, corrects ≤16 errors     ║")
-            Log.i("NadeSession", "╚══════════════════════════════════════════════════════════╝")
-        }
-        
-        var packets = 0
-        // Buffer for Reed-Solomon encoded data
-        val rsEncodedBuffer = ByteArray(outgoingBuffer.size + 32) // +32 for RS parity
         try {
             while (running.get()) {
                 val out = outputStream
@@ -407,48 +455,18 @@ internal class NadeSession(
                     Thread.sleep(10)
                     continue
                 }
-                val produced = NadeCore.generateOutgoing(outgoingBuffer, outgoingBuffer.size)
+                val fsk = fskModeEnabled
+                val produced = if (fsk) {
+                    // 4-FSK Audio Transport Mode: framing, optional Reed-Solomon FEC,
+                    // modulation and PCM packing all happen in one native call
+                    NadeCore.pipelineTxPcm(fskTxPcmBuffer)
+                } else {
+                    NadeCore.generateOutgoing(outgoingBuffer, outgoingBuffer.size)
+                }
                 if (produced > 0) {
-                    if (fskModeEnabled) {
-                        // 4-FSK Audio Transport Mode with optional Reed-Solomon FEC
-                        var dataToModulate = outgoingBuffer.copyOf(produced)
-                        var dataLen = produced
-                        
-                        // Apply Reed-Solomon encoding if enabled (for noisy audio channels)
-                        if (NadeCore.isRsEnabled()) {
-                            val rsEncoded = NadeCore.rsEncode(dataToModulate, rsEncodedBuffer)
-                            if (rsEncoded > 0) {
-                                dataToModulate = rsEncodedBuffer.copyOf(rsEncoded)
-                                dataLen = rsEncoded
-                                if (packets < 5 || packets % 100 == 0) {
-                                    Log.i("NadeSession", "🛡️ RS TX #$packets: $produced data + 32 parity = $rsEncoded bytes")
-                                }
-                            }
-                        }
-                        
-                        // Modulate the (possibly RS-encoded) data into audio tones
-                        val samplesNeeded = NadeCore.fskSamplesForBytes(dataLen)
-                        val modulatedSamples = if (samplesNeeded <= fskModulatedBuffer.size) {
-                            NadeCore.fskModulate(dataToModulate, fskModulatedBuffer)
-                        } else {
-                            Log.w("NadeSession", "FSK buffer too small for $dataLen bytes")
-                            0
-                        }
-                        
-                        if (modulatedSamples > 0) {
-                            // Convert ShortArray to ByteArray (16-bit PCM, little-endian)
-                            val audioBytes = ByteArray(modulatedSamples * 2)
-                            for (i in 0 until modulatedSamples) {
-                                val sample = fskModulatedBuffer[i]
-                                audioBytes[i * 2] = (sample.toInt() and 0xFF).toByte()
-                                audioBytes[i * 2 + 1] = ((sample.toInt() shr 8) and 0xFF).toByte()
-                            }
-                            out.write(audioBytes)
-                            out.flush()
-                            if (packets < 5 || packets % 50 == 0) {
-                                Log.d("NadeSession", "FSK Tx: $dataLen bytes -> $modulatedSamples samples")
-                            }
-                        }
+                    if (fsk) {
+                        out.write(fskTxPcmBuffer, 0, produced)
+                        out.flush()
                     } else {
                         // Direct byte transport (current behavior)
                         out.write(outgoingBuffer, 0, produced)
@@ -460,18 +478,8 @@ internal class NadeSession(
                         hangupDrainSucceeded = true
                         Log.i("NadeSession", "Hangup frame flushed via transmit loop")
                     }
-                    packets++
-                    
-                    // Log RS stats periodically
-                    if (packets % 100 == 0) {
-                        Log.d("NadeSession", "Tx sent $packets packets")
-                        if (fskModeEnabled && NadeCore.isRsEnabled()) {
-                            val stats = NadeCore.getRsStats()
-                            Log.i("NadeSession", "📊 RS STATS: ${stats.encodes} encoded | ${stats.decodes} decoded | ${stats.errorsCorrected} errors fixed | ${stats.uncorrectable} uncorrectable")
-                        }
-                    }
                 } else {
-                    Thread.sleep(4)
+                    NadeCore.waitOutgoing(waitTimeoutMs)
                 }
             }
         } catch (ex: IOException) {
@@ -486,22 +494,6 @@ internal class NadeSession(
 
     private fun receiveLoop() {
         Log.d("NadeSession", "receiveLoop started (FSK mode: $fskModeEnabled)")
-        
-        // Log RS status on start
-        if (fskModeEnabled && NadeCore.isRsEnabled()) {
-            Log.i("NadeSession", "╔══════════════════════════════════════════════════════════╗")
-            Log.i("NadeSession", "║  Reed-Solomon FEC: ACTIVE in receive pipeline           ║")
-            Log.i("NadeSession", "║  Watching for corrupted frames to correct...            ║")
-            Log.i("NadeSession", "╚══════════════════════════════════════════════════════════╝")
-        }
-        
-        var packets = 0
-        var rsErrorsCorrected = 0
-        // Buffer for receiving audio samples in FSK mode
-        val fskRxAudioBuffer = ShortArray(8192)
-        // Buffer for accumulating RS-encoded blocks
-        val rsBlockBuffer = ByteArray(fskDemodulatedBuffer.size)
-        var rsBlockLen = 0
         try {
             while (running.get()) {
                 val input = inputStream
@@ -515,52 +507,9 @@ internal class NadeSession(
                 val read = input.read(incomingBuffer)
                 if (read > 0) {
                     if (fskModeEnabled) {
-                        // 4-FSK Audio Transport Mode:
-                        // Received data is audio samples - demodulate to bytes
-                        val sampleCount = read / 2 // 16-bit samples
-                        if (sampleCount > 0 && sampleCount <= fskRxAudioBuffer.size) {
-                            // Convert ByteArray to ShortArray (16-bit PCM, little-endian)
-                            for (i in 0 until sampleCount) {
-                                val low = incomingBuffer[i * 2].toInt() and 0xFF
-                                val high = incomingBuffer[i * 2 + 1].toInt() and 0xFF
-                                fskRxAudioBuffer[i] = ((high shl 8) or low).toShort()
-                            }
-                            
-                            // Feed audio to demodulator
-                            NadeCore.fskFeedAudio(fskRxAudioBuffer, sampleCount)
-                            
-                            // Pull demodulated bytes
-                            val demodulated = NadeCore.fskPullDemodulated(fskDemodulatedBuffer)
-                            if (demodulated > 0) {
-                                // Apply Reed-Solomon decoding if enabled
-                                if (NadeCore.isRsEnabled() && demodulated > 32) {
-                                    // RS decode in-place
-                                    val codeword = fskDemodulatedBuffer.copyOf(demodulated)
-                                    val errors = NadeCore.rsDecode(codeword)
-                                    if (errors >= 0) {
-                                        // Successfully decoded - extract data portion
-                                        val dataLen = NadeCore.rsDataLen(demodulated)
-                                        NadeCore.handleIncoming(codeword, dataLen)
-                                        if (errors > 0) {
-                                            rsErrorsCorrected += errors
-                                            Log.i("NadeSession", "🔧 RS RX #$packets: CORRECTED $errors byte errors! (session total: $rsErrorsCorrected)")
-                                        } else if (packets < 5 || packets % 100 == 0) {
-                                            Log.d("NadeSession", "✓ RS RX #$packets: Clean frame, $dataLen bytes")
-                                        }
-                                    } else {
-                                        // Uncorrectable - still try to pass through
-                                        Log.w("NadeSession", "❌ RS RX #$packets: UNCORRECTABLE (>16 byte errors)")
-                                        NadeCore.handleIncoming(fskDemodulatedBuffer, demodulated)
-                                    }
-                                } else {
-                                    // No RS encoding, pass directly
-                                    NadeCore.handleIncoming(fskDemodulatedBuffer, demodulated)
-                                    if (packets < 5 || packets % 50 == 0) {
-                                        Log.d("NadeSession", "FSK Rx: $sampleCount samples -> $demodulated bytes (no RS)")
-                                    }
-                                }
-                            }
-                        }
+                        // 4-FSK Audio Transport Mode: received data is PCM audio.
+                        // Demodulation, Reed-Solomon decoding and frame parsing run natively.
+                        NadeCore.pipelineRxPcm(incomingBuffer, read)
                     } else {
                         // Direct byte transport (current behavior)
                         NadeCore.handleIncoming(incomingBuffer, read)
@@ -569,10 +518,6 @@ internal class NadeSession(
                     if (checkRemoteHangup("post-frame")) {
                         break
                     }
-                    packets++
-                    if (packets < 5 || packets % 100 == 0) {
-                        Log.d("NadeSession", "Rx received packet #$packets ($read bytes)")
-                    }
                 } else if (read < 0) {
                     Log.i("NadeSession", "Transport closed by peer (read=$read)")
                     notifyRemoteHangup("socket_eof")
@@ -592,20 +537,17 @@ internal class NadeSession(
 
     private fun playbackLoop() {
         Log.d("NadeSession", "playbackLoop started")
-        var frames = 0
         try {
             while (running.get()) {
-                val pulled = NadeCore.pullSpeakerFrame(speakerBuffer, speakerBuffer.size)
+                val pulled = NadeCore.pullSpeakerFrame(speakerBuffer, frameSamples)
                 if (pulled > 0) {
-                    val written = player.write(speakerBuffer, 0, pulled)
+                    speakerBuffer.position(0)
+                    val written = player.write(speakerBuffer, pulled * 2, AudioTrack.WRITE_BLOCKING)
                     if (written < 0) {
                         Log.w("NadeSession", "AudioTrack write error: $written")
-                    } else {
-                        frames++
-                        if (frames % 100 == 0) Log.d("NadeSession", "Speaker played $frames frames")
                     }
                 } else {
-                    Thread.sleep(4)
+                    NadeCore.waitSpeaker(frameSamples, waitTimeoutMs)
                 }
             }
         } catch (ex: Exception) {
@@ -613,6 +555,10 @@ internal class NadeSession(
         }
     }
 
+    private fun allocateDirect(bytes: Int): ByteBuffer {
+        return ByteBuffer.allocateDirect(bytes).order(ByteOrder.nativeOrder())
+    }
+
     private fun decodeKey(value: String): ByteArray {
         val trimmed = value.trim()
         if (trimmed.isEmpty()) {
@@ -629,6 +575,12 @@ internal class NadeSession(
         dispatchEvent(mapOf("type" to "state", "value" to state))
     }
 
+    private fun emitMetrics() {
+        val values = NadeCore.getMetrics()
+        if (values.isEmpty()) return
+        dispatchEvent(mapOf("type" to "metrics", "values" to values.toList()))
+    }
+
     private fun emitError(stage: String, throwable: Throwable) {
         Log.e("NadeSession", "NADE pipeline error at $stage", throwable)
         dispatchEvent(
@@ -223,6 +223,19 @@ class Nade {
     return encodedLen > rsParitySize ? encodedLen - rsParitySize : 0;
   }
 
+  // -------------------------------------------------------------------------
+  // Diagnostics
+
+  /// Dump the native event trace for post-call analysis.
+  /// Records are (timeNs, event, arg0, arg1) quadruples, oldest first; the
+  /// event ids are listed in native/include/nade_trace.h.
+  static Future<Int64List> dumpTrace({bool clear = false}) async {
+    final result = await _channel.invokeMethod<Int64List>('dumpTrace', {
+      'clear': clear,
+    });
+    return result ?? Int64List(0);
+  }
+
   static Future<void> _waitForInit() async {
     if (_isInitialized) return;
     if (_initializing != null) {
@@ -241,3 +254,130 @@ class Nade {
     }
   }
 }
+
+/// Traffic through one native ring, in samples or bytes.
+class NadeRingMetrics {
+  const NadeRingMetrics({
+    required this.pushed,
+    required this.popped,
+    required this.dropped,
+    required this.highWater,
+  });
+
+  final int pushed;
+  final int popped;
+  final int dropped;
+  final int highWater;
+}
+
+/// Log2 histogram: bucket i counts values whose bit width is i.
+class NadeHistogram {
+  const NadeHistogram({
+    required this.count,
+    required this.total,
+    required this.max,
+    required this.buckets,
+  });
+
+  final int count;
+  final int total;
+  final int max;
+  final List<int> buckets;
+
+  double get mean => count == 0 ? 0 : total / count;
+}
+
+/// Native metrics snapshot, delivered as `{'type': 'metrics', 'values': [...]}`
+/// events about once a second during a session. The flattened layout is the
+/// one described in native/include/nade_metrics.h.
+class NadeMetrics {
+  NadeMetrics._({
+    required this.rings,
+    required this.decryptFailures,
+    required this.handshakes,
+    required this.handshakeLastMs,
+    required this.handshakeMaxMs,
+    required this.framesPlayed,
+    required this.framesConcealed,
+    required this.lateDropped,
+    required this.duplicates,
+    required this.rebuffers,
+    required this.expanded,
+    required this.compressed,
+    required this.stageNanos,
+    required this.txFrameBytes,
+    required this.rxFrameBytes,
+  });
+
+  static const int layoutVersion = 2;
+  static const List<String> ringNames = ['mic', 'spk', 'out', 'in', 'fsk_demod'];
+  static const List<String> stageNames = [
+    'codec_encode',
+    'codec_decode',
+    'aead_seal',
+    'aead_open',
+    'fec_encode',
+    'fec_decode',
+    'fsk_mod',
+    'fsk_demod',
+  ];
+  static const int _buckets = 24;
+
+  final Map<String, NadeRingMetrics> rings;
+  final int decryptFailures;
+  final int handshakes;
+  final int handshakeLastMs;
+  final int handshakeMaxMs;
+  final int framesPlayed;
+  final int framesConcealed;
+  final int lateDropped;
+  final int duplicates;
+  final int rebuffers;
+  final int expanded;
+  final int compressed;
+  /// Processing time per call, in nanoseconds, keyed by [stageNames].
+  final Map<String, NadeHistogram> stageNanos;
+  final NadeHistogram txFrameBytes;
+  final NadeHistogram rxFrameBytes;
+
+  /// Parse the `values` of a metrics event. Returns null for an unknown
+  /// layout version or a truncated list.
+  static NadeMetrics? fromValues(List<dynamic> values) {
+    final v = values.map((e) => (e as num).toInt()).toList();
+    if (v.length < 2 || v[0] != layoutVersion || v.length < v[1]) {
+      return null;
+    }
+    var i = 2;
+    int next() => v[i++];
+    NadeHistogram histogram() {
+      final count = next();
+      final total = next();
+      final max = next();
+      final buckets = v.sublist(i, i + _buckets);
+      i += _buckets;
+      return NadeHistogram(count: count, total: total, max: max, buckets: buckets);
+    }
+
+    final rings = <String, NadeRingMetrics>{
+      for (final name in ringNames)
+        name: NadeRingMetrics(pushed: next(), popped: next(), dropped: next(), highWater: next()),
+    };
+    return NadeMetrics._(
+      rings: rings,
+      decryptFailures: next(),
+      handshakes: next(),
+      handshakeLastMs: next(),
+      handshakeMaxMs: next(),
+      framesPlayed: next(),
+      framesConcealed: next(),
+      lateDropped: next(),
+      duplicates: next(),
+      rebuffers: next(),
+      expanded: next(),
+      compressed: next(),
+      stageNanos: {for (final name in stageNames) name: histogram()},
+      txFrameBytes: histogram(),
+      rxFrameBytes: histogram(),
+    );
+  }
+}
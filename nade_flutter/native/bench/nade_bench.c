@@ -0,0 +1,1641 @@
+/*
+ * NADE host benchmark and loopback simulation
+ *
+ * The microbenchmarks time the codecs, the resampler (per rate pair),
+ * Reed-Solomon (per kernel and error count), the FEC framer, the FSK modem
+ * (per profile) and AEAD records (per backend, after checking they agree)
+ * in isolation. The loopback
+ * simulation connects two contexts through a simulated channel on a
+ * virtual clock and runs a call from handshake to audio, reporting frames
+ * per second, CPU time per simulated call-second and mouth-to-ear
+ * latency. --calls runs several calls between the same two
+ * contexts, so later calls can start from session resumption (--resume).
+ * --mtu switches both endpoints to datagram transport, so the byte link
+ * carries (and loses or corrupts) whole datagrams instead of frames.
+ * --capture records endpoint b's side of the simulation to a capture file
+ * (see nade_capture.h) and --replay feeds one back through a fresh context,
+ * at full speed or, with --realtime, at the pace it was recorded. A capture
+ * holds no keys, so a replayed handshake cannot complete; the replay still
+ * runs the framing, modem, FEC and playout paths on the recorded input.
+ * Received FSK line audio is only recorded with --line-audio, which also
+ * keeps the handshake bursts that are otherwise blanked.
+ *
+ * Latency is measured from the onset of a talk spurt fed to one endpoint's
+ * microphone to its onset at the other endpoint's speaker. Spurts repeat
+ * every --period ms and each onset is matched to the latest spurt that
+ * started before it, so latencies longer than the period alias.
+ *
+ * A loopback call fails (exit status 1) if the handshake does not complete,
+ * if a call with SPEECH_MIN_MS to spare after it decodes no frames or hears
+ * no spurt, or if a clean FSK channel ends up owing more airtime than the
+ * call lasted.
+ *
+ *   nade_bench [--quick] [--micro | --loopback] [--min-ms N]
+ *              [--seconds N] [--fsk] [--shaped] [--profiles MASK] [--codec NAME]
+ *              [--batch-ms N] [--no-dtx] [--noise DBFS] [--loss P] [--ber P] [--mtu N]
+ *              [--drift PPM] [--delay MS] [--period MS] [--seed N]
+ *              [--calls N] [--resume] [--audio-rate HZ] [--capture PATH]
+ *              [--line-audio]
+ *   nade_bench --replay PATH [--realtime]
+ */
+
+#include "monocypher.h"
+#include "nade_aead.h"
+#include "nade_capture.h"
+#include "nade_codec.h"
+#include "nade_core.h"
+#include "nade_datagram.h"
+#include "nade_fec.h"
+#include "nade_fsk.h"
+#include "nade_metrics.h"
+#include "nade_resample.h"
+#include "nade_trace.h"
+#include "reed_solomon.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 8000                        // FSK channel
+#define STEP_MS 20
+#define STEP_SAMPLES (SAMPLE_RATE * STEP_MS / 1000)
+#define STEP_MAX_SAMPLES (NADE_RESAMPLE_MAX_RATE * STEP_MS / 1000 * 2)  // Endpoint audio, room for a fast clock
+#define LINK_QUEUE_LEN 4096                     // Packets in flight per direction
+#define LINK_MAX_PACKET (3 + 4096)
+#define LINK_STAGE_BYTES 65536
+#define LINK_DRAIN_BURSTS 64                    // Bound on the bursts left over at a hang-up
+#define REJECT_CHECK_GAP (SAMPLE_RATE / 4)      // Silence around the rejected-datagram check
+#define MAX_ONSETS 4096
+#define CAPTURE_MAX_BYTES ((size_t)256 << 20)
+
+typedef struct {
+    bool run_micro;
+    bool run_loopback;
+    double min_seconds;         // Minimum measuring time per microbenchmark
+    double call_seconds;
+    bool fsk;
+    bool shaped;
+    long profiles;
+    const char *codec;
+    long batch_ms;
+    bool no_dtx;
+    double noise_dbfs;          // Channel noise level, <= -200 for none
+    double loss;
+    double ber;
+    double drift_ppm;
+    long delay_ms;
+    long period_ms;
+    uint64_t seed;
+    long calls;
+    bool resume;
+    long audio_rate;            // Endpoint mic and speaker rate
+    long link_mtu;              // Datagram transport of this MTU, 0 for a byte stream
+    const char *capture_path;   // Record endpoint b here
+    bool line_audio;            // ...line audio included, unredacted
+    const char *replay_path;    // Replay this capture instead of benchmarking
+    bool realtime;              // Replay at the recorded pace
+} options_t;
+
+static volatile uint64_t g_sink;   // Keeps benchmarked results observable
+
+// -------------------------------------------------------------------------
+// Utility helpers
+
+static double now_seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static uint64_t g_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng_next(void) {
+    // xorshift64*, deterministic for a given --seed
+    g_rng_state ^= g_rng_state >> 12;
+    g_rng_state ^= g_rng_state << 25;
+    g_rng_state ^= g_rng_state >> 27;
+    return g_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_uniform(void) {
+    return (double)(rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_gaussian(void) {
+    double u = rng_uniform();
+    double v = rng_uniform();
+    return sqrt(-2.0 * log(u > 0.0 ? u : 1e-300)) * cos(2.0 * M_PI * v);
+}
+
+static int16_t clamp_sample(double value) {
+    if (value > 32767.0) {
+        return 32767;
+    }
+    if (value < -32768.0) {
+        return -32768;
+    }
+    return (int16_t)lrint(value);
+}
+
+// Voiced test signal: a 200 Hz fundamental with three harmonics, which both
+// the waveform codecs and the LPC vocoders carry recognisably
+static int16_t voice_sample(uint64_t n, long rate) {
+    double t = (double)n / (double)rate;
+    double v = 0.0;
+    for (int h = 1; h <= 4; h++) {
+        v += 3000.0 / h * sin(2.0 * M_PI * 200.0 * h * t);
+    }
+    return clamp_sample(v);
+}
+
+// -------------------------------------------------------------------------
+// Microbenchmarks
+
+typedef void (*bench_fn)(void *arg);
+
+// Time fn, doubling the iteration count until one batch takes at least
+// min_seconds. bytes and audio_seconds describe one call and, when set, are
+// reported as throughput and as a multiple of real time.
+static void bench_run(const options_t *opt, const char *name, bench_fn fn, void *arg,
+                      size_t bytes, double audio_seconds) {
+    fn(arg);
+    uint64_t iterations = 1;
+    double elapsed = 0.0;
+    while (true) {
+        double start = now_seconds(CLOCK_MONOTONIC);
+        for (uint64_t i = 0; i < iterations; i++) {
+            fn(arg);
+        }
+        elapsed = now_seconds(CLOCK_MONOTONIC) - start;
+        if (elapsed >= opt->min_seconds || iterations >= (1ULL << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+    double per_call = elapsed / (double)iterations;
+    printf("  %-34s %12.1f ns/op", name, per_call * 1e9);
+    if (bytes > 0) {
+        printf("  %9.2f MB/s", (double)bytes / per_call / 1e6);
+    }
+    if (audio_seconds > 0.0) {
+        printf("  %9.1fx realtime", audio_seconds / per_call);
+    }
+    printf("\n");
+}
+
+typedef struct {
+    int codec;
+    nade_codec_encoder_t enc;
+    nade_codec_decoder_t dec;
+    size_t frame_samples;
+    int16_t pcm[NADE_CODEC_MAX_FRAME_SAMPLES];
+    uint8_t encoded[NADE_CODEC_MAX_ENCODED];
+    size_t encoded_len;
+    int16_t decoded[NADE_CODEC_MAX_FRAME_SAMPLES];
+} codec_bench_t;
+
+static void bench_codec_encode(void *arg) {
+    codec_bench_t *b = (codec_bench_t *)arg;
+    b->encoded_len = nade_codec_encode(&b->enc, b->codec, b->pcm, b->frame_samples,
+                                       b->encoded, sizeof(b->encoded));
+    g_sink += b->encoded_len;
+}
+
+static void bench_codec_decode(void *arg) {
+    codec_bench_t *b = (codec_bench_t *)arg;
+    g_sink += nade_codec_decode(&b->dec, b->codec, b->encoded, b->encoded_len,
+                                b->decoded, b->frame_samples);
+}
+
+static void run_codec_benchmarks(const options_t *opt) {
+    printf("codec (one %d ms frame)\n", NADE_CODEC_FRAME_SAMPLES * 1000 / NADE_CODEC_RATE);
+    static codec_bench_t b;
+    for (int codec = NADE_CODEC_NONE + 1; codec < NADE_CODEC_COUNT; codec++) {
+        const nade_codec_info_t *info = nade_codec_info(codec);
+        memset(&b, 0, sizeof(b));
+        b.codec = codec;
+        b.frame_samples = info->frame_samples;
+        for (size_t i = 0; i < b.frame_samples; i++) {
+            b.pcm[i] = voice_sample(i, info->sample_rate);
+        }
+        nade_codec_encoder_reset(&b.enc);
+        nade_codec_decoder_reset(&b.dec);
+        double frame_seconds = (double)b.frame_samples / info->sample_rate;
+        char name[64];
+        snprintf(name, sizeof(name), "%s encode", nade_codec_info(codec)->name);
+        bench_run(opt, name, bench_codec_encode, &b, 0, frame_seconds);
+        snprintf(name, sizeof(name), "%s decode", nade_codec_info(codec)->name);
+        bench_run(opt, name, bench_codec_decode, &b, 0, frame_seconds);
+    }
+}
+
+#define RESAMPLE_BENCH_MS 40
+
+typedef struct {
+    nade_resampler_t rs;
+    size_t in_len;
+    int16_t in[NADE_RESAMPLE_MAX_RATE * RESAMPLE_BENCH_MS / 1000];
+    int16_t out[NADE_RESAMPLE_MAX_RATE * RESAMPLE_BENCH_MS / 1000 + 1];
+} resample_bench_t;
+
+static void bench_resample(void *arg) {
+    resample_bench_t *b = (resample_bench_t *)arg;
+    g_sink += nade_resampler_process(&b->rs, b->in, b->in_len, b->out);
+}
+
+// The conversions an Android device at 16, 44.1 or 48 kHz needs around the
+// two codec rates
+static void run_resample_benchmarks(const options_t *opt) {
+    static const int kPairs[][2] = {
+        {16000, 8000}, {8000, 16000}, {48000, 16000}, {16000, 48000}, {44100, 8000}, {8000, 44100},
+    };
+    printf("resample (one %d ms frame)\n", RESAMPLE_BENCH_MS);
+    static resample_bench_t b;
+    for (size_t p = 0; p < sizeof(kPairs) / sizeof(kPairs[0]); p++) {
+        int in_rate = kPairs[p][0];
+        int out_rate = kPairs[p][1];
+        nade_resampler_init(&b.rs, in_rate, out_rate);
+        b.in_len = (size_t)in_rate * RESAMPLE_BENCH_MS / 1000;
+        for (size_t i = 0; i < b.in_len; i++) {
+            b.in[i] = voice_sample(i, in_rate);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%d -> %d Hz (%d taps)", in_rate, out_rate, b.rs.taps);
+        bench_run(opt, name, bench_resample, &b, 0, RESAMPLE_BENCH_MS / 1000.0);
+    }
+}
+
+typedef struct {
+    uint8_t data[RS_DATA_SIZE];
+    uint8_t codeword[RS_BLOCK_SIZE];
+    uint8_t work[RS_BLOCK_SIZE];
+    size_t positions[RS_CORRECT_CAPABLE];
+    uint8_t erasures[RS_PARITY_SIZE];
+    int errors;
+    int erased;
+} rs_bench_t;
+
+static void bench_rs_encode(void *arg) {
+    rs_bench_t *b = (rs_bench_t *)arg;
+    g_sink += rs_encode(b->data, RS_DATA_SIZE, b->codeword);
+}
+
+static void bench_rs_decode(void *arg) {
+    rs_bench_t *b = (rs_bench_t *)arg;
+    memcpy(b->work, b->codeword, RS_BLOCK_SIZE);
+    for (int i = 0; i < b->errors; i++) {
+        b->work[b->positions[i]] ^= 0x5A;
+    }
+    g_sink += (uint64_t)rs_decode(b->work, RS_BLOCK_SIZE);
+}
+
+static void corrupt_with_erasures(rs_bench_t *b) {
+    memcpy(b->work, b->codeword, RS_BLOCK_SIZE);
+    for (int i = 0; i < b->errors; i++) {
+        b->work[b->positions[i]] ^= 0x5A;
+    }
+    for (int i = 0; i < b->erased; i++) {
+        b->work[b->erasures[i]] ^= 0xA5;
+    }
+}
+
+static void bench_rs_decode_erasures(void *arg) {
+    rs_bench_t *b = (rs_bench_t *)arg;
+    corrupt_with_erasures(b);
+    g_sink += (uint64_t)rs_decode_erasures(b->work, RS_BLOCK_SIZE, RS_PARITY_SIZE,
+                                           b->erasures, (size_t)b->erased);
+}
+
+static void run_rs_benchmarks(const options_t *opt) {
+    static const int kErrorCounts[] = {0, 1, 4, 8, RS_CORRECT_CAPABLE};
+    printf("reed-solomon RS(%d,%d)\n", RS_BLOCK_SIZE, RS_DATA_SIZE);
+    rs_init();
+    static rs_bench_t b;
+    for (size_t i = 0; i < RS_DATA_SIZE; i++) {
+        b.data[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    // Distinct error positions spread over data and parity
+    for (int i = 0; i < RS_CORRECT_CAPABLE; i++) {
+        b.positions[i] = (size_t)(i * 15 + 7) % RS_BLOCK_SIZE;
+    }
+    // Erased bytes between the first half of the error positions
+    for (int i = 0; i < RS_PARITY_SIZE / 2; i++) {
+        b.erasures[i] = (uint8_t)(i * 13 + 3);
+    }
+    rs_kernel_t initial = rs_get_kernel();
+    for (int kernel = RS_KERNEL_REFERENCE; kernel <= RS_KERNEL_NEON; kernel++) {
+        if (!rs_set_kernel((rs_kernel_t)kernel)) {
+            continue;
+        }
+        const char *kernel_name = rs_kernel_name((rs_kernel_t)kernel);
+        char name[64];
+        b.errors = 0;
+        snprintf(name, sizeof(name), "%s encode", kernel_name);
+        bench_run(opt, name, bench_rs_encode, &b, RS_DATA_SIZE, 0.0);
+        rs_encode(b.data, RS_DATA_SIZE, b.codeword);
+        for (size_t e = 0; e < sizeof(kErrorCounts) / sizeof(kErrorCounts[0]); e++) {
+            b.errors = kErrorCounts[e];
+            memcpy(b.work, b.codeword, RS_BLOCK_SIZE);
+            for (int i = 0; i < b.errors; i++) {
+                b.work[b.positions[i]] ^= 0x5A;
+            }
+            if (rs_decode(b.work, RS_BLOCK_SIZE) != b.errors ||
+                memcmp(b.work, b.codeword, RS_BLOCK_SIZE) != 0) {
+                printf("  %s decode failed to correct %d errors\n", kernel_name, b.errors);
+                continue;
+            }
+            snprintf(name, sizeof(name), "%s decode, %d errors", kernel_name, b.errors);
+            bench_run(opt, name, bench_rs_decode, &b, RS_BLOCK_SIZE, 0.0);
+        }
+        // Half the parity spent on erasures, the rest on errors
+        b.erased = RS_PARITY_SIZE / 2;
+        b.errors = RS_PARITY_SIZE / 4;
+        corrupt_with_erasures(&b);
+        if (rs_decode_erasures(b.work, RS_BLOCK_SIZE, RS_PARITY_SIZE, b.erasures, (size_t)b.erased) !=
+                b.errors + b.erased ||
+            memcmp(b.work, b.codeword, RS_BLOCK_SIZE) != 0) {
+            printf("  %s decode failed to correct %d erasures and %d errors\n", kernel_name, b.erased,
+                   b.errors);
+        } else {
+            snprintf(name, sizeof(name), "%s decode, %d erased + %d errors", kernel_name, b.erased,
+                     b.errors);
+            bench_run(opt, name, bench_rs_decode_erasures, &b, RS_BLOCK_SIZE, 0.0);
+        }
+        b.erased = 0;
+    }
+    rs_set_kernel(initial);
+}
+
+typedef struct {
+    uint8_t payload[200];
+    uint8_t frame[NADE_FEC_MAX_FRAME];
+    size_t frame_len;
+    uint8_t out[NADE_FEC_MAX_PAYLOAD];
+    nade_fec_decoder_t dec;
+    nade_fec_stats_t stats;
+} fec_bench_t;
+
+static void bench_fec_encode(void *arg) {
+    fec_bench_t *b = (fec_bench_t *)arg;
+    b->frame_len = nade_fec_encode(b->payload, sizeof(b->payload), NADE_FEC_DEFAULT_PARITY,
+                                   b->frame, sizeof(b->frame));
+    g_sink += b->frame_len;
+}
+
+static void bench_fec_decode(void *arg) {
+    fec_bench_t *b = (fec_bench_t *)arg;
+    size_t offset = 0;
+    while (offset < b->frame_len) {
+        size_t consumed = 0;
+        g_sink += nade_fec_decoder_push(&b->dec, b->frame + offset, NULL, b->frame_len - offset,
+                                        &consumed, b->out, &b->stats);
+        if (consumed == 0) {
+            break;
+        }
+        offset += consumed;
+    }
+}
+
+static void run_fec_benchmarks(const options_t *opt) {
+    printf("fec framing (%zu byte payload)\n", sizeof(((fec_bench_t *)0)->payload));
+    static fec_bench_t b;
+    for (size_t i = 0; i < sizeof(b.payload); i++) {
+        b.payload[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    nade_fec_decoder_reset(&b.dec);
+    bench_run(opt, "encode", bench_fec_encode, &b, sizeof(b.payload), 0.0);
+    bench_run(opt, "decode", bench_fec_decode, &b, sizeof(b.payload), 0.0);
+}
+
+#define FSK_BENCH_BYTES 64
+#define FSK_BENCH_LEAD 400      // Silence before the burst, in samples
+
+typedef struct {
+    int profile;
+    uint8_t data[FSK_BENCH_BYTES];
+    nade_fsk_mod_t mod;
+    nade_fsk_demod_t demod;
+    int16_t *pcm;
+    size_t pcm_len;
+    size_t pcm_max;
+    uint8_t out[FSK_BENCH_BYTES * 2];
+    size_t decoded;
+} fsk_bench_t;
+
+static void bench_fsk_modulate(void *arg) {
+    fsk_bench_t *b = (fsk_bench_t *)arg;
+    g_sink += nade_fsk_modulate_burst(&b->mod, b->profile, b->data, FSK_BENCH_BYTES,
+                                      b->pcm + FSK_BENCH_LEAD, b->pcm_max - FSK_BENCH_LEAD);
+}
+
+static void bench_fsk_demodulate(void *arg) {
+    fsk_bench_t *b = (fsk_bench_t *)arg;
+    nade_fsk_demod_reset(&b->demod);
+    size_t offset = 0;
+    b->decoded = 0;
+    while (offset < b->pcm_len) {
+        size_t consumed = 0;
+        b->decoded += nade_fsk_demodulate(&b->demod, b->pcm + offset, b->pcm_len - offset, &consumed,
+                                          b->out + b->decoded, NULL, sizeof(b->out) - b->decoded);
+        offset += consumed;
+    }
+    g_sink += b->decoded;
+}
+
+static void run_fsk_benchmarks(const options_t *opt) {
+    printf("fsk modem (%d byte burst)\n", FSK_BENCH_BYTES);
+    static fsk_bench_t b;
+    for (size_t i = 0; i < FSK_BENCH_BYTES; i++) {
+        b.data[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    b.pcm_max = FSK_BENCH_LEAD * 2 + nade_fsk_burst_samples(NADE_FSK_PROFILE_BASE, FSK_BENCH_BYTES);
+    b.pcm = calloc(b.pcm_max, sizeof(int16_t));
+    if (!b.pcm) {
+        return;
+    }
+    for (int profile = 0; profile < NADE_FSK_PROFILE_COUNT; profile++) {
+        b.profile = profile;
+        memset(b.pcm, 0, b.pcm_max * sizeof(int16_t));
+        nade_fsk_mod_reset(&b.mod);
+        nade_fsk_mod_set_shaping(&b.mod, opt->shaped);
+        size_t burst = nade_fsk_modulate_burst(&b.mod, profile, b.data, FSK_BENCH_BYTES,
+                                               b.pcm + FSK_BENCH_LEAD, b.pcm_max - FSK_BENCH_LEAD);
+        b.pcm_len = FSK_BENCH_LEAD * 2 + burst;
+        double burst_seconds = (double)burst / SAMPLE_RATE;
+        const char *profile_name = nade_fsk_profile(profile)->name;
+        char name[64];
+        snprintf(name, sizeof(name), "%s modulate", profile_name);
+        bench_run(opt, name, bench_fsk_modulate, &b, FSK_BENCH_BYTES, burst_seconds);
+        bench_fsk_demodulate(&b);
+        if (b.decoded != FSK_BENCH_BYTES || memcmp(b.out, b.data, FSK_BENCH_BYTES) != 0) {
+            printf("  %s demodulate recovered %zu of %d bytes\n", profile_name, b.decoded, FSK_BENCH_BYTES);
+            continue;
+        }
+        snprintf(name, sizeof(name), "%s demodulate", profile_name);
+        bench_run(opt, name, bench_fsk_demodulate, &b, FSK_BENCH_BYTES,
+                  (double)b.pcm_len / SAMPLE_RATE);
+    }
+    free(b.pcm);
+    b.pcm = NULL;
+}
+
+typedef struct {
+    uint8_t key[32];
+    uint8_t nonce[12];
+    uint8_t plain[1024];
+    uint8_t cipher[1024];
+    uint8_t mac[16];
+    size_t len;
+} aead_bench_t;
+
+static void bench_aead_seal(void *arg) {
+    aead_bench_t *b = (aead_bench_t *)arg;
+    memcpy(b->cipher, b->plain, b->len);
+    nade_aead_seal(b->key, b->nonce, NULL, 0, b->cipher, b->len, b->mac);
+    g_sink += b->mac[0];
+}
+
+static void bench_aead_open(void *arg) {
+    aead_bench_t *b = (aead_bench_t *)arg;
+    uint8_t text[sizeof(b->cipher)];
+    memcpy(text, b->cipher, b->len);
+    g_sink += (uint64_t)nade_aead_open(b->key, b->nonce, NULL, 0, text, b->len, b->mac);
+}
+
+// Every backend must produce the portable backend's records, and open them
+static bool aead_backends_agree(aead_bench_t *b) {
+    uint8_t ad[13];
+    for (size_t i = 0; i < sizeof(ad); i++) {
+        ad[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    for (size_t len = 0; len <= sizeof(b->plain); len += len < 300 ? 1 : 61) {
+        uint8_t expected[sizeof(b->plain)], expected_mac[16];
+        memcpy(expected, b->plain, len);
+        nade_aead_select_backend("portable");
+        nade_aead_seal(b->key, b->nonce, ad, len % sizeof(ad), expected, len, expected_mac);
+        for (int i = 0; nade_aead_backend_name(i) != NULL; i++) {
+            uint8_t text[sizeof(b->plain)], mac[16];
+            memcpy(text, b->plain, len);
+            nade_aead_select_backend(nade_aead_backend_name(i));
+            nade_aead_seal(b->key, b->nonce, ad, len % sizeof(ad), text, len, mac);
+            bool same = memcmp(text, expected, len) == 0 && memcmp(mac, expected_mac, 16) == 0;
+            same = same && nade_aead_open(b->key, b->nonce, ad, len % sizeof(ad), text, len, mac) == 0 &&
+                   memcmp(text, b->plain, len) == 0;
+            mac[len % 16] ^= 1;
+            same = same && nade_aead_open(b->key, b->nonce, ad, len % sizeof(ad), expected, len, mac) != 0;
+            if (!same) {
+                fprintf(stderr, "aead backend %s disagrees at %zu bytes\n", nade_aead_backend_name(i), len);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void run_aead_benchmarks(const options_t *opt) {
+    // One adpcm4 audio record, a full batch and a large control payload
+    static const size_t kRecordSizes[] = {1 + 8 + NADE_CODEC_MAX_ENCODED, 512, 1024};
+    static aead_bench_t b;
+    for (size_t i = 0; i < sizeof(b.key); i++) {
+        b.key[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    for (size_t i = 0; i < sizeof(b.plain); i++) {
+        b.plain[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    if (!aead_backends_agree(&b)) {
+        exit(1);
+    }
+    for (int backend = 0; nade_aead_backend_name(backend) != NULL; backend++) {
+        nade_aead_select_backend(nade_aead_backend_name(backend));
+        printf("aead chacha20-poly1305, %s backend (one record)\n", nade_aead_backend());
+        for (size_t i = 0; i < sizeof(kRecordSizes) / sizeof(kRecordSizes[0]); i++) {
+            b.len = kRecordSizes[i];
+            nade_aead_seal(b.key, b.nonce, NULL, 0, memcpy(b.cipher, b.plain, b.len), b.len, b.mac);
+            char name[64];
+            snprintf(name, sizeof(name), "seal %zu bytes", b.len);
+            bench_run(opt, name, bench_aead_seal, &b, b.len, 0.0);
+            snprintf(name, sizeof(name), "open %zu bytes", b.len);
+            bench_run(opt, name, bench_aead_open, &b, b.len, 0.0);
+        }
+    }
+    nade_aead_select_backend("auto");
+}
+
+// -------------------------------------------------------------------------
+// Loopback simulation
+
+static uint64_t g_sim_ms;
+
+static uint64_t sim_clock(void *user) {
+    (void)user;
+    return g_sim_ms;
+}
+
+typedef struct {
+    uint64_t due_ms;
+    size_t len;
+    uint8_t data[LINK_MAX_PACKET];
+} link_packet_t;
+
+// One direction of the channel. The byte link carries whole transport
+// frames, the audio link carries PCM with a fixed delay line.
+typedef struct {
+    // Byte link
+    uint8_t stage[LINK_STAGE_BYTES];    // Outgoing bytes not yet split into frames
+    size_t stage_len;
+    link_packet_t *queue;
+    size_t head;
+    size_t count;
+    uint64_t sent;
+    uint64_t sent_bytes;
+    uint64_t lost;
+    uint64_t corrupted;
+
+    // Audio link
+    int16_t *burst;                     // Current transmit burst
+    size_t burst_len;
+    size_t burst_pos;
+    uint8_t *burst_bytes;
+    size_t burst_max_bytes;
+    int16_t *delay;                     // Delay line, delay_len samples
+    size_t delay_len;
+    size_t delay_pos;
+    uint64_t faded_blocks;
+    uint64_t burst_samples;             // Samples of bursts sent, i.e. time on air
+} link_t;
+
+typedef struct {
+    nade_ctx_t *ctx;
+    const char *name;
+    double clock_rate;          // Audio clock relative to simulated time
+    double mic_carry;
+    double spk_carry;
+    uint64_t mic_samples;       // Samples fed, at this endpoint's clock
+    uint64_t spk_samples;       // Samples played
+    long onset_offset_ms;       // Phase of this talker's spurts in the period
+
+    // Talk spurts sent by this endpoint, in simulated milliseconds
+    double onsets[MAX_ONSETS];
+    size_t onset_count;
+
+    // Speaker onset detector
+    int quiet_blocks;
+    bool in_spurt;
+
+    bool heard_audio;
+    uint64_t first_audio_ms;    // When the speaker first had audio, from the call start
+} endpoint_t;
+
+typedef struct {
+    double total_ms;
+    double min_ms;
+    double max_ms;
+    uint64_t count;
+    uint64_t unmatched;
+} latency_t;
+
+#define SPURT_MS 300
+#define SPEECH_MIN_MS 10000     // Call time after the handshake that must carry speech
+#define ONSET_LEVEL 1500        // Sample magnitude that starts a spurt
+#define QUIET_LEVEL 400         // Mean magnitude of a quiet block
+#define QUIET_BLOCKS 5          // Quiet blocks needed before a new onset
+
+static link_t *link_create(const options_t *opt) {
+    link_t *link = calloc(1, sizeof(*link));
+    if (!link) {
+        return NULL;
+    }
+    link->queue = calloc(LINK_QUEUE_LEN, sizeof(*link->queue));
+    link->burst_max_bytes = nade_pipeline_tx_max_bytes();
+    link->burst_bytes = malloc(link->burst_max_bytes);
+    link->burst = malloc(link->burst_max_bytes);
+    link->delay_len = (size_t)(opt->delay_ms > 0 ? opt->delay_ms : 0) * SAMPLE_RATE / 1000 + 1;
+    link->delay = calloc(link->delay_len, sizeof(int16_t));
+    if (!link->queue || !link->burst_bytes || !link->burst || !link->delay) {
+        free(link->queue);
+        free(link->burst_bytes);
+        free(link->burst);
+        free(link->delay);
+        free(link);
+        return NULL;
+    }
+    return link;
+}
+
+static void link_destroy(link_t *link) {
+    if (!link) {
+        return;
+    }
+    free(link->queue);
+    free(link->burst_bytes);
+    free(link->burst);
+    free(link->delay);
+    free(link);
+}
+
+// Queue one packet for delivery after the channel delay, or lose it, or
+// corrupt its bytes from corrupt_from on
+static void link_queue_packet(const options_t *opt, link_t *link, const uint8_t *data, size_t len,
+                              size_t corrupt_from) {
+    link->sent++;
+    link->sent_bytes += len;
+    if (rng_uniform() < opt->loss) {
+        link->lost++;
+        return;
+    }
+    if (link->count == LINK_QUEUE_LEN) {
+        link->lost++;
+        return;
+    }
+    link_packet_t *packet = &link->queue[(link->head + link->count) % LINK_QUEUE_LEN];
+    link->count++;
+    packet->due_ms = g_sim_ms + (uint64_t)(opt->delay_ms > 0 ? opt->delay_ms : 0);
+    packet->len = len;
+    memcpy(packet->data, data, len);
+    if (opt->ber > 0.0) {
+        bool hit = false;
+        for (size_t i = corrupt_from; i < len; i++) {
+            if (rng_uniform() < opt->ber) {
+                packet->data[i] ^= (uint8_t)(1u << (rng_next() & 7));
+                hit = true;
+            }
+        }
+        link->corrupted += hit ? 1 : 0;
+    }
+}
+
+// Split the sender's outgoing bytes into transport frames and queue each
+// one as a packet. With --mtu each generate call returns one datagram,
+// which is the packet, and corruption may hit its segment headers too.
+static void link_send_bytes(const options_t *opt, link_t *link, nade_ctx_t *from) {
+    if (opt->link_mtu > 0) {
+        uint8_t datagram[LINK_MAX_PACKET];
+        size_t got;
+        while ((got = nade_ctx_generate_outgoing(from, datagram, min_size((size_t)opt->link_mtu,
+                                                                          sizeof(datagram)))) > 0) {
+            link_queue_packet(opt, link, datagram, got, 0);
+        }
+        return;
+    }
+    while (link->stage_len < sizeof(link->stage)) {
+        size_t got = nade_ctx_generate_outgoing(from, link->stage + link->stage_len,
+                                                sizeof(link->stage) - link->stage_len);
+        if (got == 0) {
+            break;
+        }
+        link->stage_len += got;
+    }
+    size_t offset = 0;
+    while (link->stage_len - offset >= 3) {
+        const uint8_t *frame = link->stage + offset;
+        size_t len = 3 + (size_t)(frame[1] | (frame[2] << 8));
+        if (len > LINK_MAX_PACKET || link->stage_len - offset < len) {
+            break;
+        }
+        offset += len;
+        // Corrupt bodies only, so the receiver stays aligned to frame boundaries
+        link_queue_packet(opt, link, frame, len, 3);
+    }
+    memmove(link->stage, link->stage + offset, link->stage_len - offset);
+    link->stage_len -= offset;
+}
+
+static void link_deliver_bytes(link_t *link, nade_ctx_t *to) {
+    while (link->count > 0 && link->queue[link->head].due_ms <= g_sim_ms) {
+        link_packet_t *packet = &link->queue[link->head];
+        nade_ctx_handle_incoming(to, packet->data, packet->len);
+        link->head = (link->head + 1) % LINK_QUEUE_LEN;
+        link->count--;
+    }
+}
+
+// Play one step of the sender's FSK bursts through the channel: fades,
+// additive noise and the delay line, then into the receiver's demodulator
+static void link_carry_audio(const options_t *opt, link_t *link, nade_ctx_t *from, nade_ctx_t *to) {
+    int16_t block[STEP_SAMPLES];
+    size_t filled = 0;
+    while (filled < STEP_SAMPLES) {
+        if (link->burst_pos == link->burst_len) {
+            size_t bytes = nade_ctx_pipeline_tx_pcm(from, link->burst_bytes, link->burst_max_bytes);
+            link->burst_len = bytes / 2;
+            link->burst_pos = 0;
+            link->burst_samples += link->burst_len;
+            for (size_t i = 0; i < link->burst_len; i++) {
+                link->burst[i] = (int16_t)(link->burst_bytes[2 * i] | (link->burst_bytes[2 * i + 1] << 8));
+            }
+            if (link->burst_len == 0) {
+                memset(block + filled, 0, (STEP_SAMPLES - filled) * sizeof(int16_t));
+                break;
+            }
+        }
+        size_t take = link->burst_len - link->burst_pos;
+        if (take > STEP_SAMPLES - filled) {
+            take = STEP_SAMPLES - filled;
+        }
+        memcpy(block + filled, link->burst + link->burst_pos, take * sizeof(int16_t));
+        link->burst_pos += take;
+        filled += take;
+    }
+    bool faded = rng_uniform() < opt->loss;
+    link->faded_blocks += faded ? 1 : 0;
+    double sigma = opt->noise_dbfs > -200.0 ? 32768.0 * pow(10.0, opt->noise_dbfs / 20.0) : 0.0;
+    uint8_t bytes[STEP_SAMPLES * 2];
+    for (size_t i = 0; i < STEP_SAMPLES; i++) {
+        double value = faded ? 0.0 : block[i];
+        if (sigma > 0.0) {
+            value += sigma * rng_gaussian();
+        }
+        int16_t delayed = link->delay[link->delay_pos];
+        link->delay[link->delay_pos] = clamp_sample(value);
+        link->delay_pos = (link->delay_pos + 1) % link->delay_len;
+        bytes[2 * i] = (uint8_t)(delayed & 0xFF);
+        bytes[2 * i + 1] = (uint8_t)(((uint16_t)delayed >> 8) & 0xFF);
+    }
+    nade_ctx_pipeline_rx_pcm(to, bytes, sizeof(bytes));
+}
+
+// Seconds the sender had the line during the call: the bursts played out,
+// less what the hang-up cut off of the last one
+static double link_on_air_seconds(const link_t *link) {
+    return (double)(link->burst_samples - (link->burst_len - link->burst_pos)) / SAMPLE_RATE;
+}
+
+// Seconds of bursts the sender still had queued at the hang-up, what it
+// owed the line beyond the call. Drains its transmit pipeline.
+static double link_drain_seconds(link_t *link, nade_ctx_t *from) {
+    uint64_t samples = 0;
+    for (size_t i = 0; i < LINK_DRAIN_BURSTS; i++) {
+        size_t bytes = nade_ctx_pipeline_tx_pcm(from, link->burst_bytes, link->burst_max_bytes);
+        if (bytes == 0) {
+            break;
+        }
+        samples += bytes / 2;
+    }
+    return (double)samples / SAMPLE_RATE;
+}
+
+// Feed the receiver one chunk of line audio holding a good burst, a burst
+// whose datagram is damaged and another good burst, each datagram carrying
+// a frame of a kind the parser skips. The chunk must be reported as having
+// a rejected frame, and the frames on both sides of it must still reach the
+// parser. Datagram transport over FSK only.
+static bool link_check_rejected_datagram(nade_ctx_t *from, nade_ctx_t *to) {
+    static const uint8_t frame[4] = {0x7F, 0x01, 0x00, 0x00};
+    uint8_t datagrams[3][NADE_DGRAM_HEADER_LEN + sizeof(frame)];
+    size_t datagram_len[3];
+    for (size_t i = 0; i < 3; i++) {
+        datagram_len[i] = nade_dgram_write_segment(datagrams[i], (uint8_t)i, 0, 1, frame, sizeof(frame));
+    }
+    // No sync byte: the segment, and so the datagram, is damaged
+    memset(datagrams[1], 0, datagram_len[1]);
+
+    uint8_t coded[3][NADE_FEC_MAX_FRAME];
+    size_t coded_len[3];
+    size_t total = 2 * REJECT_CHECK_GAP;
+    for (size_t i = 0; i < 3; i++) {
+        coded_len[i] = nade_fec_encode(datagrams[i], datagram_len[i], NADE_FEC_DEFAULT_PARITY,
+                                       coded[i], sizeof(coded[i]));
+        total += nade_ctx_fsk_samples_for_bytes(from, coded_len[i]);
+    }
+    int16_t *pcm = calloc(total, sizeof(int16_t));
+    uint8_t *bytes = malloc(total * 2);
+    if (!pcm || !bytes) {
+        free(pcm);
+        free(bytes);
+        return false;
+    }
+    size_t pos = REJECT_CHECK_GAP;
+    for (size_t i = 0; i < 3; i++) {
+        pos += nade_ctx_fsk_modulate(from, coded[i], coded_len[i], pcm + pos, total - pos);
+    }
+    for (size_t i = 0; i < total; i++) {
+        bytes[2 * i] = (uint8_t)(pcm[i] & 0xFF);
+        bytes[2 * i + 1] = (uint8_t)(((uint16_t)pcm[i] >> 8) & 0xFF);
+    }
+
+    nade_metrics_t before;
+    nade_metrics_t after;
+    nade_ctx_get_metrics(to, &before);
+    int rc = nade_ctx_pipeline_rx_pcm(to, bytes, total * 2);
+    nade_ctx_get_metrics(to, &after);
+    free(pcm);
+    free(bytes);
+    uint64_t parsed = after.rings[NADE_METRICS_RING_IN].pushed - before.rings[NADE_METRICS_RING_IN].pushed;
+    return rc == -1 && parsed == 2 * sizeof(frame);
+}
+
+// Samples this endpoint's audio clock produces during one step
+static size_t endpoint_step_samples(const options_t *opt, double rate, double *carry) {
+    *carry += (double)opt->audio_rate * STEP_MS / 1000.0 * rate;
+    size_t n = (size_t)*carry;
+    *carry -= (double)n;
+    return n < STEP_MAX_SAMPLES ? n : STEP_MAX_SAMPLES;
+}
+
+static void endpoint_feed_mic(const options_t *opt, endpoint_t *ep) {
+    int16_t pcm[STEP_MAX_SAMPLES];
+    size_t n = endpoint_step_samples(opt, ep->clock_rate, &ep->mic_carry);
+    uint64_t rate = (uint64_t)opt->audio_rate;
+    double samples_per_ms = (double)rate / 1000.0;
+    uint64_t period = (uint64_t)opt->period_ms * rate / 1000;
+    uint64_t offset = (uint64_t)ep->onset_offset_ms * rate / 1000;
+    uint64_t spurt = (uint64_t)SPURT_MS * rate / 1000;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t s = ep->mic_samples + i;
+        uint64_t phase = (s + period - offset % period) % period;
+        if (phase == 0 && ep->onset_count < MAX_ONSETS) {
+            // Onset time on the simulated clock, given this endpoint's clock rate
+            ep->onsets[ep->onset_count++] = (double)s / samples_per_ms / ep->clock_rate;
+        }
+        double value = phase < spurt ? voice_sample(phase, opt->audio_rate) : 0.0;
+        pcm[i] = clamp_sample(value + 30.0 * rng_gaussian());
+    }
+    ep->mic_samples += n;
+    nade_ctx_feed_mic(ep->ctx, pcm, n);
+}
+
+static void latency_add(latency_t *lat, double ms) {
+    if (lat->count == 0 || ms < lat->min_ms) {
+        lat->min_ms = ms;
+    }
+    if (lat->count == 0 || ms > lat->max_ms) {
+        lat->max_ms = ms;
+    }
+    lat->total_ms += ms;
+    lat->count++;
+}
+
+// Play one step at the listener and time any talk spurt that starts in it
+// against the talker's latest spurt
+static void endpoint_play(const options_t *opt, endpoint_t *listener, const endpoint_t *talker,
+                          latency_t *lat, uint64_t step_start_ms) {
+    int16_t pcm[STEP_MAX_SAMPLES];
+    size_t n = endpoint_step_samples(opt, listener->clock_rate, &listener->spk_carry);
+    int got = nade_ctx_pull_speaker(listener->ctx, pcm, n);
+    size_t played = got > 0 ? (size_t)got : 0;
+    if (played > 0 && !listener->heard_audio) {
+        listener->heard_audio = true;
+        listener->first_audio_ms = step_start_ms;
+    }
+    memset(pcm + played, 0, (n - played) * sizeof(int16_t));
+    listener->spk_samples += n;
+
+    uint64_t level = 0;
+    for (size_t i = 0; i < n; i++) {
+        level += (uint64_t)abs(pcm[i]);
+    }
+    bool quiet = n == 0 || level / n < QUIET_LEVEL;
+    if (!listener->in_spurt && listener->quiet_blocks >= QUIET_BLOCKS) {
+        for (size_t i = 0; i < n; i++) {
+            if (abs(pcm[i]) < ONSET_LEVEL) {
+                continue;
+            }
+            double heard_ms = (double)step_start_ms + (double)i / n * STEP_MS;
+            double spoken_ms = -1.0;
+            for (size_t k = talker->onset_count; k > 0; k--) {
+                if (talker->onsets[k - 1] <= heard_ms) {
+                    spoken_ms = talker->onsets[k - 1];
+                    break;
+                }
+            }
+            if (spoken_ms >= 0.0) {
+                latency_add(lat, heard_ms - spoken_ms);
+            } else {
+                lat->unmatched++;
+            }
+            listener->in_spurt = true;
+            break;
+        }
+    }
+    if (quiet) {
+        listener->quiet_blocks++;
+        listener->in_spurt = false;
+    } else {
+        listener->quiet_blocks = 0;
+    }
+}
+
+static void print_latency(const char *direction, const latency_t *lat, size_t spurts) {
+    if (lat->count == 0) {
+        printf("  latency %s        no spurts heard (%zu sent)\n", direction, spurts);
+        return;
+    }
+    printf("  latency %s        mean %.1f ms, min %.1f, max %.1f (%llu of %zu spurts heard",
+           direction, lat->total_ms / (double)lat->count, lat->min_ms, lat->max_ms,
+           (unsigned long long)lat->count, spurts);
+    if (lat->unmatched > 0) {
+        printf(", %llu unmatched", (unsigned long long)lat->unmatched);
+    }
+    printf(")\n");
+}
+
+static void print_endpoint_metrics(const endpoint_t *ep) {
+    nade_metrics_t m;
+    nade_ctx_get_metrics(ep->ctx, &m);
+    printf("  %s: handshake %llu ms, decoded %llu frames, played %llu, concealed %llu, "
+           "late %llu, rebuffers %llu, stretched %llu/%llu, decrypt failures %llu, "
+           "outgoing bytes dropped %llu\n",
+           ep->name,
+           (unsigned long long)m.handshake_last_ms,
+           (unsigned long long)m.stages[NADE_STAGE_CODEC_DECODE].count,
+           (unsigned long long)m.frames_played,
+           (unsigned long long)m.frames_concealed,
+           (unsigned long long)m.late_dropped,
+           (unsigned long long)m.rebuffers,
+           (unsigned long long)m.expanded,
+           (unsigned long long)m.compressed,
+           (unsigned long long)m.decrypt_failures,
+           (unsigned long long)m.rings[NADE_METRICS_RING_OUT].dropped);
+}
+
+// Report the negotiated codec and FSK profile from the trace, which records
+// changes away from the session defaults
+static void print_negotiation(const options_t *opt) {
+    static nade_trace_record_t records[NADE_TRACE_CAPACITY];
+    size_t count = nade_trace_dump(records, NADE_TRACE_CAPACITY);
+    int codec = NADE_CODEC_ADPCM4;
+    int profile = NADE_FSK_PROFILE_BASE;
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].event == NADE_EV_CODEC) {
+            codec = (int)records[i].arg0;
+        } else if (records[i].event == NADE_EV_FSK_PROFILE) {
+            profile = (int)records[i].arg0;
+        }
+    }
+    const nade_codec_info_t *info = nade_codec_info(codec);
+    printf("  codec             %s", info ? info->name : "none");
+    if (info) {
+        printf(" (%d bps)", info->bitrate);
+    }
+    if (opt->fsk && nade_fsk_profile(profile)) {
+        printf(", fsk %s (%d bps)", nade_fsk_profile(profile)->name, nade_fsk_profile_bitrate(profile));
+    }
+    printf("\n");
+}
+
+static void print_first_audio(const endpoint_t *a, const endpoint_t *b) {
+    const endpoint_t *endpoints[2] = {a, b};
+    printf("  first audio      ");
+    for (size_t i = 0; i < 2; i++) {
+        if (endpoints[i]->heard_audio) {
+            printf(" %s %llu ms", endpoints[i]->name, (unsigned long long)endpoints[i]->first_audio_ms);
+        } else {
+            printf(" %s none", endpoints[i]->name);
+        }
+        printf(i == 0 ? "," : " (from the call start)\n");
+    }
+}
+
+// One call between two set-up endpoints, starting at the current simulated
+// time. Returns 0 if both sides completed the handshake.
+static int run_call(const options_t *opt, endpoint_t *a, endpoint_t *b, const uint8_t pub_b[32], long call) {
+    link_t *a_to_b = link_create(opt);
+    link_t *b_to_a = link_create(opt);
+    if (!a_to_b || !b_to_a) {
+        fprintf(stderr, "loopback: allocation failed\n");
+        link_destroy(a_to_b);
+        link_destroy(b_to_a);
+        return 1;
+    }
+    endpoint_t *endpoints[2] = {a, b};
+    for (size_t i = 0; i < 2; i++) {
+        endpoint_t *ep = endpoints[i];
+        ep->mic_carry = 0.0;
+        ep->spk_carry = 0.0;
+        ep->mic_samples = 0;
+        ep->spk_samples = 0;
+        ep->onset_count = 0;
+        ep->quiet_blocks = 0;
+        ep->in_spurt = false;
+        ep->heard_audio = false;
+        ep->first_audio_ms = 0;
+        nade_ctx_reset_metrics(ep->ctx);
+    }
+    nade_trace_clear();
+    g_sim_ms += 1000;
+    uint64_t start_ms = g_sim_ms;
+    // Resuming needs the client to know whom it is calling
+    nade_ctx_start_session_client(a->ctx, opt->resume ? pub_b : NULL, opt->resume ? 32 : 0);
+    nade_ctx_start_session_server(b->ctx, NULL, 0);
+
+    latency_t a_to_b_latency = {0};
+    latency_t b_to_a_latency = {0};
+    uint64_t steps = (uint64_t)(opt->call_seconds * 1000.0 / STEP_MS);
+    double wall_start = now_seconds(CLOCK_MONOTONIC);
+    double cpu_start = now_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    for (uint64_t step = 0; step < steps; step++) {
+        g_sim_ms = start_ms + step * STEP_MS;
+        endpoint_feed_mic(opt, a);
+        endpoint_feed_mic(opt, b);
+        if (opt->fsk) {
+            link_carry_audio(opt, a_to_b, a->ctx, b->ctx);
+            link_carry_audio(opt, b_to_a, b->ctx, a->ctx);
+        } else {
+            link_send_bytes(opt, a_to_b, a->ctx);
+            link_send_bytes(opt, b_to_a, b->ctx);
+            link_deliver_bytes(a_to_b, b->ctx);
+            link_deliver_bytes(b_to_a, a->ctx);
+        }
+        endpoint_play(opt, b, a, &a_to_b_latency, g_sim_ms - start_ms);
+        endpoint_play(opt, a, b, &b_to_a_latency, g_sim_ms - start_ms);
+    }
+    double cpu = now_seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+    double wall = now_seconds(CLOCK_MONOTONIC) - wall_start;
+    double call_length = (double)steps * STEP_MS / 1000.0;
+
+    nade_metrics_t ma;
+    nade_metrics_t mb;
+    nade_ctx_get_metrics(a->ctx, &ma);
+    nade_ctx_get_metrics(b->ctx, &mb);
+    uint64_t frames = ma.stages[NADE_STAGE_CODEC_DECODE].count + mb.stages[NADE_STAGE_CODEC_DECODE].count;
+
+    printf("loopback over %s: %.1f s call simulated in %.3f s (%.0fx real time)",
+           opt->fsk ? "fsk audio" : "byte link", call_length, wall, wall > 0.0 ? call_length / wall : 0.0);
+    if (opt->calls > 1) {
+        printf(", call %ld of %ld", call + 1, opt->calls);
+    }
+    printf("\n");
+    printf("  channel           delay %ld ms, loss %.3f, ", opt->delay_ms, opt->loss);
+    if (opt->fsk) {
+        if (opt->noise_dbfs > -200.0) {
+            printf("noise %.1f dBFS, ", opt->noise_dbfs);
+        } else {
+            printf("no noise, ");
+        }
+    } else {
+        printf("ber %.2g, ", opt->ber);
+    }
+    printf("drift %.0f ppm\n", opt->drift_ppm);
+    print_negotiation(opt);
+    printf("  frames/s          %.0f decoded (both endpoints, wall clock)\n",
+           wall > 0.0 ? (double)frames / wall : 0.0);
+    printf("  cpu               %.3f ms per call-second (both endpoints and the channel)\n",
+           call_length > 0.0 ? cpu * 1000.0 / call_length : 0.0);
+    print_first_audio(a, b);
+    print_latency("a->b", &a_to_b_latency, a->onset_count);
+    print_latency("b->a", &b_to_a_latency, b->onset_count);
+    print_endpoint_metrics(a);
+    print_endpoint_metrics(b);
+    if (!opt->fsk) {
+        printf("  link a->b: %llu frames (%llu bytes), %llu lost, %llu corrupted; "
+               "b->a: %llu frames (%llu bytes), %llu lost, %llu corrupted\n",
+               (unsigned long long)a_to_b->sent, (unsigned long long)a_to_b->sent_bytes,
+               (unsigned long long)a_to_b->lost, (unsigned long long)a_to_b->corrupted,
+               (unsigned long long)b_to_a->sent, (unsigned long long)b_to_a->sent_bytes,
+               (unsigned long long)b_to_a->lost, (unsigned long long)b_to_a->corrupted);
+    }
+    double a_air = 0.0;
+    double b_air = 0.0;
+    if (opt->fsk) {
+        double a_owed = link_drain_seconds(a_to_b, a->ctx);
+        double b_owed = link_drain_seconds(b_to_a, b->ctx);
+        a_air = link_on_air_seconds(a_to_b);
+        b_air = link_on_air_seconds(b_to_a);
+        printf("  link a->b: %.1f s on air, %.1f s queued at hang-up, %llu faded blocks; "
+               "b->a: %.1f s on air, %.1f s queued at hang-up, %llu faded blocks\n",
+               a_air, a_owed, (unsigned long long)a_to_b->faded_blocks,
+               b_air, b_owed, (unsigned long long)b_to_a->faded_blocks);
+        a_air += a_owed;
+        b_air += b_owed;
+    }
+
+    bool connected = ma.handshakes > 0 && mb.handshakes > 0;
+    // A call that connected with time to talk must have carried speech. The
+    // handshake alone takes seconds over FSK, so shorter calls are let off.
+    bool speechless = false;
+    uint64_t handshake_ms = ma.handshake_last_ms > mb.handshake_last_ms ? ma.handshake_last_ms : mb.handshake_last_ms;
+    if (connected && call_length * 1000.0 >= (double)(handshake_ms + SPEECH_MIN_MS)) {
+        speechless = frames == 0 || a_to_b_latency.count + b_to_a_latency.count == 0;
+    }
+    bool rejects_ok = true;
+    if (opt->fsk && opt->link_mtu > 0 && connected) {
+        rejects_ok = link_check_rejected_datagram(a->ctx, b->ctx);
+        printf("  rx rejects        damaged datagram mid-chunk %s\n",
+               rejects_ok ? "reported, later frames parsed" : "MISHANDLED");
+    }
+    // On a clean channel the modem must keep up with the call: more time on
+    // air, counting what was still queued at the hang-up, than the call
+    // lasted means the codec and batching overrun the link
+    bool overrun = false;
+    if (opt->fsk && connected && opt->noise_dbfs <= -200.0 && opt->loss <= 0.0) {
+        overrun = a_air > call_length || b_air > call_length;
+    }
+    nade_ctx_stop_session(a->ctx);
+    nade_ctx_stop_session(b->ctx);
+    // What the app does after every call
+    nade_ctx_prepare_ephemerals(a->ctx);
+    nade_ctx_prepare_ephemerals(b->ctx);
+    link_destroy(a_to_b);
+    link_destroy(b_to_a);
+    if (!connected) {
+        fprintf(stderr, "loopback: handshake did not complete\n");
+        return 1;
+    }
+    if (speechless) {
+        fprintf(stderr, "loopback: %s\n", frames == 0 ? "no audio frames decoded" : "no talk spurt heard");
+        return 1;
+    }
+    if (overrun) {
+        fprintf(stderr, "loopback: more time on air than the call lasted on a clean channel\n");
+        return 1;
+    }
+    if (!rejects_ok) {
+        fprintf(stderr, "loopback: a damaged datagram was not reported or cost the frames after it\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int run_loopback(const options_t *opt) {
+    uint8_t seed_a[32];
+    uint8_t seed_b[32];
+    for (size_t i = 0; i < 32; i++) {
+        seed_a[i] = (uint8_t)(rng_next() & 0xFF);
+        seed_b[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    uint8_t pub_b[32];
+    crypto_x25519_public_key(pub_b, seed_b);
+    static endpoint_t a;
+    static endpoint_t b;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    a.name = "a";
+    b.name = "b";
+    a.ctx = nade_ctx_create(seed_a);
+    b.ctx = nade_ctx_create(seed_b);
+    if (!a.ctx || !b.ctx) {
+        fprintf(stderr, "loopback: allocation failed\n");
+        nade_ctx_destroy(a.ctx);
+        nade_ctx_destroy(b.ctx);
+        return 1;
+    }
+    // Endpoint a's audio clock runs drift ppm fast against b's and the channel
+    a.clock_rate = 1.0 + opt->drift_ppm * 1e-6;
+    b.clock_rate = 1.0;
+    a.onset_offset_ms = 100;
+    b.onset_offset_ms = 100 + opt->period_ms / 2;
+
+    char config[256];
+    snprintf(config, sizeof(config),
+             "{\"fsk_profiles\":%ld,\"audio_batch_ms\":%ld,\"audio_codec\":\"%s\",\"resume\":%s,\"dtx\":%s,"
+             "\"audio_rate\":%ld,\"link_mtu\":%ld}",
+             opt->profiles, opt->batch_ms, opt->codec ? opt->codec : "auto", opt->resume ? "true" : "false",
+             opt->no_dtx ? "false" : "true", opt->audio_rate, opt->link_mtu);
+    endpoint_t *endpoints[2] = {&a, &b};
+    for (size_t i = 0; i < 2; i++) {
+        nade_ctx_set_clock(endpoints[i]->ctx, sim_clock, NULL);
+        nade_ctx_set_config(endpoints[i]->ctx, config);
+        nade_ctx_fsk_set_enabled(endpoints[i]->ctx, opt->fsk);
+        nade_ctx_fsk_set_shaping(endpoints[i]->ctx, opt->shaped);
+        nade_ctx_prepare_ephemerals(endpoints[i]->ctx);
+    }
+    g_sim_ms = 0;
+    if (opt->capture_path && nade_ctx_capture_start(b.ctx, opt->capture_path, CAPTURE_MAX_BYTES,
+                                                   opt->line_audio) != 0) {
+        fprintf(stderr, "loopback: cannot capture to %s\n", opt->capture_path);
+        nade_ctx_destroy(a.ctx);
+        nade_ctx_destroy(b.ctx);
+        return 1;
+    }
+    int rc = 0;
+    for (long call = 0; call < opt->calls && rc == 0; call++) {
+        rc = run_call(opt, &a, &b, pub_b, call);
+    }
+    if (opt->capture_path) {
+        nade_ctx_capture_stop(b.ctx);
+        printf("  capture           endpoint b written to %s\n", opt->capture_path);
+    }
+    nade_ctx_destroy(a.ctx);
+    nade_ctx_destroy(b.ctx);
+    return rc;
+}
+
+// -------------------------------------------------------------------------
+// Capture replay
+
+#define REPLAY_KINDS (NADE_CAPTURE_MOD_OUT + 1)
+
+static const char *const replay_kind_names[REPLAY_KINDS] = {
+    "end", "config", "settings", "session", "mic", "speaker", "transport in",
+    "transport out", "line in", "line out", "fsk in", "demod in", "mod out",
+};
+
+typedef struct {
+    uint64_t records[REPLAY_KINDS];
+    uint64_t bytes[REPLAY_KINDS];   // Payload bytes recorded
+    uint64_t replayed_out;          // Bytes the replay produced where the capture has transport out
+    uint64_t replayed_line;         // Line audio bytes the replay produced
+    uint64_t played;                // Speaker samples the replay produced
+} replay_stats_t;
+
+static bool read_file(const char *path, uint8_t **data, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fseek(f, 0, SEEK_END) == 0;
+    long end = ok ? ftell(f) : -1;
+    ok = end >= 0 && fseek(f, 0, SEEK_SET) == 0;
+    *data = ok ? malloc(end > 0 ? (size_t)end : 1) : NULL;
+    ok = *data && fread(*data, 1, (size_t)end, f) == (size_t)end;
+    fclose(f);
+    if (!ok) {
+        free(*data);
+        *data = NULL;
+        return false;
+    }
+    *size = (size_t)end;
+    return true;
+}
+
+static void le_to_pcm(const uint8_t *bytes, size_t samples, int16_t *pcm) {
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = (int16_t)(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+    }
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Sleep until ms after the wall-clock start
+static void replay_pace(double wall_start, uint32_t ms) {
+    double wait = wall_start + ms / 1000.0 - now_seconds(CLOCK_MONOTONIC);
+    if (wait > 0.0) {
+        struct timespec ts = {(time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9)};
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Drive the context with one record: inputs are fed, outputs are pulled as
+// the app pulled them, and what the pipelines recovered or produced is only
+// counted since the replay makes it anew
+static void replay_record(nade_ctx_t *ctx, const nade_capture_record_t *rec, uint8_t *scratch,
+                          size_t scratch_len, replay_stats_t *stats) {
+    int16_t *pcm = (int16_t *)scratch;
+    size_t samples = min_size(rec->len / 2, scratch_len / sizeof(int16_t));
+    switch (rec->kind) {
+    case NADE_CAPTURE_CONFIG: {
+        char *json = malloc(rec->len + 1);
+        if (json) {
+            memcpy(json, rec->data, rec->len);
+            json[rec->len] = 0;
+            nade_ctx_set_config(ctx, json);
+            free(json);
+        }
+        break;
+    }
+    case NADE_CAPTURE_SETTINGS:
+        if (rec->len >= 3) {
+            nade_ctx_fsk_set_enabled(ctx, rec->data[0] != 0);
+            nade_ctx_rs_set_enabled(ctx, rec->data[1] != 0);
+            nade_ctx_fsk_set_shaping(ctx, rec->data[2] != 0);
+        }
+        break;
+    case NADE_CAPTURE_SESSION:
+        if (rec->len < 1 || rec->data[0] == NADE_CAPTURE_ROLE_STOP) {
+            nade_ctx_stop_session(ctx);
+        } else if (rec->data[0] == NADE_CAPTURE_ROLE_SERVER) {
+            nade_ctx_start_session_server(ctx, NULL, 0);
+        } else {
+            nade_ctx_start_session_client(ctx, NULL, 0);
+        }
+        break;
+    case NADE_CAPTURE_MIC:
+        le_to_pcm(rec->data, samples, pcm);
+        nade_ctx_feed_mic(ctx, pcm, samples);
+        break;
+    case NADE_CAPTURE_SPEAKER:
+        if (rec->len >= 4) {
+            size_t want = min_size(le32(rec->data), scratch_len / sizeof(int16_t));
+            int got = nade_ctx_pull_speaker(ctx, pcm, want);
+            stats->played += got > 0 ? (uint64_t)got : 0;
+        }
+        break;
+    case NADE_CAPTURE_TRANSPORT_IN:
+        nade_ctx_handle_incoming(ctx, rec->data, rec->len);
+        break;
+    case NADE_CAPTURE_TRANSPORT_OUT:
+        stats->replayed_out += nade_ctx_generate_outgoing(ctx, scratch, min_size(rec->len, scratch_len));
+        break;
+    case NADE_CAPTURE_LINE_IN:
+        nade_ctx_pipeline_rx_pcm(ctx, rec->data, rec->len);
+        break;
+    case NADE_CAPTURE_LINE_OUT:
+        stats->replayed_line += nade_ctx_pipeline_tx_pcm(ctx, scratch, scratch_len);
+        break;
+    case NADE_CAPTURE_FSK_IN: {
+        le_to_pcm(rec->data, samples, pcm);
+        nade_ctx_fsk_feed_audio(ctx, pcm, samples);
+        uint8_t bytes[1024];
+        size_t got;
+        while ((got = nade_ctx_fsk_pull_demodulated(ctx, bytes, sizeof(bytes))) > 0) {
+            nade_ctx_handle_incoming(ctx, bytes, got);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static int run_replay(const options_t *opt) {
+    uint8_t *file = NULL;
+    size_t size = 0;
+    nade_capture_reader_t reader;
+    if (!read_file(opt->replay_path, &file, &size) || !nade_capture_reader_init(&reader, file, size)) {
+        fprintf(stderr, "replay: %s is not a capture\n", opt->replay_path);
+        free(file);
+        return 1;
+    }
+    uint8_t seed[32];
+    for (size_t i = 0; i < 32; i++) {
+        seed[i] = (uint8_t)(rng_next() & 0xFF);
+    }
+    // Outputs are pulled at most as large as the largest line burst
+    size_t scratch_len = nade_pipeline_tx_max_bytes();
+    if (scratch_len < LINK_STAGE_BYTES) {
+        scratch_len = LINK_STAGE_BYTES;
+    }
+    uint8_t *scratch = malloc(scratch_len);
+    static endpoint_t ep;
+    memset(&ep, 0, sizeof(ep));
+    ep.name = "replay";
+    ep.ctx = nade_ctx_create(seed);
+    if (!scratch || !ep.ctx) {
+        fprintf(stderr, "replay: allocation failed\n");
+        free(scratch);
+        free(file);
+        nade_ctx_destroy(ep.ctx);
+        return 1;
+    }
+    g_sim_ms = 0;
+    nade_ctx_set_clock(ep.ctx, sim_clock, NULL);
+    nade_ctx_prepare_ephemerals(ep.ctx);
+
+    replay_stats_t stats = {0};
+    nade_capture_record_t rec;
+    uint32_t last_ms = 0;
+    double wall_start = now_seconds(CLOCK_MONOTONIC);
+    double cpu_start = now_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    while (nade_capture_next(&reader, &rec)) {
+        if (opt->realtime) {
+            replay_pace(wall_start, rec.time_ms);
+        }
+        g_sim_ms = rec.time_ms;
+        last_ms = rec.time_ms;
+        if (rec.kind < REPLAY_KINDS) {
+            stats.records[rec.kind]++;
+            stats.bytes[rec.kind] += rec.len;
+        }
+        replay_record(ep.ctx, &rec, scratch, scratch_len, &stats);
+    }
+    double cpu = now_seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+    double wall = now_seconds(CLOCK_MONOTONIC) - wall_start;
+    double length = last_ms / 1000.0;
+
+    printf("replay of %s: %.1f s capture replayed in %.3f s (%.0fx real time)\n", opt->replay_path, length,
+           wall, wall > 0.0 ? length / wall : 0.0);
+    if (reader.dropped > 0 || reader.offset < size) {
+        printf("  capture           %u records dropped when recorded, %zu bytes unread\n", reader.dropped,
+               size - reader.offset);
+    }
+    for (size_t kind = 1; kind < REPLAY_KINDS; kind++) {
+        if (stats.records[kind] > 0) {
+            printf("  %-17s %llu records, %llu bytes\n", replay_kind_names[kind],
+                   (unsigned long long)stats.records[kind], (unsigned long long)stats.bytes[kind]);
+        }
+    }
+    printf("  produced          %llu transport bytes, %llu line bytes, %llu speaker samples\n",
+           (unsigned long long)stats.replayed_out, (unsigned long long)stats.replayed_line,
+           (unsigned long long)stats.played);
+    printf("  cpu               %.3f ms per capture-second\n", length > 0.0 ? cpu * 1000.0 / length : 0.0);
+    print_endpoint_metrics(&ep);
+    nade_ctx_destroy(ep.ctx);
+    free(scratch);
+    free(file);
+    return 0;
+}
+
+// -------------------------------------------------------------------------
+// Command line
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--quick] [--micro | --loopback] [options]\n"
+            "  --min-ms N        measuring time per microbenchmark (default 200)\n"
+            "  --seconds N       simulated call length (default 20)\n"
+            "  --fsk             carry the call as FSK audio instead of a byte link\n"
+            "  --shaped          raised-cosine FSK tone transitions\n"
+            "  --profiles MASK   FSK profile mask (default all)\n"
+            "  --codec NAME      fixed codec (adpcm4, lpc1200, ...) instead of auto\n"
+            "  --batch-ms N      audio batching window (default 0)\n"
+            "  --no-dtx          send silent mic frames instead of silence descriptors\n"
+            "  --noise DBFS      white noise on the FSK channel, e.g. -30\n"
+            "  --loss P          frame loss (byte link) or 20 ms fade (FSK) probability\n"
+            "  --ber P           per-byte corruption probability on the byte link\n"
+            "  --mtu N           datagram transport of N-byte packets (byte link, FSK with RS)\n"
+            "  --drift PPM       endpoint a's audio clock offset\n"
+            "  --delay MS        one-way channel delay (default 20)\n"
+            "  --period MS       talk spurt period for latency probes (default 2000)\n"
+            "  --seed N          random seed\n"
+            "  --calls N         calls in a row between the same endpoints (default 1)\n"
+            "  --resume          resume later calls from the previous call's secret\n"
+            "  --audio-rate HZ   endpoint mic and speaker rate (default 8000)\n"
+            "  --capture PATH    record endpoint b of the loopback to a capture file\n"
+            "  --line-audio      capture FSK line audio as heard, handshakes included\n"
+            "  --replay PATH     replay a capture instead of benchmarking\n"
+            "  --realtime        replay at the pace the capture was recorded\n",
+            argv0);
+}
+
+static bool parse_options(int argc, char **argv, options_t *opt) {
+    *opt = (options_t){
+        .run_micro = true,
+        .run_loopback = true,
+        .min_seconds = 0.2,
+        .call_seconds = 20.0,
+        .profiles = NADE_FSK_PROFILE_MASK_ALL,
+        .noise_dbfs = -1000.0,
+        .delay_ms = 20,
+        .period_ms = 2000,
+        .seed = 1,
+        .calls = 1,
+        .audio_rate = NADE_CODEC_RATE,
+    };
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--quick") == 0) {
+            opt->min_seconds = 0.01;
+            opt->call_seconds = 5.0;
+        } else if (strcmp(arg, "--micro") == 0) {
+            opt->run_loopback = false;
+        } else if (strcmp(arg, "--loopback") == 0) {
+            opt->run_micro = false;
+        } else if (strcmp(arg, "--fsk") == 0) {
+            opt->fsk = true;
+        } else if (strcmp(arg, "--shaped") == 0) {
+            opt->shaped = true;
+        } else if (strcmp(arg, "--resume") == 0) {
+            opt->resume = true;
+        } else if (strcmp(arg, "--no-dtx") == 0) {
+            opt->no_dtx = true;
+        } else if (strcmp(arg, "--realtime") == 0) {
+            opt->realtime = true;
+        } else if (strcmp(arg, "--line-audio") == 0) {
+            opt->line_audio = true;
+        } else if (!value) {
+            return false;
+        } else if (strcmp(arg, "--min-ms") == 0) {
+            opt->min_seconds = atof(value) / 1000.0;
+            i++;
+        } else if (strcmp(arg, "--seconds") == 0) {
+            opt->call_seconds = atof(value);
+            i++;
+        } else if (strcmp(arg, "--profiles") == 0) {
+            opt->profiles = strtol(value, NULL, 0);
+            i++;
+        } else if (strcmp(arg, "--codec") == 0) {
+            opt->codec = value;
+            i++;
+        } else if (strcmp(arg, "--batch-ms") == 0) {
+            opt->batch_ms = atol(value);
+            i++;
+        } else if (strcmp(arg, "--noise") == 0) {
+            opt->noise_dbfs = atof(value);
+            i++;
+        } else if (strcmp(arg, "--loss") == 0) {
+            opt->loss = atof(value);
+            i++;
+        } else if (strcmp(arg, "--ber") == 0) {
+            opt->ber = atof(value);
+            i++;
+        } else if (strcmp(arg, "--mtu") == 0) {
+            opt->link_mtu = atol(value);
+            i++;
+        } else if (strcmp(arg, "--drift") == 0) {
+            opt->drift_ppm = atof(value);
+            i++;
+        } else if (strcmp(arg, "--delay") == 0) {
+            opt->delay_ms = atol(value);
+            i++;
+        } else if (strcmp(arg, "--period") == 0) {
+            opt->period_ms = atol(value);
+            i++;
+        } else if (strcmp(arg, "--seed") == 0) {
+            opt->seed = strtoull(value, NULL, 0);
+            i++;
+        } else if (strcmp(arg, "--calls") == 0) {
+            opt->calls = atol(value);
+            i++;
+        } else if (strcmp(arg, "--audio-rate") == 0) {
+            opt->audio_rate = atol(value);
+            i++;
+        } else if (strcmp(arg, "--capture") == 0) {
+            opt->capture_path = value;
+            i++;
+        } else if (strcmp(arg, "--replay") == 0) {
+            opt->replay_path = value;
+            i++;
+        } else {
+            return false;
+        }
+    }
+    if (opt->calls < 1) {
+        opt->calls = 1;
+    }
+    if (opt->period_ms < 2 * SPURT_MS) {
+        opt->period_ms = 2 * SPURT_MS;
+    }
+    if (opt->drift_ppm < -100000.0 || opt->drift_ppm > 100000.0) {
+        return false;
+    }
+    if (opt->audio_rate < NADE_RESAMPLE_MIN_RATE || opt->audio_rate > NADE_RESAMPLE_MAX_RATE) {
+        return false;
+    }
+    if (opt->link_mtu < 0 || (size_t)opt->link_mtu > LINK_MAX_PACKET) {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    options_t opt;
+    if (!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    g_rng_state ^= opt.seed * 0xD1B54A32D192ED03ULL;
+    if (g_rng_state == 0) {
+        g_rng_state = 1;
+    }
+    if (opt.replay_path) {
+        return run_replay(&opt);
+    }
+    if (opt.run_micro) {
+        run_codec_benchmarks(&opt);
+        run_resample_benchmarks(&opt);
+        run_rs_benchmarks(&opt);
+        run_fec_benchmarks(&opt);
+        run_fsk_benchmarks(&opt);
+        run_aead_benchmarks(&opt);
+    }
+    int rc = 0;
+    if (opt.run_loopback) {
+        rc = run_loopback(&opt);
+    }
+    return rc;
+}
@@ -0,0 +1,60 @@
+/*
+ * ChaCha20-Poly1305 (RFC 8439) record sealing for NADE
+ *
+ * Every sealed record goes through here. Two backends produce identical
+ * output:
+ *   - "portable": monocypher's crypto_aead_* (always available)
+ *   - "sse2" / "neon": four ChaCha20 blocks per pass as vector lanes,
+ *     which covers the Poly1305 key block and the first 192 bytes of a
+ *     record in one pass, and a 64-bit limb Poly1305 where the compiler
+ *     has 128-bit products
+ * The best backend the CPU supports is picked on first use (32-bit ARM
+ * checks for NEON at run time); nade_aead_select_backend() overrides the
+ * choice, for benchmarks.
+ *
+ * Records are sealed in place with the tag kept separately; no AD in the
+ * calls below means an empty AD.
+ */
+
+#ifndef NADE_AEAD_H
+#define NADE_AEAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_AEAD_KEY_LEN       32
+#define NADE_AEAD_NONCE_LEN     12
+#define NADE_AEAD_TAG_LEN       16
+
+// Encrypt len bytes of text in place and write the tag
+void nade_aead_seal(const uint8_t key[NADE_AEAD_KEY_LEN], const uint8_t nonce[NADE_AEAD_NONCE_LEN],
+                    const uint8_t *ad, size_t ad_len, uint8_t *text, size_t len,
+                    uint8_t tag[NADE_AEAD_TAG_LEN]);
+
+// Check the tag and decrypt len bytes of text in place. Returns 0 on
+// success, -1 on a forgery, which leaves text untouched.
+int nade_aead_open(const uint8_t key[NADE_AEAD_KEY_LEN], const uint8_t nonce[NADE_AEAD_NONCE_LEN],
+                   const uint8_t *ad, size_t ad_len, uint8_t *text, size_t len,
+                   const uint8_t tag[NADE_AEAD_TAG_LEN]);
+
+// Name of the backend in use
+const char *nade_aead_backend(void);
+
+// Names of the backends this build and CPU can run, best first; NULL past
+// the end
+const char *nade_aead_backend_name(int index);
+
+// Switch to the named backend, or back to the best one with "auto".
+// Returns false (and keeps the current one) if it is not available.
+bool nade_aead_select_backend(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_AEAD_H
@@ -0,0 +1,69 @@
+/*
+ * Native audio engine for NADE on AAudio
+ *
+ * Opens a low-latency input and output stream, exclusive where the device
+ * allows it, whose real-time callbacks feed the context's mic ring and
+ * drain its speaker ring directly: the Java audio stack's buffering and
+ * the two JVM audio threads drop out of the path. The callbacks take no
+ * lock; a refill thread of the engine plays out the jitter buffer into the
+ * speaker ring ahead of them. The app keeps only the lifecycle.
+ *
+ * AAudio is loaded at run time, so the library still loads on API levels
+ * without it (and on hosts); opening then fails and the caller keeps its
+ * own audio path. Streams open at the device's native rate when the
+ * resampler supports it, which is the rate that gets the fast path; the
+ * caller passes that rate to set_config ("audio_rate") before starting.
+ *
+ * A stream lost to a route change (headset, Bluetooth) is reopened before
+ * long by the engine's service thread at the same rate.
+ *
+ * Open, start and close are not thread-safe against each other.
+ */
+
+#ifndef NADE_AUDIO_H
+#define NADE_AUDIO_H
+
+#include <stdbool.h>
+
+#include "nade_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct nade_audio nade_audio_t;
+
+typedef struct {
+    int sample_rate;            // Both streams
+    int mic_burst;              // Frames per callback
+    int spk_burst;
+    int spk_buffer;             // Frames queued at the speaker
+    bool exclusive;             // Both streams got exclusive mode
+    bool low_latency;           // Both streams got the low-latency path
+} nade_audio_info_t;
+
+// Whether AAudio can be loaded on this device
+bool nade_audio_available(void);
+
+// Open, but do not start, streams driving ctx. preferred_rate is used when
+// the native rate cannot be resampled. Returns NULL if AAudio is missing,
+// another engine is open on ctx or either stream fails to open.
+nade_audio_t *nade_audio_open(nade_ctx_t *ctx, int preferred_rate);
+
+void nade_audio_get_info(const nade_audio_t *audio, nade_audio_info_t *out);
+
+int nade_audio_start(nade_audio_t *audio);
+
+// Stop and close the streams; no callback runs once this returns
+void nade_audio_close(nade_audio_t *audio);
+
+// Stop any engine still driving ctx, as nade_ctx_destroy does before it
+// frees the context. The handle stays valid until nade_audio_close, which
+// then only frees it; starting it again fails.
+void nade_audio_detach(nade_ctx_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_AUDIO_H
@@ -0,0 +1,116 @@
+/*
+ * Binary session capture for NADE
+ *
+ * A capture file records what crossed the core's boundary during a call,
+ * so a field problem can be replayed and profiled offline. It is a fixed
+ * header followed by length-prefixed records, all little-endian:
+ *
+ *   header   magic "NADECAP\0", u32 version, u32 header bytes,
+ *            u64 wall clock at the start (Unix ms), u32 records dropped,
+ *            u32 reserved
+ *   record   u8 kind, u24 payload bytes, u32 ms since the start on the
+ *            context's clock, the payload, zero padding to 4 bytes
+ *
+ * A record of kind 0 ends the file early. PCM payloads are mono 16-bit
+ * samples. Captures hold no secrets: handshake frames have their keys,
+ * ticket and echo zeroed, and a session start records only whether a peer
+ * key was expected. Line audio over FSK would still carry the handshake, so
+ * a transmitted burst with handshake bytes in it is recorded as silence of
+ * the same length, and received line audio, which cannot be matched to its
+ * frames before it is demodulated, is left out. A capture started with line
+ * audio opted in keeps all of it as heard and is not redacted.
+ *
+ * The writer appends into a memory-mapped file of a size fixed when it is
+ * opened. Any thread may append: a record claims its space with one
+ * fetch-add, and records that do not fit are counted and dropped. The
+ * caller must stop all appends before closing.
+ */
+
+#ifndef NADE_CAPTURE_H
+#define NADE_CAPTURE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_CAPTURE_VERSION 1
+#define NADE_CAPTURE_HEADER_LEN 32
+#define NADE_CAPTURE_RECORD_HEADER 8
+#define NADE_CAPTURE_MAX_PAYLOAD 0xFFFFFF
+
+// Record kinds and their payloads. Kinds are stable: captures are decoded
+// offline.
+typedef enum {
+    NADE_CAPTURE_END = 0,
+    NADE_CAPTURE_CONFIG = 1,        // JSON as passed to set_config; the first one is a snapshot
+    NADE_CAPTURE_SETTINGS = 2,      // u8 FSK enabled, u8 Reed-Solomon enabled, u8 shaped tones
+    NADE_CAPTURE_SESSION = 3,       // u8 role (0 stop, 1 server, 2 client), u8 expects a peer key
+    NADE_CAPTURE_MIC = 4,           // PCM fed to the mic, at the device rate
+    NADE_CAPTURE_SPEAKER = 5,       // u32 samples asked of the speaker
+    NADE_CAPTURE_TRANSPORT_IN = 6,  // Bytes passed to handle_incoming
+    NADE_CAPTURE_TRANSPORT_OUT = 7, // Bytes returned by generate_outgoing
+    NADE_CAPTURE_LINE_IN = 8,       // PCM passed to the receive pipeline, with line audio only
+    NADE_CAPTURE_LINE_OUT = 9,      // PCM of a burst from the transmit pipeline
+    NADE_CAPTURE_FSK_IN = 10,       // PCM passed to fsk_feed_audio, with line audio only
+    NADE_CAPTURE_DEMOD_IN = 11,     // Frame bytes the receive pipeline recovered from line audio
+    NADE_CAPTURE_MOD_OUT = 12,      // Frame bytes the transmit pipeline put into a burst
+} nade_capture_kind_t;
+
+#define NADE_CAPTURE_ROLE_STOP 0
+#define NADE_CAPTURE_ROLE_SERVER 1
+#define NADE_CAPTURE_ROLE_CLIENT 2
+
+typedef struct {
+    uint8_t *base;              // Mapped file
+    size_t capacity;
+    _Atomic size_t used;        // Bytes claimed, header included; may run past capacity
+    _Atomic uint32_t dropped;   // Records that did not fit
+    int fd;
+} nade_capture_t;
+
+// Create (or truncate) path as a capture of max_bytes at most. Returns false
+// if the file cannot be created or mapped.
+bool nade_capture_open(nade_capture_t *cap, const char *path, size_t max_bytes);
+
+// Claim room for one record and return its payload, for the caller to fill
+// before closing; NULL if it does not fit
+uint8_t *nade_capture_append(nade_capture_t *cap, uint8_t kind, uint32_t time_ms, size_t len);
+
+// Append one record holding a copy of data
+void nade_capture_write(nade_capture_t *cap, uint8_t kind, uint32_t time_ms, const void *data, size_t len);
+
+// Write the drop count, trim the file to the records kept and unmap it.
+// Returns the bytes kept.
+size_t nade_capture_close(nade_capture_t *cap);
+
+typedef struct {
+    uint8_t kind;
+    uint32_t time_ms;
+    const uint8_t *data;
+    size_t len;
+} nade_capture_record_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+    uint64_t start_unix_ms;
+    uint32_t dropped;
+} nade_capture_reader_t;
+
+// Read a capture held in memory. Returns false if it has no valid header.
+bool nade_capture_reader_init(nade_capture_reader_t *reader, const void *data, size_t size);
+
+// The next record, or false at the end (or at a record cut short)
+bool nade_capture_next(nade_capture_reader_t *reader, nade_capture_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_CAPTURE_H
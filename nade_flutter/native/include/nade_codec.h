@@ -0,0 +1,117 @@
+/*
+ * Voice codecs for NADE audio frames
+ *
+ * Every audio payload names its codec in the "codec version" byte, so a
+ * receiver decodes whatever the sender picked. Codec ids are stable wire
+ * values; id 1 is the original 4-bit IMA ADPCM.
+ *
+ *   adpcm4   IMA ADPCM, 4 bits/sample           32.8 kbit/s
+ *   adpcm3   IMA-style ADPCM, 3 bits/sample     24.8 kbit/s
+ *   adpcm2   IMA-style ADPCM, 2 bits/sample     16.8 kbit/s
+ *   lpc2400  LPC-10 style vocoder, 20 ms frames  2.4 kbit/s
+ *   lpc1200  LPC-10 style vocoder, 40 ms frames  1.2 kbit/s
+ *   adpcm4wb IMA ADPCM at 16 kHz                64.8 kbit/s
+ *
+ * Every codec works on 40 ms frames of mono PCM at its sample rate:
+ * NADE_CODEC_FRAME_SAMPLES at 8 kHz, twice that for the wideband one. ADPCM
+ * blocks start with the predictor and step index, so they decode without
+ * prior state. The vocoder sends, per analysis frame, 10 reflection
+ * coefficients, a gain and a pitch period (0 = unvoiced) and resynthesises
+ * from a pulse-train or noise excitation.
+ */
+
+#ifndef NADE_CODEC_H
+#define NADE_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    NADE_CODEC_NONE = 0,
+    NADE_CODEC_ADPCM4 = 1,
+    NADE_CODEC_ADPCM3 = 2,
+    NADE_CODEC_ADPCM2 = 3,
+    NADE_CODEC_LPC2400 = 4,
+    NADE_CODEC_LPC1200 = 5,
+    NADE_CODEC_ADPCM4_WB = 6,
+    NADE_CODEC_COUNT
+};
+#define NADE_CODEC_MASK_ALL         (((1u << NADE_CODEC_COUNT) - 1u) & ~1u)
+
+#define NADE_CODEC_RATE             8000
+#define NADE_CODEC_WB_RATE          16000
+#define NADE_CODEC_FRAME_SAMPLES    320     // 40 ms at 8 kHz
+#define NADE_CODEC_MAX_FRAME_SAMPLES (NADE_CODEC_FRAME_SAMPLES * NADE_CODEC_WB_RATE / NADE_CODEC_RATE)
+#define NADE_CODEC_MAX_ENCODED      (4 + NADE_CODEC_MAX_FRAME_SAMPLES / 2)  // adpcm4wb
+
+#define NADE_LPC_ORDER              10
+#define NADE_LPC_PITCH_MIN          20      // 400 Hz
+#define NADE_LPC_PITCH_MAX          146     // ~55 Hz
+
+typedef struct {
+    const char *name;
+    int bitrate;                // Encoded payload bits per second
+    int sample_rate;
+    size_t frame_samples;       // Samples per 40 ms frame
+    size_t frame_bytes;         // Encoded bytes of a full frame
+} nade_codec_info_t;
+
+typedef struct {
+    int predictor;
+    int index;
+    bool initialized;
+} nade_adpcm_state_t;
+
+typedef struct {
+    float last_input;                       // Pre-emphasis memory
+    float signal[NADE_LPC_PITCH_MAX];       // Pre-emphasised history
+    float residual[NADE_LPC_PITCH_MAX];     // Prediction residual history
+} nade_lpc_encoder_t;
+
+typedef struct {
+    float lattice[NADE_LPC_ORDER];          // Backward errors of the synthesis lattice
+    float last_output;                      // De-emphasis memory
+    int pulse_countdown;                    // Samples until the next pitch pulse
+    uint32_t noise_seed;
+} nade_lpc_decoder_t;
+
+typedef struct {
+    nade_adpcm_state_t adpcm;
+    nade_lpc_encoder_t lpc;
+} nade_codec_encoder_t;
+
+typedef struct {
+    nade_adpcm_state_t adpcm;
+    nade_lpc_decoder_t lpc;
+} nade_codec_decoder_t;
+
+// Codec table entry, or NULL if id is not a known codec
+const nade_codec_info_t *nade_codec_info(int id);
+
+// Codec id for a name ("adpcm4", "lpc1200", ...), or NADE_CODEC_NONE
+int nade_codec_find(const char *name, size_t len);
+
+void nade_codec_encoder_reset(nade_codec_encoder_t *enc);
+void nade_codec_decoder_reset(nade_codec_decoder_t *dec);
+
+// Encode up to the codec's frame_samples samples (vocoder frames are
+// zero-padded). Returns bytes written, or 0 on an unknown codec or if out
+// is too small.
+size_t nade_codec_encode(nade_codec_encoder_t *enc, int codec, const int16_t *samples,
+                         size_t count, uint8_t *out, size_t max_bytes);
+
+// Decode one payload. Returns samples written, or 0 on an unknown codec or
+// malformed payload.
+size_t nade_codec_decode(nade_codec_decoder_t *dec, int codec, const uint8_t *data,
+                         size_t len, int16_t *out, size_t max_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_CODEC_H
@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "nade_metrics.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,11 +16,36 @@ int nade_start_session_server(const uint8_t *peer_pubkey, size_t len);
 int nade_start_session_client(const uint8_t *peer_pubkey, size_t len);
 int nade_stop_session(void);
 
+// Generate ephemeral keypairs ahead of the next calls, so starting a session
+// does not wait for key generation. Slow; call from a background thread after
+// nade_init and after each call. Returns the keypairs added (0 when the pool
+// is already full) or -1 if no entropy was available.
+int nade_prepare_ephemerals(void);
+
+// Mic and speaker audio is mono PCM at the device rate, the "audio_rate"
+// config value (8000 by default; 16000 or more also allows wideband calls).
+// The core converts it to and from the codec rates.
 int nade_feed_mic_frame(const int16_t *pcm, size_t samples);
 size_t nade_generate_outgoing_frame(uint8_t *buffer, size_t max_len);
 int nade_handle_incoming_frame(const uint8_t *data, size_t len);
 int nade_pull_speaker_frame(int16_t *out_buf, size_t max_samples);
 
+// Block until nade_generate_outgoing_frame (or nade_pipeline_tx_pcm) has
+// bytes to return, serving handshake-resend and keepalive deadlines while
+// waiting. Returns 1 when data is ready, 0 on timeout or session stop.
+int nade_wait_outgoing(int timeout_ms);
+
+// Block until nade_pull_speaker_frame can return min_samples. Returns 1 when
+// ready, 0 on timeout or session stop. Call from the speaker thread.
+int nade_wait_speaker(size_t min_samples, int timeout_ms);
+
+// "link_mtu" (0 by default) makes the transport a packet link of that MTU
+// from the next session, on both ends: every nade_generate_outgoing_frame
+// call then returns one datagram of at most the MTU (and max_len), and each
+// nade_handle_incoming_frame call must pass one received datagram whole.
+// A lost or damaged datagram costs only the frames it carried; the frames
+// ahead of the damage are still parsed, but the call returns -1. FSK carries
+// datagrams only with Reed-Solomon on. See nade_datagram.h.
 int nade_set_config(const char *json);
 
 int nade_send_hangup_signal(void);
@@ -32,6 +59,10 @@ int nade_consume_remote_hangup(void);
 int nade_fsk_set_enabled(bool enabled);
 bool nade_fsk_is_enabled(void);
 
+// Shape tone transitions with a raised cosine to reduce splatter (off by
+// default). Takes effect from the next burst.
+int nade_fsk_set_shaping(bool shaped);
+
 // Modulate data bytes into PCM audio samples (for transmission)
 // Returns number of PCM samples written to pcm_out
 size_t nade_fsk_modulate(const uint8_t *data, size_t len, int16_t *pcm_out, size_t max_samples);
@@ -42,8 +73,8 @@ int nade_fsk_feed_audio(const int16_t *pcm, size_t samples);
 // Pull demodulated bytes (call after feeding audio)
 size_t nade_fsk_pull_demodulated(uint8_t *out, size_t max_len);
 
-// Calculate number of PCM samples needed to modulate given bytes
-// (4 symbols per byte * 80 samples per symbol = 320 samples per byte)
+// Calculate number of PCM samples needed to modulate given bytes as one burst
+// in the negotiated profile (base 4-FSK: 320 samples per byte plus framing)
 size_t nade_fsk_samples_for_bytes(size_t byte_count);
 
 // -------------------------------------------------------------------------
@@ -69,6 +100,126 @@ size_t nade_rs_encoded_len(size_t data_len);
 // Get data length from encoded length (encoded_len - 32 parity bytes)
 size_t nade_rs_data_len(size_t encoded_len);
 
+// -------------------------------------------------------------------------
+// Audio-channel pipeline API
+// One call per direction runs framing, Reed-Solomon (when enabled), 4-FSK
+// modulation and 16-bit little-endian PCM packing on internal scratch buffers.
+
+// Produce the next transmit burst as little-endian PCM bytes
+// Returns bytes written to out_le_bytes (0 when nothing is queued)
+size_t nade_pipeline_tx_pcm(uint8_t *out_le_bytes, size_t max);
+
+// Largest burst nade_pipeline_tx_pcm can produce, in bytes
+size_t nade_pipeline_tx_max_bytes(void);
+
+// Demodulate received little-endian PCM bytes and parse the recovered frames
+// Returns frame bytes delivered to the parser, or -1 on error. A frame the
+// parser refuses, such as a damaged datagram, does not stop the rest of the
+// input from being demodulated and parsed, but the call returns -1.
+int nade_pipeline_rx_pcm(const uint8_t *in_le_bytes, size_t len);
+
+// -------------------------------------------------------------------------
+// Metrics API
+// Ring traffic, per-stage processing time, decrypt failures, handshake
+// latency and frame sizes; see nade_metrics.h for the fields and the
+// flattened layout. Counters run from session to session until reset.
+
+void nade_get_metrics(nade_metrics_t *out);
+void nade_reset_metrics(void);
+
+// -------------------------------------------------------------------------
+// Capture API
+// Record what crosses the core's boundary into a file of max_bytes at most,
+// for replay offline; see nade_capture.h for the format. Handshake keys are
+// zeroed before they reach the file, and FSK bursts of ours that carry them
+// are recorded as silence. Received FSK line audio cannot be redacted, so it
+// is recorded only with line_audio, which keeps all line audio as heard,
+// handshakes included. Start fails if a capture is running or the file
+// cannot be mapped; stop fails if none is running.
+
+int nade_capture_start(const char *path, size_t max_bytes, bool line_audio);
+int nade_capture_stop(void);
+
+// -------------------------------------------------------------------------
+// Context API
+// The functions above drive one process-wide default context. A bridge or
+// relay carrying several calls creates a context per call: each has its own
+// identity, session, rings, modem state and locks, so separate contexts can
+// be driven from separate threads without contending with each other.
+// The same threading rules apply within one context as for the default one.
+
+typedef struct nade_ctx nade_ctx_t;
+
+// Allocate a context, initialised as by nade_ctx_init when seed32 is given.
+// Returns NULL on allocation failure or if initialisation fails.
+nade_ctx_t *nade_ctx_create(const uint8_t *seed32);
+
+// Free a context. No other thread may still be using it; a native audio
+// engine still open on it is stopped first (nade_audio_detach).
+void nade_ctx_destroy(nade_ctx_t *ctx);
+
+// The context behind the context-free API
+nade_ctx_t *nade_ctx_default(void);
+
+// Replace the millisecond clock behind a context's handshake resends,
+// keepalives and jitter-buffer arrival times, so a simulation can run a call
+// faster or slower than real time. NULL restores the monotonic clock. The
+// wait functions always sleep on the monotonic clock, so a context with its
+// own clock should be driven by polling instead.
+typedef uint64_t (*nade_clock_fn)(void *user);
+void nade_ctx_set_clock(nade_ctx_t *ctx, nade_clock_fn clock, void *user);
+
+int nade_ctx_init(nade_ctx_t *ctx, const uint8_t *seed32);
+int nade_ctx_start_session_server(nade_ctx_t *ctx, const uint8_t *peer_pubkey, size_t len);
+int nade_ctx_start_session_client(nade_ctx_t *ctx, const uint8_t *peer_pubkey, size_t len);
+int nade_ctx_stop_session(nade_ctx_t *ctx);
+int nade_ctx_prepare_ephemerals(nade_ctx_t *ctx);
+
+int nade_ctx_feed_mic(nade_ctx_t *ctx, const int16_t *pcm, size_t samples);
+size_t nade_ctx_generate_outgoing(nade_ctx_t *ctx, uint8_t *buffer, size_t max_len);
+int nade_ctx_handle_incoming(nade_ctx_t *ctx, const uint8_t *data, size_t len);
+int nade_ctx_pull_speaker(nade_ctx_t *ctx, int16_t *out_buf, size_t max_samples);
+int nade_ctx_wait_outgoing(nade_ctx_t *ctx, int timeout_ms);
+int nade_ctx_wait_speaker(nade_ctx_t *ctx, size_t min_samples, int timeout_ms);
+
+// For real-time audio callbacks, which must not block: push_mic is
+// feed_mic that only sets the audio aside for a running capture, and
+// pop_speaker returns only what the speaker ring already holds, without
+// playing out the jitter buffer. Another thread keeps the ring filled with
+// nade_ctx_wait_speaker and records the mic audio set aside with
+// nade_ctx_flush_mic_capture, which returns the samples recorded. Neither
+// callback function takes a lock; on Linux the transmit thread is woken
+// without one too.
+int nade_ctx_push_mic(nade_ctx_t *ctx, const int16_t *pcm, size_t samples);
+int nade_ctx_pop_speaker(nade_ctx_t *ctx, int16_t *out_buf, size_t max_samples);
+int nade_ctx_flush_mic_capture(nade_ctx_t *ctx);
+
+int nade_ctx_set_config(nade_ctx_t *ctx, const char *json);
+
+int nade_ctx_send_hangup(nade_ctx_t *ctx);
+int nade_ctx_consume_remote_hangup(nade_ctx_t *ctx);
+
+int nade_ctx_fsk_set_enabled(nade_ctx_t *ctx, bool enabled);
+bool nade_ctx_fsk_is_enabled(nade_ctx_t *ctx);
+int nade_ctx_fsk_set_shaping(nade_ctx_t *ctx, bool shaped);
+size_t nade_ctx_fsk_modulate(nade_ctx_t *ctx, const uint8_t *data, size_t len,
+                             int16_t *pcm_out, size_t max_samples);
+int nade_ctx_fsk_feed_audio(nade_ctx_t *ctx, const int16_t *pcm, size_t samples);
+size_t nade_ctx_fsk_pull_demodulated(nade_ctx_t *ctx, uint8_t *out, size_t max_len);
+size_t nade_ctx_fsk_samples_for_bytes(nade_ctx_t *ctx, size_t byte_count);
+
+int nade_ctx_rs_set_enabled(nade_ctx_t *ctx, bool enabled);
+bool nade_ctx_rs_is_enabled(nade_ctx_t *ctx);
+
+size_t nade_ctx_pipeline_tx_pcm(nade_ctx_t *ctx, uint8_t *out_le_bytes, size_t max);
+int nade_ctx_pipeline_rx_pcm(nade_ctx_t *ctx, const uint8_t *in_le_bytes, size_t len);
+
+void nade_ctx_get_metrics(nade_ctx_t *ctx, nade_metrics_t *out);
+void nade_ctx_reset_metrics(nade_ctx_t *ctx);
+
+int nade_ctx_capture_start(nade_ctx_t *ctx, const char *path, size_t max_bytes, bool line_audio);
+int nade_ctx_capture_stop(nade_ctx_t *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,83 @@
+/*
+ * Datagram segmentation for NADE packet transports
+ *
+ * A stream transport carries frames back to back and the receiver trusts
+ * each frame's length to find the next one. A packet transport (BLE L2CAP
+ * CoC, a UDP relay, FSK bursts behind the FEC framer) instead carries
+ * datagrams of at most the link MTU, and a datagram is lost or damaged as
+ * a whole. Each datagram holds whole segments:
+ *
+ *   [sync] [seq] [index] [count] [len_lo len_hi] [crc_lo crc_hi]  payload
+ *
+ * A segment is a whole frame (count 1) or fragment index of count of one
+ * frame too large for a datagram. seq numbers frames, so fragments of
+ * different frames are never joined. The CRC-16 (CCITT) covers the rest of
+ * the header. A segment whose sync or CRC is wrong, or whose length runs
+ * past the datagram, ends the datagram: the receiver picks up again at the
+ * next one instead of losing the stream. Payloads are not covered; the
+ * frames inside are authenticated (or, for handshakes, bound into the
+ * transcript) and the FEC framer guards FSK bursts.
+ *
+ * Not thread-safe; a reassembly state belongs to one receiving thread.
+ */
+
+#ifndef NADE_DATAGRAM_H
+#define NADE_DATAGRAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_DGRAM_SYNC         0xA7
+#define NADE_DGRAM_HEADER_LEN   8
+#define NADE_DGRAM_MIN_MTU      32      // Keeps the largest frame within 255 fragments
+#define NADE_DGRAM_MAX_MTU      65535
+#define NADE_DGRAM_MAX_FRAME    (3 + 2048)
+
+typedef struct {
+    uint8_t seq;
+    uint8_t index;
+    uint8_t count;
+    const uint8_t *payload;     // Within the datagram
+    size_t len;
+} nade_dgram_segment_t;
+
+typedef struct {
+    uint8_t frame[NADE_DGRAM_MAX_FRAME];
+    size_t len;
+    uint8_t seq;
+    uint8_t next;               // Fragment index expected next
+    uint8_t count;
+    bool active;
+} nade_dgram_reassembly_t;
+
+// Write one segment header and payload at dst, which must have room for
+// NADE_DGRAM_HEADER_LEN + len bytes. Returns the bytes written.
+size_t nade_dgram_write_segment(uint8_t *dst, uint8_t seq, uint8_t index, uint8_t count,
+                                const uint8_t *payload, size_t len);
+
+// Fragments a frame of len bytes needs at the given fragment payload size
+size_t nade_dgram_fragment_count(size_t len, size_t fragment_len);
+
+// The segment at *offset of a datagram of len bytes. Returns false at the
+// end of the datagram or at a damaged segment, which ends it.
+bool nade_dgram_next_segment(const uint8_t *datagram, size_t len, size_t *offset, nade_dgram_segment_t *seg);
+
+void nade_dgram_reassembly_reset(nade_dgram_reassembly_t *r);
+
+// Add a segment. Returns the frame it completes, a whole-frame segment's
+// own payload or the reassembled frame, and its length in *frame_len; NULL
+// while a frame is incomplete or when the segment does not follow the
+// fragments seen (a loss drops the rest of that frame).
+const uint8_t *nade_dgram_reassemble(nade_dgram_reassembly_t *r, const nade_dgram_segment_t *seg,
+                                     size_t *frame_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_DATAGRAM_H
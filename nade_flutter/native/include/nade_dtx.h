@@ -0,0 +1,78 @@
+/*
+ * Discontinuous transmission for NADE
+ *
+ * The sender runs every mic frame through a voice activity detector that
+ * tracks the background level and calls a frame speech when its energy
+ * stands clear of it, or stands a little clear of it with the zero-crossing
+ * rate of a fricative. A few frames of hangover keep word endings. Silent
+ * frames are not sent; a silence descriptor (level and spectral tilt of the
+ * background) goes out at the start of each pause and then now and then.
+ *
+ * The receiver turns descriptors into comfort noise: white noise through a
+ * one-pole filter matching the tilt, scaled to the level, with level changes
+ * ramped over a frame.
+ *
+ * Not thread-safe; each state belongs to one session.
+ */
+
+#ifndef NADE_DTX_H
+#define NADE_DTX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_DTX_HANGOVER_FRAMES    5       // Frames still sent after speech ends
+#define NADE_DTX_SID_MIN_FRAMES     3       // Frames between descriptors for a changed background
+#define NADE_DTX_SID_MAX_FRAMES     12      // Frames between descriptors for a steady one
+
+typedef struct {
+    uint8_t level;      // Background level, dB below full scale (127 = digital silence)
+    int8_t tilt;        // First reflection coefficient x 127; > 0 for low-pass noise
+} nade_sid_t;
+
+typedef struct {
+    float floor_db;     // Tracked minimum level, what speech must rise above
+    float noise_db;     // Smoothed level of the frames classed as silence
+    float tilt;         // Smoothed first reflection coefficient of those frames
+    int hangover;       // Frames left before a pause is declared
+    bool primed;        // The trackers have seen a frame
+} nade_vad_t;
+
+typedef struct {
+    float gain;         // Excitation gain reached at the end of the last frame
+    float target_gain;
+    float pole;
+    float state;        // Filter memory
+    uint32_t seed;
+} nade_comfort_t;
+
+void nade_vad_reset(nade_vad_t *vad);
+
+// Classify one 40 ms frame of count samples, at any sample rate. Returns
+// true while it should be sent: speech, or the hangover after it.
+bool nade_vad_frame(nade_vad_t *vad, const int16_t *pcm, size_t count);
+
+// Describe the background heard in the frames classed as silence
+void nade_vad_describe(const nade_vad_t *vad, nade_sid_t *sid);
+
+// Whether the background moved enough from a to b for a new descriptor
+bool nade_sid_changed(const nade_sid_t *a, const nade_sid_t *b);
+
+void nade_comfort_reset(nade_comfort_t *cn);
+
+// Move the noise towards a new descriptor; the next frame ramps to it
+void nade_comfort_update(nade_comfort_t *cn, const nade_sid_t *sid);
+
+// Produce count samples of comfort noise
+void nade_comfort_generate(nade_comfort_t *cn, int16_t *out, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_DTX_H
@@ -0,0 +1,108 @@
+/*
+ * Multi-block Reed-Solomon framing for NADE audio-channel transport
+ *
+ * A payload of up to NADE_FEC_MAX_PAYLOAD bytes is split into N balanced,
+ * shortened RS(255,255-P) codewords and the codewords are byte-interleaved
+ * so a burst of channel errors is spread across all N blocks instead of
+ * exhausting the t=P/2 budget of one. P is 32 unless the sender picks
+ * another parity level.
+ *
+ * Wire layout of one FEC frame:
+ *   [len_hi len_lo crc8] [~len_hi ~len_lo ~crc8]  interleaved codewords...
+ * The 3-byte length header is sent twice, the second copy inverted; either
+ * copy passing its CRC-8 is enough. The top two bits of len_hi name the
+ * parity level (0 for 32, the only one older decoders accept, then 8, 16
+ * and 64). Block count and sizes are derived from the payload length and
+ * the parity, so the header carries nothing else.
+ *
+ * The receiver may pass a reliability score per byte along with the bytes.
+ * A codeword that errors-only decoding cannot correct is tried again with
+ * its least reliable bytes as erasures: each costs one parity byte instead
+ * of the two an error at an unknown position does.
+ */
+
+#ifndef NADE_FEC_H
+#define NADE_FEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "reed_solomon.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_FEC_HEADER_COPY    3
+#define NADE_FEC_HEADER_SIZE    (NADE_FEC_HEADER_COPY * 2)
+#define NADE_FEC_MAX_PAYLOAD    2048
+#define NADE_FEC_DEFAULT_PARITY RS_PARITY_SIZE
+#define NADE_FEC_MAX_BLOCKS     ((NADE_FEC_MAX_PAYLOAD + RS_BLOCK_SIZE - RS_MAX_PARITY - 1) / \
+                                 (RS_BLOCK_SIZE - RS_MAX_PARITY))
+#define NADE_FEC_MAX_FRAME      (NADE_FEC_HEADER_SIZE + NADE_FEC_MAX_PAYLOAD + \
+                                 NADE_FEC_MAX_BLOCKS * RS_MAX_PARITY)
+#define NADE_FEC_ERASE_BELOW    64      // Reliability under which a byte may be erased
+
+// Decoder statistics, accumulated by nade_fec_decoder_push
+typedef struct {
+    uint64_t frames;            // Frames delivered
+    uint64_t blocks;            // Codewords decoded
+    uint64_t clean_blocks;      // Codewords with no errors
+    uint64_t errors_corrected;  // Symbol errors fixed
+    uint64_t uncorrectable;     // Codewords passed through uncorrected
+    uint64_t erasure_blocks;    // Codewords corrected only once unreliable bytes were erased
+    uint64_t errors_seen;       // errors_corrected plus t + 1 per uncorrectable codeword
+    uint64_t coded_bytes;       // Codeword bytes decoded, parity included
+    uint64_t rejected_headers;  // Headers that looked valid but every block failed
+    uint64_t slipped_bytes;     // Bytes skipped while hunting for a header
+} nade_fec_stats_t;
+
+// Streaming receive state. Feed demodulated bytes in any chunking.
+typedef struct {
+    uint8_t buf[NADE_FEC_MAX_FRAME];
+    uint8_t reliability[NADE_FEC_MAX_FRAME];    // Of the bytes in buf
+    size_t fill;
+    size_t frame_len;           // 0 while hunting for a header
+    size_t payload_len;
+    size_t parity;              // Of the frame being received
+    uint8_t blocks[NADE_FEC_MAX_BLOCKS][RS_BLOCK_SIZE];
+    uint8_t block_reliability[NADE_FEC_MAX_BLOCKS][RS_BLOCK_SIZE];
+} nade_fec_decoder_t;
+
+// The geometry and encoder calls take the parity bytes per codeword, one of
+// the Reed-Solomon levels (NADE_FEC_DEFAULT_PARITY for older peers).
+
+// Number of RS blocks used for a payload of the given length
+size_t nade_fec_block_count(size_t payload_len, size_t parity);
+
+// Total on-air bytes for a payload of the given length (0 if out of range)
+size_t nade_fec_frame_len(size_t payload_len, size_t parity);
+
+// Largest payload whose frame fits in frame_budget bytes (0 if none)
+size_t nade_fec_max_payload(size_t frame_budget, size_t parity);
+
+// Encode one payload into out. Returns frame length, or 0 if the payload is
+// empty, larger than NADE_FEC_MAX_PAYLOAD, the parity is not a level, or
+// out is too small.
+size_t nade_fec_encode(const uint8_t *data, size_t len, size_t parity, uint8_t *out, size_t max_out);
+
+// Drop any partially received frame and start hunting for a header
+void nade_fec_decoder_reset(nade_fec_decoder_t *dec);
+
+// Consume bytes from in until one frame completes or input runs out.
+// reliability holds a score per byte of in (NADE_FSK_RELIABLE scale), or is
+// NULL if every byte is to be trusted alike. *consumed receives the number
+// of input bytes used. When a frame completes its payload is written to out
+// (which must hold NADE_FEC_MAX_PAYLOAD bytes) and its length is returned;
+// otherwise returns 0. Blocks that cannot be corrected are passed through
+// as received so the byte stream stays aligned. Frames at every parity
+// level are accepted.
+size_t nade_fec_decoder_push(nade_fec_decoder_t *dec, const uint8_t *in, const uint8_t *reliability,
+                             size_t len, size_t *consumed, uint8_t *out, nade_fec_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_FEC_H
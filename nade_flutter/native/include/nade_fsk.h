@@ -0,0 +1,203 @@
+/*
+ * Multi-profile FSK modem for NADE audio-channel transport
+ *
+ * Each transmit call produces one burst:
+ *   preamble | sync word | burst header | data | tail
+ * The preamble alternates the outer tones to give the receiver clean symbol
+ * transitions, the 32-bit sync word marks the first symbol boundary, and the
+ * burst header (len, profile, then the same three bytes inverted) tells the
+ * receiver how the data is modulated and where the burst ends. The
+ * one-symbol tail lets the last data symbol's late gate window complete
+ * without waiting for more audio.
+ *
+ * Preamble, sync and header always use the base 4-FSK profile so any
+ * receiver can lock; data and tail use the profile named in the header.
+ * A profile is one or more groups of 2^bits tones sent in parallel, every
+ * tone on a Goertzel bin of its symbol window so they stay orthogonal.
+ * Data bits are packed LSB first across symbols; the last symbol is
+ * zero-padded.
+ *
+ * The receiver hunts for the sync word on NADE_FSK_HUNT_PHASES staggered
+ * symbol clocks at once, scored by a sliding Goertzel bank that costs one
+ * update per sample, locks onto the best one, and then tracks symbol
+ * timing with an early-late gate. While locked every symbol is decided
+ * (weak ones included) so byte alignment can never slip; a sustained fade
+ * or a bad length header drops it back to hunting for the next sync.
+ *
+ * Each data byte can come with a reliability score: how far the winning
+ * tone of its weakest symbol stood above the runner-up, from 0 (a tie, or
+ * a symbol too weak to trust) to NADE_FSK_RELIABLE. The FEC decoder turns
+ * the least reliable bytes into erasures.
+ */
+
+#ifndef NADE_FSK_H
+#define NADE_FSK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nade_goertzel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_FSK_FREQ_00            1200    // Symbol 00 -> 1200 Hz
+#define NADE_FSK_FREQ_01            1600    // Symbol 01 -> 1600 Hz
+#define NADE_FSK_FREQ_10            2000    // Symbol 10 -> 2000 Hz
+#define NADE_FSK_FREQ_11            2400    // Symbol 11 -> 2400 Hz
+#define NADE_FSK_SAMPLE_RATE        8000    // 8 kHz sample rate
+#define NADE_FSK_SYMBOL_RATE        100     // 100 symbols/sec = 200 bits/sec
+#define NADE_FSK_SAMPLES_PER_SYMBOL (NADE_FSK_SAMPLE_RATE / NADE_FSK_SYMBOL_RATE)  // 80 samples
+#define NADE_FSK_AMPLITUDE          16000   // Amplitude for generated tones (< 32767)
+#define NADE_FSK_THRESHOLD          1000000.0f  // Minimum Goertzel power for a "strong" symbol
+
+// Burst framing
+#define NADE_FSK_PREAMBLE_SYMBOLS   16
+#define NADE_FSK_SYNC_WORD          0x1ACFFC1Du
+#define NADE_FSK_SYNC_SYMBOLS       16
+#define NADE_FSK_HEADER_BYTES       6
+#define NADE_FSK_TAIL_SYMBOLS       1
+#define NADE_FSK_MAX_BURST          4096    // Largest data length a receiver accepts
+#define NADE_FSK_OVERHEAD_SYMBOLS   (NADE_FSK_PREAMBLE_SYMBOLS + NADE_FSK_SYNC_SYMBOLS + \
+                                     NADE_FSK_HEADER_BYTES * 4 + NADE_FSK_TAIL_SYMBOLS)
+
+// Modulation profiles. Ordered by id; the id is what goes on the wire.
+enum {
+    NADE_FSK_PROFILE_4FSK_100 = 0,  // 4 tones,  100 baud,  200 bps (base)
+    NADE_FSK_PROFILE_8FSK_100,      // 8 tones,  100 baud,  300 bps
+    NADE_FSK_PROFILE_16FSK_100,     // 16 tones, 100 baud,  400 bps
+    NADE_FSK_PROFILE_4FSK_200,      // 4 tones,  200 baud,  400 bps
+    NADE_FSK_PROFILE_16FSK_200,     // 16 tones, 200 baud,  800 bps
+    NADE_FSK_PROFILE_MT4X4_100,     // 4 parallel 4-tone groups, 100 baud,  800 bps
+    NADE_FSK_PROFILE_MT4X4_200,     // 4 parallel 4-tone groups, 200 baud, 1600 bps
+    NADE_FSK_PROFILE_COUNT
+};
+#define NADE_FSK_PROFILE_BASE       NADE_FSK_PROFILE_4FSK_100
+#define NADE_FSK_PROFILE_MASK_ALL   ((1u << NADE_FSK_PROFILE_COUNT) - 1u)
+// Single-tone profiles only: the parallel-tone ones split the amplitude four
+// ways and need roughly 12 dB more SNR, so they are opt-in.
+#define NADE_FSK_PROFILE_MASK_DEFAULT ((1u << NADE_FSK_PROFILE_MT4X4_100) - 1u)
+#define NADE_FSK_MAX_GROUPS         4       // Parallel tone groups per symbol
+#define NADE_FSK_MAX_TONES          16      // Tones across all groups
+#define NADE_FSK_MIN_SAMPLES_PER_BYTE 40    // Fastest profile (1600 bps)
+
+typedef struct {
+    const char *name;
+    int bits;                   // Bits per group per symbol
+    int groups;                 // Tone groups sent in parallel
+    int samples_per_symbol;     // Symbol window, a divisor of the sample rate
+    int base_freq;              // Tone 0 of group 0 (Hz)
+    int spacing;                // Tone spacing (Hz), a multiple of the bin width
+} nade_fsk_profile_t;
+
+// Receiver tuning
+#define NADE_FSK_HUNT_PHASES        8       // Staggered symbol clocks while hunting
+#define NADE_FSK_HUNT_STEP          (NADE_FSK_SAMPLES_PER_SYMBOL / NADE_FSK_HUNT_PHASES)
+#define NADE_FSK_SYNC_MAX_ERRORS    1       // Symbol mismatches tolerated in the sync word
+#define NADE_FSK_GATE_OFFSET        (NADE_FSK_SAMPLES_PER_SYMBOL / 8)
+#define NADE_FSK_FADE_SYMBOLS       8       // Consecutive weak symbols that end a lock
+#define NADE_FSK_RELIABLE           255     // Reliability of a byte whose tones were unambiguous
+#define NADE_FSK_HISTORY            256     // Sample history, power of two
+
+#define NADE_FSK_SHAPE_DIVISOR      4       // Shaped transitions span 1/4 of a symbol
+
+typedef struct {
+    uint32_t phase[NADE_FSK_MAX_GROUPS];        // NCO phase per group, 2^32 per cycle
+    uint32_t increment[NADE_FSK_MAX_GROUPS];    // Phase step of the tone last sent
+    int groups;                 // Groups in the last symbol (0 before the first)
+    bool shaped;                // Raised-cosine tone transitions; kept across resets
+} nade_fsk_mod_t;
+
+typedef struct {
+    uint64_t syncs;             // Sync words locked
+    uint64_t bursts;            // Bursts received to their full length
+    uint64_t fades;             // Locks lost to a fade
+    uint64_t bad_headers;       // Locks dropped on an invalid burst header
+    uint64_t timing_adjusts;    // Early-late gate corrections (samples)
+    uint64_t weak_symbols;      // Symbols decided below NADE_FSK_THRESHOLD
+    uint64_t dropped_bytes;     // Bytes lost because the output was full
+} nade_fsk_stats_t;
+
+typedef struct {
+    // Every sample is stored twice, NADE_FSK_HISTORY apart, so any window
+    // up to the history length is contiguous
+    int16_t history[2 * NADE_FSK_HISTORY];
+    uint64_t sample_index;      // Absolute index of the next sample
+    int state;
+
+    // Hunting
+    nade_goertzel_slide_t hunt_bank;    // Base tones over the last symbol window
+    uint32_t phase_symbols[NADE_FSK_HUNT_PHASES];   // Last 16 symbols per clock
+    float phase_quality[NADE_FSK_HUNT_PHASES];      // Smoothed decision margin
+    bool have_candidate;
+    uint64_t candidate_end;     // Sample index just after the sync word
+    float candidate_quality;
+    uint64_t candidate_deadline;
+
+    // Locked
+    uint64_t symbol_start;      // Sample index of the next symbol window
+    float gate_error;
+    int weak_run;
+    int profile;                // Profile of the symbols being decided
+    uint32_t bits;              // Decided bits not yet assembled into a byte
+    int bit_count;
+    uint8_t bits_reliability;   // Least reliable symbol among those bits
+    uint8_t header[NADE_FSK_HEADER_BYTES];
+    size_t header_fill;
+    size_t burst_remaining;
+
+    uint32_t epoch;             // Incremented on every sync lock
+    nade_fsk_stats_t stats;
+} nade_fsk_demod_t;
+
+// Profile table entry, or NULL if id is out of range
+const nade_fsk_profile_t *nade_fsk_profile(int id);
+
+// Data throughput of a profile in bits per second (0 if id is out of range)
+int nade_fsk_profile_bitrate(int id);
+
+// Highest-throughput profile whose bit is set in mask; the base profile if
+// none is. Ties go to the longer symbol window, which tolerates more noise.
+int nade_fsk_best_profile(uint32_t mask);
+
+// Samples needed for a burst carrying len data bytes
+size_t nade_fsk_burst_samples(int profile, size_t len);
+
+// Largest data length whose burst fits in max_samples (0 if none)
+size_t nade_fsk_burst_capacity(int profile, size_t max_samples);
+
+void nade_fsk_mod_reset(nade_fsk_mod_t *mod);
+
+// Sweep each group's frequency from the old tone to the new one along a
+// raised cosine over the first 1/NADE_FSK_SHAPE_DIVISOR of every symbol
+// instead of switching at once. Cuts the splatter of the frequency steps
+// at a small cost in demodulator margin. Off by default.
+void nade_fsk_mod_set_shaping(nade_fsk_mod_t *mod, bool shaped);
+
+// Modulate one burst. Returns samples written, or 0 if it does not fit or
+// the profile is unknown.
+size_t nade_fsk_modulate_burst(nade_fsk_mod_t *mod, int profile, const uint8_t *data, size_t len,
+                               int16_t *out, size_t max_samples);
+
+void nade_fsk_demod_reset(nade_fsk_demod_t *demod);
+
+// Feed received samples. Decoded data bytes are written to out and, unless
+// reliability is NULL, their scores to the same positions of reliability;
+// bytes that do not fit in max_out are dropped. Returns early, right after a
+// sync lock, so the caller can react to a new burst: *consumed receives the
+// samples used. Returns the number of bytes written.
+size_t nade_fsk_demodulate(nade_fsk_demod_t *demod, const int16_t *samples, size_t count,
+                           size_t *consumed, uint8_t *out, uint8_t *reliability, size_t max_out);
+
+// Upper bound on bytes nade_fsk_demodulate can produce from count samples
+static inline size_t nade_fsk_max_bytes_for_samples(size_t count) {
+    return count / NADE_FSK_MIN_SAMPLES_PER_BYTE + 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_FSK_H
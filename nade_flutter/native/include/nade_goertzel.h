@@ -0,0 +1,67 @@
+/*
+ * Goertzel filter banks for NADE
+ *
+ * nade_goertzel_bank evaluates any number of tones over one window in a
+ * single pass: the window is converted to float once and the tones run as
+ * independent lanes (SSE on x86, NEON on ARM, plain C elsewhere), four at
+ * a time. Power is |X(omega)|^2 of the window, the same value a per-tone
+ * Goertzel pass returns.
+ *
+ * nade_goertzel_slide_t keeps the complex DFT of the last n samples for a
+ * fixed tone set and updates it in O(tones) per sample, so every sample
+ * offset of a symbol clock can be evaluated for the price of one step.
+ * Rounding accumulates slowly in the recursive state; re-prime it from the
+ * sample history now and then.
+ */
+
+#ifndef NADE_GOERTZEL_H
+#define NADE_GOERTZEL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_GOERTZEL_LANES         4       // Tones evaluated per vector
+#define NADE_GOERTZEL_MAX_TONES     64      // Tones in one block bank call
+#define NADE_GOERTZEL_MAX_SLIDE     16      // Tones in a sliding bank, multiple of the lanes
+
+// Goertzel coefficient 2 * cos(omega) of a tone, omega in radians per sample
+float nade_goertzel_coeff(float omega);
+
+// Power of count tones (coefficients from nade_goertzel_coeff, at most
+// NADE_GOERTZEL_MAX_TONES) over the n samples at x, written to power[0..count)
+void nade_goertzel_bank(const float *coeffs, int count, const int16_t *x, int n, float *power);
+
+typedef struct {
+    int count;                  // Tones in use
+    int n;                      // Window length in samples
+    // Per tone, padded to the lanes: e^(j omega) and e^(j omega n)
+    float rot_re[NADE_GOERTZEL_MAX_SLIDE];
+    float rot_im[NADE_GOERTZEL_MAX_SLIDE];
+    float tail_re[NADE_GOERTZEL_MAX_SLIDE];
+    float tail_im[NADE_GOERTZEL_MAX_SLIDE];
+    // DFT of the current window
+    float re[NADE_GOERTZEL_MAX_SLIDE];
+    float im[NADE_GOERTZEL_MAX_SLIDE];
+} nade_goertzel_slide_t;
+
+// Set up count tones (at most NADE_GOERTZEL_MAX_SLIDE) over an n-sample
+// window. The window starts out all zeros.
+void nade_goertzel_slide_init(nade_goertzel_slide_t *slide, const float *omegas, int count, int n);
+
+// Restart from the n samples at window, oldest first
+void nade_goertzel_slide_prime(nade_goertzel_slide_t *slide, const int16_t *window);
+
+// Move the window one sample: in enters, out (the sample n before it) leaves
+void nade_goertzel_slide_step(nade_goertzel_slide_t *slide, int16_t in, int16_t out);
+
+// Power of every tone over the current window, written to power[0..count)
+void nade_goertzel_slide_power(const nade_goertzel_slide_t *slide, float *power);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_GOERTZEL_H
@@ -0,0 +1,121 @@
+/*
+ * Adaptive jitter buffer for NADE speaker playout
+ *
+ * Decoded audio frames are stored by their 16-bit sequence number and played
+ * out in order, one frame per pull, so the speaker clock drives playout.
+ * The target delay follows an RFC 3550 style interarrival jitter estimate.
+ * Frames that arrive after their slot was played are dropped. Missing
+ * frames are concealed by repeating the last pitch period with a fade.
+ * When the buffer settles above or below the target, a pitch period is
+ * removed from or added to a frame (overlap-add) so clock drift and delay
+ * changes are absorbed without gaps.
+ *
+ * A silence descriptor takes the slot of the frame it stands for and starts
+ * comfort noise, which plays until the next talk spurt. The pause is where
+ * the playout point moves for free: it holds while nothing arrives and
+ * stays the target delay behind the newest arrival, so every spurt starts
+ * from a fresh prebuffer.
+ *
+ * Frames are 40 ms at the rate of the audio the peer sends, 8 or 16 kHz;
+ * the buffer switches rate when the frames it is given do.
+ *
+ * Not thread-safe; the caller serialises push and pull.
+ */
+
+#ifndef NADE_JITTER_H
+#define NADE_JITTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nade_dtx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_JITTER_BASE_RATE       8000
+#define NADE_JITTER_MAX_RATE        16000
+#define NADE_JITTER_FRAME_MS        40
+#define NADE_JITTER_MAX_FRAME_SAMPLES (NADE_JITTER_MAX_RATE * NADE_JITTER_FRAME_MS / 1000)
+#define NADE_JITTER_SLOTS           32      // Frames held, 1.28 s
+#define NADE_JITTER_MIN_TARGET      2       // Frames
+#define NADE_JITTER_MAX_TARGET      12
+#define NADE_JITTER_PITCH_MIN       20      // At the base rate
+#define NADE_JITTER_PITCH_MAX       146
+#define NADE_JITTER_MAX_CONCEAL     5       // Concealed frames before rebuffering
+#define NADE_JITTER_MAX_OUTPUT      (NADE_JITTER_MAX_FRAME_SAMPLES + \
+                                     NADE_JITTER_PITCH_MAX * (NADE_JITTER_MAX_RATE / NADE_JITTER_BASE_RATE))
+
+typedef struct {
+    uint64_t frames_played;     // Received frames played out
+    uint64_t frames_concealed;  // Frames synthesised for missing audio
+    uint64_t late_dropped;      // Frames that arrived after their slot played
+    uint64_t duplicates;        // Frames received twice
+    uint64_t rebuffers;         // Times playout stopped to refill
+    uint64_t expanded;          // Frames stretched by one pitch period
+    uint64_t compressed;        // Frames shortened by one pitch period
+} nade_jitter_stats_t;
+
+typedef struct {
+    int16_t pcm[NADE_JITTER_MAX_FRAME_SAMPLES];
+    uint16_t seq;
+    bool valid;
+    bool comfort;               // Holds a silence descriptor instead of audio
+    nade_sid_t sid;
+} nade_jitter_slot_t;
+
+typedef struct {
+    nade_jitter_slot_t slots[NADE_JITTER_SLOTS];
+    int sample_rate;
+    int frame_samples;
+    int rate_scale;             // sample_rate / NADE_JITTER_BASE_RATE
+    bool started;               // A first frame has arrived
+    bool playing;               // Prebuffering is done
+    bool in_comfort;            // Playing comfort noise through a pause
+    uint16_t next_seq;          // Sequence number of the next frame to play
+    uint16_t newest_seq;        // Highest sequence number received
+    uint16_t last_arrival_seq;
+    uint64_t last_arrival_ms;
+    float jitter_ms;            // Smoothed interarrival jitter
+    float avg_depth;            // Smoothed buffered frames, for drift control
+    int target;                 // Target depth in frames
+    int stretch_cooldown;       // Frames until the next time-scale change
+    int conceal_run;            // Consecutive concealed frames
+    int conceal_period;         // Pitch period being repeated
+    int conceal_phase;          // Position within that period
+    float conceal_gain;
+    nade_comfort_t comfort;
+    int16_t history[NADE_JITTER_MAX_FRAME_SAMPLES];  // Last frame_samples played
+    nade_jitter_stats_t stats;
+} nade_jitter_t;
+
+// Empty the buffer. A zeroed one starts at NADE_JITTER_BASE_RATE, others
+// keep their rate.
+void nade_jitter_reset(nade_jitter_t *jb);
+
+// Empty the buffer and take frames at sample_rate (a multiple of
+// NADE_JITTER_BASE_RATE up to NADE_JITTER_MAX_RATE) from now on. The
+// counters are kept.
+void nade_jitter_set_rate(nade_jitter_t *jb, int sample_rate);
+
+// Store a decoded frame (count <= frame_samples, zero-padded)
+void nade_jitter_push(nade_jitter_t *jb, uint16_t seq, const int16_t *pcm, size_t count,
+                      uint64_t now_ms);
+
+// Store the silence descriptor sent in place of frame seq
+void nade_jitter_push_sid(nade_jitter_t *jb, uint16_t seq, const nade_sid_t *sid, uint64_t now_ms);
+
+// Produce the next frame of playout into out (NADE_JITTER_MAX_OUTPUT
+// samples). Returns samples written; 0 while prebuffering.
+size_t nade_jitter_pull(nade_jitter_t *jb, int16_t *out);
+
+// Frames buffered from the playout point up to the newest one received
+int nade_jitter_depth(const nade_jitter_t *jb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_JITTER_H
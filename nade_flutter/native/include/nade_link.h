@@ -0,0 +1,80 @@
+/*
+ * Link adaptation for the NADE audio-channel transport
+ *
+ * The receiver sums what its FEC decoder saw into a report and sends it to
+ * the peer now and then. The sender keeps a decayed estimate of the symbol
+ * error rate from those reports. A codeword of n symbols with P parity
+ * fails when more than P / 2 of them are wrong, a binomial tail, and what
+ * survives carries n - P payload bytes. Protection goes up when a stronger
+ * level would deliver more payload per byte on air than the current one,
+ * and comes down only after a run of reports in which a lighter level
+ * stays under NADE_LINK_TARGET_FAILURE with a margin, so the level does
+ * not flap and a clean link is not traded for a lossy one.
+ *
+ * When even the strongest code fails more than NADE_LINK_MAX_FAILURE of its
+ * codewords the sender backs off to a slower modulation profile instead,
+ * and it returns to the faster one after a longer calm run at the weakest
+ * code. The codec follows through the bit rate left after parity.
+ *
+ * Not thread-safe; each state belongs to one session.
+ */
+
+#ifndef NADE_LINK_H
+#define NADE_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nade_fec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_LINK_TARGET_FAILURE    0.002   // Codeword failure rate a lighter level must stay under
+#define NADE_LINK_RELAX_MARGIN      0.1     // by this factor
+#define NADE_LINK_MAX_FAILURE       0.05    // Codeword failure rate that calls for a slower profile
+#define NADE_LINK_RELAX_REPORTS     2       // Calm reports in a row before less parity
+#define NADE_LINK_RATE_UP_REPORTS   6       // Calm reports at the weakest code before a faster profile
+
+// What the receiver's FEC decoder saw since the last report
+typedef struct {
+    uint32_t blocks;            // Codewords decoded
+    uint32_t failed;            // Of those, uncorrectable
+    uint32_t errors;            // Symbol errors: corrected, plus t + 1 per failed codeword
+    uint32_t coded_bytes;       // Codeword bytes, parity included
+} nade_link_report_t;
+
+typedef struct {
+    int level;                  // Parity level of the next frames, see rs_level_parity
+    int rate_backoff;           // Profile steps below the fastest negotiated one
+    double errors;              // Decayed report sums behind the error rate estimate
+    double bytes;
+    size_t block_data;          // Mean payload bytes per codeword of the last report
+    int calm_reports;
+    int hold_reports;           // Reports still describing the previous profile
+} nade_link_ctl_t;
+
+// Add a decoder pass to a report, saturating rather than wrapping
+void nade_link_report_add(nade_link_report_t *report, const nade_fec_stats_t *stats);
+
+// Back to the default parity at the fastest profile
+void nade_link_ctl_reset(nade_link_ctl_t *ctl);
+
+// Parity bytes per codeword the sender should use
+size_t nade_link_ctl_parity(const nade_link_ctl_t *ctl);
+
+// Estimated symbol error rate
+double nade_link_ctl_error_rate(const nade_link_ctl_t *ctl);
+
+// Take a report from the peer. max_backoff is how many slower profiles the
+// link has below the fastest one. Returns true if the parity level or the
+// rate backoff changed.
+bool nade_link_ctl_update(nade_link_ctl_t *ctl, const nade_link_report_t *report, int max_backoff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_LINK_H
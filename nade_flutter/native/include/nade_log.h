@@ -0,0 +1,62 @@
+/*
+ * Compile-time gated logcat output for NADE
+ *
+ * NADE_LOG(prio, tag, fmt, ...) forwards to __android_log_print when prio
+ * is at or above NADE_LOG_MIN_LEVEL, and compiles to nothing otherwise, so
+ * disabled messages cost neither formatting nor a logd round trip. Builds
+ * choose the level with -DNADE_LOG_MIN_LEVEL=<ANDROID_LOG_* value>; release
+ * builds (NDEBUG) default to warnings and errors only.
+ *
+ * Host builds (benchmarks and simulations) have no logcat; the same
+ * priorities are written to stderr instead.
+ *
+ * Nothing on the per-frame paths or inside the session lock should log;
+ * record a trace event (nade_trace.h) there instead.
+ */
+
+#ifndef NADE_LOG_H
+#define NADE_LOG_H
+
+#if defined(__ANDROID__)
+#include <android/log.h>
+#define NADE_LOG_WRITE __android_log_print
+#else
+#include <stdarg.h>
+#include <stdio.h>
+
+enum {
+    ANDROID_LOG_VERBOSE = 2,
+    ANDROID_LOG_DEBUG = 3,
+    ANDROID_LOG_INFO = 4,
+    ANDROID_LOG_WARN = 5,
+    ANDROID_LOG_ERROR = 6,
+};
+
+static inline void nade_log_host_print(int prio, const char *tag, const char *fmt, ...) {
+    static const char levels[] = "??VDIWE";
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%c/%s: ", prio >= 0 && prio <= ANDROID_LOG_ERROR ? levels[prio] : '?', tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+#define NADE_LOG_WRITE nade_log_host_print
+#endif
+
+#ifndef NADE_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define NADE_LOG_MIN_LEVEL ANDROID_LOG_WARN
+#else
+#define NADE_LOG_MIN_LEVEL ANDROID_LOG_DEBUG
+#endif
+#endif
+
+#define NADE_LOG(prio, tag, ...)                                   \
+    do {                                                           \
+        if ((prio) >= NADE_LOG_MIN_LEVEL) {                        \
+            NADE_LOG_WRITE((prio), (tag), __VA_ARGS__);            \
+        }                                                          \
+    } while (0)
+
+#endif // NADE_LOG_H
@@ -0,0 +1,115 @@
+/*
+ * Per-stage latency and throughput metrics for NADE
+ *
+ * Counters and histograms are relaxed atomics, so the audio threads record
+ * into them without locks and a monitoring thread can take a snapshot at any
+ * time. A snapshot is not a single instant across all fields; each value is
+ * individually consistent.
+ *
+ * Histogram bucket i counts values whose bit width is i: bucket 0 holds 0,
+ * bucket 1 holds 1, bucket 2 holds 2..3, ..., and the last bucket is open
+ * ended. Stage timings are recorded in nanoseconds, frame sizes in bytes.
+ */
+
+#ifndef NADE_METRICS_H
+#define NADE_METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_METRICS_VERSION        2
+#define NADE_METRICS_BUCKETS        24      // Last bucket: >= 2^22 (4.2 ms or 4 MiB)
+
+typedef enum {
+    NADE_STAGE_CODEC_ENCODE = 0,
+    NADE_STAGE_CODEC_DECODE,
+    NADE_STAGE_AEAD_SEAL,
+    NADE_STAGE_AEAD_OPEN,
+    NADE_STAGE_FEC_ENCODE,
+    NADE_STAGE_FEC_DECODE,
+    NADE_STAGE_FSK_MOD,
+    NADE_STAGE_FSK_DEMOD,
+    NADE_STAGE_COUNT
+} nade_stage_t;
+
+typedef enum {
+    NADE_METRICS_RING_MIC = 0,
+    NADE_METRICS_RING_SPK,
+    NADE_METRICS_RING_OUT,
+    NADE_METRICS_RING_IN,
+    NADE_METRICS_RING_FSK_DEMOD,
+    NADE_METRICS_RING_COUNT
+} nade_metrics_ring_t;
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t total;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[NADE_METRICS_BUCKETS];
+} nade_histogram_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[NADE_METRICS_BUCKETS];
+} nade_histogram_snapshot_t;
+
+// Ring traffic in elements (samples or bytes) since the last reset
+typedef struct {
+    uint64_t pushed;
+    uint64_t popped;            // Includes elements discarded by a reset
+    uint64_t dropped;           // Rejected because the ring was full
+    uint64_t high_water;        // Most elements held at once
+} nade_ring_metrics_t;
+
+typedef struct {
+    uint32_t version;
+    nade_ring_metrics_t rings[NADE_METRICS_RING_COUNT];
+    uint64_t decrypt_failures;
+    uint64_t handshakes;            // Handshakes completed
+    uint64_t handshake_last_ms;     // Session start to keys derived, last handshake
+    uint64_t handshake_max_ms;
+    uint64_t frames_played;         // Jitter buffer counters, see nade_jitter_stats_t
+    uint64_t frames_concealed;
+    uint64_t late_dropped;
+    uint64_t duplicates;
+    uint64_t rebuffers;
+    uint64_t expanded;
+    uint64_t compressed;
+    nade_histogram_snapshot_t stages[NADE_STAGE_COUNT];   // Nanoseconds per call
+    nade_histogram_snapshot_t tx_frame_bytes;             // Transport frames queued
+    nade_histogram_snapshot_t rx_frame_bytes;             // Transport frames parsed
+} nade_metrics_t;
+
+// Flattened layout written by nade_metrics_flatten, one int64 per field:
+//   [0] version, [1] total length,
+//   rings x (pushed, popped, dropped, high_water),
+//   decrypt_failures, handshakes, handshake_last_ms, handshake_max_ms,
+//   the seven jitter buffer counters in struct order,
+//   stages x (count, total, max, buckets...), tx_frame_bytes, rx_frame_bytes
+#define NADE_METRICS_HIST_LEN       (3 + NADE_METRICS_BUCKETS)
+#define NADE_METRICS_FLAT_LEN       (2 + NADE_METRICS_RING_COUNT * 4 + 4 + 7 + \
+                                     (NADE_STAGE_COUNT + 2) * NADE_METRICS_HIST_LEN)
+
+void nade_histogram_record(nade_histogram_t *hist, uint64_t value);
+void nade_histogram_snapshot(const nade_histogram_t *hist, nade_histogram_snapshot_t *out);
+void nade_histogram_reset(nade_histogram_t *hist);
+
+// Monotonic clock for stage timing
+uint64_t nade_metrics_now_ns(void);
+
+// Write the snapshot into out as NADE_METRICS_FLAT_LEN int64 values.
+// Returns the number written, 0 if max is too small.
+size_t nade_metrics_flatten(const nade_metrics_t *metrics, int64_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_METRICS_H
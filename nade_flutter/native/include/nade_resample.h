@@ -0,0 +1,73 @@
+/*
+ * Polyphase sample rate conversion for NADE audio
+ *
+ * Converts a stream of 16-bit mono PCM by the ratio up / down of the two
+ * rates, reduced. The prototype is a Kaiser-windowed sinc low-pass at the
+ * upsampled rate with its cutoff just below the lower of the two Nyquist
+ * frequencies. It is split into `up` phases; every output is the dot
+ * product of one phase with the newest inputs, so the zeros of the
+ * upsampled signal and the dropped outputs of the downsampler are never
+ * computed. Equal rates pass samples through untouched.
+ *
+ * Not thread-safe; each converter belongs to the thread feeding it.
+ */
+
+#ifndef NADE_RESAMPLE_H
+#define NADE_RESAMPLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_RESAMPLE_MIN_RATE      8000
+#define NADE_RESAMPLE_MAX_RATE      48000
+#define NADE_RESAMPLE_MAX_TAPS      192     // Per phase, for 48 kHz down to 8 kHz
+#define NADE_RESAMPLE_MAX_COEFFS    15360   // All phases, for 22.05 kHz down to 16 kHz
+#define NADE_RESAMPLE_CHUNK         256     // Input samples converted to float at a time
+
+typedef struct {
+    int in_rate;
+    int out_rate;
+    int up;                     // Interpolation factor L
+    int down;                   // Decimation factor M
+    int taps;                   // Per phase, a multiple of four
+    int phase;                  // Of the next output, 0 .. up - 1
+    int pos;                    // History index of the newest input the next output uses
+    int fill;                   // Valid samples in history
+    float coeffs[NADE_RESAMPLE_MAX_COEFFS];     // Per phase, oldest input first
+    float history[NADE_RESAMPLE_MAX_TAPS + NADE_RESAMPLE_CHUNK];
+} nade_resampler_t;
+
+// Whether the pair of rates has a filter that fits. Every common device
+// rate (8, 16, 22.05, 32, 44.1, 48 kHz) converts to and from 8 and 16 kHz.
+bool nade_resampler_supported(int in_rate, int out_rate);
+
+// Set up conversion from in_rate to out_rate. Returns false, leaving a
+// pass-through converter, if the pair is not supported.
+bool nade_resampler_init(nade_resampler_t *rs, int in_rate, int out_rate);
+
+// Drop the signal history, keeping the filter
+void nade_resampler_reset(nade_resampler_t *rs);
+
+// Whether rs converts from in_rate to out_rate
+bool nade_resampler_matches(const nade_resampler_t *rs, int in_rate, int out_rate);
+
+// Outputs the next count inputs produce
+size_t nade_resampler_output_len(const nade_resampler_t *rs, size_t count);
+
+// Inputs needed before count more outputs are produced
+size_t nade_resampler_input_len(const nade_resampler_t *rs, size_t count);
+
+// Convert count samples into out, which must hold
+// nade_resampler_output_len(rs, count). Returns samples written.
+size_t nade_resampler_process(nade_resampler_t *rs, const int16_t *in, size_t count, int16_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_RESAMPLE_H
@@ -0,0 +1,143 @@
+/*
+ * Wait-free single-producer/single-consumer ring buffer for NADE
+ *
+ * Each ring has exactly one producer thread and one consumer thread. The
+ * producer owns write_idx, the consumer owns read_idx, and both indices are
+ * free-running so full/empty never need a separate flag. Capacity must be a
+ * power of two; push/pop copy in at most two memcpy segments.
+ *
+ * Overflow policy: push never overwrites unread data. Elements that do not
+ * fit are dropped and the caller learns how many were accepted.
+ */
+
+#ifndef NADE_RING_H
+#define NADE_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NADE_RING_CACHE_LINE 64
+
+typedef struct {
+    uint8_t *storage;
+    size_t elem_size;
+    size_t capacity;    // Elements, power of two
+    size_t mask;        // capacity - 1
+    // Producer-owned index, kept on its own cache line
+    _Alignas(NADE_RING_CACHE_LINE) _Atomic size_t write_idx;
+    _Atomic size_t dropped;     // Elements rejected because the ring was full
+    _Atomic size_t high_water;  // Most elements held at once
+    // Consumer-owned index
+    _Alignas(NADE_RING_CACHE_LINE) _Atomic size_t read_idx;
+    // Discard request posted by any thread, applied by the consumer
+    _Alignas(NADE_RING_CACHE_LINE) _Atomic size_t discard_to;
+    _Atomic bool discard_pending;
+} nade_ring_t;
+
+// Traffic counters. pushed and popped are the free-running indices, so the
+// difference of two readings is the traffic in between.
+typedef struct {
+    size_t pushed;
+    size_t popped;
+    size_t dropped;
+    size_t high_water;
+} nade_ring_stats_t;
+
+// Part of the ring mapped in place: first_count elements at first, then, if
+// the region wraps around the end of the storage, second_count at second.
+// Read views map readable elements, write views map free space.
+typedef struct {
+    uint8_t *first;
+    size_t first_count;
+    uint8_t *second;            // NULL when the region does not wrap
+    size_t second_count;
+    size_t start;               // Ring index of the first element
+} nade_ring_view_t;
+
+// Static initializer for a ring over a fixed storage array
+#define NADE_RING_INITIALIZER(storage_array, cap, esize) { \
+    .storage = (uint8_t *)(storage_array),                 \
+    .elem_size = (esize),                                  \
+    .capacity = (cap),                                     \
+    .mask = (cap) - 1,                                     \
+    .write_idx = 0,                                        \
+    .dropped = 0,                                          \
+    .high_water = 0,                                       \
+    .read_idx = 0,                                         \
+    .discard_to = 0,                                       \
+    .discard_pending = false,                              \
+}
+
+#define NADE_RING_IS_POW2(cap) ((cap) != 0 && (((cap) & ((cap) - 1)) == 0))
+
+// Initialize a ring at runtime. Returns false if capacity is not a power of two.
+// A ring initialized without storage (NULL, capacity 0) has no room and
+// nothing to read until it is rebound.
+bool nade_ring_init(nade_ring_t *ring, void *storage, size_t capacity, size_t elem_size);
+
+// Move an idle ring onto other storage, or none, dropping what it holds.
+// Neither side may be using the ring meanwhile. The indices carry on, so
+// traffic counters read before the move stay comparable with later ones.
+bool nade_ring_rebind(nade_ring_t *ring, void *storage, size_t capacity);
+
+// Producer: copy up to count elements in. Returns the number accepted.
+size_t nade_ring_push(nade_ring_t *ring, const void *src, size_t count);
+
+// Consumer: copy up to max elements out and release them. Returns count.
+size_t nade_ring_pop(nade_ring_t *ring, void *dst, size_t max);
+
+// Consumer: copy exactly count elements out without releasing them.
+// Returns false (and copies nothing) if fewer than count are available.
+bool nade_ring_peek(nade_ring_t *ring, void *dst, size_t count);
+
+// Consumer: map every readable element without copying or releasing it.
+// The elements stay in place, and may be modified by the consumer, until it
+// releases them. Returns the number mapped.
+size_t nade_ring_read_view(nade_ring_t *ring, nade_ring_view_t *view);
+
+// Consumer: release the first count elements of a view in one index update.
+// A discard requested since the view was taken still applies.
+void nade_ring_release_view(nade_ring_t *ring, const nade_ring_view_t *view, size_t count);
+
+// Consumer: release up to count elements without copying them.
+size_t nade_ring_skip(nade_ring_t *ring, size_t count);
+
+// Producer: map the free space without publishing anything. Elements written
+// through the view become readable when committed. Returns the number mapped.
+size_t nade_ring_write_view(nade_ring_t *ring, nade_ring_view_t *view);
+
+// Producer: publish the first count elements of a write view in one index
+// update.
+void nade_ring_commit_view(nade_ring_t *ring, const nade_ring_view_t *view, size_t count);
+
+// Producer: count elements discarded because they did not fit
+void nade_ring_note_dropped(nade_ring_t *ring, size_t count);
+
+// Either side: number of elements currently readable (snapshot).
+size_t nade_ring_size(nade_ring_t *ring);
+
+// Either side: number of elements that can currently be pushed (snapshot).
+size_t nade_ring_free(nade_ring_t *ring);
+
+// Any thread: discard everything pushed so far. The consumer applies the
+// request on its next operation; data pushed afterwards is kept.
+void nade_ring_request_discard(nade_ring_t *ring);
+
+// Any thread: read the traffic counters (snapshot).
+void nade_ring_get_stats(nade_ring_t *ring, nade_ring_stats_t *stats);
+
+// Any thread: restart the high-water mark from the current fill level. A
+// push racing with the reset may keep the mark it was about to publish.
+void nade_ring_reset_high_water(nade_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_RING_H
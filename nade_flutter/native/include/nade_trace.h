@@ -0,0 +1,88 @@
+/*
+ * Fixed-size binary event trace for NADE
+ *
+ * A process-wide ring of NADE_TRACE_CAPACITY records, each a monotonic
+ * timestamp, an event id and two 32-bit arguments. Any thread may record:
+ * a writer claims a slot with one fetch-add and publishes it through a
+ * per-slot sequence word, so recording never blocks and never formats
+ * text. When the ring is full the oldest records are overwritten.
+ *
+ * nade_trace_dump copies out the records that were complete at the time
+ * of the call, oldest first, for post-call analysis.
+ *
+ * Build with -DNADE_TRACE_ENABLED=0 to compile every NADE_TRACE away.
+ */
+
+#ifndef NADE_TRACE_H
+#define NADE_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NADE_TRACE_ENABLED
+#define NADE_TRACE_ENABLED 1
+#endif
+
+#define NADE_TRACE_CAPACITY 4096    // Records, power of two
+
+// Event ids and their arguments. Ids are stable: dumps are decoded offline.
+typedef enum {
+    NADE_EV_NONE = 0,
+    NADE_EV_SESSION_START = 1,      // role, expects a peer key
+    NADE_EV_SESSION_STOP = 2,       // role, handshake complete
+    NADE_EV_HANDSHAKE_SKIP = 3,     // role
+    NADE_EV_HANDSHAKE_TX = 4,       // role, complete | acknowledged << 1
+    NADE_EV_HANDSHAKE_RX = 5,       // role, capability bits
+    NADE_EV_KEYS_DERIVED = 6,       // role
+    NADE_EV_KEY_FAILURE = 7,        // role, step (1 ephemeral, 2 HKDF)
+    NADE_EV_PEER_KEY_MISMATCH = 8,  // role
+    NADE_EV_HANDSHAKE_COMPLETE = 9, // role, ms since session start
+    NADE_EV_HANDSHAKE_ACK = 10,     // role
+    NADE_EV_DECRYPT_FAIL = 11,      // nonce counter (low 32 bits), record length
+    NADE_EV_HANGUP_TX = 12,         // role
+    NADE_EV_HANGUP_RX = 13,         // role
+    NADE_EV_FSK_PROFILE = 14,       // profile id, bit rate
+    NADE_EV_CODEC = 15,             // codec id, bit rate
+    NADE_EV_RS_ENCODE = 16,         // data bytes, encoded bytes
+    NADE_EV_RS_DECODE = 17,         // errors corrected (or ~0 uncorrectable), codeword bytes
+    NADE_EV_FEC_UNCORRECTABLE = 18, // uncorrectable blocks, blocks in the frame
+    NADE_EV_JITTER_REBUFFER = 19,   // rebuffers so far, target depth
+    NADE_EV_EPHEMERAL = 20,         // role, 1 if taken from the prepared pool
+    NADE_EV_RESUME = 21,            // role, outcome (0 offered, 1 accepted, 2 rejected)
+    NADE_EV_REPLAY = 22,            // record counter (low 32 bits), 0 seen before or 1 behind the window
+    NADE_EV_FEC_PARITY = 23,        // parity bytes per codeword, estimated symbol error rate (ppm)
+    NADE_EV_DGRAM_DAMAGED = 24,     // bytes dropped at a damaged segment, datagram length
+} nade_trace_event_t;
+
+typedef struct {
+    uint64_t time_ns;       // CLOCK_MONOTONIC
+    uint32_t event;
+    uint32_t arg0;
+    uint32_t arg1;
+} nade_trace_record_t;
+
+void nade_trace_record(uint32_t event, uint32_t arg0, uint32_t arg1);
+
+// Copy up to max of the newest complete records into out, oldest first.
+// Returns the number copied.
+size_t nade_trace_dump(nade_trace_record_t *out, size_t max);
+
+// Forget everything recorded so far
+void nade_trace_clear(void);
+
+#if NADE_TRACE_ENABLED
+#define NADE_TRACE(event, arg0, arg1) \
+    nade_trace_record((uint32_t)(event), (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define NADE_TRACE(event, arg0, arg1) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NADE_TRACE_H
@@ -3,6 +3,11 @@
  * 
  * Implements RS(255, 223) over GF(2^8) with generator polynomial x^8 + x^4 + x^3 + x^2 + 1
  * Can correct up to 16 byte errors per 255-byte block (32 parity bytes)
+ *
+ * The same field also gives codes with 8, 16 or 64 parity bytes (t = 4, 8,
+ * 32). Every generator has the consecutive roots alpha^2, alpha^3, ..., so
+ * the syndromes of a code are the first ones of any stronger code and all
+ * levels share the root tables; only the encoder needs a table per level.
  * 
  * Optimized for real-time audio transmission over noisy channels (4-FSK, radio, etc.)
  */
@@ -29,9 +34,37 @@ extern "C" {
 // RS(n, k) where n <= 255 and parity = RS_PARITY_SIZE
 #define RS_MIN_DATA_SIZE    1       // Minimum data bytes
 
+// Parity levels: level l has RS_MIN_PARITY << l parity bytes
+#define RS_MIN_PARITY       8
+#define RS_MAX_PARITY       64
+#define RS_PARITY_LEVELS    4       // 8, 16, 32 and 64 parity bytes
+#define RS_MAX_CORRECT      (RS_MAX_PARITY / 2)
+
 // Initialize Reed-Solomon encoder/decoder (call once at startup)
 void rs_init(void);
 
+// Encoder/syndrome kernels. rs_init picks the fastest one available: SSSE3 or
+// AVX2 are detected at runtime on x86, NEON is used whenever the target was
+// built with it. The reference kernel is the original gf_mul implementation.
+typedef enum {
+    RS_KERNEL_AUTO = 0,     // Best available kernel for this CPU
+    RS_KERNEL_REFERENCE,    // Log/exp gf_mul loops
+    RS_KERNEL_TABLE,        // Portable generator/root multiplication tables
+    RS_KERNEL_SSSE3,        // pshufb split-nibble syndromes
+    RS_KERNEL_AVX2,         // 256-bit pshufb split-nibble syndromes
+    RS_KERNEL_NEON,         // vtbl split-nibble syndromes
+} rs_kernel_t;
+
+// Switch kernels (mostly for testing and benchmarks). Returns false and keeps
+// the current kernel if the requested one is not supported here.
+bool rs_set_kernel(rs_kernel_t kernel);
+
+// Kernel currently in use
+rs_kernel_t rs_get_kernel(void);
+
+// Short printable name of a kernel
+const char *rs_kernel_name(rs_kernel_t kernel);
+
 // Encode data with Reed-Solomon parity
 // Input: data[0..data_len-1] where data_len <= RS_DATA_SIZE
 // Output: out[0..data_len+RS_PARITY_SIZE-1] (data followed by parity)
@@ -41,13 +74,38 @@ size_t rs_encode(const uint8_t *data, size_t data_len, uint8_t *out);
 // Decode and correct errors in Reed-Solomon codeword
 // Input/Output: codeword[0..len-1] where len = data_len + RS_PARITY_SIZE
 // The data portion is corrected in-place
-// Returns: number of errors corrected, or -1 if uncorrectable
+// Returns: number of errors corrected, or -1 if uncorrectable (codeword
+// unchanged)
 int rs_decode(uint8_t *codeword, size_t len);
 
 // Check if a codeword has errors (without correcting)
 // Returns: true if codeword is valid (no errors or correctable errors)
 bool rs_check(const uint8_t *codeword, size_t len);
 
+// Variable-parity forms of the above. parity must be one of the levels;
+// data_len may be up to RS_BLOCK_SIZE - parity.
+size_t rs_encode_parity(const uint8_t *data, size_t data_len, size_t parity, uint8_t *out);
+int rs_decode_parity(uint8_t *codeword, size_t len, size_t parity);
+bool rs_check_parity(const uint8_t *codeword, size_t len, size_t parity);
+
+// Decode with erasures: erasures[0..erasure_count-1] are distinct byte
+// positions in codeword known to be unreliable. Corrects any mix of e
+// erasures and v errors elsewhere with e + 2v <= parity. Returns the number
+// of bytes changed (an erased byte may turn out right), or -1 if
+// uncorrectable, in which case codeword is left as it was.
+int rs_decode_erasures(uint8_t *codeword, size_t len, size_t parity, const uint8_t *erasures,
+                       size_t erasure_count);
+
+// Whether parity is one of the supported levels
+static inline bool rs_parity_supported(size_t parity) {
+    return parity == 8 || parity == 16 || parity == 32 || parity == 64;
+}
+
+// Parity bytes of a level, 0 .. RS_PARITY_LEVELS - 1
+static inline size_t rs_level_parity(int level) {
+    return (size_t)RS_MIN_PARITY << level;
+}
+
 // Get the data length from an encoded block
 // encoded_len = data_len + RS_PARITY_SIZE
 static inline size_t rs_data_len(size_t encoded_len) {
@@ -0,0 +1,512 @@
+/*
+ * ChaCha20-Poly1305 record sealing implementation
+ *
+ * The vector backend runs four ChaCha20 blocks at once, one block per lane:
+ * vector i holds state word i of four consecutive block counters, so the
+ * quarter rounds are plain lane-wise adds, xors and rotates and only the
+ * final store has to interleave the lanes back into four 64-byte blocks.
+ * Counter 0 is the Poly1305 key block, so the first pass also yields the
+ * keystream for the first 192 bytes; an audio record (or a batch of a few
+ * frames) is a single pass instead of the key block plus one block per
+ * 64 bytes.
+ *
+ * Poly1305 is a serial multiply-accumulate chain over 16-byte blocks. With
+ * 128-bit products (arm64, x86-64) it runs on three 44-bit limbs: nine
+ * 64x64-bit multiplies per block against monocypher's twenty-one; splitting
+ * it into lanes with powers of r only pays off on records far longer than
+ * ours. Elsewhere monocypher's Poly1305 is used.
+ */
+
+#include "nade_aead.h"
+
+#include "monocypher.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AEAD_SIMD_NAME "sse2"
+
+typedef __m128i vu4;
+static inline vu4 vu4_set1(uint32_t w) { return _mm_set1_epi32((int)w); }
+static inline vu4 vu4_counters(uint32_t c) {
+    return _mm_setr_epi32((int)c, (int)(c + 1), (int)(c + 2), (int)(c + 3));
+}
+static inline vu4 vu4_add(vu4 a, vu4 b) { return _mm_add_epi32(a, b); }
+static inline vu4 vu4_xor(vu4 a, vu4 b) { return _mm_xor_si128(a, b); }
+static inline void vu4_store_le(uint8_t *p, vu4 v) { _mm_storeu_si128((__m128i *)p, v); }
+#define vu4_rotl(v, n) _mm_or_si128(_mm_slli_epi32((v), (n)), _mm_srli_epi32((v), 32 - (n)))
+
+// Rows a..d become columns
+static inline void vu4_transpose(vu4 *a, vu4 *b, vu4 *c, vu4 *d) {
+    vu4 ab_lo = _mm_unpacklo_epi32(*a, *b), ab_hi = _mm_unpackhi_epi32(*a, *b);
+    vu4 cd_lo = _mm_unpacklo_epi32(*c, *d), cd_hi = _mm_unpackhi_epi32(*c, *d);
+    *a = _mm_unpacklo_epi64(ab_lo, cd_lo);
+    *b = _mm_unpackhi_epi64(ab_lo, cd_lo);
+    *c = _mm_unpacklo_epi64(ab_hi, cd_hi);
+    *d = _mm_unpackhi_epi64(ab_hi, cd_hi);
+}
+#elif defined(__ARM_NEON) && (!defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#include <arm_neon.h>
+#define AEAD_SIMD_NAME "neon"
+
+typedef uint32x4_t vu4;
+static inline vu4 vu4_set1(uint32_t w) { return vdupq_n_u32(w); }
+static inline vu4 vu4_counters(uint32_t c) {
+    const uint32_t lanes[4] = {c, c + 1, c + 2, c + 3};
+    return vld1q_u32(lanes);
+}
+static inline vu4 vu4_add(vu4 a, vu4 b) { return vaddq_u32(a, b); }
+static inline vu4 vu4_xor(vu4 a, vu4 b) { return veorq_u32(a, b); }
+static inline void vu4_store_le(uint8_t *p, vu4 v) { vst1q_u8(p, vreinterpretq_u8_u32(v)); }
+#define vu4_rotl(v, n) vsriq_n_u32(vshlq_n_u32((v), (n)), (v), 32 - (n))
+
+// Rows a..d become columns
+static inline void vu4_transpose(vu4 *a, vu4 *b, vu4 *c, vu4 *d) {
+    uint32x4x2_t ab = vtrnq_u32(*a, *b);
+    uint32x4x2_t cd = vtrnq_u32(*c, *d);
+    *a = vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0]));
+    *b = vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1]));
+    *c = vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0]));
+    *d = vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1]));
+}
+
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#define AEAD_SIMD_RUNTIME_CHECK 1
+#endif
+#endif
+
+typedef void (*seal_fn)(const uint8_t *key, const uint8_t *nonce, const uint8_t *ad, size_t ad_len,
+                        uint8_t *text, size_t len, uint8_t *tag);
+typedef int (*open_fn)(const uint8_t *key, const uint8_t *nonce, const uint8_t *ad, size_t ad_len,
+                       uint8_t *text, size_t len, const uint8_t *tag);
+
+typedef struct {
+    const char *name;
+    seal_fn seal;
+    open_fn open;
+    bool (*supported)(void);
+} aead_backend_t;
+
+// Zero secrets on the way out. crypto_wipe goes a volatile byte at a time,
+// which costs as much as sealing a short record.
+static void wipe(void *secret, size_t len) {
+#if defined(__GNUC__)
+    memset(secret, 0, len);
+    __asm__ __volatile__("" : : "r"(secret) : "memory");
+#else
+    crypto_wipe(secret, len);
+#endif
+}
+
+static bool always_supported(void) {
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Portable backend
+
+static void portable_seal(const uint8_t *key, const uint8_t *nonce, const uint8_t *ad, size_t ad_len,
+                          uint8_t *text, size_t len, uint8_t *tag) {
+    crypto_aead_ctx aead;
+    crypto_aead_init_ietf(&aead, key, nonce);
+    crypto_aead_write(&aead, text, tag, ad, ad_len, text, len);
+    wipe(&aead, sizeof(aead));
+}
+
+static int portable_open(const uint8_t *key, const uint8_t *nonce, const uint8_t *ad, size_t ad_len,
+                         uint8_t *text, size_t len, const uint8_t *tag) {
+    crypto_aead_ctx aead;
+    crypto_aead_init_ietf(&aead, key, nonce);
+    // Checks the tag before it writes anything
+    int rc = crypto_aead_read(&aead, text, tag, ad, ad_len, text, len);
+    wipe(&aead, sizeof(aead));
+    return rc;
+}
+
+#ifdef AEAD_SIMD_NAME
+// -------------------------------------------------------------------------
+// Vector backend
+
+static void store_le32(uint8_t *out, uint32_t w) {
+    out[0] = (uint8_t)w;
+    out[1] = (uint8_t)(w >> 8);
+    out[2] = (uint8_t)(w >> 16);
+    out[3] = (uint8_t)(w >> 24);
+}
+
+static uint32_t load_le32(const uint8_t *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static void store_le64(uint8_t *out, uint64_t w) {
+    store_le32(out, (uint32_t)w);
+    store_le32(out + 4, (uint32_t)(w >> 32));
+}
+
+// -------------------------------------------------------------------------
+// Poly1305
+
+#if defined(__SIZEOF_INT128__)
+#define POLY_MASK44 0xFFFFFFFFFFFULL
+#define POLY_MASK42 0x3FFFFFFFFFFULL
+
+typedef struct {
+    uint64_t r[3];
+    uint64_t h[3];
+    uint64_t pad[2];
+} poly_t;
+
+static uint64_t load_le64(const uint8_t *in) {
+    return (uint64_t)load_le32(in) | ((uint64_t)load_le32(in + 4) << 32);
+}
+
+static void poly_init(poly_t *poly, const uint8_t key[32]) {
+    uint64_t t0 = load_le64(key);
+    uint64_t t1 = load_le64(key + 8);
+    // Clamped r in 44 + 44 + 42 bit limbs
+    poly->r[0] = t0 & 0xFFC0FFFFFFFULL;
+    poly->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xFFFFFC0FFFFULL;
+    poly->r[2] = (t1 >> 24) & 0x00FFFFFFC0FULL;
+    poly->h[0] = poly->h[1] = poly->h[2] = 0;
+    poly->pad[0] = load_le64(key + 16);
+    poly->pad[1] = load_le64(key + 24);
+}
+
+// Absorb whole 16-byte blocks, each with the 2^128 bit set
+static void poly_blocks(poly_t *poly, const uint8_t *m, size_t blocks) {
+    const uint64_t r0 = poly->r[0], r1 = poly->r[1], r2 = poly->r[2];
+    // 2^130 = 5 mod p, and the limbs above 2^130 sit 2 bits high
+    const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    uint64_t h0 = poly->h[0], h1 = poly->h[1], h2 = poly->h[2];
+    for (size_t i = 0; i < blocks; i++, m += 16) {
+        uint64_t t0 = load_le64(m);
+        uint64_t t1 = load_le64(m + 8);
+        h0 += t0 & POLY_MASK44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & POLY_MASK44;
+        h2 += ((t1 >> 24) & POLY_MASK42) | (1ULL << 40);
+
+        unsigned __int128 d0 = (unsigned __int128)h0 * r0 + (unsigned __int128)h1 * s2 +
+                               (unsigned __int128)h2 * s1;
+        unsigned __int128 d1 = (unsigned __int128)h0 * r1 + (unsigned __int128)h1 * r0 +
+                               (unsigned __int128)h2 * s2;
+        unsigned __int128 d2 = (unsigned __int128)h0 * r2 + (unsigned __int128)h1 * r1 +
+                               (unsigned __int128)h2 * r0;
+        uint64_t c = (uint64_t)(d0 >> 44);
+        h0 = (uint64_t)d0 & POLY_MASK44;
+        d1 += c;
+        c = (uint64_t)(d1 >> 44);
+        h1 = (uint64_t)d1 & POLY_MASK44;
+        d2 += c;
+        c = (uint64_t)(d2 >> 42);
+        h2 = (uint64_t)d2 & POLY_MASK42;
+        h0 += c * 5;
+        c = h0 >> 44;
+        h0 &= POLY_MASK44;
+        h1 += c;
+    }
+    poly->h[0] = h0;
+    poly->h[1] = h1;
+    poly->h[2] = h2;
+}
+
+static void poly_finish(poly_t *poly, uint8_t mac[16]) {
+    uint64_t h0 = poly->h[0], h1 = poly->h[1], h2 = poly->h[2];
+    // Fully carry h
+    uint64_t c = h1 >> 44;
+    h1 &= POLY_MASK44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= POLY_MASK42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= POLY_MASK44;
+    h1 += c;
+    c = h1 >> 44;
+    h1 &= POLY_MASK44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= POLY_MASK42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= POLY_MASK44;
+    h1 += c;
+
+    // h - p, selected in constant time if h >= p
+    uint64_t g0 = h0 + 5;
+    c = g0 >> 44;
+    g0 &= POLY_MASK44;
+    uint64_t g1 = h1 + c;
+    c = g1 >> 44;
+    g1 &= POLY_MASK44;
+    uint64_t g2 = h2 + c - (1ULL << 42);
+    uint64_t keep_g = (g2 >> 63) - 1;
+    h0 = (h0 & ~keep_g) | (g0 & keep_g);
+    h1 = (h1 & ~keep_g) | (g1 & keep_g);
+    h2 = (h2 & ~keep_g) | (g2 & keep_g);
+
+    // + s, mod 2^128
+    uint64_t t0 = poly->pad[0], t1 = poly->pad[1];
+    h0 += t0 & POLY_MASK44;
+    c = h0 >> 44;
+    h0 &= POLY_MASK44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & POLY_MASK44) + c;
+    c = h1 >> 44;
+    h1 &= POLY_MASK44;
+    h2 += ((t1 >> 24) & POLY_MASK42) + c;
+    h2 &= POLY_MASK42;
+
+    store_le64(mac, h0 | (h1 << 44));
+    store_le64(mac + 8, (h1 >> 20) | (h2 << 24));
+    wipe(poly, sizeof(*poly));
+}
+#else
+typedef crypto_poly1305_ctx poly_t;
+
+static void poly_init(poly_t *poly, const uint8_t key[32]) {
+    crypto_poly1305_init(poly, key);
+}
+
+static void poly_blocks(poly_t *poly, const uint8_t *m, size_t blocks) {
+    crypto_poly1305_update(poly, m, blocks * 16);
+}
+
+static void poly_finish(poly_t *poly, uint8_t mac[16]) {
+    crypto_poly1305_final(poly, mac);
+}
+#endif
+
+// Absorb data zero-padded to whole blocks, as the AEAD construction does
+static void poly_padded(poly_t *poly, const uint8_t *data, size_t len) {
+    poly_blocks(poly, data, len / 16);
+    size_t tail = len % 16;
+    if (tail > 0) {
+        uint8_t block[16] = {0};
+        memcpy(block, data + len - tail, tail);
+        poly_blocks(poly, block, 1);
+    }
+}
+
+static void aead_mac(const uint8_t poly_key[32], const uint8_t *ad, size_t ad_len,
+                     const uint8_t *cipher, size_t len, uint8_t mac[16]) {
+    poly_t poly;
+    poly_init(&poly, poly_key);
+    poly_padded(&poly, ad, ad_len);
+    poly_padded(&poly, cipher, len);
+    uint8_t sizes[16];
+    store_le64(sizes, (uint64_t)ad_len);
+    store_le64(sizes + 8, (uint64_t)len);
+    poly_blocks(&poly, sizes, 1);
+    poly_finish(&poly, mac);
+}
+
+// -------------------------------------------------------------------------
+// ChaCha20, four blocks per pass
+
+#define CHACHA_PASS_BYTES   (4 * 64)
+#define CHACHA_FIRST_BYTES  (3 * 64)    // Keystream after the Poly1305 key block
+
+#define QUARTER_ROUND(a, b, c, d)                                          \
+    do {                                                                   \
+        a = vu4_add(a, b); d = vu4_xor(d, a); d = vu4_rotl(d, 16);         \
+        c = vu4_add(c, d); b = vu4_xor(b, c); b = vu4_rotl(b, 12);         \
+        a = vu4_add(a, b); d = vu4_xor(d, a); d = vu4_rotl(d, 8);          \
+        c = vu4_add(c, d); b = vu4_xor(b, c); b = vu4_rotl(b, 7);          \
+    } while (0)
+
+static void chacha_setup(uint32_t state[16], const uint8_t key[32], const uint8_t nonce[12]) {
+    state[0] = 0x61707865;  // "expand 32-byte k"
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        state[4 + i] = load_le32(key + 4 * i);
+    }
+    state[12] = 0;
+    for (int i = 0; i < 3; i++) {
+        state[13 + i] = load_le32(nonce + 4 * i);
+    }
+}
+
+// Keystream of blocks state[12] .. state[12] + 3, in order
+static void chacha_pass(const uint32_t state[16], uint8_t out[CHACHA_PASS_BYTES]) {
+    vu4 x[16];
+    for (int i = 0; i < 16; i++) {
+        x[i] = vu4_set1(state[i]);
+    }
+    x[12] = vu4_counters(state[12]);
+    vu4 counters = x[12];
+    for (int round = 0; round < 10; round++) {
+        QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; i++) {
+        x[i] = vu4_add(x[i], i == 12 ? counters : vu4_set1(state[i]));
+    }
+    // Each group of four words, transposed, is 16 bytes of every block
+    for (int group = 0; group < 4; group++) {
+        vu4 *w = x + 4 * group;
+        vu4_transpose(w, w + 1, w + 2, w + 3);
+        for (int block = 0; block < 4; block++) {
+            vu4_store_le(out + 64 * block + 16 * group, w[block]);
+        }
+    }
+}
+
+static void xor_bytes(uint8_t *text, const uint8_t *stream, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, text + i, 8);
+        memcpy(&b, stream + i, 8);
+        a ^= b;
+        memcpy(text + i, &a, 8);
+    }
+    for (; i < len; i++) {
+        text[i] ^= stream[i];
+    }
+}
+
+// text ^= keystream from block 1 on; first is the pass for blocks 0..3
+static void chacha_apply(uint32_t state[16], const uint8_t first[CHACHA_PASS_BYTES],
+                         uint8_t *text, size_t len) {
+    size_t done = len < CHACHA_FIRST_BYTES ? len : CHACHA_FIRST_BYTES;
+    xor_bytes(text, first + 64, done);
+    if (done == len) {
+        return;
+    }
+    uint8_t stream[CHACHA_PASS_BYTES];
+    while (done < len) {
+        state[12] += 4;
+        chacha_pass(state, stream);
+        size_t chunk = len - done < CHACHA_PASS_BYTES ? len - done : CHACHA_PASS_BYTES;
+        xor_bytes(text + done, stream, chunk);
+        done += chunk;
+    }
+    wipe(stream, sizeof(stream));
+}
+
+static void simd_seal(const uint8_t *key, const uint8_t *nonce, const uint8_t *ad, size_t ad_len,
+                      uint8_t *text, size_t len, uint8_t *tag) {
+    uint32_t state[16];
+    uint8_t first[CHACHA_PASS_BYTES];
+    chacha_setup(state, key, nonce);
+    chacha_pass(state, first);
+    chacha_apply(state, first, text, len);
+    aead_mac(first, ad, ad_len, text, len, tag);
+    wipe(state, sizeof(state));
+    wipe(first, sizeof(first));
+}
+
+static int simd_open(const uint8_t *key, const uint8_t *nonce, const uint8_t *ad, size_t ad_len,
+                     uint8_t *text, size_t len, const uint8_t *tag) {
+    uint32_t state[16];
+    uint8_t first[CHACHA_PASS_BYTES];
+    uint8_t mac[16];
+    chacha_setup(state, key, nonce);
+    chacha_pass(state, first);
+    aead_mac(first, ad, ad_len, text, len, mac);
+    int rc = crypto_verify16(mac, tag);
+    if (rc == 0) {
+        chacha_apply(state, first, text, len);
+    }
+    wipe(state, sizeof(state));
+    wipe(first, sizeof(first));
+    wipe(mac, sizeof(mac));
+    return rc;
+}
+
+static bool simd_supported(void) {
+#ifdef AEAD_SIMD_RUNTIME_CHECK
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+    return true;
+#endif
+}
+#endif // AEAD_SIMD_NAME
+
+// -------------------------------------------------------------------------
+// Backend selection
+
+static const aead_backend_t kBackends[] = {
+#ifdef AEAD_SIMD_NAME
+    {AEAD_SIMD_NAME, simd_seal, simd_open, simd_supported},
+#endif
+    {"portable", portable_seal, portable_open, always_supported},
+};
+
+#define BACKEND_COUNT ((int)(sizeof(kBackends) / sizeof(kBackends[0])))
+
+static _Atomic(const aead_backend_t *) g_backend;
+
+static const aead_backend_t *best_backend(void) {
+    for (int i = 0; i < BACKEND_COUNT; i++) {
+        if (kBackends[i].supported()) {
+            return &kBackends[i];
+        }
+    }
+    return &kBackends[BACKEND_COUNT - 1];
+}
+
+static const aead_backend_t *current_backend(void) {
+    const aead_backend_t *backend = atomic_load_explicit(&g_backend, memory_order_acquire);
+    if (!backend) {
+        // Racing first uses pick the same backend
+        backend = best_backend();
+        atomic_store_explicit(&g_backend, backend, memory_order_release);
+    }
+    return backend;
+}
+
+void nade_aead_seal(const uint8_t key[NADE_AEAD_KEY_LEN], const uint8_t nonce[NADE_AEAD_NONCE_LEN],
+                    const uint8_t *ad, size_t ad_len, uint8_t *text, size_t len,
+                    uint8_t tag[NADE_AEAD_TAG_LEN]) {
+    current_backend()->seal(key, nonce, ad, ad_len, text, len, tag);
+}
+
+int nade_aead_open(const uint8_t key[NADE_AEAD_KEY_LEN], const uint8_t nonce[NADE_AEAD_NONCE_LEN],
+                   const uint8_t *ad, size_t ad_len, uint8_t *text, size_t len,
+                   const uint8_t tag[NADE_AEAD_TAG_LEN]) {
+    return current_backend()->open(key, nonce, ad, ad_len, text, len, tag);
+}
+
+const char *nade_aead_backend(void) {
+    return current_backend()->name;
+}
+
+const char *nade_aead_backend_name(int index) {
+    for (int i = 0; i < BACKEND_COUNT; i++) {
+        if (kBackends[i].supported() && index-- == 0) {
+            return kBackends[i].name;
+        }
+    }
+    return NULL;
+}
+
+bool nade_aead_select_backend(const char *name) {
+    if (!name) {
+        return false;
+    }
+    if (strcmp(name, "auto") == 0) {
+        atomic_store_explicit(&g_backend, best_backend(), memory_order_release);
+        return true;
+    }
+    for (int i = 0; i < BACKEND_COUNT; i++) {
+        if (strcmp(kBackends[i].name, name) == 0 && kBackends[i].supported()) {
+            atomic_store_explicit(&g_backend, &kBackends[i], memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,471 @@
+/*
+ * Native audio engine implementation
+ *
+ * The AAudio entry points are resolved with dlsym against the NDK's ABI,
+ * declared here rather than taken from <aaudio/AAudio.h> so the library
+ * builds for minSdk 24. The usage, content type and input preset setters
+ * arrived in API 28 and are applied only when present.
+ *
+ * The callbacks only move samples through the context's lock-free rings:
+ * nade_ctx_push_mic into the mic ring, which wakes the transmit thread
+ * without a lock, and nade_ctx_pop_speaker out of the speaker ring. The
+ * jitter buffer, concealment, decoding and resampling behind the speaker
+ * run on the engine's refill thread, which keeps the ring a few bursts
+ * ahead of the callback. The refill thread also records the mic audio the
+ * callback sets aside for a running capture, since writing the capture file
+ * may fault pages in. AAudio may not be stopped or closed from its own
+ * callbacks, so a disconnect only flags the engine; the service thread
+ * reopens the streams.
+ *
+ * Open engines are listed by context, so nade_ctx_destroy can stop one that
+ * still drives the context it frees.
+ */
+
+#include "nade_audio.h"
+#include "nade_codec.h"
+#include "nade_log.h"
+#include "nade_resample.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TAG "NADEAudio"
+
+#define SERVICE_POLL_MS 250     // Bounds a disconnect signalled between check and wait
+#define SPK_BUFFER_BURSTS 2     // Double buffering, the least that plays without glitches
+#define SPK_AHEAD_BURSTS 3      // Speaker ring fill the refill thread keeps ahead of the callback
+#define REFILL_POLL_MS 20       // Refill thread wait while there is no audio to play out
+
+// AAudio ABI (NDK aaudio/AAudio.h)
+typedef struct AAudioStreamStruct AAudioStream;
+typedef struct AAudioStreamBuilderStruct AAudioStreamBuilder;
+typedef int32_t aaudio_result_t;
+typedef aaudio_result_t (*aaudio_data_callback_t)(AAudioStream *stream, void *user, void *data, int32_t frames);
+typedef void (*aaudio_error_callback_t)(AAudioStream *stream, void *user, aaudio_result_t error);
+
+#define AAUDIO_OK                               0
+#define AAUDIO_ERROR_DISCONNECTED               (-899)
+#define AAUDIO_UNSPECIFIED                      0
+#define AAUDIO_DIRECTION_OUTPUT                 0
+#define AAUDIO_DIRECTION_INPUT                  1
+#define AAUDIO_FORMAT_PCM_I16                   1
+#define AAUDIO_SHARING_MODE_EXCLUSIVE           0
+#define AAUDIO_PERFORMANCE_MODE_LOW_LATENCY     12
+#define AAUDIO_USAGE_VOICE_COMMUNICATION        2
+#define AAUDIO_CONTENT_TYPE_SPEECH              1
+#define AAUDIO_INPUT_PRESET_VOICE_COMMUNICATION 7
+#define AAUDIO_CALLBACK_RESULT_CONTINUE         0
+
+typedef struct {
+    aaudio_result_t (*create_builder)(AAudioStreamBuilder **builder);
+    void (*set_direction)(AAudioStreamBuilder *builder, int32_t direction);
+    void (*set_sharing_mode)(AAudioStreamBuilder *builder, int32_t mode);
+    void (*set_performance_mode)(AAudioStreamBuilder *builder, int32_t mode);
+    void (*set_format)(AAudioStreamBuilder *builder, int32_t format);
+    void (*set_channel_count)(AAudioStreamBuilder *builder, int32_t channels);
+    void (*set_sample_rate)(AAudioStreamBuilder *builder, int32_t rate);
+    void (*set_data_callback)(AAudioStreamBuilder *builder, aaudio_data_callback_t callback, void *user);
+    void (*set_error_callback)(AAudioStreamBuilder *builder, aaudio_error_callback_t callback, void *user);
+    void (*set_usage)(AAudioStreamBuilder *builder, int32_t usage);
+    void (*set_content_type)(AAudioStreamBuilder *builder, int32_t type);
+    void (*set_input_preset)(AAudioStreamBuilder *builder, int32_t preset);
+    aaudio_result_t (*open_stream)(AAudioStreamBuilder *builder, AAudioStream **stream);
+    aaudio_result_t (*delete_builder)(AAudioStreamBuilder *builder);
+    aaudio_result_t (*request_start)(AAudioStream *stream);
+    aaudio_result_t (*request_stop)(AAudioStream *stream);
+    aaudio_result_t (*close)(AAudioStream *stream);
+    int32_t (*get_sample_rate)(AAudioStream *stream);
+    int32_t (*get_frames_per_burst)(AAudioStream *stream);
+    int32_t (*get_buffer_size)(AAudioStream *stream);
+    aaudio_result_t (*set_buffer_size)(AAudioStream *stream, int32_t frames);
+    int32_t (*get_sharing_mode)(AAudioStream *stream);
+    int32_t (*get_performance_mode)(AAudioStream *stream);
+} aaudio_api_t;
+
+struct nade_audio {
+    nade_ctx_t *ctx;
+    AAudioStream *mic;
+    AAudioStream *spk;
+    int rate;
+    _Atomic bool started;
+    _Atomic bool lost;          // A stream was disconnected
+    _Atomic bool closing;
+    pthread_mutex_t mutex;      // Streams, against the service thread
+    pthread_cond_t cond;
+    pthread_t service;
+    // Speaker ring fill (frames) and refill pause, from the open streams
+    _Atomic int spk_ahead;
+    _Atomic long refill_ns;
+    pthread_t refill;
+    nade_audio_t *next;         // In g_engines
+};
+
+static aaudio_api_t g_aaudio;
+static bool g_aaudio_loaded;
+static pthread_once_t g_aaudio_once = PTHREAD_ONCE_INIT;
+
+// Open engines; ctx is NULL in one nade_audio_detach has stopped
+static pthread_mutex_t g_engines_mutex = PTHREAD_MUTEX_INITIALIZER;
+static nade_audio_t *g_engines;
+
+static void load_aaudio(void) {
+    void *lib = dlopen("libaaudio.so", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        return;
+    }
+    // Object to function pointer through memcpy: ISO C has no direct cast
+#define RESOLVE(field, name)                             \
+    do {                                                 \
+        void *sym = dlsym(lib, name);                    \
+        memcpy(&g_aaudio.field, &sym, sizeof(sym));      \
+    } while (0)
+    RESOLVE(create_builder, "AAudio_createStreamBuilder");
+    RESOLVE(set_direction, "AAudioStreamBuilder_setDirection");
+    RESOLVE(set_sharing_mode, "AAudioStreamBuilder_setSharingMode");
+    RESOLVE(set_performance_mode, "AAudioStreamBuilder_setPerformanceMode");
+    RESOLVE(set_format, "AAudioStreamBuilder_setFormat");
+    RESOLVE(set_channel_count, "AAudioStreamBuilder_setChannelCount");
+    RESOLVE(set_sample_rate, "AAudioStreamBuilder_setSampleRate");
+    RESOLVE(set_data_callback, "AAudioStreamBuilder_setDataCallback");
+    RESOLVE(set_error_callback, "AAudioStreamBuilder_setErrorCallback");
+    RESOLVE(set_usage, "AAudioStreamBuilder_setUsage");
+    RESOLVE(set_content_type, "AAudioStreamBuilder_setContentType");
+    RESOLVE(set_input_preset, "AAudioStreamBuilder_setInputPreset");
+    RESOLVE(open_stream, "AAudioStreamBuilder_openStream");
+    RESOLVE(delete_builder, "AAudioStreamBuilder_delete");
+    RESOLVE(request_start, "AAudioStream_requestStart");
+    RESOLVE(request_stop, "AAudioStream_requestStop");
+    RESOLVE(close, "AAudioStream_close");
+    RESOLVE(get_sample_rate, "AAudioStream_getSampleRate");
+    RESOLVE(get_frames_per_burst, "AAudioStream_getFramesPerBurst");
+    RESOLVE(get_buffer_size, "AAudioStream_getBufferSizeInFrames");
+    RESOLVE(set_buffer_size, "AAudioStream_setBufferSizeInFrames");
+    RESOLVE(get_sharing_mode, "AAudioStream_getSharingMode");
+    RESOLVE(get_performance_mode, "AAudioStream_getPerformanceMode");
+#undef RESOLVE
+    const aaudio_api_t *a = &g_aaudio;
+    g_aaudio_loaded = a->create_builder && a->set_direction && a->set_sharing_mode && a->set_performance_mode &&
+                      a->set_format && a->set_channel_count && a->set_sample_rate && a->set_data_callback &&
+                      a->set_error_callback && a->open_stream && a->delete_builder && a->request_start &&
+                      a->request_stop && a->close && a->get_sample_rate && a->get_frames_per_burst &&
+                      a->get_buffer_size && a->set_buffer_size && a->get_sharing_mode && a->get_performance_mode;
+    if (!g_aaudio_loaded) {
+        NADE_LOG(ANDROID_LOG_WARN, TAG, "libaaudio.so lacks entry points, native audio disabled");
+        dlclose(lib);
+    }
+}
+
+bool nade_audio_available(void) {
+    pthread_once(&g_aaudio_once, load_aaudio);
+    return g_aaudio_loaded;
+}
+
+static aaudio_result_t mic_callback(AAudioStream *stream, void *user, void *data, int32_t frames) {
+    (void)stream;
+    nade_audio_t *audio = (nade_audio_t *)user;
+    if (frames > 0) {
+        nade_ctx_push_mic(audio->ctx, (const int16_t *)data, (size_t)frames);
+    }
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+static aaudio_result_t speaker_callback(AAudioStream *stream, void *user, void *data, int32_t frames) {
+    (void)stream;
+    nade_audio_t *audio = (nade_audio_t *)user;
+    int16_t *pcm = (int16_t *)data;
+    if (frames <= 0) {
+        return AAUDIO_CALLBACK_RESULT_CONTINUE;
+    }
+    int got = nade_ctx_pop_speaker(audio->ctx, pcm, (size_t)frames);
+    size_t played = got > 0 ? (size_t)got : 0;
+    // Silence while the refill thread has nothing, rather than stale samples
+    memset(pcm + played, 0, ((size_t)frames - played) * sizeof(int16_t));
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+static void error_callback(AAudioStream *stream, void *user, aaudio_result_t error) {
+    (void)stream;
+    nade_audio_t *audio = (nade_audio_t *)user;
+    if (error == AAUDIO_ERROR_DISCONNECTED && !atomic_load(&audio->closing)) {
+        atomic_store(&audio->lost, true);
+        pthread_cond_signal(&audio->cond);
+    }
+}
+
+static AAudioStream *open_stream(nade_audio_t *audio, int32_t direction, int rate) {
+    AAudioStreamBuilder *builder = NULL;
+    if (g_aaudio.create_builder(&builder) != AAUDIO_OK) {
+        return NULL;
+    }
+    bool input = direction == AAUDIO_DIRECTION_INPUT;
+    g_aaudio.set_direction(builder, direction);
+    g_aaudio.set_sharing_mode(builder, AAUDIO_SHARING_MODE_EXCLUSIVE);
+    g_aaudio.set_performance_mode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    g_aaudio.set_format(builder, AAUDIO_FORMAT_PCM_I16);
+    g_aaudio.set_channel_count(builder, 1);
+    g_aaudio.set_sample_rate(builder, rate);
+    g_aaudio.set_data_callback(builder, input ? mic_callback : speaker_callback, audio);
+    g_aaudio.set_error_callback(builder, error_callback, audio);
+    if (input && g_aaudio.set_input_preset) {
+        // Keeps the platform's echo canceller on the call
+        g_aaudio.set_input_preset(builder, AAUDIO_INPUT_PRESET_VOICE_COMMUNICATION);
+    }
+    if (!input && g_aaudio.set_usage && g_aaudio.set_content_type) {
+        g_aaudio.set_usage(builder, AAUDIO_USAGE_VOICE_COMMUNICATION);
+        g_aaudio.set_content_type(builder, AAUDIO_CONTENT_TYPE_SPEECH);
+    }
+    AAudioStream *stream = NULL;
+    aaudio_result_t rc = g_aaudio.open_stream(builder, &stream);
+    g_aaudio.delete_builder(builder);
+    if (rc != AAUDIO_OK) {
+        NADE_LOG(ANDROID_LOG_WARN, TAG, "Opening %s stream at %d Hz failed: %d", input ? "input" : "output",
+                 rate, rc);
+        return NULL;
+    }
+    return stream;
+}
+
+static void close_streams(nade_audio_t *audio) {
+    AAudioStream *streams[2] = {audio->mic, audio->spk};
+    for (size_t i = 0; i < 2; i++) {
+        if (streams[i]) {
+            g_aaudio.request_stop(streams[i]);
+            g_aaudio.close(streams[i]);
+        }
+    }
+    audio->mic = NULL;
+    audio->spk = NULL;
+}
+
+static bool rate_supported(int rate) {
+    return nade_resampler_supported(rate, NADE_CODEC_RATE) && nade_resampler_supported(rate, NADE_CODEC_WB_RATE);
+}
+
+// Open the speaker at rate (the native rate when unspecified), then the mic
+// at whatever the speaker got: the context has one device rate
+static bool open_streams(nade_audio_t *audio, int rate) {
+    audio->spk = open_stream(audio, AAUDIO_DIRECTION_OUTPUT, rate);
+    if (!audio->spk) {
+        return false;
+    }
+    int opened = g_aaudio.get_sample_rate(audio->spk);
+    if (!rate_supported(opened)) {
+        close_streams(audio);
+        return false;
+    }
+    audio->mic = open_stream(audio, AAUDIO_DIRECTION_INPUT, opened);
+    if (!audio->mic || g_aaudio.get_sample_rate(audio->mic) != opened) {
+        close_streams(audio);
+        return false;
+    }
+    int burst = g_aaudio.get_frames_per_burst(audio->spk);
+    g_aaudio.set_buffer_size(audio->spk, burst * SPK_BUFFER_BURSTS);
+    int64_t half_burst_ns = (int64_t)burst * 500000000LL / opened;
+    atomic_store(&audio->refill_ns, (long)(half_burst_ns > 1000000 ? half_burst_ns : 1000000));
+    atomic_store(&audio->spk_ahead, burst * SPK_AHEAD_BURSTS);
+    audio->rate = opened;
+    return true;
+}
+
+static int start_streams(nade_audio_t *audio) {
+    if (g_aaudio.request_start(audio->spk) != AAUDIO_OK || g_aaudio.request_start(audio->mic) != AAUDIO_OK) {
+        g_aaudio.request_stop(audio->spk);
+        g_aaudio.request_stop(audio->mic);
+        return -1;
+    }
+    return 0;
+}
+
+// Reopens the streams after a disconnect, at the rate the context was told
+static void *service_main(void *arg) {
+    nade_audio_t *audio = (nade_audio_t *)arg;
+    pthread_mutex_lock(&audio->mutex);
+    while (!atomic_load(&audio->closing)) {
+        if (atomic_exchange(&audio->lost, false)) {
+            close_streams(audio);
+            int rate = audio->rate;
+            if (!open_streams(audio, rate) || audio->rate != rate || (audio->started && start_streams(audio) != 0)) {
+                // Retried on the next poll, e.g. while the new route settles
+                close_streams(audio);
+                audio->rate = rate;
+                atomic_store(&audio->lost, true);
+            } else {
+                NADE_LOG(ANDROID_LOG_INFO, TAG, "Audio streams reopened after a disconnect");
+            }
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += SERVICE_POLL_MS * 1000000L;
+        ts.tv_sec += ts.tv_nsec / 1000000000L;
+        ts.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&audio->cond, &audio->mutex, &ts);
+    }
+    pthread_mutex_unlock(&audio->mutex);
+    return NULL;
+}
+
+// Plays out the jitter buffer into the speaker ring, so the speaker callback
+// only has to pop: tops the ring up to spk_ahead frames, then pauses for half
+// a callback burst. Records the mic audio set aside for a capture on the way.
+static void *refill_main(void *arg) {
+    nade_audio_t *audio = (nade_audio_t *)arg;
+    while (!atomic_load(&audio->closing)) {
+        nade_ctx_flush_mic_capture(audio->ctx);
+        int ahead = atomic_load(&audio->spk_ahead);
+        long pause_ns = REFILL_POLL_MS * 1000000L;
+        if (atomic_load(&audio->started) && ahead > 0) {
+            // Waits for decoded audio when there is nothing to play out
+            if (nade_ctx_wait_speaker(audio->ctx, (size_t)ahead, REFILL_POLL_MS) != 1) {
+                continue;
+            }
+            pause_ns = atomic_load(&audio->refill_ns);
+        }
+        struct timespec ts = {pause_ns / 1000000000L, pause_ns % 1000000000L};
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+static bool ctx_has_engine(const nade_ctx_t *ctx) {
+    pthread_mutex_lock(&g_engines_mutex);
+    const nade_audio_t *audio = g_engines;
+    while (audio && audio->ctx != ctx) {
+        audio = audio->next;
+    }
+    pthread_mutex_unlock(&g_engines_mutex);
+    return audio != NULL;
+}
+
+nade_audio_t *nade_audio_open(nade_ctx_t *ctx, int preferred_rate) {
+    if (!ctx || !nade_audio_available()) {
+        return NULL;
+    }
+    if (ctx_has_engine(ctx)) {
+        NADE_LOG(ANDROID_LOG_WARN, TAG, "Context already has an audio engine open");
+        return NULL;
+    }
+    nade_audio_t *audio = (nade_audio_t *)calloc(1, sizeof(*audio));
+    if (!audio) {
+        return NULL;
+    }
+    audio->ctx = ctx;
+    atomic_init(&audio->started, false);
+    atomic_init(&audio->lost, false);
+    atomic_init(&audio->closing, false);
+    atomic_init(&audio->spk_ahead, 0);
+    atomic_init(&audio->refill_ns, 0);
+    pthread_mutex_init(&audio->mutex, NULL);
+    pthread_cond_init(&audio->cond, NULL);
+    if (!open_streams(audio, AAUDIO_UNSPECIFIED) && !open_streams(audio, preferred_rate)) {
+        pthread_cond_destroy(&audio->cond);
+        pthread_mutex_destroy(&audio->mutex);
+        free(audio);
+        return NULL;
+    }
+    if (pthread_create(&audio->service, NULL, service_main, audio) != 0) {
+        close_streams(audio);
+        pthread_cond_destroy(&audio->cond);
+        pthread_mutex_destroy(&audio->mutex);
+        free(audio);
+        return NULL;
+    }
+    if (pthread_create(&audio->refill, NULL, refill_main, audio) != 0) {
+        pthread_mutex_lock(&audio->mutex);
+        atomic_store(&audio->closing, true);
+        pthread_cond_signal(&audio->cond);
+        pthread_mutex_unlock(&audio->mutex);
+        pthread_join(audio->service, NULL);
+        close_streams(audio);
+        pthread_cond_destroy(&audio->cond);
+        pthread_mutex_destroy(&audio->mutex);
+        free(audio);
+        return NULL;
+    }
+    nade_audio_info_t info;
+    nade_audio_get_info(audio, &info);
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "Audio open: %d Hz, bursts %d/%d, speaker buffer %d, %s, %s", info.sample_rate,
+             info.mic_burst, info.spk_burst, info.spk_buffer, info.exclusive ? "exclusive" : "shared",
+             info.low_latency ? "low latency" : "normal latency");
+    pthread_mutex_lock(&g_engines_mutex);
+    audio->next = g_engines;
+    g_engines = audio;
+    pthread_mutex_unlock(&g_engines_mutex);
+    return audio;
+}
+
+void nade_audio_get_info(const nade_audio_t *audio, nade_audio_info_t *out) {
+    nade_audio_t *a = (nade_audio_t *)audio;
+    memset(out, 0, sizeof(*out));
+    pthread_mutex_lock(&a->mutex);
+    out->sample_rate = a->rate;
+    if (a->mic && a->spk) {
+        out->mic_burst = g_aaudio.get_frames_per_burst(a->mic);
+        out->spk_burst = g_aaudio.get_frames_per_burst(a->spk);
+        out->spk_buffer = g_aaudio.get_buffer_size(a->spk);
+        out->exclusive = g_aaudio.get_sharing_mode(a->mic) == AAUDIO_SHARING_MODE_EXCLUSIVE &&
+                         g_aaudio.get_sharing_mode(a->spk) == AAUDIO_SHARING_MODE_EXCLUSIVE;
+        out->low_latency = g_aaudio.get_performance_mode(a->mic) == AAUDIO_PERFORMANCE_MODE_LOW_LATENCY &&
+                           g_aaudio.get_performance_mode(a->spk) == AAUDIO_PERFORMANCE_MODE_LOW_LATENCY;
+    }
+    pthread_mutex_unlock(&a->mutex);
+}
+
+int nade_audio_start(nade_audio_t *audio) {
+    if (!audio->ctx) {
+        return -1;
+    }
+    pthread_mutex_lock(&audio->mutex);
+    atomic_store(&audio->started, true);
+    // Streams lost meanwhile start when the service thread reopens them
+    int rc = audio->mic && audio->spk ? start_streams(audio) : 0;
+    pthread_mutex_unlock(&audio->mutex);
+    return rc;
+}
+
+// End the threads and close the streams; no callback runs once this returns
+static void stop_engine(nade_audio_t *audio) {
+    pthread_mutex_lock(&audio->mutex);
+    atomic_store(&audio->closing, true);
+    pthread_cond_signal(&audio->cond);
+    pthread_mutex_unlock(&audio->mutex);
+    pthread_join(audio->service, NULL);
+    pthread_join(audio->refill, NULL);
+    close_streams(audio);
+}
+
+void nade_audio_detach(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&g_engines_mutex);
+    for (nade_audio_t *audio = g_engines; audio; audio = audio->next) {
+        if (audio->ctx == ctx) {
+            NADE_LOG(ANDROID_LOG_WARN, TAG, "Context destroyed with its audio engine open, stopping it");
+            stop_engine(audio);
+            audio->ctx = NULL;
+        }
+    }
+    pthread_mutex_unlock(&g_engines_mutex);
+}
+
+void nade_audio_close(nade_audio_t *audio) {
+    if (!audio) {
+        return;
+    }
+    pthread_mutex_lock(&g_engines_mutex);
+    nade_audio_t **link = &g_engines;
+    while (*link != audio) {
+        link = &(*link)->next;
+    }
+    *link = audio->next;
+    bool running = audio->ctx != NULL;
+    pthread_mutex_unlock(&g_engines_mutex);
+    if (running) {
+        stop_engine(audio);
+    }
+    pthread_cond_destroy(&audio->cond);
+    pthread_mutex_destroy(&audio->mutex);
+    free(audio);
+}
@@ -0,0 +1,141 @@
+/*
+ * Binary session capture implementation
+ *
+ * The file is sized with ftruncate when it is opened, so the pages are
+ * zero and a record that was claimed but never filled reads as the end.
+ * Closing trims the file to the bytes claimed; a record that ran past the
+ * end leaves at most one record's worth of zeros before the trim.
+ */
+
+#include "nade_capture.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static const uint8_t capture_magic[8] = {'N', 'A', 'D', 'E', 'C', 'A', 'P', 0};
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static size_t record_size(size_t len) {
+    return NADE_CAPTURE_RECORD_HEADER + ((len + 3) & ~(size_t)3);
+}
+
+bool nade_capture_open(nade_capture_t *cap, const char *path, size_t max_bytes) {
+    if (!path || max_bytes < NADE_CAPTURE_HEADER_LEN) {
+        return false;
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, (off_t)max_bytes) != 0) {
+        close(fd);
+        return false;
+    }
+    void *base = mmap(NULL, max_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t unix_ms = (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+    cap->base = (uint8_t *)base;
+    cap->capacity = max_bytes;
+    cap->fd = fd;
+    memcpy(cap->base, capture_magic, sizeof(capture_magic));
+    put_le32(cap->base + 8, NADE_CAPTURE_VERSION);
+    put_le32(cap->base + 12, NADE_CAPTURE_HEADER_LEN);
+    put_le32(cap->base + 16, (uint32_t)unix_ms);
+    put_le32(cap->base + 20, (uint32_t)(unix_ms >> 32));
+    atomic_init(&cap->used, NADE_CAPTURE_HEADER_LEN);
+    atomic_init(&cap->dropped, 0);
+    return true;
+}
+
+uint8_t *nade_capture_append(nade_capture_t *cap, uint8_t kind, uint32_t time_ms, size_t len) {
+    if (kind == NADE_CAPTURE_END || len > NADE_CAPTURE_MAX_PAYLOAD) {
+        atomic_fetch_add_explicit(&cap->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    size_t size = record_size(len);
+    size_t offset = atomic_fetch_add_explicit(&cap->used, size, memory_order_relaxed);
+    if (offset > cap->capacity || cap->capacity - offset < size) {
+        atomic_fetch_add_explicit(&cap->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    uint8_t *record = cap->base + offset;
+    put_le32(record, (uint32_t)kind | ((uint32_t)len << 8));
+    put_le32(record + 4, time_ms);
+    // Padding stays zero from the sizing of the file
+    return record + NADE_CAPTURE_RECORD_HEADER;
+}
+
+void nade_capture_write(nade_capture_t *cap, uint8_t kind, uint32_t time_ms, const void *data, size_t len) {
+    uint8_t *payload = nade_capture_append(cap, kind, time_ms, len);
+    if (payload && len > 0) {
+        memcpy(payload, data, len);
+    }
+}
+
+size_t nade_capture_close(nade_capture_t *cap) {
+    size_t used = atomic_load_explicit(&cap->used, memory_order_relaxed);
+    size_t kept = used < cap->capacity ? used : cap->capacity;
+    put_le32(cap->base + 24, atomic_load_explicit(&cap->dropped, memory_order_relaxed));
+    munmap(cap->base, cap->capacity);
+    if (ftruncate(cap->fd, (off_t)kept) != 0) {
+        kept = cap->capacity;
+    }
+    close(cap->fd);
+    cap->base = NULL;
+    cap->fd = -1;
+    return kept;
+}
+
+bool nade_capture_reader_init(nade_capture_reader_t *reader, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    if (!bytes || size < NADE_CAPTURE_HEADER_LEN || memcmp(bytes, capture_magic, sizeof(capture_magic)) != 0 ||
+        get_le32(bytes + 8) != NADE_CAPTURE_VERSION) {
+        return false;
+    }
+    uint32_t header_len = get_le32(bytes + 12);
+    if (header_len < NADE_CAPTURE_HEADER_LEN || header_len > size) {
+        return false;
+    }
+    reader->data = bytes;
+    reader->size = size;
+    reader->offset = header_len;
+    reader->start_unix_ms = (uint64_t)get_le32(bytes + 16) | ((uint64_t)get_le32(bytes + 20) << 32);
+    reader->dropped = get_le32(bytes + 24);
+    return true;
+}
+
+bool nade_capture_next(nade_capture_reader_t *reader, nade_capture_record_t *record) {
+    if (reader->size - reader->offset < NADE_CAPTURE_RECORD_HEADER) {
+        return false;
+    }
+    const uint8_t *p = reader->data + reader->offset;
+    uint32_t word = get_le32(p);
+    size_t len = word >> 8;
+    if ((word & 0xFF) == NADE_CAPTURE_END || record_size(len) > reader->size - reader->offset) {
+        return false;
+    }
+    record->kind = (uint8_t)(word & 0xFF);
+    record->time_ms = get_le32(p + 4);
+    record->data = p + NADE_CAPTURE_RECORD_HEADER;
+    record->len = len;
+    reader->offset += record_size(len);
+    return true;
+}
@@ -0,0 +1,656 @@
+/*
+ * Voice codec implementation
+ *
+ * The 2- and 3-bit ADPCM variants reuse the IMA step table with a
+ * sign + magnitude code and their own index adaptation. The vocoder is a
+ * classic LPC-10 style design: pre-emphasis, autocorrelation LPC with a lag
+ * window, pitch from the normalised autocorrelation of the residual, and an
+ * all-pole lattice synthesiser driven by the quantised reflection
+ * coefficients so the decoder is stable whatever arrives.
+ */
+
+#include "nade_codec.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define CODEC_ENTRY(name, bytes, rate) {name, (bytes) * 8 * 25, rate, \
+                                        NADE_CODEC_FRAME_SAMPLES * (rate) / NADE_CODEC_RATE, bytes}
+
+static const nade_codec_info_t kCodecs[NADE_CODEC_COUNT] = {
+    [NADE_CODEC_ADPCM4]    = CODEC_ENTRY("adpcm4",   4 + NADE_CODEC_FRAME_SAMPLES / 2, NADE_CODEC_RATE),
+    [NADE_CODEC_ADPCM3]    = CODEC_ENTRY("adpcm3",   4 + NADE_CODEC_FRAME_SAMPLES * 3 / 8, NADE_CODEC_RATE),
+    [NADE_CODEC_ADPCM2]    = CODEC_ENTRY("adpcm2",   4 + NADE_CODEC_FRAME_SAMPLES / 4, NADE_CODEC_RATE),
+    [NADE_CODEC_LPC2400]   = CODEC_ENTRY("lpc2400",  12, NADE_CODEC_RATE),  // Two analysis frames
+    [NADE_CODEC_LPC1200]   = CODEC_ENTRY("lpc1200",  6, NADE_CODEC_RATE),
+    [NADE_CODEC_ADPCM4_WB] = CODEC_ENTRY("adpcm4wb", 4 + NADE_CODEC_MAX_FRAME_SAMPLES / 2, NADE_CODEC_WB_RATE),
+};
+
+const nade_codec_info_t *nade_codec_info(int id) {
+    if (id <= NADE_CODEC_NONE || id >= NADE_CODEC_COUNT) {
+        return NULL;
+    }
+    return &kCodecs[id];
+}
+
+int nade_codec_find(const char *name, size_t len) {
+    for (int id = NADE_CODEC_NONE + 1; id < NADE_CODEC_COUNT; id++) {
+        if (strlen(kCodecs[id].name) == len && strncmp(kCodecs[id].name, name, len) == 0) {
+            return id;
+        }
+    }
+    return NADE_CODEC_NONE;
+}
+
+static int clamp_int(int value, int min_v, int max_v) {
+    if (value < min_v) return min_v;
+    if (value > max_v) return max_v;
+    return value;
+}
+
+// -------------------------------------------------------------------------
+// ADPCM codec (IMA 4-bit mono)
+
+static const int kStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16,
+    17, 19, 21, 23, 25, 28, 31, 34,
+    37, 41, 45, 50, 55, 60, 66, 73,
+    80, 88, 97, 107, 118, 130, 143, 157,
+    173, 190, 209, 230, 253, 279, 307, 337,
+    371, 408, 449, 494, 544, 598, 658, 724,
+    796, 876, 963, 1060, 1166, 1282, 1411, 1552,
+    1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132,
+    7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289,
+    16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int kIndexAdjust[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static void reset_adpcm(nade_adpcm_state_t *state) {
+    state->predictor = 0;
+    state->index = 0;
+    state->initialized = false;
+}
+
+static size_t adpcm_encode_block(const int16_t *samples, size_t count,
+                                 uint8_t *out, size_t max_bytes,
+                                 nade_adpcm_state_t *state) {
+    if (count == 0 || max_bytes < 4) {
+        return 0;
+    }
+    if (!state->initialized) {
+        state->predictor = samples[0];
+        state->index = 0;
+        state->initialized = true;
+    }
+    const size_t encoded_nibbles = count;
+    const size_t encoded_bytes = (encoded_nibbles + 1) / 2;
+    if (4 + encoded_bytes > max_bytes) {
+        return 0;
+    }
+    out[0] = (uint8_t)(state->predictor & 0xFF);
+    out[1] = (uint8_t)((state->predictor >> 8) & 0xFF);
+    out[2] = (uint8_t)state->index;
+    out[3] = 0;
+    size_t out_idx = 4;
+    uint8_t current_byte = 0;
+    bool high_nibble = false;
+    for (size_t i = 0; i < count; ++i) {
+        int diff = samples[i] - state->predictor;
+        int step = kStepTable[state->index];
+        int nibble = 0;
+        if (diff < 0) {
+            nibble = 8;
+            diff = -diff;
+        }
+        if (diff >= step) {
+            nibble |= 4;
+            diff -= step;
+        }
+        if (diff >= step / 2) {
+            nibble |= 2;
+            diff -= step / 2;
+        }
+        if (diff >= step / 4) {
+            nibble |= 1;
+        }
+        int delta = step >> 3;
+        if (nibble & 4) delta += step;
+        if (nibble & 2) delta += step >> 1;
+        if (nibble & 1) delta += step >> 2;
+        if (nibble & 8) {
+            state->predictor -= delta;
+        } else {
+            state->predictor += delta;
+        }
+        state->predictor = clamp_int(state->predictor, -32768, 32767);
+        state->index = clamp_int(state->index + kIndexAdjust[nibble & 0x0F], 0, 88);
+        if (!high_nibble) {
+            current_byte = (uint8_t)(nibble & 0x0F);
+            high_nibble = true;
+        } else {
+            current_byte |= (uint8_t)((nibble & 0x0F) << 4);
+            out[out_idx++] = current_byte;
+            high_nibble = false;
+            current_byte = 0;
+        }
+    }
+    if (high_nibble) {
+        out[out_idx++] = current_byte;
+    }
+    return out_idx;
+}
+
+static size_t adpcm_decode_block(const uint8_t *data, size_t len,
+                                 int16_t *out, size_t max_samples,
+                                 nade_adpcm_state_t *state) {
+    if (len < 4 || max_samples == 0) {
+        return 0;
+    }
+    int predictor = (int16_t)(data[0] | (data[1] << 8));
+    int index = clamp_int(data[2], 0, 88);
+    size_t produced = 0;
+    for (size_t i = 4; i < len && produced < max_samples; ++i) {
+        uint8_t byte = data[i];
+        for (int shift = 0; shift <= 4 && produced < max_samples; shift += 4) {
+            int nibble = (byte >> shift) & 0x0F;
+            int step = kStepTable[index];
+            int delta = step >> 3;
+            if (nibble & 4) delta += step;
+            if (nibble & 2) delta += step >> 1;
+            if (nibble & 1) delta += step >> 2;
+            if (nibble & 8) {
+                predictor -= delta;
+            } else {
+                predictor += delta;
+            }
+            predictor = clamp_int(predictor, -32768, 32767);
+            index = clamp_int(index + kIndexAdjust[nibble], 0, 88);
+            out[produced++] = (int16_t)predictor;
+        }
+    }
+    state->predictor = predictor;
+    state->index = index;
+    state->initialized = true;
+    return produced;
+}
+
+// -------------------------------------------------------------------------
+// Low-bit ADPCM (2 or 3 bits per sample)
+//
+// Code = sign bit above (bits - 1) magnitude bits, packed LSB first. The
+// magnitude m quantises |diff| in steps of step / 2^(bits - 2) and
+// reconstructs at the interval midpoint, as IMA does with 3 magnitude bits.
+
+static const int kIndexAdjust3[4] = {-1, -1, 2, 4};
+static const int kIndexAdjust2[2] = {-1, 2};
+
+static const int *lowbit_adjust(int bits) {
+    return bits == 3 ? kIndexAdjust3 : kIndexAdjust2;
+}
+
+static int lowbit_delta(int step, int magnitude, int mag_bits) {
+    return (step * (2 * magnitude + 1)) >> mag_bits;
+}
+
+static size_t adpcm_lowbit_encode(const int16_t *samples, size_t count, int bits,
+                                  uint8_t *out, size_t max_bytes, nade_adpcm_state_t *state) {
+    size_t encoded_bytes = (count * (size_t)bits + 7) / 8;
+    if (count == 0 || 4 + encoded_bytes > max_bytes) {
+        return 0;
+    }
+    if (!state->initialized) {
+        state->predictor = samples[0];
+        state->index = 0;
+        state->initialized = true;
+    }
+    out[0] = (uint8_t)(state->predictor & 0xFF);
+    out[1] = (uint8_t)((state->predictor >> 8) & 0xFF);
+    out[2] = (uint8_t)state->index;
+    out[3] = 0;
+    const int mag_bits = bits - 1;
+    const int max_mag = (1 << mag_bits) - 1;
+    const int *adjust = lowbit_adjust(bits);
+    size_t out_idx = 4;
+    uint32_t acc = 0;
+    int acc_bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int diff = samples[i] - state->predictor;
+        int step = kStepTable[state->index];
+        int sign = 0;
+        if (diff < 0) {
+            sign = 1;
+            diff = -diff;
+        }
+        int magnitude = ((diff << mag_bits) >> 1) / step;
+        if (magnitude > max_mag) {
+            magnitude = max_mag;
+        }
+        int delta = lowbit_delta(step, magnitude, mag_bits);
+        state->predictor += sign ? -delta : delta;
+        state->predictor = clamp_int(state->predictor, -32768, 32767);
+        state->index = clamp_int(state->index + adjust[magnitude], 0, 88);
+        acc |= (uint32_t)((sign << mag_bits) | magnitude) << acc_bits;
+        acc_bits += bits;
+        while (acc_bits >= 8) {
+            out[out_idx++] = (uint8_t)(acc & 0xFF);
+            acc >>= 8;
+            acc_bits -= 8;
+        }
+    }
+    if (acc_bits > 0) {
+        out[out_idx++] = (uint8_t)(acc & 0xFF);
+    }
+    return out_idx;
+}
+
+static size_t adpcm_lowbit_decode(const uint8_t *data, size_t len, int bits,
+                                  int16_t *out, size_t max_samples, nade_adpcm_state_t *state) {
+    if (len < 4 || max_samples == 0) {
+        return 0;
+    }
+    int predictor = (int16_t)(data[0] | (data[1] << 8));
+    int index = clamp_int(data[2], 0, 88);
+    const int mag_bits = bits - 1;
+    const int *adjust = lowbit_adjust(bits);
+    const uint32_t mask = (1u << bits) - 1u;
+    size_t produced = 0;
+    uint32_t acc = 0;
+    int acc_bits = 0;
+    for (size_t i = 4; i < len && produced < max_samples; ++i) {
+        acc |= (uint32_t)data[i] << acc_bits;
+        acc_bits += 8;
+        while (acc_bits >= bits && produced < max_samples) {
+            int code = (int)(acc & mask);
+            acc >>= bits;
+            acc_bits -= bits;
+            int magnitude = code & ((1 << mag_bits) - 1);
+            int delta = lowbit_delta(kStepTable[index], magnitude, mag_bits);
+            predictor += (code >> mag_bits) ? -delta : delta;
+            predictor = clamp_int(predictor, -32768, 32767);
+            index = clamp_int(index + adjust[magnitude], 0, 88);
+            out[produced++] = (int16_t)predictor;
+        }
+    }
+    state->predictor = predictor;
+    state->index = index;
+    state->initialized = true;
+    return produced;
+}
+
+// -------------------------------------------------------------------------
+// LPC vocoder
+//
+// Each analysis frame packs into 48 bits, LSB first:
+//   pitch code (7) | gain code (5) | reflection coefficients (36)
+// lpc2400 sends two 160-sample frames per audio frame, lpc1200 one
+// 320-sample frame.
+
+#define LPC_FRAME_BYTES     6
+#define LPC_PREEMPHASIS     0.9375f
+#define LPC_VOICING_MIN     0.35f   // Normalised residual correlation for "voiced"
+#define LPC_GAIN_LEVELS     31      // Gain codes 1..31; 0 is silence
+#define LPC_GAIN_LOG2_MAX   14.0f   // Largest coded residual RMS, 2^14
+
+_Static_assert(NADE_LPC_PITCH_MAX - NADE_LPC_PITCH_MIN + 1 <= 127, "pitch must fit 7 bits");
+
+// Bits and arcsine-domain range per reflection coefficient
+static const int kLpcBits[NADE_LPC_ORDER] = {5, 5, 4, 4, 4, 4, 3, 3, 2, 2};
+static const float kLpcRange[NADE_LPC_ORDER] = {
+    1.45f, 1.45f, 1.2f, 1.2f, 1.0f, 1.0f, 0.8f, 0.8f, 0.6f, 0.6f
+};
+
+typedef struct {
+    int pitch;                  // 0 = unvoiced
+    int gain_code;
+    int k_code[NADE_LPC_ORDER];
+} lpc_params_t;
+
+static size_t lpc_frame_samples(int codec) {
+    return codec == NADE_CODEC_LPC2400 ? NADE_CODEC_FRAME_SAMPLES / 2 : NADE_CODEC_FRAME_SAMPLES;
+}
+
+static int quantize_reflection(float k, int i) {
+    int levels = 1 << kLpcBits[i];
+    float r = kLpcRange[i];
+    float theta = asinf(k < -0.999f ? -0.999f : (k > 0.999f ? 0.999f : k));
+    int code = (int)lrintf((theta + r) / (2.0f * r) * (float)(levels - 1));
+    return clamp_int(code, 0, levels - 1);
+}
+
+static float dequantize_reflection(int code, int i) {
+    int levels = 1 << kLpcBits[i];
+    float r = kLpcRange[i];
+    return sinf(-r + 2.0f * r * (float)code / (float)(levels - 1));
+}
+
+static int quantize_gain(float rms) {
+    if (rms < 1.0f) {
+        return 0;
+    }
+    int code = 1 + (int)lrintf(log2f(rms) * (float)(LPC_GAIN_LEVELS - 1) / LPC_GAIN_LOG2_MAX);
+    return clamp_int(code, 1, LPC_GAIN_LEVELS);
+}
+
+static float dequantize_gain(int code) {
+    if (code == 0) {
+        return 0.0f;
+    }
+    return exp2f((float)(code - 1) * LPC_GAIN_LOG2_MAX / (float)(LPC_GAIN_LEVELS - 1));
+}
+
+static void pack_lpc(const lpc_params_t *p, uint8_t *out) {
+    uint64_t bits = (uint64_t)p->pitch | ((uint64_t)p->gain_code << 7);
+    int shift = 12;
+    for (int i = 0; i < NADE_LPC_ORDER; i++) {
+        bits |= (uint64_t)p->k_code[i] << shift;
+        shift += kLpcBits[i];
+    }
+    for (int i = 0; i < LPC_FRAME_BYTES; i++) {
+        out[i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+static void unpack_lpc(const uint8_t *in, lpc_params_t *p) {
+    uint64_t bits = 0;
+    for (int i = 0; i < LPC_FRAME_BYTES; i++) {
+        bits |= (uint64_t)in[i] << (8 * i);
+    }
+    p->pitch = (int)(bits & 0x7F);
+    p->gain_code = (int)((bits >> 7) & 0x1F);
+    int shift = 12;
+    for (int i = 0; i < NADE_LPC_ORDER; i++) {
+        p->k_code[i] = (int)((bits >> shift) & ((1u << kLpcBits[i]) - 1u));
+        shift += kLpcBits[i];
+    }
+}
+
+// Levinson-Durbin on r[0..order]: predictor a[1..order] (x[n] ~ sum a[j] x[n-j])
+// and reflection coefficients k[0..order-1].
+static void levinson(const float *r, float *a, float *k) {
+    float error = r[0];
+    float tmp[NADE_LPC_ORDER + 1];
+    memset(a, 0, sizeof(float) * (NADE_LPC_ORDER + 1));
+    for (int i = 1; i <= NADE_LPC_ORDER; i++) {
+        float acc = r[i];
+        for (int j = 1; j < i; j++) {
+            acc -= a[j] * r[i - j];
+        }
+        float ki = error > 0.0f ? acc / error : 0.0f;
+        if (ki > 0.999f) ki = 0.999f;
+        if (ki < -0.999f) ki = -0.999f;
+        k[i - 1] = ki;
+        memcpy(tmp, a, sizeof(tmp));
+        a[i] = ki;
+        for (int j = 1; j < i; j++) {
+            a[j] = tmp[j] - ki * tmp[i - j];
+        }
+        error *= 1.0f - ki * ki;
+    }
+}
+
+// Pitch lag from the normalised autocorrelation of the residual, or 0 if the
+// frame does not look voiced. res points at the frame, with
+// NADE_LPC_PITCH_MAX samples of history before it.
+static int find_pitch(const float *residual, size_t n) {
+    // Twice-applied [1 2 1] / 4 low-pass: spreads each pitch pulse over a few
+    // samples so lags that fall between integers still correlate
+    float smooth[NADE_LPC_PITCH_MAX + NADE_CODEC_FRAME_SAMPLES];
+    size_t total = NADE_LPC_PITCH_MAX + n;
+    const float *src = residual - NADE_LPC_PITCH_MAX;
+    for (int pass = 0; pass < 2; pass++) {
+        float prev1 = 0.0f, prev2 = 0.0f;
+        for (size_t i = 0; i < total; i++) {
+            float cur = src[i];
+            smooth[i] = 0.25f * (cur + 2.0f * prev1 + prev2);
+            prev2 = prev1;
+            prev1 = cur;
+        }
+        src = smooth;
+    }
+    const float *res = smooth + NADE_LPC_PITCH_MAX;
+
+    float corr[NADE_LPC_PITCH_MAX + 1] = {0};
+    float energy = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        energy += res[i] * res[i];
+    }
+    if (energy <= 0.0f) {
+        return 0;
+    }
+    int best = 0;
+    for (int lag = NADE_LPC_PITCH_MIN; lag <= NADE_LPC_PITCH_MAX; lag++) {
+        float cross = 0.0f, lagged = 0.0f;
+        for (size_t i = 0; i < n; i++) {
+            cross += res[i] * res[(ptrdiff_t)i - lag];
+            lagged += res[(ptrdiff_t)i - lag] * res[(ptrdiff_t)i - lag];
+        }
+        corr[lag] = lagged > 0.0f ? cross / sqrtf(energy * lagged) : 0.0f;
+        if (best == 0 || corr[lag] > corr[best]) {
+            best = lag;
+        }
+    }
+    if (corr[best] < LPC_VOICING_MIN) {
+        return 0;
+    }
+    // Prefer a submultiple that correlates almost as well (avoid octave
+    // errors); the true lag may fall between integers, so search +-1
+    for (int div = 3; div >= 2; div--) {
+        int centre = (best + div / 2) / div;
+        int lag = 0;
+        for (int d = -1; d <= 1; d++) {
+            int cand = centre + d;
+            if (cand >= NADE_LPC_PITCH_MIN && (lag == 0 || corr[cand] > corr[lag])) {
+                lag = cand;
+            }
+        }
+        if (lag != 0 && corr[lag] > 0.7f * corr[best]) {
+            return lag;
+        }
+    }
+    return best;
+}
+
+static void lpc_analyse(nade_lpc_encoder_t *enc, const int16_t *samples, size_t n,
+                        lpc_params_t *params) {
+    float buf[NADE_LPC_PITCH_MAX + NADE_CODEC_FRAME_SAMPLES];
+    float res[NADE_LPC_PITCH_MAX + NADE_CODEC_FRAME_SAMPLES];
+    float *x = buf + NADE_LPC_PITCH_MAX;
+    float *e = res + NADE_LPC_PITCH_MAX;
+    memcpy(buf, enc->signal, sizeof(enc->signal));
+    memcpy(res, enc->residual, sizeof(enc->residual));
+    for (size_t i = 0; i < n; i++) {
+        float in = (float)samples[i];
+        x[i] = in - LPC_PREEMPHASIS * enc->last_input;
+        enc->last_input = in;
+    }
+
+    // Hamming-windowed autocorrelation with a 60 Hz Gaussian lag window and
+    // a white-noise floor to keep the normal equations well conditioned
+    float windowed[NADE_CODEC_FRAME_SAMPLES];
+    for (size_t i = 0; i < n; i++) {
+        float w = 0.54f - 0.46f * cosf(2.0f * (float)M_PI * (float)i / (float)(n - 1));
+        windowed[i] = x[i] * w;
+    }
+    float r[NADE_LPC_ORDER + 1];
+    for (int lag = 0; lag <= NADE_LPC_ORDER; lag++) {
+        float acc = 0.0f;
+        for (size_t i = (size_t)lag; i < n; i++) {
+            acc += windowed[i] * windowed[i - (size_t)lag];
+        }
+        float f = 2.0f * (float)M_PI * 60.0f * (float)lag / 8000.0f;
+        r[lag] = acc * expf(-0.5f * f * f);
+    }
+    r[0] *= 1.0001f;
+
+    float a[NADE_LPC_ORDER + 1];
+    float k[NADE_LPC_ORDER];
+    if (r[0] <= 0.0f) {
+        memset(a, 0, sizeof(a));
+        memset(k, 0, sizeof(k));
+    } else {
+        levinson(r, a, k);
+    }
+
+    float energy = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        float pred = 0.0f;
+        for (int j = 1; j <= NADE_LPC_ORDER; j++) {
+            pred += a[j] * x[(ptrdiff_t)i - j];
+        }
+        e[i] = x[i] - pred;
+        energy += e[i] * e[i];
+    }
+
+    params->gain_code = quantize_gain(sqrtf(energy / (float)n));
+    int lag = params->gain_code > 0 ? find_pitch(e, n) : 0;
+    params->pitch = lag > 0 ? lag - NADE_LPC_PITCH_MIN + 1 : 0;
+    for (int i = 0; i < NADE_LPC_ORDER; i++) {
+        params->k_code[i] = quantize_reflection(k[i], i);
+    }
+
+    memcpy(enc->signal, buf + n, sizeof(enc->signal));
+    memcpy(enc->residual, res + n, sizeof(enc->residual));
+}
+
+static float lpc_noise(nade_lpc_decoder_t *dec) {
+    dec->noise_seed = dec->noise_seed * 1664525u + 1013904223u;
+    return (float)(int32_t)dec->noise_seed / 2147483648.0f;  // [-1, 1)
+}
+
+static void lpc_synthesise(nade_lpc_decoder_t *dec, const lpc_params_t *params,
+                           int16_t *out, size_t n) {
+    float k[NADE_LPC_ORDER];
+    for (int i = 0; i < NADE_LPC_ORDER; i++) {
+        k[i] = dequantize_reflection(params->k_code[i], i);
+    }
+    float gain = dequantize_gain(params->gain_code);
+    int period = params->pitch > 0 ? params->pitch + NADE_LPC_PITCH_MIN - 1 : 0;
+    // Unit-RMS excitation: one pulse of sqrt(period) per period, or uniform
+    // noise scaled by sqrt(3)
+    float pulse = period > 0 ? gain * sqrtf((float)period) : 0.0f;
+    float noise = gain * 1.7320508f;
+
+    for (size_t i = 0; i < n; i++) {
+        float excitation;
+        if (period > 0) {
+            if (dec->pulse_countdown <= 0 || dec->pulse_countdown > period) {
+                dec->pulse_countdown = period;
+            }
+            excitation = dec->pulse_countdown == period ? pulse : 0.0f;
+            dec->pulse_countdown--;
+        } else {
+            excitation = noise * lpc_noise(dec);
+        }
+        // All-pole lattice, highest stage first
+        float f = excitation;
+        for (int s = NADE_LPC_ORDER - 1; s >= 0; s--) {
+            f += k[s] * dec->lattice[s];
+            if (s + 1 < NADE_LPC_ORDER) {
+                dec->lattice[s + 1] = dec->lattice[s] - k[s] * f;
+            }
+        }
+        dec->lattice[0] = f;
+        float y = f + LPC_PREEMPHASIS * dec->last_output;
+        dec->last_output = y;
+        out[i] = (int16_t)clamp_int((int)lrintf(y), -32768, 32767);
+    }
+}
+
+static size_t lpc_encode(nade_lpc_encoder_t *enc, int codec, const int16_t *samples, size_t count,
+                         uint8_t *out, size_t max_bytes) {
+    size_t frame = lpc_frame_samples(codec);
+    size_t frames = NADE_CODEC_FRAME_SAMPLES / frame;
+    if (count == 0 || max_bytes < frames * LPC_FRAME_BYTES) {
+        return 0;
+    }
+    int16_t padded[NADE_CODEC_FRAME_SAMPLES] = {0};
+    memcpy(padded, samples, (count < NADE_CODEC_FRAME_SAMPLES ? count : NADE_CODEC_FRAME_SAMPLES) *
+                            sizeof(int16_t));
+    for (size_t f = 0; f < frames; f++) {
+        lpc_params_t params;
+        lpc_analyse(enc, padded + f * frame, frame, &params);
+        pack_lpc(&params, out + f * LPC_FRAME_BYTES);
+    }
+    return frames * LPC_FRAME_BYTES;
+}
+
+static size_t lpc_decode(nade_lpc_decoder_t *dec, int codec, const uint8_t *data, size_t len,
+                         int16_t *out, size_t max_samples) {
+    size_t frame = lpc_frame_samples(codec);
+    size_t frames = NADE_CODEC_FRAME_SAMPLES / frame;
+    if (len < frames * LPC_FRAME_BYTES || max_samples < NADE_CODEC_FRAME_SAMPLES) {
+        return 0;
+    }
+    for (size_t f = 0; f < frames; f++) {
+        lpc_params_t params;
+        unpack_lpc(data + f * LPC_FRAME_BYTES, &params);
+        lpc_synthesise(dec, &params, out + f * frame, frame);
+    }
+    return NADE_CODEC_FRAME_SAMPLES;
+}
+
+// -------------------------------------------------------------------------
+// Dispatch
+
+void nade_codec_encoder_reset(nade_codec_encoder_t *enc) {
+    memset(enc, 0, sizeof(*enc));
+    reset_adpcm(&enc->adpcm);
+}
+
+void nade_codec_decoder_reset(nade_codec_decoder_t *dec) {
+    memset(dec, 0, sizeof(*dec));
+    reset_adpcm(&dec->adpcm);
+    dec->lpc.noise_seed = 0x1234567u;
+}
+
+size_t nade_codec_encode(nade_codec_encoder_t *enc, int codec, const int16_t *samples,
+                         size_t count, uint8_t *out, size_t max_bytes) {
+    const nade_codec_info_t *info = nade_codec_info(codec);
+    if (!enc || !samples || !out || !info || count > info->frame_samples) {
+        return 0;
+    }
+    switch (codec) {
+    case NADE_CODEC_ADPCM4:
+    case NADE_CODEC_ADPCM4_WB:
+        return adpcm_encode_block(samples, count, out, max_bytes, &enc->adpcm);
+    case NADE_CODEC_ADPCM3:
+        return adpcm_lowbit_encode(samples, count, 3, out, max_bytes, &enc->adpcm);
+    case NADE_CODEC_ADPCM2:
+        return adpcm_lowbit_encode(samples, count, 2, out, max_bytes, &enc->adpcm);
+    case NADE_CODEC_LPC2400:
+    case NADE_CODEC_LPC1200:
+        return lpc_encode(&enc->lpc, codec, samples, count, out, max_bytes);
+    default:
+        return 0;
+    }
+}
+
+size_t nade_codec_decode(nade_codec_decoder_t *dec, int codec, const uint8_t *data,
+                         size_t len, int16_t *out, size_t max_samples) {
+    if (!dec || !data || !out) {
+        return 0;
+    }
+    switch (codec) {
+    case NADE_CODEC_ADPCM4:
+    case NADE_CODEC_ADPCM4_WB:
+        return adpcm_decode_block(data, len, out, max_samples, &dec->adpcm);
+    case NADE_CODEC_ADPCM3:
+        return adpcm_lowbit_decode(data, len, 3, out, max_samples, &dec->adpcm);
+    case NADE_CODEC_ADPCM2:
+        return adpcm_lowbit_decode(data, len, 2, out, max_samples, &dec->adpcm);
+    case NADE_CODEC_LPC2400:
+    case NADE_CODEC_LPC1200:
+        return lpc_decode(&dec->lpc, codec, data, len, out, max_samples);
+    default:
+        return 0;
+    }
+}
@@ -2,19 +2,39 @@
  * Copyright (c) 2024 Icing Project
  *
  * NADE core implementation responsible for Noise-style key exchange,
- * ChaCha20-Poly1305 transport security, ADPCM audio framing, and
+ * ChaCha20-Poly1305 transport security, voice codec framing, and
  * Reed-Solomon error correction.
  */
 
+// syscall(), for the futex wake-ups, on top of the POSIX level the build asks for
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include "nade_core.h"
 #include "monocypher.h"
+#include "nade_aead.h"
+#include "nade_audio.h"
+#include "nade_capture.h"
+#include "nade_codec.h"
+#include "nade_datagram.h"
+#include "nade_dtx.h"
+#include "nade_fec.h"
+#include "nade_fsk.h"
+#include "nade_jitter.h"
+#include "nade_link.h"
+#include "nade_log.h"
+#include "nade_metrics.h"
+#include "nade_resample.h"
+#include "nade_ring.h"
+#include "nade_trace.h"
 #include "reed_solomon.h"
 
-#include <android/log.h>
-#include <jni.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -22,6 +42,10 @@
 #include <string.h>
 #include <time.h>
 
+#if NADE_WITH_JNI
+#include <jni.h>
+#endif
+
 #if defined(_WIN32)
 #include <windows.h>
 #include <bcrypt.h>
@@ -32,44 +56,79 @@
 #endif
 #endif
 
+#if defined(__linux__)
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #define TAG "NADECore"
 
-#define MIC_CAPACITY 65536
-#define SPK_CAPACITY 65536
-#define OUT_CAPACITY 262144
-#define IN_CAPACITY 262144
-#define AUDIO_FRAME_SAMPLES 320
+// Session ring sizes, rounded up to powers of two when a session starts
+#define MIC_QUEUE_MS 500        // Mic audio the transmit thread may fall behind by, beyond a batch
+#define FSK_MIC_QUEUE_MS 3000   // The same over FSK, where the handshake alone takes seconds
+#define SPK_QUEUE_MS 200        // Played-out audio the speaker ring holds beyond one frame
+#define OUT_QUEUE_FRAMES 4      // Largest frames the outgoing ring holds
+#define IN_QUEUE_FRAMES 4       // Largest frames the input ring holds, partial one included
+#define CAPTURE_MIC_TAP_SAMPLES 16384   // Mic audio set aside for a capture, 340 ms at 48 kHz
+#define ARENA_ALIGN 64          // Of each buffer in a session arena
+// Speaker ring room for one jitter buffer frame at the device rate
+#define SPK_FRAME_MAX (NADE_JITTER_MAX_OUTPUT * (NADE_RESAMPLE_MAX_RATE / NADE_JITTER_MAX_RATE) + 1)
+// Mic audio converted to the codec rate per resampler chunk
+#define MIC_CHUNK_MAX (NADE_RESAMPLE_CHUNK * (NADE_CODEC_WB_RATE / NADE_RESAMPLE_MIN_RATE) + 1)
 
 // -------------------------------------------------------------------------
-// 4-FSK Modulation Configuration
-// Frequencies chosen for voice-band transmission (300-3400 Hz range)
-#define FSK_FREQ_00     1200    // Symbol 00 -> 1200 Hz
-#define FSK_FREQ_01     1600    // Symbol 01 -> 1600 Hz
-#define FSK_FREQ_10     2000    // Symbol 10 -> 2000 Hz
-#define FSK_FREQ_11     2400    // Symbol 11 -> 2400 Hz
-#define FSK_SAMPLE_RATE 8000    // 8 kHz sample rate
-#define FSK_SYMBOL_RATE 100     // 100 symbols/sec = 200 bits/sec
-#define FSK_SAMPLES_PER_SYMBOL (FSK_SAMPLE_RATE / FSK_SYMBOL_RATE)  // 80 samples
-#define FSK_AMPLITUDE   16000   // Amplitude for generated tones (< 32767)
-
-// Goertzel detection thresholds
-#define FSK_GOERTZEL_THRESHOLD 1000000.0f  // Minimum power to detect a tone
-#define FSK_GUARD_SAMPLES 8     // Guard samples at symbol boundaries
-
-// 4-FSK modulation/demodulation ring buffers
-#define FSK_MOD_CAPACITY 32768  // PCM samples for modulated output
+// 4-FSK demodulation ring buffer (modem itself lives in nade_fsk.c)
 #define FSK_DEMOD_CAPACITY 8192 // Bytes for demodulated input
-#define HANDSHAKE_PAYLOAD_LEN 84
+
+// Audio-channel pipeline scratch sizes (one FEC frame per transmit call).
+// A burst holds at most one full FEC frame at the fastest profile: slower
+// profiles carry fewer bytes per burst rather than bursts that take minutes
+// to play.
+#define PIPELINE_MAX_CODED_BYTES NADE_FEC_MAX_FRAME
+#define PIPELINE_TX_MAX_SAMPLES (NADE_FSK_OVERHEAD_SYMBOLS * NADE_FSK_SAMPLES_PER_SYMBOL + \
+                                 PIPELINE_MAX_CODED_BYTES * NADE_FSK_MIN_SAMPLES_PER_BYTE)
+#define PIPELINE_RX_CHUNK_SAMPLES 2048
+#define PIPELINE_RX_MAX_BYTES (PIPELINE_RX_CHUNK_SAMPLES / NADE_FSK_MIN_SAMPLES_PER_BYTE + 1)
+#define HANDSHAKE_PAYLOAD_LEN 85
+#define HANDSHAKE_MIN_PAYLOAD_LEN 84    // Version 1 peers without the codec byte
 #define FRAME_KIND_HANDSHAKE 0x01
 #define FRAME_KIND_CIPHER 0x02
 #define FRAME_KIND_PLAINTEXT 0x03
 #define FRAME_KIND_CONTROL 0x04
+#define FRAME_KIND_COUNTED_CIPHER 0x05  // [counter low 16 bits LE][ciphertext][tag]
 #define AUDIO_PAYLOAD_TYPE 0xA1
+#define AUDIO_BATCH_PAYLOAD_TYPE 0xA2   // [type, count, count x audio payload]
+#define AUDIO_SID_PAYLOAD_TYPE 0xA3     // [type, seq lo, seq hi, level, tilt]
+#define AUDIO_SID_LEN 5
+#define AUDIO_HEADER_LEN 8
+#define AUDIO_FRAME_MS 40
+#define AUDIO_BATCH_MAX_FRAMES 8
+#define AUDIO_BATCH_MAX_BYTES (MAX_FRAME_BODY - RECORD_COUNTER_LEN - 2 - 16)    // Entries of a sealed batch
 #define KEEPALIVE_TYPE 0xCC
 #define HANGUP_TYPE 0xDD
-#define HANDSHAKE_RESEND_MS 500
+#define LINK_REPORT_TYPE 0xCE           // [type, blocks, failed, errors, coded bytes], u16 LE each
+#define LINK_REPORT_LEN 9
+#define HANDSHAKE_RESEND_MIN_MS 100     // First retransmit; doubled on every further one
+#define HANDSHAKE_RESEND_MAX_MS 2000
+#define HANDSHAKE_TICKET_LEN 16         // Resumption ticket id
+#define HANDSHAKE_ECHO_LEN 8            // Prefix of the peer ephemeral the sender derived with
+#define HANDSHAKE_EXTENSIONS_LEN 1      // Further capability bits, last
+#define HANDSHAKE_MAX_PAYLOAD_LEN (HANDSHAKE_PAYLOAD_LEN + HANDSHAKE_TICKET_LEN + HANDSHAKE_ECHO_LEN + \
+                                   HANDSHAKE_EXTENSIONS_LEN)
+#define RECORD_COUNTER_LEN 2            // Counter bits carried by a counted record
+#define REPLAY_WINDOW 64                // Records behind the newest that may still arrive
+#define EPHEMERAL_POOL_SIZE 4
+#define RESUME_CACHE_SIZE 4
 #define KEEPALIVE_INTERVAL_MS 1000
+#define KEEPALIVE_FSK_INTERVAL_MS 4000  // Every FSK burst pays for its lead-in and sync
+#define FSK_AUDIO_AIRTIME_PERCENT 80    // Share of the modem audio may fill; the rest is control and slack
+#define FSK_AUDIO_CREDIT_MAX_MS 400     // Airtime a talk spurt may borrow against that share
+#define LINK_REPORT_INTERVAL_MS 4000    // Between FEC reports to an adapting peer
+#define LINK_REPORT_MIN_BLOCKS 2        // Codewords a report waits for
+#define DTX_FSK_SID_SCALE 8             // Descriptors that much sparser on the FSK link
 #define MAX_FRAME_BODY 2048
+_Static_assert(3 + MAX_FRAME_BODY <= NADE_DGRAM_MAX_FRAME, "a whole frame must reassemble");
 
 typedef enum {
     NADE_ROLE_NONE = 0,
@@ -77,17 +136,41 @@ typedef enum {
     NADE_ROLE_CLIENT = 2,
 } nade_role_t;
 
-typedef struct {
-    int predictor;
-    int index;
-    bool initialized;
-} nade_adpcm_state_t;
-
 typedef struct {
     bool encrypt;
     bool decrypt;
+    uint8_t fsk_profiles;   // Modulation profiles offered in the handshake (bit per id)
+    uint8_t audio_codec;    // Preferred codec id, NADE_CODEC_NONE = pick from the link
+    uint16_t audio_batch_ms; // Extra latency allowed to pack audio frames into one record
+    bool resume;            // Keep per-peer secrets and resume calls from them
+    bool dtx;               // Send silence descriptors instead of silent mic frames
+    bool wideband;          // Send 16 kHz audio on a raw link when the device captures it
+    bool adaptive_fec;      // Trade parity and modulation rate against the peer's FEC reports
+    uint16_t link_mtu;      // Datagram size of a packet transport, 0 for a byte stream
 } nade_config_t;
 
+typedef struct {
+    uint8_t priv[32];
+    uint8_t pub[32];
+} ephemeral_key_t;
+
+// Secret carried over from the last call with a peer, plus what that peer
+// offered then, so the next call can encrypt before hearing from it
+typedef struct {
+    bool used;
+    uint64_t stamp;             // resume_clock at the last store, for eviction
+    uint8_t peer_static[32];
+    uint8_t secret[32];
+    uint8_t peer_fsk_profiles;
+    uint8_t peer_codecs;
+    bool peer_accepts_encrypt;
+    bool peer_sends_encrypt;
+    bool peer_accepts_batch;
+    bool peer_reads_counted;
+    bool peer_takes_sid;
+    bool peer_adapts_fec;
+} resume_entry_t;
+
 typedef struct {
     bool active;
     bool handshake_ready;
@@ -96,10 +179,23 @@ typedef struct {
     bool expect_peer_static;
     bool have_peer_static;
     bool have_peer_ephemeral;
+    bool peer_has_handshake;    // Peer echoed our ephemeral, so resending is pointless
+    bool resumed;               // Keys came from a resumption secret
+    bool peer_resume_rejected;  // Peer offered a ticket we could not honour
+    uint8_t ticket[HANDSHAKE_TICKET_LEN];   // Offered (client) or accepted (server)
+    uint8_t resume_next[32];    // Secret for resuming the next call with this peer
     bool outbound_encrypted;
     bool inbound_encrypted;
     bool peer_accepts_encrypt;
     bool peer_sends_encrypt;
+    uint8_t peer_fsk_profiles;
+    uint8_t peer_codecs;    // Codecs the peer can decode (bit per id)
+    bool peer_accepts_batch;
+    bool peer_reads_counted;    // Takes FRAME_KIND_COUNTED_CIPHER records
+    bool peer_takes_sid;        // Plays comfort noise for AUDIO_SID_PAYLOAD_TYPE records
+    bool peer_adapts_fec;       // Decodes every parity level and sends LINK_REPORT_TYPE
+    uint8_t tx_codec;
+    uint8_t tx_batch;           // Frames per record the modem needs for tx_codec to fit, 0 for no floor
     nade_role_t role;
     uint8_t static_priv[32];
     uint8_t static_pub[32];
@@ -113,77 +209,277 @@ typedef struct {
     uint8_t tx_nonce_base[12];
     uint8_t rx_nonce_base[12];
     uint64_t tx_counter;
-    uint64_t rx_counter;
+    uint64_t rx_counter;        // Next implicit counter (FRAME_KIND_CIPHER)
+    uint64_t rx_top;            // Counted records: one past the newest opened
+    uint64_t rx_window;         // Bit i: record rx_top - 1 - i was opened
     uint16_t audio_seq;
+    nade_vad_t vad;
+    bool tx_paused;             // Mic frames are being withheld as silence
+    uint16_t sid_age;           // Silent frames since the last descriptor
+    nade_sid_t last_sid;
+    uint64_t started_ms;
+    // Where the audio share of the modem counts from: the handshake's
+    // completion, less the burst still playing out then
+    uint64_t audio_air_from_ms;
+    uint64_t audio_air_from_samples;
     uint64_t last_handshake_ms;
+    uint32_t handshake_resends;
+    size_t handshake_queued_end;    // out_ring push count just after the latest copy
+    uint64_t handshake_sent_ms;     // When that copy is on the air, 0 while still queued
     uint64_t last_keepalive_ms;
+    // Link adaptation: what our FEC decoder saw since the last report to the
+    // peer, and the controller acting on the peer's reports
+    nade_link_report_t link_rx;
+    uint64_t last_link_report_ms;
+    nade_link_ctl_t link_ctl;
     bool tx_aead_ready;
     bool rx_aead_ready;
     bool remote_hangup_requested;
-    nade_adpcm_state_t enc_state;
-    nade_adpcm_state_t dec_state;
+    nade_codec_encoder_t encoder;
+    nade_codec_decoder_t decoder;
 } nade_session_state_t;
 
-static nade_session_state_t g_session;
-static nade_config_t g_config = {.encrypt = true, .decrypt = true};
-static pthread_mutex_t g_session_mutex = PTHREAD_MUTEX_INITIALIZER;
-static uint8_t g_identity_priv[32];
-static uint8_t g_identity_pub[32];
-static bool g_identity_ready = false;
-
-static int16_t g_mic_ring[MIC_CAPACITY];
-static size_t g_mic_head = 0;
-static size_t g_mic_size = 0;
-static pthread_mutex_t g_mic_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static int16_t g_spk_ring[SPK_CAPACITY];
-static size_t g_spk_head = 0;
-static size_t g_spk_size = 0;
-static pthread_mutex_t g_spk_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static uint8_t g_out_ring[OUT_CAPACITY];
-static size_t g_out_head = 0;
-static size_t g_out_size = 0;
-static pthread_mutex_t g_out_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static uint8_t g_in_ring[IN_CAPACITY];
-static size_t g_in_head = 0;
-static size_t g_in_size = 0;
-static pthread_mutex_t g_in_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// 4-FSK Modulation state
-static bool g_fsk_enabled = false;  // Enable/disable 4-FSK modulation (only for audio channel transport)
-static int16_t g_fsk_mod_ring[FSK_MOD_CAPACITY];  // Modulated PCM output
-static size_t g_fsk_mod_head = 0;
-static size_t g_fsk_mod_size = 0;
-static pthread_mutex_t g_fsk_mod_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static uint8_t g_fsk_demod_ring[FSK_DEMOD_CAPACITY];  // Demodulated bytes
-static size_t g_fsk_demod_head = 0;
-static size_t g_fsk_demod_size = 0;
-static pthread_mutex_t g_fsk_demod_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// Phase accumulators for continuous phase modulation
-static float g_fsk_tx_phase = 0.0f;
-
-// Demodulator sample buffer for symbol detection
-static int16_t g_fsk_rx_samples[FSK_SAMPLES_PER_SYMBOL];
-static size_t g_fsk_rx_sample_count = 0;
-static uint8_t g_fsk_rx_byte = 0;
-static int g_fsk_rx_nibble_count = 0;
+// Sizes of the buffers a session allocates, from the configuration in force
+// as it starts
+typedef struct {
+    bool fsk;                   // Audio-channel pipeline scratch and demodulation ring
+    size_t mic_capacity;        // Ring capacities, in elements
+    size_t spk_capacity;
+    size_t out_capacity;
+    size_t in_capacity;
+} arena_layout_t;
+
+// Buffers only a session needs, carved out of one allocation (see
+// arena_create). The ring storage is bound to the context's rings while the
+// arena is in place.
+typedef struct {
+    arena_layout_t layout;
+    size_t size;                // Bytes allocated, this header included
+    int16_t *mic_storage;
+    int16_t *spk_storage;
+    uint8_t *out_storage;
+    uint8_t *in_storage;
+    uint8_t *fsk_demod_storage;
+    // Pipeline scratch. TX scratch is only touched by the transmit thread,
+    // RX scratch only by the receive thread.
+    uint8_t *tx_frame;          // PIPELINE_MAX_CODED_BYTES
+    uint8_t *tx_coded;          // PIPELINE_MAX_CODED_BYTES
+    int16_t *tx_pcm;            // PIPELINE_TX_MAX_SAMPLES
+    int16_t *rx_pcm;            // PIPELINE_RX_CHUNK_SAMPLES
+    uint8_t *rx_bytes;          // PIPELINE_RX_MAX_BYTES
+    uint8_t *rx_reliability;    // PIPELINE_RX_MAX_BYTES, the demodulator's score per byte
+    uint8_t *rx_payload;        // NADE_FEC_MAX_PAYLOAD
+} session_arena_t;
+
+// Follows the frames of one captured byte stream across records, the way
+// the parser walks them, so handshake keys are zeroed wherever they fall
+typedef struct {
+    uint8_t header[3];
+    size_t header_seen;
+    size_t body_len;
+    size_t body_seen;
+    // Datagram mode: the fragmented frame being followed
+    uint8_t dgram_seq;
+    uint8_t dgram_next;
+    bool dgram_active;
+    uint32_t epoch;             // Capture epoch the position belongs to
+} capture_framer_t;
+
+// A frame going out as datagram fragments. It stays in the outgoing ring
+// until the last one is sent.
+typedef struct {
+    size_t frame_start;         // Ring index of the frame
+    size_t sent;
+    size_t fragment_len;
+    uint8_t seq;                // Of the frame being fragmented
+    uint8_t index;              // Next fragment
+    uint8_t count;
+    bool active;
+    uint8_t next_seq;           // Numbers every frame sent
+} dgram_tx_t;
+
+// A running capture (nade_ctx_capture_start)
+typedef struct {
+    nade_capture_t file;
+    uint64_t start_ms;          // Context clock at the start; record times count from here
+    // Sessions restart the streams: a frame cut short by a stop never ends
+    _Atomic uint32_t epoch;
+    capture_framer_t in_framer;     // Bytes into the parser
+    capture_framer_t out_framer;    // Bytes out of the outgoing ring
+    // Line audio as heard, handshake bursts included (nade_ctx_capture_start)
+    bool line_audio;
+    // The last bytes out of the outgoing ring carried handshake bytes, so the
+    // burst made of them is recorded as silence
+    _Atomic bool out_handshake;
+    // Mic audio from nade_ctx_push_mic, which must not write the file, until
+    // nade_ctx_flush_mic_capture records it
+    nade_ring_t mic_tap;
+    int16_t mic_tap_storage[CAPTURE_MIC_TAP_SAMPLES];
+} session_capture_t;
+
+// Everything one call needs. Contexts share nothing, so separate contexts can
+// be driven from separate threads without contending on a common lock.
+struct nade_ctx {
+    nade_session_state_t session;
+    nade_config_t config;
+    pthread_mutex_t session_mutex;
+    // Lock-free mirror of session.active for the real-time audio entry points
+    _Atomic bool session_active;
+    uint8_t identity_priv[32];
+    uint8_t identity_pub[32];
+    bool identity_ready;
+
+    // Ephemeral keypairs generated ahead of calls (nade_ctx_prepare_ephemerals),
+    // so starting a session does not wait for key generation.
+    // Lock order: session_mutex, then eph_pool_mutex.
+    pthread_mutex_t eph_pool_mutex;
+    ephemeral_key_t eph_pool[EPHEMERAL_POOL_SIZE];
+    int eph_pool_count;
+
+    // Resumption secrets per peer. They outlive sessions and are dropped with
+    // the identity. Guarded by session_mutex.
+    resume_entry_t resume_cache[RESUME_CACHE_SIZE];
+    uint64_t resume_clock;
+
+    // Replacement for the monotonic clock, see nade_ctx_set_clock
+    nade_clock_fn clock;
+    void *clock_user;
+
+    // Buffers of the running session, NULL between sessions. Real-time entry
+    // points take them through arena_enter, counted in arena_users, so the
+    // control thread replacing them can wait until the old ones are idle.
+    // Replacements are serialized by arena_mutex, taken before session_mutex.
+    _Atomic(session_arena_t *) arena;
+    _Atomic uint32_t arena_users;
+    pthread_mutex_t arena_mutex;
+
+    // Capture being recorded, NULL when none. Taken and replaced like the
+    // arena, with capture_users and capture_mutex.
+    _Atomic(session_capture_t *) capture;
+    _Atomic uint32_t capture_users;
+    pthread_mutex_t capture_mutex;
+
+    // Audio and transport rings. Each has exactly one producer and one
+    // consumer thread (nade-mic -> nade-tx, nade-spk refills its own ring from
+    // the jitter buffer, or with native audio a refill thread keeps it topped
+    // up for the speaker callback, producers of the outgoing ring are serialized by
+    // session_mutex), so they are lock-free SPSC rings. Their storage is in
+    // the session arena; they are rebound only under session_mutex with no
+    // arena user inside, and have none between sessions.
+    nade_ring_t mic_ring;
+    nade_ring_t spk_ring;
+    nade_ring_t out_ring;
+    nade_ring_t in_ring;
+    nade_ring_t fsk_demod_ring;     // Demodulated bytes
+
+    // Decoded frames wait here, ordered by audio sequence number, until the
+    // speaker thread pulls them. Lock order: session_mutex, then jitter_mutex.
+    nade_jitter_t jitter;
+    pthread_mutex_t jitter_mutex;
+
+    // Sample rate conversion between the audio device and the codecs. The
+    // mic ring runs at the rate of the transmit codec, mirrored in
+    // tx_audio_rate; the speaker ring at the device rate. Each converter
+    // belongs to the thread feeding it and follows rate changes on its own.
+    _Atomic int device_rate;
+    _Atomic int tx_audio_rate;
+    nade_resampler_t mic_resampler;     // Mic thread
+    nade_resampler_t spk_resampler;     // Speaker thread, under jitter_mutex
+    int16_t mic_resampled[MIC_CHUNK_MAX];
+    int16_t spk_resampled[SPK_FRAME_MAX];
+
+    // Wake-ups for threads blocked in nade_ctx_wait_*. Producers bump the
+    // event counter before waking waiters, so a waiter that sampled the
+    // counter before checking for work cannot miss a wake-up. On Linux the
+    // counters are futexes and a wake-up takes no lock, so the audio
+    // callbacks may signal; elsewhere wait_mutex is only held around the
+    // condition waits and broadcasts, never while working.
+    pthread_mutex_t wait_mutex;
+    pthread_cond_t out_cond;
+    pthread_cond_t spk_cond;
+    _Atomic uint32_t out_events;    // Outgoing frames queued or mic audio fed
+    _Atomic uint32_t spk_events;    // Decoded audio reached the jitter buffer
+
+    // 4-FSK modulation (only for audio channel transport)
+    bool fsk_enabled;
+    // Modem state. The modulator is driven by the transmit thread and the
+    // demodulator by the receive thread; other threads only post resets.
+    nade_fsk_mod_t fsk_mod;
+    nade_fsk_demod_t fsk_demod;
+    _Atomic bool fsk_tx_reset_pending;
+    // Set by any thread, applied by the receive thread before its next demodulation
+    _Atomic bool fsk_rx_reset_pending;
+    // Negotiated transmit profile, mirrored lock-free for the transmit thread
+    _Atomic int fsk_tx_profile;
+    // FEC parity bytes per codeword, likewise
+    _Atomic int fec_tx_parity;
+    // Raised-cosine tone transitions, picked up by the transmit thread
+    _Atomic bool fsk_tx_shaped;
+    // When the audio modulated so far will have finished playing (ctx clock),
+    // so handshake retransmits are timed from the end of the previous copy
+    _Atomic uint64_t tx_airtime_end_ms;
+    // Airtime of every burst modulated this session, in samples
+    _Atomic uint64_t tx_airtime_samples;
+
+    // Receive pipeline state; its scratch buffers are in the session arena
+    uint8_t pipe_rx_carry;          // Low byte of a sample split across reads
+    bool pipe_rx_has_carry;
+    nade_fec_decoder_t pipe_rx_fec;
+    uint32_t pipe_rx_epoch;         // Demodulator sync epoch the FEC state belongs to
+
+    // Frames that wrap around the end of the input ring are parsed from here.
+    // Only touched under session_mutex, like rx_skip: input bytes still to
+    // drop of a frame too long to be one.
+    uint8_t rx_linear[MAX_FRAME_BODY + 32];
+    size_t rx_skip;
+    // Outgoing frames that would wrap around the end of the ring are built
+    // here (under session_mutex); the consumer tracks a frame it is handing
+    // out in pieces.
+    uint8_t out_linear[3 + MAX_FRAME_BODY];
+    size_t out_partial_end;
+
+    // Datagram mode, latched from config.link_mtu at session start (0 while
+    // the transport is a byte stream). The consumer keeps the fragmented
+    // frame it is sending in dgram_tx; the receiver reassembles in dgram_rx.
+    _Atomic int link_mtu;
+    dgram_tx_t dgram_tx;
+    _Atomic bool dgram_tx_reset_pending;
+    nade_dgram_reassembly_t dgram_rx;   // Receive thread only
+    _Atomic bool dgram_rx_reset_pending;
+
+    // Reed-Solomon is applied to frames when using 4-FSK mode (noisy audio channel)
+    bool rs_enabled;
+    // Reed-Solomon statistics for logging
+    uint64_t rs_encode_count;
+    uint64_t rs_decode_count;
+    uint64_t rs_errors_corrected;
+    uint64_t rs_uncorrectable;
+    uint64_t rs_clean_frames;
+
+    // Metrics, recorded lock-free by whichever thread runs a stage. Ring and
+    // jitter buffer counters are reported relative to the baselines taken at
+    // the last reset; the baselines and jitter_retired are guarded by
+    // jitter_mutex, which every snapshot takes anyway.
+    nade_histogram_t stage_hist[NADE_STAGE_COUNT];
+    nade_histogram_t tx_frame_hist;
+    nade_histogram_t rx_frame_hist;
+    _Atomic uint64_t decrypt_failures;
+    _Atomic uint64_t handshakes;
+    _Atomic uint64_t handshake_last_ms;
+    _Atomic uint64_t handshake_max_ms;
+    nade_ring_stats_t ring_base[NADE_METRICS_RING_COUNT];
+    nade_jitter_stats_t jitter_retired;     // Totals of jitter buffer runs since reset
+    nade_jitter_stats_t jitter_base;        // Current run's counters at reset
+};
+
+_Static_assert(NADE_RING_IS_POW2(FSK_DEMOD_CAPACITY), "ring capacities must be powers of two");
 
-// -------------------------------------------------------------------------
-// Reed-Solomon Error Correction Configuration
-// RS is applied to frames when using 4-FSK mode (noisy audio channel)
-static bool g_rs_enabled = true;  // Enable/disable Reed-Solomon (enabled by default for FSK)
-static bool g_rs_initialized = false;
-
-// Reed-Solomon statistics for logging
-static uint64_t g_rs_encode_count = 0;
-static uint64_t g_rs_decode_count = 0;
-static uint64_t g_rs_errors_corrected = 0;
-static uint64_t g_rs_uncorrectable = 0;
-static uint64_t g_rs_clean_frames = 0;
+// The context behind the original single-session API
+static nade_ctx_t g_default_ctx;
+static pthread_once_t g_default_ctx_once = PTHREAD_ONCE_INIT;
+
+// Reed-Solomon tables are process-wide and built once
+static pthread_once_t g_rs_init_once = PTHREAD_ONCE_INIT;
 
 // -------------------------------------------------------------------------
 // Utility helpers
@@ -194,6 +490,12 @@ static uint64_t now_monotonic_ms(void) {
     return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
 }
 
+// Session timers and jitter arrival times read the context's clock, which
+// a simulation may replace; blocking waits always use the monotonic clock
+static uint64_t ctx_now_ms(nade_ctx_t *ctx) {
+    return ctx->clock ? ctx->clock(ctx->clock_user) : now_monotonic_ms();
+}
+
 static size_t min_size(size_t a, size_t b);
 
 static bool is_all_zero(const uint8_t *ptr, size_t len) {
@@ -551,611 +853,938 @@ static void sha256_digest(const uint8_t *data, size_t len, uint8_t out[32]) {
     sha256_final_ctx(&ctx, out);
 }
 
-static void reset_adpcm(nade_adpcm_state_t *state) {
-    state->predictor = 0;
-    state->index = 0;
-    state->initialized = false;
+// -------------------------------------------------------------------------
+// Metrics helpers
+
+static void record_stage(nade_ctx_t *ctx, nade_stage_t stage, uint64_t start_ns) {
+    nade_histogram_record(&ctx->stage_hist[stage], nade_metrics_now_ns() - start_ns);
+}
+
+// sum += now - base, field by field
+static void jitter_stats_accumulate(nade_jitter_stats_t *sum, const nade_jitter_stats_t *now,
+                                    const nade_jitter_stats_t *base) {
+    sum->frames_played += now->frames_played - base->frames_played;
+    sum->frames_concealed += now->frames_concealed - base->frames_concealed;
+    sum->late_dropped += now->late_dropped - base->late_dropped;
+    sum->duplicates += now->duplicates - base->duplicates;
+    sum->rebuffers += now->rebuffers - base->rebuffers;
+    sum->expanded += now->expanded - base->expanded;
+    sum->compressed += now->compressed - base->compressed;
 }
 
 // -------------------------------------------------------------------------
-// Ring helpers
+// Wake-up helpers
+
+static void signal_event(nade_ctx_t *ctx, _Atomic uint32_t *events, pthread_cond_t *cond) {
+    atomic_fetch_add_explicit(events, 1, memory_order_release);
+#if defined(__linux__)
+    (void)ctx;
+    (void)cond;
+    syscall(SYS_futex, (uint32_t *)events, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&ctx->wait_mutex);
+    pthread_cond_broadcast(cond);
+    pthread_mutex_unlock(&ctx->wait_mutex);
+#endif
+}
 
-static void push_int16_ring(int16_t *ring, size_t capacity, size_t *head,
-                            size_t *size, const int16_t *samples, size_t count,
-                            pthread_mutex_t *guard) {
-    pthread_mutex_lock(guard);
-    for (size_t i = 0; i < count; ++i) {
-        size_t tail = (*head + *size) % capacity;
-        ring[tail] = samples[i];
-        if (*size == capacity) {
-            *head = (*head + 1) % capacity;
-        } else {
-            (*size)++;
+static void signal_outgoing(nade_ctx_t *ctx) {
+    signal_event(ctx, &ctx->out_events, &ctx->out_cond);
+}
+
+static void signal_speaker(nade_ctx_t *ctx) {
+    signal_event(ctx, &ctx->spk_events, &ctx->spk_cond);
+}
+
+// Block until the event counter moves past seen or deadline_ms passes.
+// Returns false on timeout.
+static bool wait_event_until(nade_ctx_t *ctx, _Atomic uint32_t *events, pthread_cond_t *cond,
+                             uint32_t seen, uint64_t deadline_ms) {
+#if defined(__linux__)
+    (void)ctx;
+    (void)cond;
+    while (atomic_load_explicit(events, memory_order_acquire) == seen) {
+        uint64_t now = now_monotonic_ms();
+        if (now >= deadline_ms) {
+            return false;
         }
+        struct timespec ts;
+        ts.tv_sec = (time_t)((deadline_ms - now) / 1000ULL);
+        ts.tv_nsec = (long)((deadline_ms - now) % 1000ULL) * 1000000L;
+        // Returns at once if the counter has already moved
+        syscall(SYS_futex, (uint32_t *)events, FUTEX_WAIT_PRIVATE, seen, &ts, NULL, 0);
     }
-    pthread_mutex_unlock(guard);
+    return true;
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline_ms / 1000ULL);
+    ts.tv_nsec = (long)(deadline_ms % 1000ULL) * 1000000L;
+    bool signalled = true;
+    pthread_mutex_lock(&ctx->wait_mutex);
+    while (atomic_load_explicit(events, memory_order_acquire) == seen) {
+        if (pthread_cond_timedwait(cond, &ctx->wait_mutex, &ts) == ETIMEDOUT) {
+            signalled = atomic_load_explicit(events, memory_order_acquire) != seen;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ctx->wait_mutex);
+    return signalled;
+#endif
 }
 
-static size_t pop_int16_ring(int16_t *ring, size_t capacity, size_t *head,
-                             size_t *size, int16_t *out, size_t max,
-                             pthread_mutex_t *guard) {
-    pthread_mutex_lock(guard);
-    size_t available = *size < max ? *size : max;
-    for (size_t i = 0; i < available; ++i) {
-        out[i] = ring[*head];
-        *head = (*head + 1) % capacity;
+// -------------------------------------------------------------------------
+// Session capture
+
+static void pcm_to_le_bytes(const int16_t *pcm, size_t samples, uint8_t *out);
+
+// Take the running capture for one record; NULL when there is none. The
+// pointer is checked without a shared write first, so callers pay next to
+// nothing while nothing is captured.
+static session_capture_t *capture_enter(nade_ctx_t *ctx) {
+    if (!atomic_load_explicit(&ctx->capture, memory_order_relaxed)) {
+        return NULL;
+    }
+    atomic_fetch_add(&ctx->capture_users, 1);
+    session_capture_t *cap = atomic_load(&ctx->capture);
+    if (!cap) {
+        atomic_fetch_sub_explicit(&ctx->capture_users, 1, memory_order_release);
     }
-    *size -= available;
-    pthread_mutex_unlock(guard);
-    return available;
+    return cap;
 }
 
-static size_t available_int16(const size_t *size_ptr, pthread_mutex_t *guard) {
-    pthread_mutex_lock(guard);
-    size_t value = *size_ptr;
-    pthread_mutex_unlock(guard);
-    return value;
+static void capture_exit(nade_ctx_t *ctx) {
+    atomic_fetch_sub_explicit(&ctx->capture_users, 1, memory_order_release);
 }
 
-static void clear_int16_ring(size_t *head, size_t *size, pthread_mutex_t *guard) {
-    pthread_mutex_lock(guard);
-    *head = 0;
-    *size = 0;
-    pthread_mutex_unlock(guard);
+static uint32_t capture_time(nade_ctx_t *ctx, const session_capture_t *cap) {
+    return (uint32_t)(ctx_now_ms(ctx) - cap->start_ms);
 }
 
-static void outgoing_push(const uint8_t *data, size_t len) {
-    pthread_mutex_lock(&g_out_mutex);
-    for (size_t i = 0; i < len; ++i) {
-        size_t tail = (g_out_head + g_out_size) % OUT_CAPACITY;
-        g_out_ring[tail] = data[i];
-        if (g_out_size == OUT_CAPACITY) {
-            g_out_head = (g_out_head + 1) % OUT_CAPACITY;
-        } else {
-            g_out_size++;
+// The keys, key fingerprint, ticket and echo of a handshake payload of len
+// bytes: everything but the version, role, capability and mask bytes and
+// the trailing extension byte
+static bool handshake_byte_redacted(size_t offset, size_t len) {
+    return (offset >= 4 && offset < HANDSHAKE_PAYLOAD_LEN - 1) ||
+           (offset >= HANDSHAKE_PAYLOAD_LEN && offset + HANDSHAKE_EXTENSIONS_LEN < len);
+}
+
+// Returns whether any of the bytes belonged to a handshake frame
+static bool capture_redact(capture_framer_t *framer, uint32_t epoch, uint8_t *bytes, size_t len) {
+    if (framer->epoch != epoch) {
+        memset(framer, 0, sizeof(*framer));
+        framer->epoch = epoch;
+    }
+    bool handshake = false;
+    size_t i = 0;
+    while (i < len) {
+        if (framer->header_seen < sizeof(framer->header)) {
+            framer->header[framer->header_seen++] = bytes[i++];
+            if (framer->header_seen == sizeof(framer->header)) {
+                framer->body_len = (size_t)(framer->header[1] | (framer->header[2] << 8));
+                framer->body_seen = 0;
+                framer->header_seen = framer->body_len > 0 ? framer->header_seen : 0;
+            }
+            continue;
+        }
+        size_t take = min_size(len - i, framer->body_len - framer->body_seen);
+        if (framer->header[0] == FRAME_KIND_HANDSHAKE) {
+            handshake = true;
+            for (size_t k = 0; k < take; k++) {
+                if (handshake_byte_redacted(framer->body_seen + k, framer->body_len)) {
+                    bytes[i + k] = 0;
+                }
+            }
+        }
+        framer->body_seen += take;
+        i += take;
+        if (framer->body_seen == framer->body_len) {
+            framer->header_seen = 0;
         }
     }
-    pthread_mutex_unlock(&g_out_mutex);
+    return handshake;
 }
 
-static size_t outgoing_pop(uint8_t *dst, size_t max_len) {
-    pthread_mutex_lock(&g_out_mutex);
-    size_t to_read = min_size(max_len, g_out_size);
-    for (size_t i = 0; i < to_read; ++i) {
-        dst[i] = g_out_ring[g_out_head];
-        g_out_head = (g_out_head + 1) % OUT_CAPACITY;
+// Datagram mode: redact the frames of one datagram segment by segment. A
+// fragment whose predecessors were not seen cannot be placed in its frame,
+// so its payload is zeroed whole, as is whatever follows a damaged segment.
+// Returns whether any of the bytes belonged, or may have belonged, to a
+// handshake frame.
+static bool capture_redact_datagram(capture_framer_t *framer, uint32_t epoch, uint8_t *bytes, size_t len) {
+    if (framer->epoch != epoch) {
+        memset(framer, 0, sizeof(*framer));
+        framer->epoch = epoch;
+    }
+    bool handshake = false;
+    size_t offset = 0;
+    nade_dgram_segment_t seg;
+    while (nade_dgram_next_segment(bytes, len, &offset, &seg)) {
+        uint8_t *payload = bytes + (seg.payload - bytes);
+        if (seg.index == 0) {
+            framer->header_seen = 0;
+            framer->dgram_seq = seg.seq;
+            framer->dgram_next = 0;
+            framer->dgram_active = true;
+        }
+        if (!framer->dgram_active || seg.seq != framer->dgram_seq || seg.index != framer->dgram_next) {
+            framer->dgram_active = false;
+            memset(payload, 0, seg.len);
+            handshake = true;
+            continue;
+        }
+        handshake |= capture_redact(framer, epoch, payload, seg.len);
+        framer->dgram_next++;
+        framer->dgram_active = framer->dgram_next < seg.count;
     }
-    g_out_size -= to_read;
-    pthread_mutex_unlock(&g_out_mutex);
-    return to_read;
+    handshake |= offset < len;
+    memset(bytes + offset, 0, len - offset);
+    return handshake;
 }
 
-static void outgoing_clear(void) {
-    pthread_mutex_lock(&g_out_mutex);
-    g_out_head = 0;
-    g_out_size = 0;
-    pthread_mutex_unlock(&g_out_mutex);
+// Record bytes crossing the core's boundary. Received line audio is kept
+// only as capture_pcm would keep it.
+static void capture_bytes(nade_ctx_t *ctx, uint8_t kind, const void *data, size_t len) {
+    session_capture_t *cap = capture_enter(ctx);
+    if (!cap) {
+        return;
+    }
+    if (kind == NADE_CAPTURE_LINE_IN && !cap->line_audio) {
+        capture_exit(ctx);
+        return;
+    }
+    uint8_t *payload = nade_capture_append(&cap->file, kind, capture_time(ctx, cap), len);
+    if (payload) {
+        memcpy(payload, data, len);
+    }
+    capture_exit(ctx);
 }
 
-static void incoming_push(const uint8_t *data, size_t len) {
-    pthread_mutex_lock(&g_in_mutex);
-    for (size_t i = 0; i < len; ++i) {
-        size_t tail = (g_in_head + g_in_size) % IN_CAPACITY;
-        g_in_ring[tail] = data[i];
-        if (g_in_size == IN_CAPACITY) {
-            g_in_head = (g_in_head + 1) % IN_CAPACITY;
+// Record frame bytes going into the parser or out of the outgoing ring,
+// as a stream or one datagram. They go through their direction's framer,
+// so no handshake key reaches the file. Outgoing bytes also note whether the
+// burst they make up carries a handshake.
+static void capture_frames(nade_ctx_t *ctx, uint8_t kind, const uint8_t *data, size_t len, bool datagram) {
+    session_capture_t *cap = capture_enter(ctx);
+    if (!cap) {
+        return;
+    }
+    bool in = kind == NADE_CAPTURE_TRANSPORT_IN || kind == NADE_CAPTURE_DEMOD_IN;
+    // Bytes that did not fit cannot be checked, so their burst is blanked
+    bool handshake = true;
+    uint8_t *payload = nade_capture_append(&cap->file, kind, capture_time(ctx, cap), len);
+    if (payload) {
+        memcpy(payload, data, len);
+        uint32_t epoch = atomic_load_explicit(&cap->epoch, memory_order_relaxed);
+        capture_framer_t *framer = in ? &cap->in_framer : &cap->out_framer;
+        if (datagram) {
+            handshake = capture_redact_datagram(framer, epoch, payload, len);
         } else {
-            g_in_size++;
+            handshake = capture_redact(framer, epoch, payload, len);
         }
     }
-    pthread_mutex_unlock(&g_in_mutex);
+    if (!in) {
+        atomic_store_explicit(&cap->out_handshake, handshake, memory_order_relaxed);
+    }
+    capture_exit(ctx);
 }
 
-static size_t incoming_size(void) {
-    pthread_mutex_lock(&g_in_mutex);
-    size_t sz = g_in_size;
-    pthread_mutex_unlock(&g_in_mutex);
-    return sz;
+// Record mic audio, or line audio of the FSK modem. Unless the capture was
+// started with line audio, a burst of ours that carries handshake bytes is
+// recorded as silence of the same length, and received line audio is left
+// out: it cannot be told apart from a handshake until it is demodulated.
+static void capture_pcm(nade_ctx_t *ctx, uint8_t kind, const int16_t *pcm, size_t samples) {
+    session_capture_t *cap = capture_enter(ctx);
+    if (!cap) {
+        return;
+    }
+    bool received = kind == NADE_CAPTURE_LINE_IN || kind == NADE_CAPTURE_FSK_IN;
+    if (received && !cap->line_audio) {
+        capture_exit(ctx);
+        return;
+    }
+    bool blank = kind == NADE_CAPTURE_LINE_OUT && !cap->line_audio &&
+                 atomic_load_explicit(&cap->out_handshake, memory_order_relaxed);
+    uint8_t *payload = nade_capture_append(&cap->file, kind, capture_time(ctx, cap), samples * 2);
+    if (payload) {
+        if (blank) {
+            memset(payload, 0, samples * 2);
+        } else {
+            pcm_to_le_bytes(pcm, samples, payload);
+        }
+    }
+    capture_exit(ctx);
 }
 
-static bool incoming_peek(uint8_t *dst, size_t len) {
-    pthread_mutex_lock(&g_in_mutex);
-    if (g_in_size < len) {
-        pthread_mutex_unlock(&g_in_mutex);
-        return false;
-    }
-    for (size_t i = 0; i < len; ++i) {
-        size_t idx = (g_in_head + i) % IN_CAPACITY;
-        dst[i] = g_in_ring[idx];
+// Set mic audio aside for the capture without touching the file, for the
+// audio callbacks
+static void capture_tap_mic(nade_ctx_t *ctx, const int16_t *pcm, size_t samples) {
+    session_capture_t *cap = capture_enter(ctx);
+    if (!cap) {
+        return;
     }
-    pthread_mutex_unlock(&g_in_mutex);
-    return true;
+    nade_ring_push(&cap->mic_tap, pcm, samples);
+    capture_exit(ctx);
 }
 
-static void incoming_drop(size_t len) {
-    pthread_mutex_lock(&g_in_mutex);
-    if (len >= g_in_size) {
-        g_in_head = 0;
-        g_in_size = 0;
-    } else {
-        g_in_head = (g_in_head + len) % IN_CAPACITY;
-        g_in_size -= len;
+int nade_ctx_flush_mic_capture(nade_ctx_t *ctx) {
+    session_capture_t *cap = capture_enter(ctx);
+    if (!cap) {
+        return 0;
+    }
+    nade_ring_view_t view;
+    size_t available = nade_ring_read_view(&cap->mic_tap, &view);
+    if (view.first_count > 0) {
+        capture_pcm(ctx, NADE_CAPTURE_MIC, (const int16_t *)view.first, view.first_count);
+    }
+    if (view.second_count > 0) {
+        capture_pcm(ctx, NADE_CAPTURE_MIC, (const int16_t *)view.second, view.second_count);
     }
-    pthread_mutex_unlock(&g_in_mutex);
+    nade_ring_release_view(&cap->mic_tap, &view, available);
+    capture_exit(ctx);
+    return (int)available;
 }
 
-static bool incoming_read(uint8_t *dst, size_t len) {
-    if (!incoming_peek(dst, len)) {
-        return false;
+static void capture_speaker(nade_ctx_t *ctx, size_t max_samples) {
+    uint32_t samples = (uint32_t)min_size(max_samples, UINT32_MAX);
+    uint8_t payload[4] = {(uint8_t)samples, (uint8_t)(samples >> 8), (uint8_t)(samples >> 16),
+                          (uint8_t)(samples >> 24)};
+    capture_bytes(ctx, NADE_CAPTURE_SPEAKER, payload, sizeof(payload));
+}
+
+static void capture_settings_locked(nade_ctx_t *ctx) {
+    uint8_t payload[3] = {ctx->fsk_enabled, ctx->rs_enabled,
+                          atomic_load_explicit(&ctx->fsk_tx_shaped, memory_order_relaxed)};
+    capture_bytes(ctx, NADE_CAPTURE_SETTINGS, payload, sizeof(payload));
+}
+
+// A session start or stop; frame streams restart with it
+static void capture_session_locked(nade_ctx_t *ctx, uint8_t role, bool expects_key) {
+    session_capture_t *cap = capture_enter(ctx);
+    if (!cap) {
+        return;
     }
-    incoming_drop(len);
-    return true;
+    atomic_fetch_add_explicit(&cap->epoch, 1, memory_order_relaxed);
+    uint8_t payload[2] = {role, expects_key};
+    nade_capture_write(&cap->file, NADE_CAPTURE_SESSION, capture_time(ctx, cap), payload, sizeof(payload));
+    capture_exit(ctx);
 }
 
-static void incoming_clear(void) {
-    pthread_mutex_lock(&g_in_mutex);
-    g_in_head = 0;
-    g_in_size = 0;
-    pthread_mutex_unlock(&g_in_mutex);
+// The whole configuration as set_config would take it, so a replay starts
+// from the same place whatever was set before the capture
+static void capture_config_locked(nade_ctx_t *ctx) {
+    const nade_codec_info_t *codec = nade_codec_info(ctx->config.audio_codec);
+    char json[384];
+    int len = snprintf(json, sizeof(json),
+                       "{\"encrypt\":%s,\"decrypt\":%s,\"fsk_enabled\":%s,\"resume\":%s,"
+                       "\"dtx\":%s,\"wideband\":%s,\"adaptive_fec\":%s,\"audio_rate\":%d,"
+                       "\"fsk_profiles\":%u,\"audio_batch_ms\":%u,\"audio_codec\":\"%s\",\"link_mtu\":%u}",
+                       ctx->config.encrypt ? "true" : "false", ctx->config.decrypt ? "true" : "false",
+                       ctx->fsk_enabled ? "true" : "false", ctx->config.resume ? "true" : "false",
+                       ctx->config.dtx ? "true" : "false", ctx->config.wideband ? "true" : "false",
+                       ctx->config.adaptive_fec ? "true" : "false",
+                       atomic_load_explicit(&ctx->device_rate, memory_order_relaxed),
+                       (unsigned)ctx->config.fsk_profiles, (unsigned)ctx->config.audio_batch_ms,
+                       codec ? codec->name : "auto", (unsigned)ctx->config.link_mtu);
+    if (len > 0 && (size_t)len < sizeof(json)) {
+        capture_bytes(ctx, NADE_CAPTURE_CONFIG, json, (size_t)len);
+    }
 }
 
 // -------------------------------------------------------------------------
-// ADPCM codec (IMA 4-bit mono)
-
-static const int kStepTable[89] = {
-    7, 8, 9, 10, 11, 12, 13, 14, 16,
-    17, 19, 21, 23, 25, 28, 31, 34,
-    37, 41, 45, 50, 55, 60, 66, 73,
-    80, 88, 97, 107, 118, 130, 143, 157,
-    173, 190, 209, 230, 253, 279, 307, 337,
-    371, 408, 449, 494, 544, 598, 658, 724,
-    796, 876, 963, 1060, 1166, 1282, 1411, 1552,
-    1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
-    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132,
-    7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289,
-    16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
-};
+// Ring helpers
 
-static const int kIndexAdjust[16] = {
-    -1, -1, -1, -1, 2, 4, 6, 8,
-    -1, -1, -1, -1, 2, 4, 6, 8
-};
+// Take the session arena for the length of one real-time call; NULL between
+// sessions. The user count goes up before the pointer is read, and a thread
+// replacing the arena clears the pointer before reading the count, so one of
+// the two always sees the other.
+static session_arena_t *arena_enter(nade_ctx_t *ctx) {
+    atomic_fetch_add(&ctx->arena_users, 1);
+    session_arena_t *arena = atomic_load(&ctx->arena);
+    if (!arena) {
+        atomic_fetch_sub_explicit(&ctx->arena_users, 1, memory_order_release);
+    }
+    return arena;
+}
 
-static int clamp_int(int value, int min_v, int max_v) {
-    if (value < min_v) return min_v;
-    if (value > max_v) return max_v;
-    return value;
+static void arena_exit(nade_ctx_t *ctx) {
+    atomic_fetch_sub_explicit(&ctx->arena_users, 1, memory_order_release);
 }
 
-static size_t adpcm_encode_block(const int16_t *samples, size_t count,
-                                 uint8_t *out, size_t max_bytes,
-                                 nade_adpcm_state_t *state) {
-    if (count == 0 || max_bytes < 4) {
-        return 0;
-    }
-    if (!state->initialized) {
-        state->predictor = samples[0];
-        state->index = 0;
-        state->initialized = true;
+// Copy len bytes found offset bytes into a ring view
+static void view_read(const nade_ring_view_t *view, size_t offset, uint8_t *dst, size_t len) {
+    if (offset < view->first_count) {
+        size_t take = min_size(len, view->first_count - offset);
+        memcpy(dst, view->first + offset, take);
+        dst += take;
+        len -= take;
+        offset = 0;
+    } else {
+        offset -= view->first_count;
     }
-    const size_t encoded_nibbles = count;
-    const size_t encoded_bytes = (encoded_nibbles + 1) / 2;
-    if (4 + encoded_bytes > max_bytes) {
-        return 0;
+    if (len > 0) {
+        memcpy(dst, view->second + offset, len);
     }
-    out[0] = (uint8_t)(state->predictor & 0xFF);
-    out[1] = (uint8_t)((state->predictor >> 8) & 0xFF);
-    out[2] = (uint8_t)state->index;
-    out[3] = 0;
-    size_t out_idx = 4;
-    uint8_t current_byte = 0;
-    bool high_nibble = false;
-    for (size_t i = 0; i < count; ++i) {
-        int diff = samples[i] - state->predictor;
-        int step = kStepTable[state->index];
-        int nibble = 0;
-        if (diff < 0) {
-            nibble = 8;
-            diff = -diff;
-        }
-        if (diff >= step) {
-            nibble |= 4;
-            diff -= step;
-        }
-        if (diff >= step / 2) {
-            nibble |= 2;
-            diff -= step / 2;
-        }
-        if (diff >= step / 4) {
-            nibble |= 1;
-        }
-        int delta = step >> 3;
-        if (nibble & 4) delta += step;
-        if (nibble & 2) delta += step >> 1;
-        if (nibble & 1) delta += step >> 2;
-        if (nibble & 8) {
-            state->predictor -= delta;
-        } else {
-            state->predictor += delta;
-        }
-        state->predictor = clamp_int(state->predictor, -32768, 32767);
-        state->index = clamp_int(state->index + kIndexAdjust[nibble & 0x0F], 0, 88);
-        if (!high_nibble) {
-            current_byte = (uint8_t)(nibble & 0x0F);
-            high_nibble = true;
-        } else {
-            current_byte |= (uint8_t)((nibble & 0x0F) << 4);
-            out[out_idx++] = current_byte;
-            high_nibble = false;
-            current_byte = 0;
-        }
+}
+
+static void view_write(const nade_ring_view_t *view, size_t offset, const uint8_t *src, size_t len) {
+    if (offset < view->first_count) {
+        size_t take = min_size(len, view->first_count - offset);
+        memcpy(view->first + offset, src, take);
+        src += take;
+        len -= take;
+        offset = 0;
+    } else {
+        offset -= view->first_count;
     }
-    if (high_nibble) {
-        out[out_idx++] = current_byte;
+    if (len > 0) {
+        memcpy(view->second + offset, src, len);
     }
-    return out_idx;
 }
 
-static size_t adpcm_decode_block(const uint8_t *data, size_t len,
-                                 int16_t *out, size_t max_samples,
-                                 nade_adpcm_state_t *state) {
-    if (len < 4 || max_samples == 0) {
-        return 0;
+// Bytes at offset in the view, in place unless they straddle the end of the
+// ring storage, in which case they are linearized into scratch
+static uint8_t *view_span(const nade_ring_view_t *view, size_t offset, size_t len, uint8_t *scratch) {
+    if (len == 0) {
+        return scratch;
     }
-    int predictor = (int16_t)(data[0] | (data[1] << 8));
-    int index = clamp_int(data[2], 0, 88);
-    size_t produced = 0;
-    for (size_t i = 4; i < len && produced < max_samples; ++i) {
-        uint8_t byte = data[i];
-        for (int shift = 0; shift <= 4 && produced < max_samples; shift += 4) {
-            int nibble = (byte >> shift) & 0x0F;
-            int step = kStepTable[index];
-            int delta = step >> 3;
-            if (nibble & 4) delta += step;
-            if (nibble & 2) delta += step >> 1;
-            if (nibble & 1) delta += step >> 2;
-            if (nibble & 8) {
-                predictor -= delta;
-            } else {
-                predictor += delta;
-            }
-            predictor = clamp_int(predictor, -32768, 32767);
-            index = clamp_int(index + kIndexAdjust[nibble], 0, 88);
-            out[produced++] = (int16_t)predictor;
-        }
+    if (offset + len <= view->first_count) {
+        return view->first + offset;
     }
-    state->predictor = predictor;
-    state->index = index;
-    state->initialized = true;
-    return produced;
+    if (offset >= view->first_count) {
+        return view->second + (offset - view->first_count);
+    }
+    view_read(view, offset, scratch, len);
+    return scratch;
 }
 
-// -------------------------------------------------------------------------
-// 4-FSK Modulation / Demodulation
-// Converts bytes <-> audio tones for "audio over audio" transmission
-
-#include <math.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-// Lookup table for 4-FSK frequencies (2 bits -> frequency)
-static const int kFskFrequencies[4] = {
-    FSK_FREQ_00,  // 00 -> 1200 Hz
-    FSK_FREQ_01,  // 01 -> 1600 Hz
-    FSK_FREQ_10,  // 10 -> 2000 Hz
-    FSK_FREQ_11   // 11 -> 2400 Hz
-};
-
-// Precomputed Goertzel coefficients for each frequency
+// The outgoing ring holds whole transport frames. Producers (all under
+// session_mutex) build each frame in place in the free space and commit it
+// in one step; a frame that would straddle the end of the storage is built
+// in out_linear and copied in two pieces when committed.
 typedef struct {
-    float coeff;
-    float omega;
-} goertzel_coeff_t;
-
-static goertzel_coeff_t g_goertzel_coeffs[4];
-static bool g_goertzel_initialized = false;
-
-static void init_goertzel_coeffs(void) {
-    if (g_goertzel_initialized) return;
-    
-    for (int i = 0; i < 4; i++) {
-        float k = (float)(kFskFrequencies[i] * FSK_SAMPLES_PER_SYMBOL) / (float)FSK_SAMPLE_RATE;
-        g_goertzel_coeffs[i].omega = (2.0f * (float)M_PI * k) / (float)FSK_SAMPLES_PER_SYMBOL;
-        g_goertzel_coeffs[i].coeff = 2.0f * cosf(g_goertzel_coeffs[i].omega);
-    }
-    g_goertzel_initialized = true;
+    nade_ring_view_t view;
+    uint8_t *frame;
+    size_t max_body;
+} outgoing_frame_t;
+
+// Start a frame with room for up to max_body body bytes. Returns where the
+// body goes.
+static uint8_t *outgoing_reserve(nade_ctx_t *ctx, outgoing_frame_t *frame, size_t max_body) {
+    frame->max_body = min_size(max_body, sizeof(ctx->out_linear) - 3);
+    nade_ring_write_view(&ctx->out_ring, &frame->view);
+    frame->frame = frame->view.first_count >= 3 + frame->max_body ? frame->view.first : ctx->out_linear;
+    return frame->frame + 3;
 }
 
-// Goertzel algorithm to detect power at a specific frequency
-static float goertzel_power(const int16_t *samples, size_t count, int freq_idx) {
-    if (freq_idx < 0 || freq_idx > 3) return 0.0f;
-    
-    float coeff = g_goertzel_coeffs[freq_idx].coeff;
-    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f;
-    
-    for (size_t i = 0; i < count; i++) {
-        s0 = (float)samples[i] + coeff * s1 - s2;
-        s2 = s1;
-        s1 = s0;
+// Finish a frame whose body_len body bytes have been written. A frame that
+// no longer fits in the ring is dropped whole.
+static void outgoing_commit(nade_ctx_t *ctx, outgoing_frame_t *frame, uint8_t kind, size_t body_len) {
+    size_t len = 3 + body_len;
+    if (body_len > frame->max_body || len > frame->view.first_count + frame->view.second_count) {
+        nade_ring_note_dropped(&ctx->out_ring, len);
+        return;
     }
-    
-    // Power = s1^2 + s2^2 - coeff * s1 * s2
-    float power = s1 * s1 + s2 * s2 - coeff * s1 * s2;
-    return power;
+    frame->frame[0] = kind;
+    frame->frame[1] = (uint8_t)(body_len & 0xFF);
+    frame->frame[2] = (uint8_t)((body_len >> 8) & 0xFF);
+    if (frame->frame == ctx->out_linear) {
+        view_write(&frame->view, 0, ctx->out_linear, len);
+    }
+    nade_ring_commit_view(&ctx->out_ring, &frame->view, len);
+    nade_histogram_record(&ctx->tx_frame_hist, len);
+    signal_outgoing(ctx);
 }
 
-// Detect which of the 4 FSK frequencies is present in a symbol period
-static int detect_fsk_symbol(const int16_t *samples, size_t count) {
-    init_goertzel_coeffs();
-    
-    float max_power = 0.0f;
-    int best_symbol = 0;
-    
-    for (int i = 0; i < 4; i++) {
-        float power = goertzel_power(samples, count, i);
-        if (power > max_power) {
-            max_power = power;
-            best_symbol = i;
+// Consumer: copy whole frames into dst while they fit. A frame larger than
+// max_len is handed out in pieces over several calls so a small buffer still
+// drains the ring; out_partial_end marks where such a frame ends.
+static size_t outgoing_take(nade_ctx_t *ctx, uint8_t *dst, size_t max_len) {
+    nade_ring_view_t view;
+    size_t available = nade_ring_read_view(&ctx->out_ring, &view);
+    size_t taken = 0;
+    // A discard since the last piece moves the read index past the frame
+    size_t partial = ctx->out_partial_end - view.start;
+    if (partial > 0 && partial <= available) {
+        taken = min_size(partial, max_len);
+        view_read(&view, 0, dst, taken);
+        if (taken < partial) {
+            nade_ring_release_view(&ctx->out_ring, &view, taken);
+            return taken;
         }
     }
-    
-    // Only return valid symbol if power exceeds threshold
-    if (max_power < FSK_GOERTZEL_THRESHOLD) {
-        return -1;  // No valid symbol detected (silence or noise)
+    while (taken < max_len && available - taken >= 3) {
+        uint8_t header[3];
+        view_read(&view, taken, header, sizeof(header));
+        size_t len = 3 + (size_t)(header[1] | (header[2] << 8));
+        if (len > available - taken) {
+            break;
+        }
+        if (len > max_len - taken) {
+            if (taken == 0) {
+                ctx->out_partial_end = view.start + len;
+                taken = max_len;
+                view_read(&view, 0, dst, taken);
+            }
+            break;
+        }
+        view_read(&view, taken, dst + taken, len);
+        taken += len;
     }
-    
-    return best_symbol;
+    nade_ring_release_view(&ctx->out_ring, &view, taken);
+    return taken;
+}
+
+// Datagram size of this session's transport, 0 for a byte stream
+static int datagram_mtu(nade_ctx_t *ctx) {
+    return atomic_load_explicit(&ctx->link_mtu, memory_order_relaxed);
 }
 
-// Modulate a single symbol (2 bits) into PCM samples
-// Uses continuous phase to avoid clicks at symbol boundaries
-static size_t fsk_modulate_symbol(int symbol, int16_t *out, size_t max_samples) {
-    if (symbol < 0 || symbol > 3 || max_samples < FSK_SAMPLES_PER_SYMBOL) {
+// Consumer, datagram mode: fill one datagram of at most the link MTU (and
+// max_len) with whole frames, each behind a segment header. A frame too
+// large for a datagram of its own goes out one fragment per datagram and
+// stays in the ring until its last fragment; that one may share its
+// datagram with the frames after it.
+static size_t outgoing_take_datagram(nade_ctx_t *ctx, uint8_t *dst, size_t max_len) {
+    size_t mtu = min_size((size_t)datagram_mtu(ctx), max_len);
+    if (mtu < NADE_DGRAM_MIN_MTU) {
         return 0;
     }
-    
-    int freq = kFskFrequencies[symbol];
-    float phase_increment = (2.0f * (float)M_PI * (float)freq) / (float)FSK_SAMPLE_RATE;
-    
-    for (size_t i = 0; i < FSK_SAMPLES_PER_SYMBOL; i++) {
-        out[i] = (int16_t)(FSK_AMPLITUDE * sinf(g_fsk_tx_phase));
-        g_fsk_tx_phase += phase_increment;
-        
-        // Keep phase in [0, 2*PI) to avoid float precision issues
-        if (g_fsk_tx_phase >= 2.0f * (float)M_PI) {
-            g_fsk_tx_phase -= 2.0f * (float)M_PI;
+    dgram_tx_t *tx = &ctx->dgram_tx;
+    if (atomic_exchange_explicit(&ctx->dgram_tx_reset_pending, false, memory_order_acquire)) {
+        tx->active = false;
+    }
+    nade_ring_view_t view;
+    size_t available = nade_ring_read_view(&ctx->out_ring, &view);
+    // A discard since the last fragment moves the read index past the frame
+    if (tx->active && tx->frame_start != view.start) {
+        tx->active = false;
+    }
+    size_t room = mtu - NADE_DGRAM_HEADER_LEN;
+    size_t consumed = 0;
+    size_t written = 0;
+    while (available - consumed >= 3) {
+        uint8_t header[3];
+        view_read(&view, consumed, header, sizeof(header));
+        size_t len = 3 + (size_t)(header[1] | (header[2] << 8));
+        if (len > available - consumed) {
+            break;
+        }
+        if (len <= room) {
+            if (NADE_DGRAM_HEADER_LEN + len > mtu - written) {
+                break;
+            }
+            uint8_t *segment = dst + written;
+            view_read(&view, consumed, segment + NADE_DGRAM_HEADER_LEN, len);
+            written += nade_dgram_write_segment(segment, tx->next_seq++, 0, 1,
+                                                segment + NADE_DGRAM_HEADER_LEN, len);
+            consumed += len;
+            continue;
+        }
+        if (written > 0) {
+            break;
+        }
+        // A smaller datagram than the fragments so far restarts the frame;
+        // the receiver drops the fragments it holds when the new seq arrives
+        if (!tx->active || room < tx->fragment_len) {
+            tx->active = true;
+            tx->frame_start = view.start;
+            tx->sent = 0;
+            tx->fragment_len = room;
+            tx->seq = tx->next_seq++;
+            tx->index = 0;
+            tx->count = (uint8_t)nade_dgram_fragment_count(len, room);
         }
+        size_t piece = min_size(tx->fragment_len, len - tx->sent);
+        view_read(&view, tx->sent, dst + NADE_DGRAM_HEADER_LEN, piece);
+        written = nade_dgram_write_segment(dst, tx->seq, tx->index++, tx->count,
+                                           dst + NADE_DGRAM_HEADER_LEN, piece);
+        tx->sent += piece;
+        if (tx->sent < len) {
+            break;
+        }
+        tx->active = false;
+        consumed = len;
     }
-    
-    return FSK_SAMPLES_PER_SYMBOL;
+    nade_ring_release_view(&ctx->out_ring, &view, consumed);
+    return written;
 }
 
-// Modulate a byte into PCM samples (4 symbols, each carrying 2 bits)
-// Returns number of samples written
-static size_t fsk_modulate_byte(uint8_t byte, int16_t *out, size_t max_samples) {
-    if (max_samples < FSK_SAMPLES_PER_SYMBOL * 4) {
+static size_t outgoing_pop(nade_ctx_t *ctx, uint8_t *dst, size_t max_len) {
+    if (!arena_enter(ctx)) {
         return 0;
     }
-    
-    size_t total = 0;
-    
-    // Extract 4 symbols (2 bits each) from the byte, LSB first
-    for (int i = 0; i < 4; i++) {
-        int symbol = (byte >> (i * 2)) & 0x03;
-        size_t written = fsk_modulate_symbol(symbol, out + total, max_samples - total);
-        total += written;
+    bool datagram = datagram_mtu(ctx) > 0;
+    size_t taken = datagram ? outgoing_take_datagram(ctx, dst, max_len) : outgoing_take(ctx, dst, max_len);
+    arena_exit(ctx);
+    if (taken > 0) {
+        capture_frames(ctx, NADE_CAPTURE_TRANSPORT_OUT, dst, taken, datagram);
     }
-    
-    return total;
+    return taken;
 }
 
-// Modulate a buffer of bytes into PCM audio
-// Returns number of PCM samples written
-static size_t fsk_modulate_buffer(const uint8_t *data, size_t len, 
-                                   int16_t *out, size_t max_samples) {
-    size_t total_samples = 0;
-    
-    for (size_t i = 0; i < len; i++) {
-        size_t needed = FSK_SAMPLES_PER_SYMBOL * 4;
-        if (total_samples + needed > max_samples) {
-            break;
-        }
-        
-        size_t written = fsk_modulate_byte(data[i], out + total_samples, 
-                                           max_samples - total_samples);
-        total_samples += written;
+static void outgoing_clear(nade_ctx_t *ctx) {
+    nade_ring_request_discard(&ctx->out_ring);
+}
+
+static void incoming_push(nade_ctx_t *ctx, const uint8_t *data, size_t len) {
+    if (arena_enter(ctx)) {
+        nade_ring_push(&ctx->in_ring, data, len);
+        arena_exit(ctx);
     }
-    
-    return total_samples;
 }
 
-// Push modulated PCM samples to the FSK output ring
-static void fsk_mod_push(const int16_t *samples, size_t count) {
-    pthread_mutex_lock(&g_fsk_mod_mutex);
-    for (size_t i = 0; i < count; i++) {
-        size_t tail = (g_fsk_mod_head + g_fsk_mod_size) % FSK_MOD_CAPACITY;
-        g_fsk_mod_ring[tail] = samples[i];
-        if (g_fsk_mod_size == FSK_MOD_CAPACITY) {
-            g_fsk_mod_head = (g_fsk_mod_head + 1) % FSK_MOD_CAPACITY;
-        } else {
-            g_fsk_mod_size++;
+// Datagram mode: queue the frames one datagram completes. Only whole frames
+// reach the input ring, so a lost datagram never leaves the parser waiting
+// on the tail of a frame; a damaged segment drops the rest of its datagram
+// and the next one starts clean. Returns false when it did. Receive thread
+// only.
+static bool incoming_push_datagram(nade_ctx_t *ctx, const uint8_t *data, size_t len) {
+    if (!arena_enter(ctx)) {
+        return true;
+    }
+    if (atomic_exchange_explicit(&ctx->dgram_rx_reset_pending, false, memory_order_acquire)) {
+        nade_dgram_reassembly_reset(&ctx->dgram_rx);
+    }
+    size_t offset = 0;
+    nade_dgram_segment_t seg;
+    while (nade_dgram_next_segment(data, len, &offset, &seg)) {
+        size_t frame_len = 0;
+        const uint8_t *frame = nade_dgram_reassemble(&ctx->dgram_rx, &seg, &frame_len);
+        if (!frame || frame_len < 3 || frame_len != 3 + (size_t)(frame[1] | (frame[2] << 8))) {
+            continue;
+        }
+        if (nade_ring_free(&ctx->in_ring) < frame_len) {
+            nade_ring_note_dropped(&ctx->in_ring, frame_len);
+            continue;
         }
+        nade_ring_push(&ctx->in_ring, frame, frame_len);
+    }
+    bool whole = offset == len;
+    if (!whole) {
+        NADE_TRACE(NADE_EV_DGRAM_DAMAGED, len - offset, len);
+    }
+    arena_exit(ctx);
+    return whole;
+}
+
+static void incoming_clear(nade_ctx_t *ctx) {
+    nade_ring_request_discard(&ctx->in_ring);
+}
+
+// -------------------------------------------------------------------------
+// 4-FSK Modulation / Demodulation
+// Converts bytes <-> audio tones for "audio over audio" transmission
+
+// Apply a posted modulator reset. Transmit thread only.
+static void fsk_tx_apply_reset(nade_ctx_t *ctx) {
+    if (atomic_exchange_explicit(&ctx->fsk_tx_reset_pending, false, memory_order_acquire)) {
+        nade_fsk_mod_reset(&ctx->fsk_mod);
     }
-    pthread_mutex_unlock(&g_fsk_mod_mutex);
+    nade_fsk_mod_set_shaping(&ctx->fsk_mod,
+                             atomic_load_explicit(&ctx->fsk_tx_shaped, memory_order_relaxed));
 }
 
-// Pull modulated PCM samples from the FSK output ring
-static size_t fsk_mod_pull(int16_t *out, size_t max_samples) {
-    pthread_mutex_lock(&g_fsk_mod_mutex);
-    size_t to_read = min_size(max_samples, g_fsk_mod_size);
-    for (size_t i = 0; i < to_read; i++) {
-        out[i] = g_fsk_mod_ring[g_fsk_mod_head];
-        g_fsk_mod_head = (g_fsk_mod_head + 1) % FSK_MOD_CAPACITY;
+// Apply a posted demodulator/FEC reset. Receive thread only.
+static void fsk_rx_apply_reset(nade_ctx_t *ctx) {
+    if (atomic_exchange_explicit(&ctx->fsk_rx_reset_pending, false, memory_order_acquire)) {
+        nade_fsk_demod_reset(&ctx->fsk_demod);
+        nade_fec_decoder_reset(&ctx->pipe_rx_fec);
+        ctx->pipe_rx_epoch = ctx->fsk_demod.epoch;
+        ctx->pipe_rx_has_carry = false;
     }
-    g_fsk_mod_size -= to_read;
-    pthread_mutex_unlock(&g_fsk_mod_mutex);
-    return to_read;
 }
 
 // Push demodulated bytes to the FSK demod ring
-static void fsk_demod_push(const uint8_t *data, size_t len) {
-    pthread_mutex_lock(&g_fsk_demod_mutex);
-    for (size_t i = 0; i < len; i++) {
-        size_t tail = (g_fsk_demod_head + g_fsk_demod_size) % FSK_DEMOD_CAPACITY;
-        g_fsk_demod_ring[tail] = data[i];
-        if (g_fsk_demod_size == FSK_DEMOD_CAPACITY) {
-            g_fsk_demod_head = (g_fsk_demod_head + 1) % FSK_DEMOD_CAPACITY;
-        } else {
-            g_fsk_demod_size++;
-        }
+static void fsk_demod_push(nade_ctx_t *ctx, const uint8_t *data, size_t len) {
+    if (arena_enter(ctx)) {
+        nade_ring_push(&ctx->fsk_demod_ring, data, len);
+        arena_exit(ctx);
     }
-    pthread_mutex_unlock(&g_fsk_demod_mutex);
 }
 
 // Pull demodulated bytes from the FSK demod ring
-static size_t fsk_demod_pull(uint8_t *out, size_t max_len) {
-    pthread_mutex_lock(&g_fsk_demod_mutex);
-    size_t to_read = min_size(max_len, g_fsk_demod_size);
-    for (size_t i = 0; i < to_read; i++) {
-        out[i] = g_fsk_demod_ring[g_fsk_demod_head];
-        g_fsk_demod_head = (g_fsk_demod_head + 1) % FSK_DEMOD_CAPACITY;
+static size_t fsk_demod_pull(nade_ctx_t *ctx, uint8_t *out, size_t max_len) {
+    if (!arena_enter(ctx)) {
+        return 0;
     }
-    g_fsk_demod_size -= to_read;
-    pthread_mutex_unlock(&g_fsk_demod_mutex);
-    return to_read;
+    size_t pulled = nade_ring_pop(&ctx->fsk_demod_ring, out, max_len);
+    arena_exit(ctx);
+    return pulled;
 }
 
 // Process incoming PCM samples and demodulate to bytes
 // Call this with speaker/received audio samples
-static void fsk_demodulate_samples(const int16_t *samples, size_t count) {
-    init_goertzel_coeffs();
-    
-    for (size_t i = 0; i < count; i++) {
-        g_fsk_rx_samples[g_fsk_rx_sample_count++] = samples[i];
-        
-        // When we have a full symbol's worth of samples
-        if (g_fsk_rx_sample_count >= FSK_SAMPLES_PER_SYMBOL) {
-            // Detect which symbol (0-3) is present
-            int symbol = detect_fsk_symbol(g_fsk_rx_samples, g_fsk_rx_sample_count);
-            
-            if (symbol >= 0) {
-                // Accumulate symbol into current byte (LSB first)
-                g_fsk_rx_byte |= (uint8_t)(symbol << (g_fsk_rx_nibble_count * 2));
-                g_fsk_rx_nibble_count++;
-                
-                // When we have 4 symbols (8 bits), output the byte
-                if (g_fsk_rx_nibble_count >= 4) {
-                    fsk_demod_push(&g_fsk_rx_byte, 1);
-                    g_fsk_rx_byte = 0;
-                    g_fsk_rx_nibble_count = 0;
-                }
-            }
-            
-            g_fsk_rx_sample_count = 0;
-        }
+static void fsk_demodulate_samples(nade_ctx_t *ctx, const int16_t *samples, size_t count) {
+    uint8_t bytes[64];
+    size_t offset = 0;
+    while (offset < count) {
+        size_t chunk = min_size(count - offset, (sizeof(bytes) - 1) * NADE_FSK_MIN_SAMPLES_PER_BYTE);
+        size_t consumed = 0;
+        uint64_t start = nade_metrics_now_ns();
+        size_t produced = nade_fsk_demodulate(&ctx->fsk_demod, samples + offset, chunk,
+                                              &consumed, bytes, NULL, sizeof(bytes));
+        record_stage(ctx, NADE_STAGE_FSK_DEMOD, start);
+        fsk_demod_push(ctx, bytes, produced);
+        offset += consumed;
     }
 }
 
 // Reset FSK state (call when starting new session)
-static void fsk_reset_state(void) {
-    g_fsk_tx_phase = 0.0f;
-    g_fsk_rx_sample_count = 0;
-    g_fsk_rx_byte = 0;
-    g_fsk_rx_nibble_count = 0;
-    
-    pthread_mutex_lock(&g_fsk_mod_mutex);
-    g_fsk_mod_head = 0;
-    g_fsk_mod_size = 0;
-    pthread_mutex_unlock(&g_fsk_mod_mutex);
-    
-    pthread_mutex_lock(&g_fsk_demod_mutex);
-    g_fsk_demod_head = 0;
-    g_fsk_demod_size = 0;
-    pthread_mutex_unlock(&g_fsk_demod_mutex);
+static void fsk_reset_state(nade_ctx_t *ctx) {
+    atomic_store_explicit(&ctx->fsk_tx_reset_pending, true, memory_order_release);
+    atomic_store_explicit(&ctx->fsk_rx_reset_pending, true, memory_order_release);
+    nade_ring_request_discard(&ctx->fsk_demod_ring);
 }
 
 // -------------------------------------------------------------------------
 // Session + framing helpers
 
-static void session_reset_locked(void) {
+static void jitter_reset(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->jitter_mutex);
+    // Keep the finished run's counters for the metrics
+    jitter_stats_accumulate(&ctx->jitter_retired, &ctx->jitter.stats, &ctx->jitter_base);
+    memset(&ctx->jitter_base, 0, sizeof(ctx->jitter_base));
+    nade_jitter_reset(&ctx->jitter);
+    pthread_mutex_unlock(&ctx->jitter_mutex);
+}
+
+static void session_reset_locked(nade_ctx_t *ctx) {
     uint8_t priv_copy[32];
     uint8_t pub_copy[32];
-    bool preserve_identity = g_identity_ready;
+    bool preserve_identity = ctx->identity_ready;
     if (preserve_identity) {
-        memcpy(priv_copy, g_identity_priv, 32);
-        memcpy(pub_copy, g_identity_pub, 32);
-    }
-    memset(&g_session, 0, sizeof(g_session));
-    g_session.tx_aead_ready = false;
-    g_session.rx_aead_ready = false;
+        memcpy(priv_copy, ctx->identity_priv, 32);
+        memcpy(pub_copy, ctx->identity_pub, 32);
+    }
+    memset(&ctx->session, 0, sizeof(ctx->session));
+    atomic_store_explicit(&ctx->session_active, false, memory_order_release);
+    ctx->rx_skip = 0;
+    atomic_store_explicit(&ctx->dgram_tx_reset_pending, true, memory_order_release);
+    atomic_store_explicit(&ctx->dgram_rx_reset_pending, true, memory_order_release);
+    ctx->session.tx_aead_ready = false;
+    ctx->session.rx_aead_ready = false;
     if (preserve_identity) {
-        memcpy(g_session.static_priv, priv_copy, 32);
-        memcpy(g_session.static_pub, pub_copy, 32);
+        memcpy(ctx->session.static_priv, priv_copy, 32);
+        memcpy(ctx->session.static_pub, pub_copy, 32);
+    }
+    nade_codec_encoder_reset(&ctx->session.encoder);
+    nade_codec_decoder_reset(&ctx->session.decoder);
+    nade_vad_reset(&ctx->session.vad);
+    atomic_store_explicit(&ctx->fsk_tx_profile, NADE_FSK_PROFILE_BASE, memory_order_release);
+    nade_link_ctl_reset(&ctx->session.link_ctl);
+    atomic_store_explicit(&ctx->fec_tx_parity, NADE_FEC_DEFAULT_PARITY, memory_order_release);
+    ctx->session.tx_codec = NADE_CODEC_ADPCM4;
+    atomic_store_explicit(&ctx->tx_audio_rate, NADE_CODEC_RATE, memory_order_release);
+    atomic_store_explicit(&ctx->tx_airtime_end_ms, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->tx_airtime_samples, 0, memory_order_relaxed);
+    fsk_reset_state(ctx);  // Reset 4-FSK modulation state
+    jitter_reset(ctx);
+}
+
+static void queue_frame(nade_ctx_t *ctx, uint8_t kind, const uint8_t *payload, uint16_t length) {
+    outgoing_frame_t frame;
+    uint8_t *body = outgoing_reserve(ctx, &frame, length);
+    if (length > 0 && payload != NULL && length <= frame.max_body) {
+        memcpy(body, payload, length);
     }
-    reset_adpcm(&g_session.enc_state);
-    reset_adpcm(&g_session.dec_state);
-    fsk_reset_state();  // Reset 4-FSK modulation state
+    outgoing_commit(ctx, &frame, kind, length);
 }
 
-static void queue_frame(uint8_t kind, const uint8_t *payload, uint16_t length) {
-    uint8_t header[3];
-    header[0] = kind;
-    header[1] = (uint8_t)(length & 0xFF);
-    header[2] = (uint8_t)((length >> 8) & 0xFF);
-    outgoing_push(header, sizeof(header));
-    if (length > 0 && payload != NULL) {
-        outgoing_push(payload, length);
+static bool generate_ephemeral(ephemeral_key_t *key) {
+    if (!secure_random_bytes(key->priv, sizeof(key->priv))) {
+        NADE_LOG(ANDROID_LOG_ERROR, TAG, "Failed to gather entropy for ephemeral key");
+        crypto_wipe(key, sizeof(*key));
+        return false;
+    }
+    clamp_x25519(key->priv);
+    return derive_public_key(key->priv, key->pub);
+}
+
+static void ensure_ephemeral_locked(nade_ctx_t *ctx) {
+    ephemeral_key_t key;
+    bool pooled = false;
+    pthread_mutex_lock(&ctx->eph_pool_mutex);
+    if (ctx->eph_pool_count > 0) {
+        ctx->eph_pool_count--;
+        key = ctx->eph_pool[ctx->eph_pool_count];
+        crypto_wipe(&ctx->eph_pool[ctx->eph_pool_count], sizeof(key));
+        pooled = true;
+    }
+    pthread_mutex_unlock(&ctx->eph_pool_mutex);
+    if (!pooled && !generate_ephemeral(&key)) {
+        memset(ctx->session.eph_priv, 0, sizeof(ctx->session.eph_priv));
+        NADE_TRACE(NADE_EV_KEY_FAILURE, ctx->session.role, 1);
+        return;
+    }
+    memcpy(ctx->session.eph_priv, key.priv, 32);
+    memcpy(ctx->session.eph_pub, key.pub, 32);
+    crypto_wipe(&key, sizeof(key));
+    ctx->session.have_peer_ephemeral = false;
+    NADE_TRACE(NADE_EV_EPHEMERAL, ctx->session.role, pooled);
+}
+
+// -------------------------------------------------------------------------
+// Session resumption
+//
+// Every full handshake also derives a 32-byte resumption secret, which both
+// sides keep per peer when resumption is enabled. The next call with that
+// peer offers ticket = SHA-256(secret)[0..16) and, without waiting for an
+// answer, keys its traffic with HKDF(secret || client ephemeral). A server
+// holding the same secret derives the same keys and echoes the ticket; one
+// that does not answers with a plain handshake and the client falls back to
+// it. Each resumption replaces the secret with one derived alongside the
+// keys, so a ticket is only accepted once.
+
+static resume_entry_t *find_resume_entry_locked(nade_ctx_t *ctx, const uint8_t peer_static[32]) {
+    for (int i = 0; i < RESUME_CACHE_SIZE; i++) {
+        resume_entry_t *entry = &ctx->resume_cache[i];
+        if (entry->used && memcmp(entry->peer_static, peer_static, 32) == 0) {
+            return entry;
+        }
     }
+    return NULL;
 }
 
-static void ensure_ephemeral_locked(void) {
-    if (!secure_random_bytes(g_session.eph_priv, sizeof(g_session.eph_priv))) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to gather entropy for ephemeral key");
-        memset(g_session.eph_priv, 0, sizeof(g_session.eph_priv));
+// Store session.resume_next and what the peer offered, evicting the entry
+// stored longest ago when the cache is full
+static void remember_peer_locked(nade_ctx_t *ctx) {
+    if (!ctx->config.resume || !ctx->session.have_peer_static) {
         return;
     }
-    clamp_x25519(g_session.eph_priv);
-    if (!derive_public_key(g_session.eph_priv, g_session.eph_pub)) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "Failed to derive ephemeral public key");
+    resume_entry_t *entry = find_resume_entry_locked(ctx, ctx->session.peer_static);
+    if (entry == NULL) {
+        // Unused entries have stamp 0, so they go first
+        entry = &ctx->resume_cache[0];
+        for (int i = 1; i < RESUME_CACHE_SIZE; i++) {
+            if (ctx->resume_cache[i].stamp < entry->stamp) {
+                entry = &ctx->resume_cache[i];
+            }
+        }
     }
-    g_session.have_peer_ephemeral = false;
+    entry->used = true;
+    entry->stamp = ++ctx->resume_clock;
+    memcpy(entry->peer_static, ctx->session.peer_static, 32);
+    memcpy(entry->secret, ctx->session.resume_next, 32);
+    entry->peer_fsk_profiles = ctx->session.peer_fsk_profiles;
+    entry->peer_codecs = ctx->session.peer_codecs;
+    entry->peer_accepts_encrypt = ctx->session.peer_accepts_encrypt;
+    entry->peer_sends_encrypt = ctx->session.peer_sends_encrypt;
+    entry->peer_accepts_batch = ctx->session.peer_accepts_batch;
+    entry->peer_reads_counted = ctx->session.peer_reads_counted;
+    entry->peer_takes_sid = ctx->session.peer_takes_sid;
+    entry->peer_adapts_fec = ctx->session.peer_adapts_fec;
 }
 
-static size_t build_handshake_payload_locked(uint8_t *out, size_t max_len) {
-    if (max_len < HANDSHAKE_PAYLOAD_LEN) {
+static void resume_ticket(const uint8_t secret[32], uint8_t ticket[HANDSHAKE_TICKET_LEN]) {
+    uint8_t digest[32];
+    sha256_digest(secret, 32, digest);
+    memcpy(ticket, digest, HANDSHAKE_TICKET_LEN);
+}
+
+static size_t build_handshake_payload_locked(nade_ctx_t *ctx, uint8_t *out, size_t max_len) {
+    if (max_len < HANDSHAKE_MAX_PAYLOAD_LEN) {
         return 0;
     }
     uint8_t capabilities = 0;
-    if (g_config.encrypt) capabilities |= 0x01;
-    if (g_config.decrypt) capabilities |= 0x02;
+    if (ctx->config.encrypt) capabilities |= 0x01;
+    if (ctx->config.decrypt) capabilities |= 0x02;
+    capabilities |= 0x04;  // out[3] carries the modulation profile mask
+    capabilities |= 0x08;  // out[84] carries the decodable codec mask
+    capabilities |= 0x10;  // accepts AUDIO_BATCH_PAYLOAD_TYPE records
+    if (ctx->session.resumed) {
+        capabilities |= 0x20;  // resumption ticket follows the codec mask
+    }
+    if (ctx->session.have_peer_ephemeral) {
+        capabilities |= 0x40;  // ends with the peer ephemeral we derived with
+    }
+    capabilities |= 0x80;  // answers resumption offers with an echo
     out[0] = 1; // version
-    out[1] = (uint8_t)g_session.role;
+    out[1] = (uint8_t)ctx->session.role;
     out[2] = capabilities;
-    out[3] = 0;
-    memcpy(out + 4, g_session.eph_pub, 32);
-    memcpy(out + 36, g_session.static_pub, 32);
+    out[3] = (uint8_t)(ctx->config.fsk_profiles | (1u << NADE_FSK_PROFILE_BASE));
+    memcpy(out + 4, ctx->session.eph_pub, 32);
+    memcpy(out + 36, ctx->session.static_pub, 32);
     uint8_t digest[32];
-    sha256_digest(g_session.static_pub, 32, digest);
+    sha256_digest(ctx->session.static_pub, 32, digest);
     memcpy(out + 68, digest, 16);
-    return HANDSHAKE_PAYLOAD_LEN;
+    out[84] = (uint8_t)NADE_CODEC_MASK_ALL;
+    size_t len = HANDSHAKE_PAYLOAD_LEN;
+    if (capabilities & 0x20) {
+        memcpy(out + len, ctx->session.ticket, HANDSHAKE_TICKET_LEN);
+        len += HANDSHAKE_TICKET_LEN;
+    }
+    if (capabilities & 0x40) {
+        memcpy(out + len, ctx->session.peer_eph_pub, HANDSHAKE_ECHO_LEN);
+        len += HANDSHAKE_ECHO_LEN;
+    }
+    // Peers that predate the extension byte ignore what follows the fields
+    // their capability bits announce
+    uint8_t extensions = 0;
+    extensions |= 0x01;  // reads FRAME_KIND_COUNTED_CIPHER records
+    extensions |= 0x02;  // plays comfort noise for AUDIO_SID_PAYLOAD_TYPE records
+    if (ctx->config.adaptive_fec) {
+        extensions |= 0x04;  // decodes every FEC parity level and sends LINK_REPORT_TYPE
+    }
+    out[len++] = extensions;
+    return len;
+}
+
+// Split the derived key block by role and restart traffic under the new keys
+static void install_keys_locked(nade_ctx_t *ctx, const uint8_t derived[96]) {
+    const uint8_t *client_key = derived;
+    const uint8_t *server_key = derived + 32;
+    const uint8_t *client_nonce = derived + 64;
+    const uint8_t *server_nonce = derived + 76;
+    if (ctx->session.role == NADE_ROLE_CLIENT) {
+        memcpy(ctx->session.tx_key, client_key, 32);
+        memcpy(ctx->session.rx_key, server_key, 32);
+        memcpy(ctx->session.tx_nonce_base, client_nonce, 12);
+        memcpy(ctx->session.rx_nonce_base, server_nonce, 12);
+    } else {
+        memcpy(ctx->session.tx_key, server_key, 32);
+        memcpy(ctx->session.rx_key, client_key, 32);
+        memcpy(ctx->session.tx_nonce_base, server_nonce, 12);
+        memcpy(ctx->session.rx_nonce_base, client_nonce, 12);
+    }
+    NADE_TRACE(NADE_EV_KEYS_DERIVED, ctx->session.role, ctx->session.resumed);
+
+    ctx->session.tx_aead_ready = true;
+    ctx->session.rx_aead_ready = true;
+    ctx->session.tx_counter = 0;
+    ctx->session.rx_counter = 0;
+    ctx->session.rx_top = 0;
+    ctx->session.rx_window = 0;
+    ctx->session.audio_seq = 0;
+    nade_codec_encoder_reset(&ctx->session.encoder);
+    nade_codec_decoder_reset(&ctx->session.decoder);
+    jitter_reset(ctx);
+    if (!ctx->session.handshake_complete) {
+        // Speech captured while the call was being set up is stale by now;
+        // sending it would only delay the first live audio
+        nade_ring_request_discard(&ctx->mic_ring);
+        uint64_t now = ctx_now_ms(ctx);
+        uint64_t end = atomic_load_explicit(&ctx->tx_airtime_end_ms, memory_order_relaxed);
+        uint64_t playing = end > now ? (end - now) * NADE_FSK_SAMPLE_RATE / 1000u : 0;
+        uint64_t samples = atomic_load_explicit(&ctx->tx_airtime_samples, memory_order_relaxed);
+        ctx->session.audio_air_from_ms = now;
+        ctx->session.audio_air_from_samples = samples > playing ? samples - playing : 0;
+    }
+    ctx->session.handshake_complete = true;
 }
 
-static bool derive_keys_locked(void) {
-    if (!g_session.have_peer_static || !g_session.have_peer_ephemeral) {
+static bool derive_keys_locked(nade_ctx_t *ctx) {
+    if (!ctx->session.have_peer_static || !ctx->session.have_peer_ephemeral) {
         return false;
     }
     uint8_t dh1[32], dh2[32], dh3[32];
-    if (!x25519(dh1, g_session.eph_priv, g_session.peer_eph_pub)) return false;
-    if (!x25519(dh2, g_session.static_priv, g_session.peer_eph_pub)) return false;
-    if (!x25519(dh3, g_session.eph_priv, g_session.peer_static)) return false;
+    if (!x25519(dh1, ctx->session.eph_priv, ctx->session.peer_eph_pub)) return false;
+    if (!x25519(dh2, ctx->session.static_priv, ctx->session.peer_eph_pub)) return false;
+    if (!x25519(dh3, ctx->session.eph_priv, ctx->session.peer_static)) return false;
     uint8_t material[96];
     memcpy(material, dh1, 32);
     // Ensure eS (Client Ephemeral * Server Static) precedes sE (Client Static * Server Ephemeral)
     // Client: dh3 = eS, dh2 = sE
     // Server: dh2 = eS, dh3 = sE
-    if (g_session.role == NADE_ROLE_CLIENT) {
+    if (ctx->session.role == NADE_ROLE_CLIENT) {
         memcpy(material + 32, dh3, 32);
         memcpy(material + 64, dh2, 32);
     } else {
@@ -1167,262 +1796,960 @@ static bool derive_keys_locked(void) {
         memcpy(material + 32, dh2, 32);
         memcpy(material + 64, dh3, 32);
     }
-    uint8_t derived[96];
+    // Keys and nonces, then the resumption secret. HKDF output is a stream,
+    // so the first 96 bytes are what peers without resumption derive.
+    uint8_t derived[128];
     const uint8_t salt[] = {'N','A','D','E','v','1'};
     // HKDF info must be identical for both parties. Do not include role.
     const uint8_t info[] = {'N','A','D','E','_','S','E','S','S'};
-    __android_log_print(ANDROID_LOG_DEBUG, TAG,
-                        "Deriving keys (role=%d) dh1=%02x%02x%02x%02x dh2=%02x%02x%02x%02x dh3=%02x%02x%02x%02x",
-                        g_session.role,
-                        dh1[0], dh1[1], dh1[2], dh1[3],
-                        material[32], material[33], material[34], material[35],
-                        material[64], material[65], material[66], material[67]);
-    if (!hkdf_sha256(derived, sizeof(derived), material, sizeof(material),
-                     salt, sizeof(salt), info, sizeof(info))) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "HKDF failed (role=%d)", g_session.role);
-        return false;
-    }
-    uint8_t client_key[32], server_key[32];
-    uint8_t client_nonce[12], server_nonce[12];
-    memcpy(client_key, derived, 32);
-    memcpy(server_key, derived + 32, 32);
-    memcpy(client_nonce, derived + 64, 12);
-    memcpy(server_nonce, derived + 76, 12);
-    if (g_session.role == NADE_ROLE_CLIENT) {
-        memcpy(g_session.tx_key, client_key, 32);
-        memcpy(g_session.rx_key, server_key, 32);
-        memcpy(g_session.tx_nonce_base, client_nonce, 12);
-        memcpy(g_session.rx_nonce_base, server_nonce, 12);
+    bool ok = hkdf_sha256(derived, sizeof(derived), material, sizeof(material),
+                          salt, sizeof(salt), info, sizeof(info));
+    if (ok) {
+        ctx->session.resumed = false;
+        install_keys_locked(ctx, derived);
+        memcpy(ctx->session.resume_next, derived + 96, 32);
     } else {
-        memcpy(g_session.tx_key, server_key, 32);
-        memcpy(g_session.rx_key, client_key, 32);
-        memcpy(g_session.tx_nonce_base, server_nonce, 12);
-        memcpy(g_session.rx_nonce_base, client_nonce, 12);
+        NADE_TRACE(NADE_EV_KEY_FAILURE, ctx->session.role, 2);
     }
-    
-    // Log the derived keys for debugging (only first few bytes)
-    __android_log_print(ANDROID_LOG_DEBUG, TAG, "Keys derived. Role: %d", g_session.role);
-    __android_log_print(ANDROID_LOG_DEBUG, TAG, "TX Key: %02x%02x%02x...", g_session.tx_key[0], g_session.tx_key[1], g_session.tx_key[2]);
-    __android_log_print(ANDROID_LOG_DEBUG, TAG, "RX Key: %02x%02x%02x...", g_session.rx_key[0], g_session.rx_key[1], g_session.rx_key[2]);
-
-    g_session.tx_aead_ready = true;
-    g_session.rx_aead_ready = true;
-    g_session.tx_counter = 0;
-    g_session.rx_counter = 0;
-    g_session.audio_seq = 0;
-    reset_adpcm(&g_session.enc_state);
-    reset_adpcm(&g_session.dec_state);
-    g_session.handshake_complete = true;
     memset(dh1, 0, sizeof(dh1));
     memset(dh2, 0, sizeof(dh2));
     memset(dh3, 0, sizeof(dh3));
     memset(material, 0, sizeof(material));
     memset(derived, 0, sizeof(derived));
-    memset(client_key, 0, sizeof(client_key));
-    memset(server_key, 0, sizeof(server_key));
-    memset(client_nonce, 0, sizeof(client_nonce));
-    memset(server_nonce, 0, sizeof(server_nonce));
-    return true;
+    return ok;
 }
 
-static void queue_handshake_locked(void) {
-    uint64_t now = now_monotonic_ms();
-    if (!g_session.handshake_ready) {
-        __android_log_print(ANDROID_LOG_DEBUG, TAG,
-                            "Handshake skip: not ready (role=%d)",
-                            g_session.role);
-        return;
-    }
-    if (g_session.last_handshake_ms != 0 &&
-        now - g_session.last_handshake_ms < HANDSHAKE_RESEND_MS) {
-        return;
+// Keys for a resumed call: both sides know the cached secret and the client
+// ephemeral from its handshake
+static bool derive_resumed_keys_locked(nade_ctx_t *ctx, const uint8_t secret[32], const uint8_t client_eph[32]) {
+    uint8_t material[64];
+    memcpy(material, secret, 32);
+    memcpy(material + 32, client_eph, 32);
+    uint8_t derived[128];
+    const uint8_t salt[] = {'N','A','D','E','v','1','-','r','e','s','u','m','e'};
+    const uint8_t info[] = {'N','A','D','E','_','S','E','S','S'};
+    bool ok = hkdf_sha256(derived, sizeof(derived), material, sizeof(material),
+                          salt, sizeof(salt), info, sizeof(info));
+    if (ok) {
+        ctx->session.resumed = true;
+        install_keys_locked(ctx, derived);
+        memcpy(ctx->session.resume_next, derived + 96, 32);
+    } else {
+        NADE_TRACE(NADE_EV_KEY_FAILURE, ctx->session.role, 2);
     }
-    uint8_t payload[HANDSHAKE_PAYLOAD_LEN];
-    size_t len = build_handshake_payload_locked(payload, sizeof(payload));
-    if (len > 0) {
-        queue_frame(FRAME_KIND_HANDSHAKE, payload, (uint16_t)len);
-        g_session.last_handshake_ms = now;
-        __android_log_print(ANDROID_LOG_DEBUG, TAG,
-                            "Queued handshake frame (role=%d, complete=%d, ack=%d)",
-                            g_session.role,
-                            g_session.handshake_complete ? 1 : 0,
-                            g_session.handshake_acknowledged ? 1 : 0);
+    memset(material, 0, sizeof(material));
+    memset(derived, 0, sizeof(derived));
+    return ok;
+}
+
+static void note_handshake_complete_locked(nade_ctx_t *ctx) {
+    uint64_t elapsed = ctx_now_ms(ctx) - ctx->session.started_ms;
+    NADE_TRACE(NADE_EV_HANDSHAKE_COMPLETE, ctx->session.role, elapsed);
+    atomic_fetch_add_explicit(&ctx->handshakes, 1, memory_order_relaxed);
+    atomic_store_explicit(&ctx->handshake_last_ms, elapsed, memory_order_relaxed);
+    if (elapsed > atomic_load_explicit(&ctx->handshake_max_ms, memory_order_relaxed)) {
+        atomic_store_explicit(&ctx->handshake_max_ms, elapsed, memory_order_relaxed);
     }
 }
 
-static void queue_control_payload_locked(uint8_t type) {
+// Retransmit interval after the given number of resends
+static uint64_t handshake_resend_interval(uint32_t resends) {
+    uint64_t interval = HANDSHAKE_RESEND_MIN_MS;
+    while (resends-- > 0 && interval < HANDSHAKE_RESEND_MAX_MS) {
+        interval *= 2;
+    }
+    return interval < HANDSHAKE_RESEND_MAX_MS ? interval : HANDSHAKE_RESEND_MAX_MS;
+}
+
+// When the next handshake copy is due: an interval after the previous one
+// has been transmitted, doubling with every resend. While the previous copy
+// is still waiting in the outgoing ring nothing is due; once it has left,
+// the modulated audio ends with the burst that carried it.
+static uint64_t handshake_due_locked(nade_ctx_t *ctx) {
+    if (ctx->session.last_handshake_ms == 0) {
+        return 0;
+    }
+    if (ctx->session.handshake_sent_ms == 0) {
+        nade_ring_stats_t stats;
+        nade_ring_get_stats(&ctx->out_ring, &stats);
+        // Free-running counts: the copy is still queued while more is
+        // pending than was pushed after it
+        if (stats.pushed - stats.popped > stats.pushed - ctx->session.handshake_queued_end) {
+            return UINT64_MAX;
+        }
+        uint64_t sent = ctx_now_ms(ctx);
+        uint64_t airtime_end = atomic_load_explicit(&ctx->tx_airtime_end_ms, memory_order_relaxed);
+        ctx->session.handshake_sent_ms = airtime_end > sent ? airtime_end : sent;
+    }
+    return ctx->session.handshake_sent_ms + handshake_resend_interval(ctx->session.handshake_resends);
+}
+
+static bool handshake_needed_locked(nade_ctx_t *ctx) {
+    if (!ctx->session.handshake_complete) {
+        return true;
+    }
+    return !ctx->session.handshake_acknowledged && !ctx->session.peer_has_handshake;
+}
+
+static void queue_handshake_locked(nade_ctx_t *ctx) {
+    uint64_t now = ctx_now_ms(ctx);
+    if (!ctx->session.handshake_ready) {
+        NADE_TRACE(NADE_EV_HANDSHAKE_SKIP, ctx->session.role, 0);
+        return;
+    }
+    bool first = ctx->session.last_handshake_ms == 0;
+    if (now < handshake_due_locked(ctx)) {
+        return;
+    }
+    uint8_t payload[HANDSHAKE_MAX_PAYLOAD_LEN];
+    size_t len = build_handshake_payload_locked(ctx, payload, sizeof(payload));
+    if (len > 0) {
+        queue_frame(ctx, FRAME_KIND_HANDSHAKE, payload, (uint16_t)len);
+        nade_ring_stats_t stats;
+        nade_ring_get_stats(&ctx->out_ring, &stats);
+        ctx->session.handshake_queued_end = stats.pushed;
+        ctx->session.handshake_sent_ms = 0;
+        // A zero timestamp means "never sent"
+        ctx->session.last_handshake_ms = now != 0 ? now : 1;
+        if (!first) {
+            ctx->session.handshake_resends++;
+        }
+        NADE_TRACE(NADE_EV_HANDSHAKE_TX, ctx->session.role,
+                   (ctx->session.handshake_complete ? 1u : 0u) |
+                   (ctx->session.handshake_acknowledged ? 2u : 0u));
+    }
+}
+
+static void queue_control_payload_locked(nade_ctx_t *ctx, uint8_t type) {
     uint8_t payload[1] = {type};
-    queue_frame(FRAME_KIND_CONTROL, payload, sizeof(payload));
+    queue_frame(ctx, FRAME_KIND_CONTROL, payload, sizeof(payload));
+}
+
+static void queue_keepalive_locked(nade_ctx_t *ctx) {
+    queue_control_payload_locked(ctx, KEEPALIVE_TYPE);
+    ctx->session.last_keepalive_ms = ctx_now_ms(ctx);
+}
+
+// Reports only flow on a modem link with FEC, to a peer that acts on them
+static bool link_reports_on_locked(const nade_ctx_t *ctx) {
+    return ctx->config.adaptive_fec && ctx->session.peer_adapts_fec && ctx->fsk_enabled && ctx->rs_enabled;
+}
+
+// When the next FEC report is due; UINT64_MAX while there is nothing to report
+static uint64_t link_report_due_locked(const nade_ctx_t *ctx) {
+    if (!ctx->session.handshake_complete || !link_reports_on_locked(ctx) ||
+        ctx->session.link_rx.blocks < LINK_REPORT_MIN_BLOCKS) {
+        return UINT64_MAX;
+    }
+    return ctx->session.last_link_report_ms + LINK_REPORT_INTERVAL_MS;
 }
 
-static void queue_keepalive_locked(void) {
-    queue_control_payload_locked(KEEPALIVE_TYPE);
-    g_session.last_keepalive_ms = now_monotonic_ms();
+static void put_u16_saturated(uint8_t *out, uint32_t value) {
+    uint16_t v = value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+    out[0] = (uint8_t)(v & 0xFF);
+    out[1] = (uint8_t)(v >> 8);
 }
 
-static void queue_hangup_locked(void) {
-    __android_log_print(ANDROID_LOG_INFO, TAG, "Queueing hangup control frame");
-    outgoing_clear();
-    queue_control_payload_locked(HANGUP_TYPE);
+_Static_assert(AUDIO_BATCH_MAX_FRAMES * (AUDIO_HEADER_LEN + 4 + NADE_CODEC_FRAME_SAMPLES / 2) <= AUDIO_BATCH_MAX_BYTES,
+               "a full batch of narrowband audio must fit in one frame body");
+
+static bool sealing_locked(const nade_ctx_t *ctx) {
+    return ctx->session.outbound_encrypted && ctx->session.tx_aead_ready;
+}
+
+// Body bytes ahead of the plaintext: the record counter, for peers that
+// read counted records
+static size_t record_lead_locked(const nade_ctx_t *ctx) {
+    return sealing_locked(ctx) && ctx->session.peer_reads_counted ? RECORD_COUNTER_LEN : 0;
 }
 
-static void queue_audio_frames_locked(void) {
-    if (!g_session.handshake_complete) {
+// Start a frame for queue_sealed_locked with room for max_plain plaintext
+// bytes. Returns where the plaintext goes.
+static uint8_t *sealed_reserve_locked(nade_ctx_t *ctx, outgoing_frame_t *frame, size_t max_plain) {
+    size_t lead = record_lead_locked(ctx);
+    return outgoing_reserve(ctx, frame, lead + max_plain + 16) + lead;
+}
+
+// Encrypt (when negotiated) and queue the plaintext payload written into a
+// frame from sealed_reserve_locked. Encryption runs in place, with the tag
+// appended. Any record also does the job of a keepalive.
+static void queue_sealed_locked(nade_ctx_t *ctx, outgoing_frame_t *frame, size_t plain_len) {
+    size_t lead = record_lead_locked(ctx);
+    uint8_t *plain = frame->frame + 3 + lead;
+    ctx->session.last_keepalive_ms = ctx_now_ms(ctx);
+    if (sealing_locked(ctx)) {
+        uint64_t counter = ctx->session.tx_counter++;
+        uint8_t nonce[12];
+        compose_nonce(nonce, ctx->session.tx_nonce_base, counter);
+        uint64_t start = nade_metrics_now_ns();
+        nade_aead_seal(ctx->session.tx_key, nonce, NULL, 0, plain, plain_len, plain + plain_len);
+        record_stage(ctx, NADE_STAGE_AEAD_SEAL, start);
+        if (lead > 0) {
+            frame->frame[3] = (uint8_t)(counter & 0xFF);
+            frame->frame[4] = (uint8_t)((counter >> 8) & 0xFF);
+            outgoing_commit(ctx, frame, FRAME_KIND_COUNTED_CIPHER, lead + plain_len + 16);
+        } else {
+            outgoing_commit(ctx, frame, FRAME_KIND_CIPHER, plain_len + 16);
+        }
+    } else {
+        outgoing_commit(ctx, frame, FRAME_KIND_PLAINTEXT, plain_len);
+    }
+}
+
+// Queue a control payload as a sealed record once keys are in place, so a
+// peer expecting encrypted records can tell it came from us; in the clear
+// before that
+static void queue_control_record_locked(nade_ctx_t *ctx, const uint8_t *payload, size_t len) {
+    if (!sealing_locked(ctx)) {
+        queue_frame(ctx, FRAME_KIND_CONTROL, payload, (uint16_t)len);
         return;
     }
-    while (available_int16(&g_mic_size, &g_mic_mutex) >= AUDIO_FRAME_SAMPLES) {
-        int16_t pcm[AUDIO_FRAME_SAMPLES];
-        size_t pulled = pop_int16_ring(g_mic_ring, MIC_CAPACITY, &g_mic_head, &g_mic_size,
-                                       pcm, AUDIO_FRAME_SAMPLES, &g_mic_mutex);
-        if (pulled == 0) {
-            break;
+    outgoing_frame_t frame;
+    uint8_t *plain = sealed_reserve_locked(ctx, &frame, len);
+    memcpy(plain, payload, len);
+    queue_sealed_locked(ctx, &frame, len);
+}
+
+// Tell the peer what our FEC decoder made of its frames since the last
+// report. It steers the peer's parity, profile and codec, so it is sealed
+// once keys are in place and the peer ignores one in the clear after that.
+static void queue_link_report_locked(nade_ctx_t *ctx) {
+    const nade_link_report_t *report = &ctx->session.link_rx;
+    uint8_t payload[LINK_REPORT_LEN];
+    payload[0] = LINK_REPORT_TYPE;
+    put_u16_saturated(payload + 1, report->blocks);
+    put_u16_saturated(payload + 3, report->failed);
+    put_u16_saturated(payload + 5, report->errors);
+    put_u16_saturated(payload + 7, report->coded_bytes);
+    queue_control_record_locked(ctx, payload, sizeof(payload));
+    memset(&ctx->session.link_rx, 0, sizeof(ctx->session.link_rx));
+    // It does a keepalive's job as well
+    ctx->session.last_link_report_ms = ctx_now_ms(ctx);
+    ctx->session.last_keepalive_ms = ctx->session.last_link_report_ms;
+}
+
+static void queue_hangup_locked(nade_ctx_t *ctx) {
+    NADE_TRACE(NADE_EV_HANGUP_TX, ctx->session.role, 0);
+    outgoing_clear(ctx);
+    uint8_t payload[1] = {HANGUP_TYPE};
+    queue_control_record_locked(ctx, payload, sizeof(payload));
+}
+
+// Encode count samples of mic audio as an audio payload into out. Returns
+// its length, or 0 if nothing was encoded.
+static size_t encode_audio_payload_locked(nade_ctx_t *ctx, const int16_t *pcm, size_t count, uint8_t *out,
+                                          size_t max_len) {
+    if (max_len < AUDIO_HEADER_LEN) {
+        return 0;
+    }
+    uint64_t start = nade_metrics_now_ns();
+    size_t encoded_len = nade_codec_encode(&ctx->session.encoder, ctx->session.tx_codec, pcm, count,
+                                           out + AUDIO_HEADER_LEN, max_len - AUDIO_HEADER_LEN);
+    record_stage(ctx, NADE_STAGE_CODEC_ENCODE, start);
+    if (encoded_len == 0) {
+        return 0;
+    }
+    uint16_t seq = ctx->session.audio_seq++;
+    out[0] = AUDIO_PAYLOAD_TYPE;
+    out[1] = ctx->session.tx_codec; // codec version
+    out[2] = (uint8_t)(seq & 0xFF);
+    out[3] = (uint8_t)(seq >> 8);
+    out[4] = (uint8_t)(count & 0xFF);
+    out[5] = (uint8_t)(count >> 8);
+    out[6] = (uint8_t)(encoded_len & 0xFF);
+    out[7] = (uint8_t)(encoded_len >> 8);
+    return encoded_len + AUDIO_HEADER_LEN;
+}
+
+// Whether a mic frame goes out as audio. With DTX on and a peer that plays
+// comfort noise, frames the detector calls silence do not.
+static bool mic_frame_voiced_locked(nade_ctx_t *ctx, const int16_t *pcm, size_t count) {
+    if (!ctx->config.dtx || !ctx->session.peer_takes_sid) {
+        return true;
+    }
+    if (!nade_vad_frame(&ctx->session.vad, pcm, count)) {
+        return false;
+    }
+    ctx->session.tx_paused = false;
+    return true;
+}
+
+// Most frames of a codec one record can pack: one, unless the peer takes
+// batches, then as many as fit in one frame
+static size_t audio_batch_max_locked(const nade_ctx_t *ctx, int codec) {
+    if (!ctx->session.peer_accepts_batch) {
+        return 1;
+    }
+    size_t fits = AUDIO_BATCH_MAX_BYTES / (AUDIO_HEADER_LEN + nade_codec_info(codec)->frame_bytes);
+    return min_size(AUDIO_BATCH_MAX_FRAMES, fits);
+}
+
+// Frames the configured latency budget packs per record
+static size_t audio_batch_configured_locked(const nade_ctx_t *ctx, int codec) {
+    return min_size(1 + ctx->config.audio_batch_ms / AUDIO_FRAME_MS, audio_batch_max_locked(ctx, codec));
+}
+
+// Frames packed per record: what the latency budget covers, or more when
+// the modem cannot carry the codec in smaller records
+static size_t audio_batch_frames_locked(nade_ctx_t *ctx) {
+    size_t configured = audio_batch_configured_locked(ctx, ctx->session.tx_codec);
+    size_t floor = min_size(ctx->session.tx_batch, audio_batch_max_locked(ctx, ctx->session.tx_codec));
+    return configured > floor ? configured : floor;
+}
+
+// Milliseconds on air of len frame bytes sent in one burst over the modem as
+// it is set up now: segment header in datagram mode, FEC framing and parity,
+// and the burst's lead-in and sync
+static size_t fsk_bytes_airtime_ms_locked(nade_ctx_t *ctx, size_t len) {
+    if (ctx->rs_enabled) {
+        len = nade_fec_frame_len(len + (datagram_mtu(ctx) > 0 ? NADE_DGRAM_HEADER_LEN : 0),
+                                 (size_t)atomic_load_explicit(&ctx->fec_tx_parity, memory_order_acquire));
+    }
+    int profile = atomic_load_explicit(&ctx->fsk_tx_profile, memory_order_acquire);
+    return nade_fsk_burst_samples(profile, len) * 1000 / NADE_FSK_SAMPLE_RATE;
+}
+
+// The same for one record of plain_len plaintext bytes, with its frame
+// header, record counter and tag, as if it went in a burst of its own (it
+// does while the link keeps up)
+static size_t fsk_record_airtime_ms_locked(nade_ctx_t *ctx, size_t plain_len) {
+    size_t len = 3 + plain_len;
+    if (ctx->session.outbound_encrypted) {
+        len += 16 + (ctx->session.peer_reads_counted ? RECORD_COUNTER_LEN : 0);
+    }
+    return fsk_bytes_airtime_ms_locked(ctx, len);
+}
+
+static size_t audio_record_airtime_ms_locked(nade_ctx_t *ctx, int codec, size_t batch) {
+    return fsk_record_airtime_ms_locked(ctx, (batch == 1 ? 0 : 2) +
+                                        batch * (AUDIO_HEADER_LEN + nade_codec_info(codec)->frame_bytes));
+}
+
+// Fewest frames per record, from the configured batch up, that keep codec's
+// records within FSK_AUDIO_AIRTIME_PERCENT of the time they cover, or 0 if
+// no batch does
+static size_t audio_fsk_batch_locked(nade_ctx_t *ctx, int codec) {
+    for (size_t batch = audio_batch_configured_locked(ctx, codec); batch <= audio_batch_max_locked(ctx, codec);
+         batch++) {
+        if (audio_record_airtime_ms_locked(ctx, codec, batch) * 100 <=
+            batch * AUDIO_FRAME_MS * FSK_AUDIO_AIRTIME_PERCENT) {
+            return batch;
         }
-        uint8_t adpcm_buf[200];
-        size_t adpcm_len = adpcm_encode_block(pcm, pulled, adpcm_buf, sizeof(adpcm_buf), &g_session.enc_state);
-        if (adpcm_len == 0) {
-            break;
+    }
+    return 0;
+}
+
+// Whether a record costing cost_ms still fits the audio share of the modem.
+// The share runs from the handshake's completion, so the seconds it took do
+// not hold back the first audio. Everything sent since counts against it:
+// the bursts on air, including what was left of the handshake then, control
+// traffic and the frames still waiting in the outgoing ring, so the modem
+// cannot fall behind the call whatever else it carries. That share is what
+// keeps it from falling behind when no codec and batch fit it; on a raw
+// link everything goes.
+static bool audio_airtime_covers_locked(nade_ctx_t *ctx, size_t cost_ms) {
+    if (!ctx->fsk_enabled) {
+        return true;
+    }
+    uint64_t elapsed = ctx_now_ms(ctx) - ctx->session.audio_air_from_ms;
+    uint64_t share = elapsed * FSK_AUDIO_AIRTIME_PERCENT / 100 + FSK_AUDIO_CREDIT_MAX_MS;
+    uint64_t spent = (atomic_load_explicit(&ctx->tx_airtime_samples, memory_order_relaxed) -
+                      ctx->session.audio_air_from_samples) * 1000u / NADE_FSK_SAMPLE_RATE;
+    size_t queued = nade_ring_size(&ctx->out_ring);
+    if (queued > 0) {
+        spent += fsk_bytes_airtime_ms_locked(ctx, queued);
+    }
+    return spent + cost_ms <= share;
+}
+
+_Static_assert(NADE_DTX_SID_MAX_FRAMES * DTX_FSK_SID_SCALE * AUDIO_FRAME_MS < KEEPALIVE_FSK_INTERVAL_MS,
+               "descriptors through a pause stand in for keepalives");
+
+// Withhold a silent mic frame. Its sequence number is still spent so the
+// receiver keeps time through the pause. A descriptor goes out as the
+// pause starts, when the background changes, and every
+// NADE_DTX_SID_MAX_FRAMES otherwise; on the FSK link, where a descriptor
+// costs a whole burst, the spacing keeps them under the keepalive interval.
+static void queue_silence_locked(nade_ctx_t *ctx) {
+    uint16_t seq = ctx->session.audio_seq++;
+    nade_sid_t sid;
+    nade_vad_describe(&ctx->session.vad, &sid);
+    uint16_t age = ++ctx->session.sid_age;
+    uint16_t scale = ctx->fsk_enabled ? DTX_FSK_SID_SCALE : 1;
+    bool due = !ctx->session.tx_paused || age >= NADE_DTX_SID_MAX_FRAMES * scale ||
+               (age >= NADE_DTX_SID_MIN_FRAMES * scale && nade_sid_changed(&sid, &ctx->session.last_sid));
+    ctx->session.tx_paused = true;
+    size_t cost = ctx->fsk_enabled ? fsk_record_airtime_ms_locked(ctx, AUDIO_SID_LEN) : 0;
+    if (!due || !audio_airtime_covers_locked(ctx, cost)) {
+        return;
+    }
+    outgoing_frame_t frame;
+    uint8_t *plain = sealed_reserve_locked(ctx, &frame, AUDIO_SID_LEN);
+    plain[0] = AUDIO_SID_PAYLOAD_TYPE;
+    plain[1] = (uint8_t)(seq & 0xFF);
+    plain[2] = (uint8_t)(seq >> 8);
+    plain[3] = sid.level;
+    plain[4] = (uint8_t)sid.tilt;
+    queue_sealed_locked(ctx, &frame, AUDIO_SID_LEN);
+    ctx->session.last_sid = sid;
+    ctx->session.sid_age = 0;
+}
+
+static void queue_audio_frames_locked(nade_ctx_t *ctx) {
+    if (!ctx->session.handshake_complete) {
+        return;
+    }
+    size_t batch = audio_batch_frames_locked(ctx);
+    const nade_codec_info_t *codec = nade_codec_info(ctx->session.tx_codec);
+    // Apply a pending discard first: the size check below already discounts
+    // it, so a ring that filled up meanwhile would never be popped to apply it
+    nade_ring_skip(&ctx->mic_ring, 0);
+    // Waiting for a full batch in the mic ring is what spends the budget
+    while (nade_ring_size(&ctx->mic_ring) >= batch * codec->frame_samples) {
+        // A record the modem has no airtime for is refused, its sequence
+        // numbers spent so the peer conceals the frames
+        if (ctx->fsk_enabled &&
+            !audio_airtime_covers_locked(ctx, audio_record_airtime_ms_locked(ctx, ctx->session.tx_codec, batch))) {
+            nade_ring_skip(&ctx->mic_ring, batch * codec->frame_samples);
+            ctx->session.audio_seq = (uint16_t)(ctx->session.audio_seq + batch);
+            continue;
         }
-        uint8_t plain[MAX_FRAME_BODY];
-        if (adpcm_len + 8 > sizeof(plain)) {
-            break;
+        // The codec writes straight into the outgoing ring, leaving room for the tag
+        size_t max_plain = (batch == 1 ? 0 : 2) + batch * (AUDIO_HEADER_LEN + codec->frame_bytes);
+        outgoing_frame_t frame;
+        uint8_t *plain = sealed_reserve_locked(ctx, &frame, max_plain);
+        size_t plain_len = batch == 1 ? 0 : 2;
+        size_t entries = 0;
+        bool silent = false;
+        while (entries < batch) {
+            int16_t pcm[NADE_CODEC_MAX_FRAME_SAMPLES];
+            size_t pulled = nade_ring_pop(&ctx->mic_ring, pcm, codec->frame_samples);
+            if (pulled == 0) {
+                break;
+            }
+            if (!mic_frame_voiced_locked(ctx, pcm, pulled)) {
+                // A pause cuts the batch short
+                silent = true;
+                break;
+            }
+            size_t entry = encode_audio_payload_locked(ctx, pcm, pulled, plain + plain_len, max_plain - plain_len);
+            if (entry == 0) {
+                break;
+            }
+            plain_len += entry;
+            entries++;
         }
-        uint16_t seq = g_session.audio_seq++;
-        plain[0] = AUDIO_PAYLOAD_TYPE;
-        plain[1] = 1; // codec version
-        plain[2] = (uint8_t)(seq & 0xFF);
-        plain[3] = (uint8_t)(seq >> 8);
-        plain[4] = (uint8_t)(pulled & 0xFF);
-        plain[5] = (uint8_t)(pulled >> 8);
-        plain[6] = (uint8_t)(adpcm_len & 0xFF);
-        plain[7] = (uint8_t)(adpcm_len >> 8);
-        memcpy(plain + 8, adpcm_buf, adpcm_len);
-        size_t plain_len = adpcm_len + 8;
-        if (g_session.outbound_encrypted && g_session.tx_aead_ready) {
-            uint8_t cipher[MAX_FRAME_BODY + 16];
-            uint8_t nonce[12];
-            compose_nonce(nonce, g_session.tx_nonce_base, g_session.tx_counter++);
-            crypto_aead_ctx ctx;
-            crypto_aead_init_ietf(&ctx, g_session.tx_key, nonce);
-            crypto_aead_write(&ctx, cipher, cipher + plain_len,
-                              NULL, 0, plain, plain_len);
-            crypto_wipe(&ctx, sizeof(ctx));
-            queue_frame(FRAME_KIND_CIPHER, cipher, (uint16_t)(plain_len + 16));
-        } else {
-            queue_frame(FRAME_KIND_PLAINTEXT, plain, (uint16_t)plain_len);
+        if (entries > 0) {
+            if (batch > 1) {
+                plain[0] = AUDIO_BATCH_PAYLOAD_TYPE;
+                plain[1] = (uint8_t)entries;
+            }
+            queue_sealed_locked(ctx, &frame, plain_len);
         }
+        if (silent) {
+            queue_silence_locked(ctx);
+        } else if (entries < batch) {
+            break;
+        }
+    }
+}
+
+// Keepalives only go out when nothing else has for this long
+static uint64_t keepalive_interval_locked(const nade_ctx_t *ctx) {
+    return ctx->fsk_enabled ? KEEPALIVE_FSK_INTERVAL_MS : KEEPALIVE_INTERVAL_MS;
+}
+
+// When the next keepalive is due. Over FSK the quiet time counts from the
+// end of the last burst, handshakes included, not from when it was queued.
+static uint64_t keepalive_due_locked(const nade_ctx_t *ctx) {
+    uint64_t last = ctx->session.last_keepalive_ms;
+    if (ctx->fsk_enabled) {
+        uint64_t airtime_end = atomic_load_explicit(&ctx->tx_airtime_end_ms, memory_order_relaxed);
+        last = airtime_end > last ? airtime_end : last;
     }
+    return last + keepalive_interval_locked(ctx) + 1;
 }
 
-static void build_outgoing_locked(void) {
-    if (!g_session.active) {
+static void build_outgoing_locked(nade_ctx_t *ctx) {
+    if (!ctx->session.active) {
         return;
     }
-    bool need_handshake = !g_session.handshake_complete || !g_session.handshake_acknowledged;
-    if (need_handshake) {
-        queue_handshake_locked();
-        if (!g_session.handshake_complete) {
+    if (handshake_needed_locked(ctx)) {
+        queue_handshake_locked(ctx);
+        if (!ctx->session.handshake_complete) {
             return;
         }
     }
-    queue_audio_frames_locked();
-    uint64_t now = now_monotonic_ms();
-    if (now - g_session.last_keepalive_ms > KEEPALIVE_INTERVAL_MS) {
-        queue_keepalive_locked();
+    queue_audio_frames_locked(ctx);
+    uint64_t now = ctx_now_ms(ctx);
+    if (now >= link_report_due_locked(ctx)) {
+        queue_link_report_locked(ctx);
+    }
+    if (now >= keepalive_due_locked(ctx)) {
+        queue_keepalive_locked(ctx);
     }
 }
 
-static void handle_audio_plain_locked(const uint8_t *data, size_t len) {
-    if (len < 8 || data[0] != AUDIO_PAYLOAD_TYPE) {
+// When build_outgoing_locked next has a timer to serve (handshake resend,
+// FEC report or keepalive), in monotonic ms; UINT64_MAX if none is armed
+static uint64_t next_timer_deadline_locked(nade_ctx_t *ctx) {
+    if (!ctx->session.active) {
+        return UINT64_MAX;
+    }
+    uint64_t deadline = UINT64_MAX;
+    if (handshake_needed_locked(ctx) && ctx->session.handshake_ready) {
+        deadline = handshake_due_locked(ctx);
+    }
+    if (ctx->session.handshake_complete) {
+        uint64_t keepalive = keepalive_due_locked(ctx);
+        if (keepalive < deadline) {
+            deadline = keepalive;
+        }
+        uint64_t report = link_report_due_locked(ctx);
+        if (report < deadline) {
+            deadline = report;
+        }
+    }
+    return deadline;
+}
+
+static void handle_audio_plain_locked(nade_ctx_t *ctx, const uint8_t *data, size_t len) {
+    if (len < AUDIO_HEADER_LEN || data[0] != AUDIO_PAYLOAD_TYPE) {
         return;
     }
     uint16_t sample_count = (uint16_t)(data[4] | (data[5] << 8));
-    uint16_t payload_len = (uint16_t)(data[6] | (data[7] << 8));
-    if (payload_len + 8 > len) {
+    size_t payload_len = (size_t)(data[6] | (data[7] << 8));
+    if (payload_len + AUDIO_HEADER_LEN > len) {
         return;
     }
-    int16_t pcm_buffer[AUDIO_FRAME_SAMPLES];
-    size_t decoded = adpcm_decode_block(data + 8, payload_len, pcm_buffer,
-                                        min_size(sample_count, (uint16_t)AUDIO_FRAME_SAMPLES),
-                                        &g_session.dec_state);
+    const nade_codec_info_t *codec = nade_codec_info(data[1]);
+    if (!codec) {
+        return;
+    }
+    int16_t pcm_buffer[NADE_CODEC_MAX_FRAME_SAMPLES];
+    uint64_t start = nade_metrics_now_ns();
+    size_t decoded = nade_codec_decode(&ctx->session.decoder, data[1], data + AUDIO_HEADER_LEN, payload_len,
+                                       pcm_buffer, min_size(sample_count, codec->frame_samples));
+    record_stage(ctx, NADE_STAGE_CODEC_DECODE, start);
     if (decoded > 0) {
-        push_int16_ring(g_spk_ring, SPK_CAPACITY, &g_spk_head, &g_spk_size,
-                        pcm_buffer, decoded, &g_spk_mutex);
+        uint16_t seq = (uint16_t)(data[2] | (data[3] << 8));
+        pthread_mutex_lock(&ctx->jitter_mutex);
+        if (ctx->jitter.sample_rate != codec->sample_rate) {
+            // The peer changed between narrowband and wideband
+            nade_jitter_set_rate(&ctx->jitter, codec->sample_rate);
+        }
+        nade_jitter_push(&ctx->jitter, seq, pcm_buffer, decoded, ctx_now_ms(ctx));
+        pthread_mutex_unlock(&ctx->jitter_mutex);
+        signal_speaker(ctx);
+    }
+}
+
+static void handle_sid_plain_locked(nade_ctx_t *ctx, const uint8_t *data, size_t len) {
+    if (len < AUDIO_SID_LEN) {
+        return;
+    }
+    uint16_t seq = (uint16_t)(data[1] | (data[2] << 8));
+    nade_sid_t sid = {.level = data[3], .tilt = (int8_t)data[4]};
+    pthread_mutex_lock(&ctx->jitter_mutex);
+    nade_jitter_push_sid(&ctx->jitter, seq, &sid, ctx_now_ms(ctx));
+    pthread_mutex_unlock(&ctx->jitter_mutex);
+    signal_speaker(ctx);
+}
+
+static void handle_audio_batch_locked(nade_ctx_t *ctx, const uint8_t *data, size_t len) {
+    if (len < 2) {
+        return;
+    }
+    size_t offset = 2;
+    for (uint8_t i = 0; i < data[1]; i++) {
+        if (offset + AUDIO_HEADER_LEN > len) {
+            return;
+        }
+        const uint8_t *entry = data + offset;
+        size_t entry_len = AUDIO_HEADER_LEN + (size_t)(entry[6] | (entry[7] << 8));
+        if (offset + entry_len > len) {
+            return;
+        }
+        handle_audio_plain_locked(ctx, entry, entry_len);
+        offset += entry_len;
     }
 }
 
-static void handle_control_plain_locked(const uint8_t *data, size_t len) {
+static void handle_link_report_locked(nade_ctx_t *ctx, const uint8_t *data);
+
+// authenticated: the payload came out of an opened record. Once records
+// from the peer are encrypted, reports and hangups that were not are
+// ignored: anyone able to inject on the link could send them.
+static void handle_control_plain_locked(nade_ctx_t *ctx, const uint8_t *data, size_t len, bool authenticated) {
     if (len == 0) {
         return;
     }
     uint8_t subtype = data[0];
     if (subtype == KEEPALIVE_TYPE) {
-        g_session.last_keepalive_ms = now_monotonic_ms();
+        ctx->session.last_keepalive_ms = ctx_now_ms(ctx);
+        return;
+    }
+    if (!authenticated && ctx->session.inbound_encrypted && ctx->session.rx_aead_ready) {
+        return;
+    }
+    if (subtype == LINK_REPORT_TYPE) {
+        if (len >= LINK_REPORT_LEN) {
+            handle_link_report_locked(ctx, data);
+        }
         return;
     }
     if (subtype == HANGUP_TYPE) {
-        if (!g_session.remote_hangup_requested) {
-            __android_log_print(ANDROID_LOG_INFO, TAG, "Remote hangup signal received");
+        if (!ctx->session.remote_hangup_requested) {
+            NADE_TRACE(NADE_EV_HANGUP_RX, ctx->session.role, 0);
         }
-        g_session.remote_hangup_requested = true;
+        ctx->session.remote_hangup_requested = true;
+    }
+}
+
+// Open the record sealed under counter in place: data = [ciphertext
+// (cipher_len)] [tag (16)]. The tag is checked before anything is
+// overwritten.
+static bool open_record_locked(nade_ctx_t *ctx, uint64_t counter, uint8_t *data, size_t cipher_len) {
+    uint8_t nonce[12];
+    compose_nonce(nonce, ctx->session.rx_nonce_base, counter);
+    uint64_t start = nade_metrics_now_ns();
+    int rc = nade_aead_open(ctx->session.rx_key, nonce, NULL, 0, data, cipher_len, data + cipher_len);
+    record_stage(ctx, NADE_STAGE_AEAD_OPEN, start);
+    if (rc != 0) {
+        atomic_fetch_add_explicit(&ctx->decrypt_failures, 1, memory_order_relaxed);
+        NADE_TRACE(NADE_EV_DECRYPT_FAIL, counter, cipher_len + 16);
+        return false;
+    }
+    if (!ctx->session.handshake_acknowledged) {
+        ctx->session.handshake_acknowledged = true;
+        NADE_TRACE(NADE_EV_HANDSHAKE_ACK, ctx->session.role, 0);
     }
+    return true;
 }
 
-static void handle_encrypted_payload_locked(const uint8_t *data, size_t len, bool encrypted) {
-    if (!g_session.handshake_complete) {
+static void handle_record_plain_locked(nade_ctx_t *ctx, const uint8_t *plain, size_t plain_len,
+                                       bool authenticated) {
+    if (plain_len == 0) {
         return;
     }
-    uint8_t plain[MAX_FRAME_BODY];
-    size_t plain_len = len;
-    if (encrypted && len > 16 && g_session.rx_aead_ready) {
-        size_t cipher_len = len - 16;
-        uint8_t nonce[12];
-        compose_nonce(nonce, g_session.rx_nonce_base, g_session.rx_counter++);
-        crypto_aead_ctx ctx;
-        crypto_aead_init_ietf(&ctx, g_session.rx_key, nonce);
-        // The tag is at the END of the message in ChaCha20-Poly1305
-        // data = [ciphertext (len-16)] [tag (16)]
-        // crypto_aead_read expects:
-        // - message: output buffer for plaintext
-        // - mac: pointer to the tag (last 16 bytes of input)
-        // - ad: associated data (NULL here)
-        // - ad_size: 0
-        // - nonce: the nonce
-        // - key: the key
-        // - ciphertext: pointer to ciphertext (start of input)
-        // - ciphertext_size: length of ciphertext (len - 16)
-        if (crypto_aead_read(&ctx, plain, data + cipher_len,
-                              NULL, 0, data, cipher_len) != 0) {
-            crypto_wipe(&ctx, sizeof(ctx));
-            // If decryption fails, we MUST NOT increment the counter, or we will be out of sync forever.
-            // Actually, for security we SHOULD increment, but if we are debugging a sync issue,
-            // let's log the nonce to see what's happening.
-            __android_log_print(ANDROID_LOG_WARN, TAG, "Failed to decrypt frame. Nonce counter: %llu", (unsigned long long)(g_session.rx_counter - 1));
+    if (plain[0] == AUDIO_PAYLOAD_TYPE) {
+        handle_audio_plain_locked(ctx, plain, plain_len);
+    } else if (plain[0] == AUDIO_BATCH_PAYLOAD_TYPE) {
+        handle_audio_batch_locked(ctx, plain, plain_len);
+    } else if (plain[0] == AUDIO_SID_PAYLOAD_TYPE) {
+        handle_sid_plain_locked(ctx, plain, plain_len);
+    } else {
+        handle_control_plain_locked(ctx, plain, plain_len, authenticated);
+    }
+}
+
+// data is the frame body in the input ring (or its linearization buffer)
+// and is decrypted in place. Cipher records from peers that predate counted
+// records take the next implicit counter, so one lost record stalls all
+// that follow until the next handshake.
+static void handle_encrypted_payload_locked(nade_ctx_t *ctx, uint8_t *data, size_t len, bool encrypted) {
+    if (!ctx->session.handshake_complete) {
+        return;
+    }
+    size_t plain_len = min_size(len, MAX_FRAME_BODY);
+    bool authenticated = false;
+    if (encrypted && len > 16 && ctx->session.rx_aead_ready) {
+        if (!open_record_locked(ctx, ctx->session.rx_counter++, data, len - 16)) {
+            if (ctx->session.peer_resume_rejected && !ctx->session.handshake_acknowledged) {
+                // Sealed under the refused resumption keys; the client
+                // restarts its counter once it falls back
+                ctx->session.rx_counter--;
+            }
             return;
         }
-        crypto_wipe(&ctx, sizeof(ctx));
-        plain_len = cipher_len;
-        if (!g_session.handshake_acknowledged) {
-            g_session.handshake_acknowledged = true;
-            __android_log_print(ANDROID_LOG_DEBUG, TAG,
-                                "Handshake acknowledged via decrypted frame (role=%d)",
-                                g_session.role);
-        }
+        plain_len = len - 16;
+        authenticated = true;
+    }
+    handle_record_plain_locked(ctx, data, plain_len, authenticated);
+}
+
+// Full counter of a counted record from its low bits: the one nearest the
+// newest counter opened so far
+static uint64_t expand_record_counter(uint64_t top, uint16_t low) {
+    uint64_t counter = (top & ~(uint64_t)0xFFFF) | low;
+    if (counter + 0x8000 < top) {
+        counter += 0x10000;
+    } else if (counter > top + 0x8000 && counter >= 0x10000) {
+        counter -= 0x10000;
+    }
+    return counter;
+}
+
+// Whether counter may still be opened: newer than every record so far, or
+// inside the window behind the newest and not seen yet
+static bool replay_fresh_locked(nade_ctx_t *ctx, uint64_t counter) {
+    if (counter >= ctx->session.rx_top) {
+        return true;
+    }
+    uint64_t age = ctx->session.rx_top - 1 - counter;
+    if (age >= REPLAY_WINDOW) {
+        NADE_TRACE(NADE_EV_REPLAY, counter, 1);
+        return false;
+    }
+    if ((ctx->session.rx_window >> age) & 1) {
+        NADE_TRACE(NADE_EV_REPLAY, counter, 0);
+        return false;
+    }
+    return true;
+}
+
+// Mark an opened record, sliding the window when it is the newest
+static void replay_accept_locked(nade_ctx_t *ctx, uint64_t counter) {
+    if (counter >= ctx->session.rx_top) {
+        uint64_t shift = counter - ctx->session.rx_top + 1;
+        ctx->session.rx_window = shift >= REPLAY_WINDOW ? 0 : ctx->session.rx_window << shift;
+        ctx->session.rx_window |= 1;
+        ctx->session.rx_top = counter + 1;
     } else {
-        memcpy(plain, data, min_size(len, sizeof(plain)));
-        plain_len = min_size(len, sizeof(plain));
+        ctx->session.rx_window |= (uint64_t)1 << (ctx->session.rx_top - 1 - counter);
     }
-    if (plain_len == 0) {
+}
+
+// Counted records name their counter, so a lost, corrupted or reordered
+// record costs only itself, and only records that open move the window
+static void handle_counted_payload_locked(nade_ctx_t *ctx, uint8_t *data, size_t len) {
+    if (!ctx->session.handshake_complete || !ctx->session.rx_aead_ready ||
+        len <= RECORD_COUNTER_LEN + 16) {
         return;
     }
-    if (plain[0] == AUDIO_PAYLOAD_TYPE) {
-        handle_audio_plain_locked(plain, plain_len);
+    uint16_t low = (uint16_t)(data[0] | (data[1] << 8));
+    uint64_t counter = expand_record_counter(ctx->session.rx_top, low);
+    if (!replay_fresh_locked(ctx, counter)) {
+        return;
+    }
+    uint8_t *cipher = data + RECORD_COUNTER_LEN;
+    size_t cipher_len = len - RECORD_COUNTER_LEN - 16;
+    if (!open_record_locked(ctx, counter, cipher, cipher_len)) {
+        return;
+    }
+    replay_accept_locked(ctx, counter);
+    handle_record_plain_locked(ctx, cipher, cipher_len, true);
+}
+
+// Fastest profile in mask slower than profile, or -1 if there is none
+static int fsk_profile_below(uint32_t mask, int profile) {
+    uint32_t slower = 0;
+    for (int id = 0; id < NADE_FSK_PROFILE_COUNT; id++) {
+        if ((mask & (1u << id)) && nade_fsk_profile_bitrate(id) < nade_fsk_profile_bitrate(profile)) {
+            slower |= 1u << id;
+        }
+    }
+    return slower != 0 ? nade_fsk_best_profile(slower) : -1;
+}
+
+// How many times the link controller can back off below the fastest
+// common profile
+static int fsk_backoff_steps_locked(const nade_ctx_t *ctx) {
+    uint32_t common = (uint32_t)(ctx->config.fsk_profiles & ctx->session.peer_fsk_profiles);
+    int steps = 0;
+    for (int profile = nade_fsk_best_profile(common); (profile = fsk_profile_below(common, profile)) >= 0;) {
+        steps++;
+    }
+    return steps;
+}
+
+// Pick the fastest modulation profile both sides offer, less the steps the
+// link controller backed off. Every receiver follows the profile named in
+// each burst header, so only TX needs this.
+static void negotiate_fsk_profile_locked(nade_ctx_t *ctx) {
+    uint32_t common = (uint32_t)(ctx->config.fsk_profiles & ctx->session.peer_fsk_profiles);
+    int profile = nade_fsk_best_profile(common);
+    for (int step = 0; step < ctx->session.link_ctl.rate_backoff; step++) {
+        int slower = fsk_profile_below(common, profile);
+        if (slower < 0) {
+            break;
+        }
+        profile = slower;
+    }
+    int previous = atomic_exchange_explicit(&ctx->fsk_tx_profile, profile, memory_order_acq_rel);
+    if (profile != previous) {
+        NADE_TRACE(NADE_EV_FSK_PROFILE, profile, nade_fsk_profile_bitrate(profile));
+    }
+}
+
+// Pick the transmit codec: the configured one if the peer can decode it,
+// otherwise ADPCM on a raw link (at 16 kHz when the device captures that
+// much and the peer decodes it) or, over the modem, the richest codec
+// whose records, with all their overhead, the link can carry at some batch
+// size. That batch becomes the floor for audio_batch_frames_locked. A
+// configured codec the modem cannot carry at any batch is passed over;
+// when none fits, the leanest goes in the largest batches.
+static void select_audio_codec_locked(nade_ctx_t *ctx) {
+    uint32_t common = NADE_CODEC_MASK_ALL & ctx->session.peer_codecs;
+    int codec = NADE_CODEC_ADPCM4;
+    size_t batch = 0;
+    bool configured = ctx->config.audio_codec != NADE_CODEC_NONE && (common & (1u << ctx->config.audio_codec));
+    if (configured && ctx->fsk_enabled) {
+        batch = audio_fsk_batch_locked(ctx, ctx->config.audio_codec);
+        if (batch == 0) {
+            NADE_LOG(ANDROID_LOG_WARN, TAG, "Codec %s does not fit the modem; choosing another",
+                     nade_codec_info(ctx->config.audio_codec)->name);
+            configured = false;
+        }
+    }
+    if (configured) {
+        codec = ctx->config.audio_codec;
+    } else if (!ctx->fsk_enabled) {
+        bool wideband_device = atomic_load_explicit(&ctx->device_rate, memory_order_relaxed) >= NADE_CODEC_WB_RATE;
+        if (ctx->config.wideband && wideband_device && (common & (1u << NADE_CODEC_ADPCM4_WB))) {
+            codec = NADE_CODEC_ADPCM4_WB;
+        }
     } else {
-        handle_control_plain_locked(plain, plain_len);
+        int best = NADE_CODEC_NONE;
+        int leanest = NADE_CODEC_NONE;
+        for (int id = NADE_CODEC_NONE + 1; id < NADE_CODEC_COUNT; id++) {
+            if (!(common & (1u << id))) {
+                continue;
+            }
+            int rate = nade_codec_info(id)->bitrate;
+            size_t fit = audio_fsk_batch_locked(ctx, id);
+            if (fit > 0 && (best == NADE_CODEC_NONE || rate > nade_codec_info(best)->bitrate)) {
+                best = id;
+                batch = fit;
+            }
+            if (leanest == NADE_CODEC_NONE || rate < nade_codec_info(leanest)->bitrate) {
+                leanest = id;
+            }
+        }
+        if (best != NADE_CODEC_NONE) {
+            codec = best;
+        } else if (leanest != NADE_CODEC_NONE) {
+            codec = leanest;
+            batch = audio_batch_max_locked(ctx, leanest);
+        }
+    }
+    ctx->session.tx_batch = (uint8_t)batch;
+    if (codec != ctx->session.tx_codec) {
+        NADE_TRACE(NADE_EV_CODEC, codec, nade_codec_info(codec)->bitrate);
+        ctx->session.tx_codec = (uint8_t)codec;
+        int rate = nade_codec_info(codec)->sample_rate;
+        if (atomic_exchange_explicit(&ctx->tx_audio_rate, rate, memory_order_acq_rel) != rate) {
+            // Mic audio already queued is at the old rate
+            nade_ring_request_discard(&ctx->mic_ring);
+        }
+    }
+}
+
+// Act on the peer's view of our frames: step the parity, and the modulation
+// profile when parity alone cannot keep up; the codec follows the bit rate
+static void handle_link_report_locked(nade_ctx_t *ctx, const uint8_t *data) {
+    if (!ctx->session.handshake_complete || !link_reports_on_locked(ctx)) {
+        return;
+    }
+    nade_link_report_t report = {
+        .blocks = (uint32_t)(data[1] | (data[2] << 8)),
+        .failed = (uint32_t)(data[3] | (data[4] << 8)),
+        .errors = (uint32_t)(data[5] | (data[6] << 8)),
+        .coded_bytes = (uint32_t)(data[7] | (data[8] << 8)),
+    };
+    nade_link_ctl_t *ctl = &ctx->session.link_ctl;
+    int backoff = ctl->rate_backoff;
+    if (!nade_link_ctl_update(ctl, &report, fsk_backoff_steps_locked(ctx))) {
+        return;
+    }
+    int parity = (int)nade_link_ctl_parity(ctl);
+    if (atomic_exchange_explicit(&ctx->fec_tx_parity, parity, memory_order_acq_rel) != parity) {
+        NADE_TRACE(NADE_EV_FEC_PARITY, parity, nade_link_ctl_error_rate(ctl) * 1e6);
+    }
+    if (ctl->rate_backoff != backoff) {
+        negotiate_fsk_profile_locked(ctx);
+    }
+    select_audio_codec_locked(ctx);
+}
+
+// Drop what the link controller learnt, back to the default parity at the
+// fastest profile
+static void link_adaptation_reset_locked(nade_ctx_t *ctx) {
+    nade_link_ctl_reset(&ctx->session.link_ctl);
+    memset(&ctx->session.link_rx, 0, sizeof(ctx->session.link_rx));
+    atomic_store_explicit(&ctx->fec_tx_parity, NADE_FEC_DEFAULT_PARITY, memory_order_release);
+    if (ctx->session.handshake_complete) {
+        negotiate_fsk_profile_locked(ctx);
+        select_audio_codec_locked(ctx);
     }
 }
 
-static void handle_handshake_payload_locked(const uint8_t *payload, size_t len) {
-    if (len < HANDSHAKE_PAYLOAD_LEN) {
+// Client side: key the call from the cached secret before the server has
+// answered, using what the server offered last time
+static void offer_resumption_locked(nade_ctx_t *ctx) {
+    if (!ctx->config.resume || ctx->session.role != NADE_ROLE_CLIENT || !ctx->session.expect_peer_static) {
+        return;
+    }
+    resume_entry_t *entry = find_resume_entry_locked(ctx, ctx->session.expected_peer_static);
+    if (entry == NULL) {
+        return;
+    }
+    if (!derive_resumed_keys_locked(ctx, entry->secret, ctx->session.eph_pub)) {
+        return;
+    }
+    resume_ticket(entry->secret, ctx->session.ticket);
+    memcpy(ctx->session.peer_static, entry->peer_static, 32);
+    ctx->session.have_peer_static = true;
+    ctx->session.peer_fsk_profiles = entry->peer_fsk_profiles;
+    ctx->session.peer_codecs = entry->peer_codecs;
+    ctx->session.peer_accepts_encrypt = entry->peer_accepts_encrypt;
+    ctx->session.peer_sends_encrypt = entry->peer_sends_encrypt;
+    ctx->session.peer_accepts_batch = entry->peer_accepts_batch;
+    ctx->session.peer_reads_counted = entry->peer_reads_counted;
+    ctx->session.peer_takes_sid = entry->peer_takes_sid;
+    ctx->session.peer_adapts_fec = entry->peer_adapts_fec;
+    ctx->session.outbound_encrypted = ctx->config.encrypt && ctx->session.peer_accepts_encrypt;
+    ctx->session.inbound_encrypted = ctx->config.decrypt && ctx->session.peer_sends_encrypt;
+    // The secret is spent whether or not the server still has it
+    remember_peer_locked(ctx);
+    negotiate_fsk_profile_locked(ctx);
+    select_audio_codec_locked(ctx);
+    note_handshake_complete_locked(ctx);
+    NADE_TRACE(NADE_EV_RESUME, ctx->session.role, 0);
+}
+
+static void read_peer_capabilities_locked(nade_ctx_t *ctx, const uint8_t *payload, size_t len,
+                                          uint8_t extensions) {
+    uint8_t capabilities = payload[2];
+    ctx->session.peer_accepts_encrypt = (capabilities & 0x02) != 0;
+    ctx->session.peer_sends_encrypt = (capabilities & 0x01) != 0;
+    ctx->session.outbound_encrypted = ctx->config.encrypt && ctx->session.peer_accepts_encrypt;
+    ctx->session.inbound_encrypted = ctx->config.decrypt && ctx->session.peer_sends_encrypt;
+    // Peers without the profile bit only understand the base profile
+    ctx->session.peer_fsk_profiles = (capabilities & 0x04) ? payload[3] :
+                                  (uint8_t)(1u << NADE_FSK_PROFILE_BASE);
+    ctx->session.peer_accepts_batch = (capabilities & 0x10) != 0;
+    ctx->session.peer_reads_counted = (extensions & 0x01) != 0;
+    ctx->session.peer_takes_sid = (extensions & 0x02) != 0;
+    ctx->session.peer_adapts_fec = (extensions & 0x04) != 0;
+    // Every peer decodes the original ADPCM codec
+    ctx->session.peer_codecs = (uint8_t)(1u << NADE_CODEC_ADPCM4);
+    if ((capabilities & 0x08) && len >= HANDSHAKE_PAYLOAD_LEN) {
+        ctx->session.peer_codecs |= payload[84];
+    }
+}
+
+// Server side: accept a resumption ticket if it names the secret we hold
+// for this peer
+static bool accept_resumption_locked(nade_ctx_t *ctx, const uint8_t *ticket, const uint8_t *client_eph) {
+    resume_entry_t *entry = find_resume_entry_locked(ctx, ctx->session.peer_static);
+    if (entry == NULL) {
+        return false;
+    }
+    uint8_t expected[HANDSHAKE_TICKET_LEN];
+    resume_ticket(entry->secret, expected);
+    if (crypto_verify16(expected, ticket) != 0) {
+        return false;
+    }
+    if (!derive_resumed_keys_locked(ctx, entry->secret, client_eph)) {
+        return false;
+    }
+    memcpy(ctx->session.ticket, expected, HANDSHAKE_TICKET_LEN);
+    return true;
+}
+
+static void handle_handshake_payload_locked(nade_ctx_t *ctx, const uint8_t *payload, size_t len) {
+    if (len < HANDSHAKE_MIN_PAYLOAD_LEN) {
         return;
     }
     uint8_t version = payload[0];
@@ -1430,203 +2757,728 @@ static void handle_handshake_payload_locked(const uint8_t *payload, size_t len)
     if (version != 1) {
         return;
     }
-    __android_log_print(ANDROID_LOG_DEBUG, TAG,
-                        "Handshake payload received (role=%d, cap=%u)",
-                        g_session.role, capabilities);
-    memcpy(g_session.peer_eph_pub, payload + 4, 32);
-    memcpy(g_session.peer_static, payload + 36, 32);
-    g_session.have_peer_ephemeral = true;
-    g_session.have_peer_static = true;
-    g_session.peer_accepts_encrypt = (capabilities & 0x02) != 0;
-    g_session.peer_sends_encrypt = (capabilities & 0x01) != 0;
-    g_session.outbound_encrypted = g_config.encrypt && g_session.peer_accepts_encrypt;
-    g_session.inbound_encrypted = g_config.decrypt && g_session.peer_sends_encrypt;
-    if (g_session.expect_peer_static &&
-        memcmp(g_session.expected_peer_static, g_session.peer_static, 32) != 0) {
-        __android_log_print(ANDROID_LOG_ERROR, TAG, "Peer public key mismatch");
+    NADE_TRACE(NADE_EV_HANDSHAKE_RX, ctx->session.role, capabilities);
+    const uint8_t *tail = payload + HANDSHAKE_PAYLOAD_LEN;
+    const uint8_t *ticket = NULL;
+    const uint8_t *echo = NULL;
+    if ((capabilities & 0x20) && len >= (size_t)(tail - payload) + HANDSHAKE_TICKET_LEN) {
+        ticket = tail;
+        tail += HANDSHAKE_TICKET_LEN;
+    }
+    if ((capabilities & 0x40) && len >= (size_t)(tail - payload) + HANDSHAKE_ECHO_LEN) {
+        echo = tail;
+        tail += HANDSHAKE_ECHO_LEN;
+    }
+    uint8_t extensions = len > (size_t)(tail - payload) ? *tail : 0;
+    if (ctx->session.expect_peer_static &&
+        memcmp(ctx->session.expected_peer_static, payload + 36, 32) != 0) {
+        NADE_TRACE(NADE_EV_PEER_KEY_MISMATCH, ctx->session.role, 0);
         return;
     }
-    if (derive_keys_locked()) {
-        if (!g_session.handshake_complete) {
-            queue_handshake_locked();
+    bool echoed = echo != NULL && memcmp(echo, ctx->session.eph_pub, HANDSHAKE_ECHO_LEN) == 0;
+    if (echoed) {
+        ctx->session.peer_has_handshake = true;
+    }
+    // A retransmit of what the keys already came from: deriving again would
+    // only restart the counters under traffic that is already flowing
+    if (ctx->session.handshake_complete && ctx->session.have_peer_ephemeral &&
+        memcmp(ctx->session.peer_eph_pub, payload + 4, 32) == 0) {
+        return;
+    }
+    if (ctx->session.resumed && ctx->session.role == NADE_ROLE_CLIENT && !ctx->session.have_peer_ephemeral) {
+        if ((capabilities & 0x80) && !echoed) {
+            return;  // Sent before the server saw our offer; its answer follows
+        }
+        if (ticket != NULL && echoed &&
+            crypto_verify16(ticket, ctx->session.ticket) == 0) {
+            // Accepted: the keys in use stand, only the offer may have changed
+            memcpy(ctx->session.peer_eph_pub, payload + 4, 32);
+            ctx->session.have_peer_ephemeral = true;
+            read_peer_capabilities_locked(ctx, payload, len, extensions);
+            negotiate_fsk_profile_locked(ctx);
+            select_audio_codec_locked(ctx);
+            remember_peer_locked(ctx);
+            NADE_TRACE(NADE_EV_RESUME, ctx->session.role, 1);
+            return;
+        }
+        NADE_TRACE(NADE_EV_RESUME, ctx->session.role, 2);
+    }
+    memcpy(ctx->session.peer_eph_pub, payload + 4, 32);
+    memcpy(ctx->session.peer_static, payload + 36, 32);
+    ctx->session.have_peer_ephemeral = true;
+    ctx->session.have_peer_static = true;
+    read_peer_capabilities_locked(ctx, payload, len, extensions);
+    bool was_complete = ctx->session.handshake_complete;
+    if (ticket != NULL && !was_complete && ctx->session.role == NADE_ROLE_SERVER) {
+        if (ctx->config.resume && accept_resumption_locked(ctx, ticket, payload + 4)) {
+            NADE_TRACE(NADE_EV_RESUME, ctx->session.role, 1);
+            note_handshake_complete_locked(ctx);
+            negotiate_fsk_profile_locked(ctx);
+            select_audio_codec_locked(ctx);
+            remember_peer_locked(ctx);
+            return;
+        }
+        // The client is already sending under keys we cannot derive
+        ctx->session.peer_resume_rejected = true;
+        NADE_TRACE(NADE_EV_RESUME, ctx->session.role, 2);
+    }
+    if (derive_keys_locked(ctx)) {
+        if (ctx->session.peer_resume_rejected) {
+            // Answer ahead of our first record, or the client would try it
+            // with the resumption keys
+            ctx->session.last_handshake_ms = 0;
         }
-        __android_log_print(ANDROID_LOG_DEBUG, TAG,
-                            "Handshake complete locally (role=%d)",
-                            g_session.role);
-        g_session.handshake_complete = true;
+        if (!was_complete) {
+            note_handshake_complete_locked(ctx);
+        }
+        negotiate_fsk_profile_locked(ctx);
+        select_audio_codec_locked(ctx);
+        remember_peer_locked(ctx);
     }
 }
 
-static void process_incoming_locked(void) {
-    while (true) {
+// Parse every complete frame in the input ring. The frames are read through
+// one view of the ring and released together, so a burst costs one index
+// handshake with the producer rather than several per frame, and bodies are
+// handled (and decrypted) where they lie. A length longer than any frame is
+// skipped as its bytes arrive, since the ring may be too small to hold them.
+static void process_incoming_locked(nade_ctx_t *ctx) {
+    nade_ring_view_t view;
+    size_t available = nade_ring_read_view(&ctx->in_ring, &view);
+    size_t offset = min_size(ctx->rx_skip, available);
+    ctx->rx_skip -= offset;
+    while (available - offset >= 3) {
         uint8_t header[3];
-        if (!incoming_peek(header, sizeof(header))) {
-            break;
+        view_read(&view, offset, header, sizeof(header));
+        size_t body_len = (size_t)(header[1] | (header[2] << 8));
+        if (body_len > sizeof(ctx->rx_linear)) {
+            size_t skip = min_size(sizeof(header) + body_len, available - offset);
+            ctx->rx_skip = sizeof(header) + body_len - skip;
+            offset += skip;
+            continue;
         }
-        uint16_t body_len = (uint16_t)(header[1] | (header[2] << 8));
-        if (incoming_size() < body_len + sizeof(header)) {
+        if (available - offset < sizeof(header) + body_len) {
             break;
         }
-        incoming_drop(sizeof(header));
-        uint8_t body[MAX_FRAME_BODY + 32];
-        if (body_len > sizeof(body)) {
-            incoming_drop(body_len);
-            continue;
-        }
-        incoming_read(body, body_len);
+        offset += sizeof(header);
+        uint8_t *body = view_span(&view, offset, body_len, ctx->rx_linear);
+        offset += body_len;
+        nade_histogram_record(&ctx->rx_frame_hist, sizeof(header) + body_len);
         switch (header[0]) {
             case FRAME_KIND_HANDSHAKE:
-                handle_handshake_payload_locked(body, body_len);
+                handle_handshake_payload_locked(ctx, body, body_len);
                 break;
             case FRAME_KIND_CIPHER:
-                handle_encrypted_payload_locked(body, body_len, true);
+                handle_encrypted_payload_locked(ctx, body, body_len, true);
                 break;
             case FRAME_KIND_PLAINTEXT:
-                handle_encrypted_payload_locked(body, body_len, false);
+                handle_encrypted_payload_locked(ctx, body, body_len, false);
+                break;
+            case FRAME_KIND_COUNTED_CIPHER:
+                handle_counted_payload_locked(ctx, body, body_len);
+                break;
+            case FRAME_KIND_CONTROL:
+                handle_control_plain_locked(ctx, body, body_len, false);
                 break;
             default:
                 break;
         }
     }
+    nade_ring_release_view(&ctx->in_ring, &view, offset);
+}
+
+// -------------------------------------------------------------------------
+// Session arena
+
+static size_t ring_capacity_for(size_t elements) {
+    size_t capacity = 1;
+    while (capacity < elements) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Buffer sizes for the configuration in force. The mic ring holds the
+// batching budget plus slack at the rate the mode's codecs capture (auto
+// picks narrowband ones over FSK), and never less than the largest batch at
+// 16 kHz, so a batch or codec changed mid-session still fills it.
+static void arena_layout_locked(nade_ctx_t *ctx, arena_layout_t *layout) {
+    bool fsk = ctx->fsk_enabled;
+    size_t mic_rate = fsk && ctx->config.audio_codec == NADE_CODEC_NONE ? NADE_CODEC_RATE : NADE_CODEC_WB_RATE;
+    size_t mic_ms = ctx->config.audio_batch_ms + AUDIO_FRAME_MS + (fsk ? FSK_MIC_QUEUE_MS : MIC_QUEUE_MS);
+    size_t mic = mic_rate * mic_ms / 1000;
+    size_t largest_batch = (size_t)NADE_CODEC_WB_RATE * AUDIO_FRAME_MS * AUDIO_BATCH_MAX_FRAMES / 1000;
+    size_t device_rate = (size_t)atomic_load_explicit(&ctx->device_rate, memory_order_relaxed);
+    layout->fsk = fsk;
+    layout->mic_capacity = ring_capacity_for(mic > largest_batch ? mic : largest_batch);
+    layout->spk_capacity = ring_capacity_for(SPK_FRAME_MAX + device_rate * SPK_QUEUE_MS / 1000);
+    layout->out_capacity = ring_capacity_for(OUT_QUEUE_FRAMES * (3 + MAX_FRAME_BODY));
+    layout->in_capacity = ring_capacity_for(IN_QUEUE_FRAMES * (3 + sizeof(ctx->rx_linear)));
+}
+
+static bool layout_equal(const arena_layout_t *a, const arena_layout_t *b) {
+    return a->fsk == b->fsk && a->mic_capacity == b->mic_capacity && a->spk_capacity == b->spk_capacity &&
+           a->out_capacity == b->out_capacity && a->in_capacity == b->in_capacity;
+}
+
+// Offset of the next buffer of bytes in an arena of *size bytes so far
+static size_t arena_reserve(size_t *size, size_t bytes) {
+    size_t offset = (*size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    *size = offset + bytes;
+    return offset;
+}
+
+// One allocation for every buffer of the layout, each on its own cache line.
+// The buffers are left uninitialized: the rings start empty and the scratch
+// is written before it is read, so pages nothing reaches stay unbacked.
+static session_arena_t *arena_create(const arena_layout_t *layout) {
+    size_t size = sizeof(session_arena_t);
+    size_t mic = arena_reserve(&size, layout->mic_capacity * sizeof(int16_t));
+    size_t spk = arena_reserve(&size, layout->spk_capacity * sizeof(int16_t));
+    size_t out = arena_reserve(&size, layout->out_capacity);
+    size_t in = arena_reserve(&size, layout->in_capacity);
+    size_t demod = 0, tx_frame = 0, tx_coded = 0, tx_pcm = 0, rx_pcm = 0, rx_bytes = 0, rx_reliability = 0,
+           rx_payload = 0;
+    if (layout->fsk) {
+        demod = arena_reserve(&size, FSK_DEMOD_CAPACITY);
+        tx_frame = arena_reserve(&size, PIPELINE_MAX_CODED_BYTES);
+        tx_coded = arena_reserve(&size, PIPELINE_MAX_CODED_BYTES);
+        tx_pcm = arena_reserve(&size, PIPELINE_TX_MAX_SAMPLES * sizeof(int16_t));
+        rx_pcm = arena_reserve(&size, PIPELINE_RX_CHUNK_SAMPLES * sizeof(int16_t));
+        rx_bytes = arena_reserve(&size, PIPELINE_RX_MAX_BYTES);
+        rx_reliability = arena_reserve(&size, PIPELINE_RX_MAX_BYTES);
+        rx_payload = arena_reserve(&size, NADE_FEC_MAX_PAYLOAD);
+    }
+    void *mem = NULL;
+    if (posix_memalign(&mem, ARENA_ALIGN, size) != 0) {
+        return NULL;
+    }
+    uint8_t *base = (uint8_t *)mem;
+    session_arena_t *arena = (session_arena_t *)mem;
+    memset(arena, 0, sizeof(*arena));
+    arena->layout = *layout;
+    arena->size = size;
+    arena->mic_storage = (int16_t *)(base + mic);
+    arena->spk_storage = (int16_t *)(base + spk);
+    arena->out_storage = base + out;
+    arena->in_storage = base + in;
+    if (layout->fsk) {
+        arena->fsk_demod_storage = base + demod;
+        arena->tx_frame = base + tx_frame;
+        arena->tx_coded = base + tx_coded;
+        arena->tx_pcm = (int16_t *)(base + tx_pcm);
+        arena->rx_pcm = (int16_t *)(base + rx_pcm);
+        arena->rx_bytes = base + rx_bytes;
+        arena->rx_reliability = base + rx_reliability;
+        arena->rx_payload = base + rx_payload;
+    }
+    return arena;
+}
+
+// Point the rings at an arena's storage, or at none. Under session_mutex
+// with no arena user inside.
+static void arena_bind_locked(nade_ctx_t *ctx, const session_arena_t *arena) {
+    static const session_arena_t no_arena;
+    const session_arena_t *a = arena ? arena : &no_arena;
+    nade_ring_rebind(&ctx->mic_ring, a->mic_storage, a->layout.mic_capacity);
+    nade_ring_rebind(&ctx->spk_ring, a->spk_storage, a->layout.spk_capacity);
+    nade_ring_rebind(&ctx->out_ring, a->out_storage, a->layout.out_capacity);
+    nade_ring_rebind(&ctx->in_ring, a->in_storage, a->layout.in_capacity);
+    nade_ring_rebind(&ctx->fsk_demod_ring, a->fsk_demod_storage, a->layout.fsk ? FSK_DEMOD_CAPACITY : 0);
+    // The rest of an oversized frame went with the input ring's contents
+    ctx->rx_skip = 0;
+}
+
+// Give the session buffers laid out for the configuration in force, or take
+// them away (want false). Buffers that already match are kept; otherwise
+// what the rings hold is dropped, and the old buffers are wiped and freed
+// once no real-time call is inside them. Control threads only, without
+// session_mutex. Returns false if the allocation failed, leaving no buffers.
+static bool arena_refit(nade_ctx_t *ctx, bool want) {
+    pthread_mutex_lock(&ctx->arena_mutex);
+    pthread_mutex_lock(&ctx->session_mutex);
+    arena_layout_t layout;
+    arena_layout_locked(ctx, &layout);
+    session_arena_t *old = atomic_load_explicit(&ctx->arena, memory_order_relaxed);
+    if (want ? old && layout_equal(&old->layout, &layout) : !old) {
+        pthread_mutex_unlock(&ctx->session_mutex);
+        pthread_mutex_unlock(&ctx->arena_mutex);
+        return true;
+    }
+    atomic_store(&ctx->arena, NULL);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    // Entry points hold the arena for one bounded step and never wait on
+    // arena_mutex, so this ends quickly
+    while (atomic_load(&ctx->arena_users) != 0) {
+        sched_yield();
+    }
+    session_arena_t *fresh = want ? arena_create(&layout) : NULL;
+    pthread_mutex_lock(&ctx->session_mutex);
+    arena_bind_locked(ctx, fresh);
+    atomic_store(&ctx->arena, fresh);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    if (old) {
+        crypto_wipe(old, old->size);
+        free(old);
+    }
+    pthread_mutex_unlock(&ctx->arena_mutex);
+    if (want && !fresh) {
+        NADE_LOG(ANDROID_LOG_ERROR, TAG, "Failed to allocate session buffers");
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Context lifecycle
+
+// Bring a zeroed context to its initial state
+static void ctx_setup(nade_ctx_t *ctx) {
+    ctx->config.encrypt = true;
+    ctx->config.decrypt = true;
+    ctx->config.fsk_profiles = NADE_FSK_PROFILE_MASK_DEFAULT;
+    ctx->config.dtx = true;
+    ctx->config.wideband = true;
+    ctx->config.adaptive_fec = true;
+    pthread_mutex_init(&ctx->session_mutex, NULL);
+    pthread_mutex_init(&ctx->jitter_mutex, NULL);
+    pthread_mutex_init(&ctx->wait_mutex, NULL);
+    pthread_mutex_init(&ctx->eph_pool_mutex, NULL);
+    pthread_mutex_init(&ctx->arena_mutex, NULL);
+    pthread_mutex_init(&ctx->capture_mutex, NULL);
+    // Deadlines are monotonic so wall-clock changes cannot stretch a wait
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ctx->out_cond, &cond_attr);
+    pthread_cond_init(&ctx->spk_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    // No storage until a session starts
+    nade_ring_init(&ctx->mic_ring, NULL, 0, sizeof(int16_t));
+    nade_ring_init(&ctx->spk_ring, NULL, 0, sizeof(int16_t));
+    nade_ring_init(&ctx->out_ring, NULL, 0, sizeof(uint8_t));
+    nade_ring_init(&ctx->in_ring, NULL, 0, sizeof(uint8_t));
+    nade_ring_init(&ctx->fsk_demod_ring, NULL, 0, sizeof(uint8_t));
+    atomic_init(&ctx->arena, NULL);
+    atomic_init(&ctx->arena_users, 0);
+    atomic_init(&ctx->capture, NULL);
+    atomic_init(&ctx->capture_users, 0);
+    atomic_init(&ctx->session_active, false);
+    atomic_init(&ctx->out_events, 0);
+    atomic_init(&ctx->spk_events, 0);
+    atomic_init(&ctx->fsk_tx_reset_pending, true);
+    atomic_init(&ctx->fsk_rx_reset_pending, true);
+    atomic_init(&ctx->link_mtu, 0);
+    atomic_init(&ctx->dgram_tx_reset_pending, true);
+    atomic_init(&ctx->dgram_rx_reset_pending, true);
+    atomic_init(&ctx->fsk_tx_profile, NADE_FSK_PROFILE_BASE);
+    atomic_init(&ctx->fec_tx_parity, NADE_FEC_DEFAULT_PARITY);
+    atomic_init(&ctx->fsk_tx_shaped, false);
+    atomic_init(&ctx->tx_airtime_end_ms, 0);
+    atomic_init(&ctx->tx_airtime_samples, 0);
+    atomic_init(&ctx->device_rate, NADE_CODEC_RATE);
+    atomic_init(&ctx->tx_audio_rate, NADE_CODEC_RATE);
+    nade_resampler_init(&ctx->mic_resampler, NADE_CODEC_RATE, NADE_CODEC_RATE);
+    nade_resampler_init(&ctx->spk_resampler, NADE_CODEC_RATE, NADE_CODEC_RATE);
+    ctx->rs_enabled = true;
+    session_reset_locked(ctx);
+}
+
+static void default_ctx_setup(void) {
+    ctx_setup(&g_default_ctx);
+}
+
+nade_ctx_t *nade_ctx_default(void) {
+    pthread_once(&g_default_ctx_once, default_ctx_setup);
+    return &g_default_ctx;
+}
+
+nade_ctx_t *nade_ctx_create(const uint8_t *seed32) {
+    void *mem = NULL;
+    // The rings keep their indices on separate cache lines
+    if (posix_memalign(&mem, _Alignof(nade_ctx_t), sizeof(nade_ctx_t)) != 0) {
+        return NULL;
+    }
+    nade_ctx_t *ctx = (nade_ctx_t *)mem;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx_setup(ctx);
+    if (seed32 && nade_ctx_init(ctx, seed32) != 0) {
+        nade_ctx_destroy(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void nade_ctx_destroy(nade_ctx_t *ctx) {
+    if (!ctx || ctx == &g_default_ctx) {
+        return;
+    }
+    // An engine left open would go on calling into the freed context
+    nade_audio_detach(ctx);
+    nade_ctx_capture_stop(ctx);
+    pthread_mutex_destroy(&ctx->session_mutex);
+    pthread_mutex_destroy(&ctx->jitter_mutex);
+    pthread_mutex_destroy(&ctx->wait_mutex);
+    pthread_mutex_destroy(&ctx->eph_pool_mutex);
+    pthread_mutex_destroy(&ctx->arena_mutex);
+    pthread_mutex_destroy(&ctx->capture_mutex);
+    pthread_cond_destroy(&ctx->out_cond);
+    pthread_cond_destroy(&ctx->spk_cond);
+    session_arena_t *arena = atomic_load(&ctx->arena);
+    if (arena) {
+        crypto_wipe(arena, arena->size);
+        free(arena);
+    }
+    crypto_wipe(ctx, sizeof(*ctx));
+    free(ctx);
+}
+
+void nade_ctx_set_clock(nade_ctx_t *ctx, nade_clock_fn clock, void *user) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    pthread_mutex_lock(&ctx->jitter_mutex);
+    ctx->clock = clock;
+    ctx->clock_user = clock ? user : NULL;
+    pthread_mutex_unlock(&ctx->jitter_mutex);
+    pthread_mutex_unlock(&ctx->session_mutex);
 }
 
 // -------------------------------------------------------------------------
 // Public NADE API
 
-int nade_init(const uint8_t *seed32) {
+int nade_ctx_init(nade_ctx_t *ctx, const uint8_t *seed32) {
     if (!seed32) {
         return -1;
     }
-    pthread_mutex_lock(&g_session_mutex);
-    memcpy(g_identity_priv, seed32, 32);
-    clamp_x25519(g_identity_priv);
-    if (!derive_public_key(g_identity_priv, g_identity_pub)) {
-        pthread_mutex_unlock(&g_session_mutex);
+    pthread_mutex_lock(&ctx->session_mutex);
+    memcpy(ctx->identity_priv, seed32, 32);
+    clamp_x25519(ctx->identity_priv);
+    if (!derive_public_key(ctx->identity_priv, ctx->identity_pub)) {
+        pthread_mutex_unlock(&ctx->session_mutex);
         return -1;
     }
-    g_identity_ready = true;
-    session_reset_locked();
-    memcpy(g_session.static_priv, g_identity_priv, 32);
-    memcpy(g_session.static_pub, g_identity_pub, 32);
-    clear_int16_ring(&g_mic_head, &g_mic_size, &g_mic_mutex);
-    clear_int16_ring(&g_spk_head, &g_spk_size, &g_spk_mutex);
-    outgoing_clear();
-    incoming_clear();
-    pthread_mutex_unlock(&g_session_mutex);
+    ctx->identity_ready = true;
+    // Secrets shared under the previous identity mean nothing to its peers now
+    crypto_wipe(ctx->resume_cache, sizeof(ctx->resume_cache));
+    ctx->resume_clock = 0;
+    session_reset_locked(ctx);
+    memcpy(ctx->session.static_priv, ctx->identity_priv, 32);
+    memcpy(ctx->session.static_pub, ctx->identity_pub, 32);
+    nade_ring_request_discard(&ctx->mic_ring);
+    nade_ring_request_discard(&ctx->spk_ring);
+    outgoing_clear(ctx);
+    incoming_clear(ctx);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "AEAD backend: %s", nade_aead_backend());
     return 0;
 }
 
-static int start_session_common(const uint8_t *peer_pubkey, size_t len, nade_role_t role) {
-    pthread_mutex_lock(&g_session_mutex);
-    if (!g_identity_ready) {
-        pthread_mutex_unlock(&g_session_mutex);
+static int start_session_common(nade_ctx_t *ctx, const uint8_t *peer_pubkey, size_t len, nade_role_t role) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    bool ready = ctx->identity_ready;
+    pthread_mutex_unlock(&ctx->session_mutex);
+    // Buffers for this session's mode, before it can take any audio
+    if (!ready || !arena_refit(ctx, true)) {
         return -1;
     }
-    session_reset_locked();
-    g_session.active = true;
-    g_session.role = role;
+    pthread_mutex_lock(&ctx->session_mutex);
+    session_reset_locked(ctx);
+    atomic_store_explicit(&ctx->link_mtu, ctx->config.link_mtu, memory_order_relaxed);
+    ctx->session.active = true;
+    atomic_store_explicit(&ctx->session_active, true, memory_order_release);
+    ctx->session.role = role;
     if (peer_pubkey && len == 32 && !is_all_zero(peer_pubkey, 32)) {
-        memcpy(g_session.expected_peer_static, peer_pubkey, 32);
-        g_session.expect_peer_static = true;
+        memcpy(ctx->session.expected_peer_static, peer_pubkey, 32);
+        ctx->session.expect_peer_static = true;
     } else {
-        g_session.expect_peer_static = false;
-    }
-    ensure_ephemeral_locked();
-    g_session.handshake_ready = true;
-    g_session.last_handshake_ms = 0;
-    g_session.last_keepalive_ms = now_monotonic_ms();
-    g_session.outbound_encrypted = g_config.encrypt;
-    g_session.inbound_encrypted = g_config.decrypt;
-    pthread_mutex_unlock(&g_session_mutex);
+        ctx->session.expect_peer_static = false;
+    }
+    ensure_ephemeral_locked(ctx);
+    ctx->session.handshake_ready = true;
+    ctx->session.last_handshake_ms = 0;
+    ctx->session.started_ms = ctx_now_ms(ctx);
+    ctx->session.last_keepalive_ms = ctx->session.started_ms;
+    ctx->session.outbound_encrypted = ctx->config.encrypt;
+    ctx->session.inbound_encrypted = ctx->config.decrypt;
+    NADE_TRACE(NADE_EV_SESSION_START, role, ctx->session.expect_peer_static);
+    capture_session_locked(ctx, role == NADE_ROLE_SERVER ? NADE_CAPTURE_ROLE_SERVER : NADE_CAPTURE_ROLE_CLIENT,
+                           ctx->session.expect_peer_static);
+    offer_resumption_locked(ctx);
+    pthread_mutex_unlock(&ctx->session_mutex);
     return 0;
 }
 
-int nade_start_session_server(const uint8_t *peer_pubkey, size_t len) {
-    return start_session_common(peer_pubkey, len, NADE_ROLE_SERVER);
+int nade_ctx_start_session_server(nade_ctx_t *ctx, const uint8_t *peer_pubkey, size_t len) {
+    return start_session_common(ctx, peer_pubkey, len, NADE_ROLE_SERVER);
 }
 
-int nade_start_session_client(const uint8_t *peer_pubkey, size_t len) {
-    return start_session_common(peer_pubkey, len, NADE_ROLE_CLIENT);
+int nade_ctx_start_session_client(nade_ctx_t *ctx, const uint8_t *peer_pubkey, size_t len) {
+    return start_session_common(ctx, peer_pubkey, len, NADE_ROLE_CLIENT);
 }
 
-int nade_stop_session(void) {
-    pthread_mutex_lock(&g_session_mutex);
-    session_reset_locked();
-    pthread_mutex_unlock(&g_session_mutex);
-    clear_int16_ring(&g_mic_head, &g_mic_size, &g_mic_mutex);
-    clear_int16_ring(&g_spk_head, &g_spk_size, &g_spk_mutex);
-    outgoing_clear();
-    incoming_clear();
+int nade_ctx_stop_session(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    NADE_TRACE(NADE_EV_SESSION_STOP, ctx->session.role, ctx->session.handshake_complete);
+    capture_session_locked(ctx, NADE_CAPTURE_ROLE_STOP, false);
+    session_reset_locked(ctx);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    // Dropping the buffers drops whatever the rings still held
+    arena_refit(ctx, false);
+    // Let blocked loops notice the session is gone
+    signal_outgoing(ctx);
+    signal_speaker(ctx);
     return 0;
 }
 
-int nade_feed_mic_frame(const int16_t *pcm, size_t samples) {
+int nade_ctx_prepare_ephemerals(nade_ctx_t *ctx) {
+    int added = 0;
+    for (;;) {
+        pthread_mutex_lock(&ctx->eph_pool_mutex);
+        bool full = ctx->eph_pool_count >= EPHEMERAL_POOL_SIZE;
+        pthread_mutex_unlock(&ctx->eph_pool_mutex);
+        if (full) {
+            return added;
+        }
+        // Generated without holding the pool lock, so a session starting
+        // meanwhile is not held up
+        ephemeral_key_t key;
+        if (!generate_ephemeral(&key)) {
+            return added > 0 ? added : -1;
+        }
+        pthread_mutex_lock(&ctx->eph_pool_mutex);
+        if (ctx->eph_pool_count < EPHEMERAL_POOL_SIZE) {
+            ctx->eph_pool[ctx->eph_pool_count++] = key;
+            added++;
+        }
+        pthread_mutex_unlock(&ctx->eph_pool_mutex);
+        crypto_wipe(&key, sizeof(key));
+    }
+}
+
+// Convert mic audio to the transmit codec rate into the mic ring and wake
+// the transmit thread. Takes no lock, so the audio callback may call it.
+static int feed_mic(nade_ctx_t *ctx, const int16_t *pcm, size_t samples, bool capture) {
     if (!pcm || samples == 0) {
         return -1;
     }
-    pthread_mutex_lock(&g_session_mutex);
-    bool active = g_session.active;
-    pthread_mutex_unlock(&g_session_mutex);
-    if (!active) {
+    if (!atomic_load_explicit(&ctx->session_active, memory_order_acquire)) {
+        return -1;
+    }
+    if (!arena_enter(ctx)) {
         return -1;
     }
-    push_int16_ring(g_mic_ring, MIC_CAPACITY, &g_mic_head, &g_mic_size, pcm, samples, &g_mic_mutex);
+    if (capture) {
+        capture_pcm(ctx, NADE_CAPTURE_MIC, pcm, samples);
+    } else {
+        capture_tap_mic(ctx, pcm, samples);
+    }
+    int device_rate = atomic_load_explicit(&ctx->device_rate, memory_order_relaxed);
+    int codec_rate = atomic_load_explicit(&ctx->tx_audio_rate, memory_order_acquire);
+    if (device_rate == codec_rate) {
+        nade_ring_push(&ctx->mic_ring, pcm, samples);
+    } else {
+        if (!nade_resampler_matches(&ctx->mic_resampler, device_rate, codec_rate)) {
+            nade_resampler_init(&ctx->mic_resampler, device_rate, codec_rate);
+        }
+        while (samples > 0) {
+            size_t take = min_size(samples, NADE_RESAMPLE_CHUNK);
+            size_t produced = nade_resampler_process(&ctx->mic_resampler, pcm, take, ctx->mic_resampled);
+            nade_ring_push(&ctx->mic_ring, ctx->mic_resampled, produced);
+            pcm += take;
+            samples -= take;
+        }
+    }
+    arena_exit(ctx);
+    signal_outgoing(ctx);
     return 0;
 }
 
-size_t nade_generate_outgoing_frame(uint8_t *buffer, size_t max_len) {
+int nade_ctx_feed_mic(nade_ctx_t *ctx, const int16_t *pcm, size_t samples) {
+    return feed_mic(ctx, pcm, samples, true);
+}
+
+int nade_ctx_push_mic(nade_ctx_t *ctx, const int16_t *pcm, size_t samples) {
+    return feed_mic(ctx, pcm, samples, false);
+}
+
+static void prepare_outgoing(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    build_outgoing_locked(ctx);
+    pthread_mutex_unlock(&ctx->session_mutex);
+}
+
+size_t nade_ctx_generate_outgoing(nade_ctx_t *ctx, uint8_t *buffer, size_t max_len) {
     if (!buffer || max_len == 0) {
         return 0;
     }
-    pthread_mutex_lock(&g_session_mutex);
-    build_outgoing_locked();
-    pthread_mutex_unlock(&g_session_mutex);
-    return outgoing_pop(buffer, max_len);
+    prepare_outgoing(ctx);
+    return outgoing_pop(ctx, buffer, max_len);
+}
+
+// Copy raw transport bytes, stream bytes or one datagram, into the input
+// ring without parsing them, captured as the given kind. Returns -1 if none
+// of it was taken, or if the datagram was damaged, after queueing the whole
+// frames ahead of the damage.
+static int accept_incoming(nade_ctx_t *ctx, const uint8_t *data, size_t len, uint8_t capture_kind,
+                           bool datagram) {
+    if (!data || len == 0) {
+        return -1;
+    }
+    if (!atomic_load_explicit(&ctx->session_active, memory_order_acquire)) {
+        return -1;
+    }
+    capture_frames(ctx, capture_kind, data, len, datagram);
+    if (datagram) {
+        return incoming_push_datagram(ctx, data, len) ? 0 : -1;
+    }
+    incoming_push(ctx, data, len);
+    return 0;
+}
+
+static void process_incoming(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    process_incoming_locked(ctx);
+    pthread_mutex_unlock(&ctx->session_mutex);
+}
+
+int nade_ctx_handle_incoming(nade_ctx_t *ctx, const uint8_t *data, size_t len) {
+    if (!data || len == 0 || !atomic_load_explicit(&ctx->session_active, memory_order_acquire)) {
+        return -1;
+    }
+    // A damaged datagram still delivers the frames ahead of the damage
+    int rc = accept_incoming(ctx, data, len, NADE_CAPTURE_TRANSPORT_IN, datagram_mtu(ctx) > 0);
+    process_incoming(ctx);
+    return rc;
+}
+
+// Queue one played-out jitter buffer frame for the speaker, converted to
+// the device rate
+static void speaker_push_locked(nade_ctx_t *ctx, const int16_t *frame, size_t count, int device_rate) {
+    int rate = ctx->jitter.sample_rate;
+    if (rate == device_rate) {
+        nade_ring_push(&ctx->spk_ring, frame, count);
+        return;
+    }
+    if (!nade_resampler_matches(&ctx->spk_resampler, rate, device_rate)) {
+        nade_resampler_init(&ctx->spk_resampler, rate, device_rate);
+    }
+    size_t produced = nade_resampler_process(&ctx->spk_resampler, frame, count, ctx->spk_resampled);
+    nade_ring_push(&ctx->spk_ring, ctx->spk_resampled, produced);
+}
+
+// Play out whole jitter buffer frames (concealed or time-scaled) until
+// min_samples are ready in the speaker ring; the remainder stays for the
+// next pull. Speaker thread only, inside the arena. Returns the samples ready.
+static size_t speaker_fill(nade_ctx_t *ctx, size_t min_samples) {
+    int16_t frame[NADE_JITTER_MAX_OUTPUT];
+    int device_rate = atomic_load_explicit(&ctx->device_rate, memory_order_relaxed);
+    pthread_mutex_lock(&ctx->jitter_mutex);
+    while (nade_ring_size(&ctx->spk_ring) < min_samples &&
+           nade_ring_free(&ctx->spk_ring) >= SPK_FRAME_MAX) {
+        uint64_t rebuffers = ctx->jitter.stats.rebuffers;
+        size_t produced = nade_jitter_pull(&ctx->jitter, frame);
+        if (ctx->jitter.stats.rebuffers != rebuffers) {
+            NADE_TRACE(NADE_EV_JITTER_REBUFFER, ctx->jitter.stats.rebuffers, ctx->jitter.target);
+        }
+        if (produced == 0) {
+            break;
+        }
+        speaker_push_locked(ctx, frame, produced, device_rate);
+    }
+    pthread_mutex_unlock(&ctx->jitter_mutex);
+    return nade_ring_size(&ctx->spk_ring);
+}
+
+int nade_ctx_pull_speaker(nade_ctx_t *ctx, int16_t *out_buf, size_t max_samples) {
+    if (!out_buf || max_samples == 0) {
+        return 0;
+    }
+    capture_speaker(ctx, max_samples);
+    if (!arena_enter(ctx)) {
+        return 0;
+    }
+    speaker_fill(ctx, max_samples);
+    int popped = (int)nade_ring_pop(&ctx->spk_ring, out_buf, max_samples);
+    arena_exit(ctx);
+    return popped;
+}
+
+int nade_ctx_pop_speaker(nade_ctx_t *ctx, int16_t *out_buf, size_t max_samples) {
+    if (!out_buf || max_samples == 0) {
+        return 0;
+    }
+    if (!arena_enter(ctx)) {
+        return 0;
+    }
+    int popped = (int)nade_ring_pop(&ctx->spk_ring, out_buf, max_samples);
+    arena_exit(ctx);
+    return popped;
 }
 
-int nade_handle_incoming_frame(const uint8_t *data, size_t len) {
-    if (!data || len == 0) {
-        return -1;
-    }
-    pthread_mutex_lock(&g_session_mutex);
-    bool active = g_session.active;
-    pthread_mutex_unlock(&g_session_mutex);
-    if (!active) {
-        return -1;
+int nade_ctx_wait_outgoing(nade_ctx_t *ctx, int timeout_ms) {
+    uint64_t deadline = now_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    while (true) {
+        uint32_t seen = atomic_load_explicit(&ctx->out_events, memory_order_acquire);
+        pthread_mutex_lock(&ctx->session_mutex);
+        build_outgoing_locked(ctx);
+        uint64_t timer = next_timer_deadline_locked(ctx);
+        pthread_mutex_unlock(&ctx->session_mutex);
+        if (nade_ring_size(&ctx->out_ring) > 0) {
+            return 1;
+        }
+        if (now_monotonic_ms() >= deadline) {
+            return 0;
+        }
+        // Sleep until new work, the caller's timeout or the next session timer
+        bool signalled = wait_event_until(ctx, &ctx->out_events, &ctx->out_cond, seen,
+                                          timer < deadline ? timer : deadline);
+        if (signalled && !atomic_load_explicit(&ctx->session_active, memory_order_acquire)) {
+            return 0;
+        }
     }
-    incoming_push(data, len);
-    pthread_mutex_lock(&g_session_mutex);
-    process_incoming_locked();
-    pthread_mutex_unlock(&g_session_mutex);
-    return 0;
 }
 
-int nade_pull_speaker_frame(int16_t *out_buf, size_t max_samples) {
-    if (!out_buf || max_samples == 0) {
-        return 0;
+int nade_ctx_wait_speaker(nade_ctx_t *ctx, size_t min_samples, int timeout_ms) {
+    uint64_t deadline = now_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    min_samples = min_samples == 0 ? 1 : min_samples;
+    while (true) {
+        uint32_t seen = atomic_load_explicit(&ctx->spk_events, memory_order_acquire);
+        session_arena_t *arena = arena_enter(ctx);
+        if (arena) {
+            // No more than the ring can be filled to
+            size_t capacity = arena->layout.spk_capacity;
+            size_t want = min_size(min_samples, capacity > SPK_FRAME_MAX ? capacity - SPK_FRAME_MAX : 0);
+            bool ready = speaker_fill(ctx, want) >= want;
+            arena_exit(ctx);
+            if (ready) {
+                return 1;
+            }
+        }
+        if (now_monotonic_ms() >= deadline) {
+            return 0;
+        }
+        bool signalled = wait_event_until(ctx, &ctx->spk_events, &ctx->spk_cond, seen, deadline);
+        if (signalled && !atomic_load_explicit(&ctx->session_active, memory_order_acquire)) {
+            return 0;
+        }
     }
-    return (int)pop_int16_ring(g_spk_ring, SPK_CAPACITY, &g_spk_head, &g_spk_size,
-                               out_buf, max_samples, &g_spk_mutex);
 }
 
-int nade_send_hangup_signal(void) {
-    pthread_mutex_lock(&g_session_mutex);
-    bool can_signal = g_session.active;
-    __android_log_print(ANDROID_LOG_INFO, TAG,
-                        "Hangup signal requested (active=%d)",
-                        can_signal ? 1 : 0);
+int nade_ctx_send_hangup(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    bool can_signal = ctx->session.active;
     if (can_signal) {
-        queue_hangup_locked();
+        queue_hangup_locked(ctx);
     }
-    pthread_mutex_unlock(&g_session_mutex);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "Hangup signal requested (active=%d)", can_signal ? 1 : 0);
     return can_signal ? 0 : -1;
 }
 
-int nade_consume_remote_hangup(void) {
-    pthread_mutex_lock(&g_session_mutex);
-    bool requested = g_session.remote_hangup_requested;
-    g_session.remote_hangup_requested = false;
-    pthread_mutex_unlock(&g_session_mutex);
+int nade_ctx_consume_remote_hangup(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    bool requested = ctx->session.remote_hangup_requested;
+    ctx->session.remote_hangup_requested = false;
+    pthread_mutex_unlock(&ctx->session_mutex);
     return requested ? 1 : 0;
 }
 
@@ -1647,235 +3499,826 @@ static bool parse_bool_flag(const char *json, const char *key, bool fallback) {
     if (strncmp(ptr, "false", 5) == 0) return false;
     return fallback;
 }
-JNIEXPORT jbyteArray JNICALL
-Java_com_icing_nade_1flutter_NadeCore_nativeDerivePublicKey(JNIEnv *env, jobject thiz, jbyteArray seed_array) {
-    if (!seed_array) {
+
+// Finds a string value; *len receives its length. Escapes are not supported.
+static const char *parse_string_field(const char *json, const char *key, size_t *len) {
+    const char *found = strstr(json, key);
+    if (!found) {
         return NULL;
     }
-    jsize len = (*env)->GetArrayLength(env, seed_array);
-    if (len != 32) {
+    const char *colon = strchr(found, ':');
+    if (!colon) {
         return NULL;
     }
-    uint8_t priv[32];
-    uint8_t pub[32];
-    (*env)->GetByteArrayRegion(env, seed_array, 0, len, (jbyte *)priv);
-    clamp_x25519(priv);
-    if (!derive_public_key(priv, pub)) {
-        memset(priv, 0, sizeof(priv));
-        memset(pub, 0, sizeof(pub));
+    const char *ptr = colon + 1;
+    while (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r') {
+        ++ptr;
+    }
+    if (*ptr != '"') {
         return NULL;
     }
-    jbyteArray out = (*env)->NewByteArray(env, 32);
-    if (!out) {
-        memset(priv, 0, sizeof(priv));
-        memset(pub, 0, sizeof(pub));
+    const char *end = strchr(ptr + 1, '"');
+    if (!end) {
         return NULL;
     }
-    (*env)->SetByteArrayRegion(env, out, 0, 32, (const jbyte *)pub);
-    memset(priv, 0, sizeof(priv));
-    memset(pub, 0, sizeof(pub));
-    return out;
+    *len = (size_t)(end - ptr - 1);
+    return ptr + 1;
 }
 
-int nade_set_config(const char *json) {
+static long parse_int_field(const char *json, const char *key, long fallback) {
+    const char *found = strstr(json, key);
+    if (!found) {
+        return fallback;
+    }
+    const char *colon = strchr(found, ':');
+    if (!colon) {
+        return fallback;
+    }
+    char *end = NULL;
+    long value = strtol(colon + 1, &end, 10);
+    if (end == colon + 1) {
+        return fallback;
+    }
+    return value;
+}
+
+int nade_ctx_set_config(nade_ctx_t *ctx, const char *json) {
     if (!json) {
         return -1;
     }
-    pthread_mutex_lock(&g_session_mutex);
-    g_config.encrypt = parse_bool_flag(json, "\"encrypt\"", g_config.encrypt);
-    g_config.decrypt = parse_bool_flag(json, "\"decrypt\"", g_config.decrypt);
-    g_fsk_enabled = parse_bool_flag(json, "\"fsk_enabled\"", g_fsk_enabled);
-    g_session.outbound_encrypted = g_config.encrypt && g_session.peer_accepts_encrypt;
-    g_session.inbound_encrypted = g_config.decrypt && g_session.peer_sends_encrypt;
-    pthread_mutex_unlock(&g_session_mutex);
-    __android_log_print(ANDROID_LOG_DEBUG, TAG, "Config updated: fsk_enabled=%d", g_fsk_enabled);
+    pthread_mutex_lock(&ctx->session_mutex);
+    capture_bytes(ctx, NADE_CAPTURE_CONFIG, json, strlen(json));
+    bool fsk_enabled = ctx->fsk_enabled;
+    int device_rate = atomic_load_explicit(&ctx->device_rate, memory_order_relaxed);
+    ctx->config.encrypt = parse_bool_flag(json, "\"encrypt\"", ctx->config.encrypt);
+    ctx->config.decrypt = parse_bool_flag(json, "\"decrypt\"", ctx->config.decrypt);
+    ctx->fsk_enabled = parse_bool_flag(json, "\"fsk_enabled\"", ctx->fsk_enabled);
+    ctx->config.resume = parse_bool_flag(json, "\"resume\"", ctx->config.resume);
+    ctx->config.dtx = parse_bool_flag(json, "\"dtx\"", ctx->config.dtx);
+    ctx->config.wideband = parse_bool_flag(json, "\"wideband\"", ctx->config.wideband);
+    bool adaptive_fec = ctx->config.adaptive_fec;
+    ctx->config.adaptive_fec = parse_bool_flag(json, "\"adaptive_fec\"", ctx->config.adaptive_fec);
+    long audio_rate = parse_int_field(json, "\"audio_rate\"", 0);
+    if (audio_rate > 0) {
+        // The device rate must convert to and from both codec rates
+        int rate = (int)min_size((size_t)audio_rate, NADE_RESAMPLE_MAX_RATE);
+        if (nade_resampler_supported(rate, NADE_CODEC_RATE) && nade_resampler_supported(rate, NADE_CODEC_WB_RATE)) {
+            atomic_store_explicit(&ctx->device_rate, rate, memory_order_relaxed);
+        } else {
+            NADE_LOG(ANDROID_LOG_WARN, TAG, "Unsupported audio_rate %ld ignored", audio_rate);
+        }
+    }
+    long profiles = parse_int_field(json, "\"fsk_profiles\"", ctx->config.fsk_profiles);
+    ctx->config.fsk_profiles = (uint8_t)(profiles & NADE_FSK_PROFILE_MASK_ALL);
+    // Takes effect from the next session; both ends must agree on the mode
+    long mtu = parse_int_field(json, "\"link_mtu\"", ctx->config.link_mtu);
+    if (mtu > 0 && mtu < NADE_DGRAM_MIN_MTU) {
+        mtu = NADE_DGRAM_MIN_MTU;
+    }
+    ctx->config.link_mtu = (uint16_t)(mtu < 0 ? 0 : min_size((size_t)mtu, NADE_DGRAM_MAX_MTU));
+    long batch_ms = parse_int_field(json, "\"audio_batch_ms\"", ctx->config.audio_batch_ms);
+    ctx->config.audio_batch_ms = (uint16_t)(batch_ms < 0 ? 0 : min_size((size_t)batch_ms,
+                                         AUDIO_FRAME_MS * (AUDIO_BATCH_MAX_FRAMES - 1)));
+    size_t codec_len = 0;
+    const char *codec = parse_string_field(json, "\"audio_codec\"", &codec_len);
+    if (codec) {
+        // "auto" (or any unknown name) lets the link decide
+        ctx->config.audio_codec = (uint8_t)nade_codec_find(codec, codec_len);
+    }
+    ctx->session.outbound_encrypted = ctx->config.encrypt && ctx->session.peer_accepts_encrypt;
+    ctx->session.inbound_encrypted = ctx->config.decrypt && ctx->session.peer_sends_encrypt;
+    if (adaptive_fec && !ctx->config.adaptive_fec) {
+        link_adaptation_reset_locked(ctx);
+    }
+    if (ctx->session.handshake_complete) {
+        negotiate_fsk_profile_locked(ctx);
+        select_audio_codec_locked(ctx);
+    }
+    // A new mode or device rate mid-call needs buffers of other sizes
+    bool refit = ctx->session.active && (ctx->fsk_enabled != fsk_enabled ||
+                 atomic_load_explicit(&ctx->device_rate, memory_order_relaxed) != device_rate);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    if (refit) {
+        arena_refit(ctx, true);
+    }
+    NADE_LOG(ANDROID_LOG_DEBUG, TAG, "Config updated: fsk_enabled=%d", ctx->fsk_enabled);
     return 0;
 }
 
 // -------------------------------------------------------------------------
 // 4-FSK Public API
 
-int nade_fsk_set_enabled(bool enabled) {
-    pthread_mutex_lock(&g_session_mutex);
-    g_fsk_enabled = enabled;
+int nade_ctx_fsk_set_enabled(nade_ctx_t *ctx, bool enabled) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    ctx->fsk_enabled = enabled;
     if (enabled) {
-        fsk_reset_state();
+        fsk_reset_state(ctx);
+    }
+    if (ctx->session.handshake_complete) {
+        select_audio_codec_locked(ctx);
     }
-    pthread_mutex_unlock(&g_session_mutex);
-    __android_log_print(ANDROID_LOG_INFO, TAG, "4-FSK modulation %s", enabled ? "enabled" : "disabled");
+    capture_settings_locked(ctx);
+    bool refit = ctx->session.active;
+    pthread_mutex_unlock(&ctx->session_mutex);
+    if (refit) {
+        arena_refit(ctx, true);
+    }
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "4-FSK modulation %s", enabled ? "enabled" : "disabled");
     return 0;
 }
 
-bool nade_fsk_is_enabled(void) {
-    pthread_mutex_lock(&g_session_mutex);
-    bool enabled = g_fsk_enabled;
-    pthread_mutex_unlock(&g_session_mutex);
+bool nade_ctx_fsk_is_enabled(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    bool enabled = ctx->fsk_enabled;
+    pthread_mutex_unlock(&ctx->session_mutex);
     return enabled;
 }
 
-// Modulate outgoing frame bytes into PCM audio tones
+int nade_ctx_fsk_set_shaping(nade_ctx_t *ctx, bool shaped) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    atomic_store_explicit(&ctx->fsk_tx_shaped, shaped, memory_order_relaxed);
+    capture_settings_locked(ctx);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    return 0;
+}
+
+// Bursts play back to back: extend the transmit schedule by this one.
+// Only the transmit thread modulates, so load and store need not be atomic
+// together.
+static void note_tx_airtime(nade_ctx_t *ctx, size_t samples) {
+    uint64_t now = ctx_now_ms(ctx);
+    uint64_t end = atomic_load_explicit(&ctx->tx_airtime_end_ms, memory_order_relaxed);
+    if (end < now) {
+        end = now;
+    }
+    end += (uint64_t)samples * 1000u / NADE_FSK_SAMPLE_RATE;
+    atomic_store_explicit(&ctx->tx_airtime_end_ms, end, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ctx->tx_airtime_samples, samples, memory_order_relaxed);
+}
+
+// Modulate outgoing frame bytes into one burst of PCM audio tones
 // Call after nade_generate_outgoing_frame to convert bytes to audio
-size_t nade_fsk_modulate(const uint8_t *data, size_t len, int16_t *pcm_out, size_t max_samples) {
+size_t nade_ctx_fsk_modulate(nade_ctx_t *ctx, const uint8_t *data, size_t len,
+                             int16_t *pcm_out, size_t max_samples) {
     if (!data || len == 0 || !pcm_out || max_samples == 0) {
         return 0;
     }
-    if (!g_fsk_enabled) {
+    if (!ctx->fsk_enabled) {
         return 0;  // FSK disabled, use raw bytes instead
     }
-    return fsk_modulate_buffer(data, len, pcm_out, max_samples);
+    fsk_tx_apply_reset(ctx);
+    int profile = atomic_load_explicit(&ctx->fsk_tx_profile, memory_order_acquire);
+    // Send as much as fits rather than nothing
+    len = min_size(len, nade_fsk_burst_capacity(profile, max_samples));
+    if (len == 0) {
+        return 0;
+    }
+    uint64_t start = nade_metrics_now_ns();
+    size_t samples = nade_fsk_modulate_burst(&ctx->fsk_mod, profile, data, len, pcm_out, max_samples);
+    record_stage(ctx, NADE_STAGE_FSK_MOD, start);
+    note_tx_airtime(ctx, samples);
+    // The bytes were captured on their way out of generate_outgoing
+    capture_pcm(ctx, NADE_CAPTURE_LINE_OUT, pcm_out, samples);
+    return samples;
 }
 
 // Demodulate incoming PCM audio into bytes
 // Call with received audio samples, then call nade_fsk_pull_demodulated to get bytes
-int nade_fsk_feed_audio(const int16_t *pcm, size_t samples) {
+int nade_ctx_fsk_feed_audio(nade_ctx_t *ctx, const int16_t *pcm, size_t samples) {
     if (!pcm || samples == 0) {
         return -1;
     }
-    if (!g_fsk_enabled) {
+    if (!ctx->fsk_enabled) {
         return -1;  // FSK disabled
     }
-    fsk_demodulate_samples(pcm, samples);
+    capture_pcm(ctx, NADE_CAPTURE_FSK_IN, pcm, samples);
+    fsk_rx_apply_reset(ctx);
+    fsk_demodulate_samples(ctx, pcm, samples);
     return 0;
 }
 
 // Pull demodulated bytes after feeding audio
-size_t nade_fsk_pull_demodulated(uint8_t *out, size_t max_len) {
+size_t nade_ctx_fsk_pull_demodulated(nade_ctx_t *ctx, uint8_t *out, size_t max_len) {
     if (!out || max_len == 0) {
         return 0;
     }
-    return fsk_demod_pull(out, max_len);
+    return fsk_demod_pull(ctx, out, max_len);
 }
 
-// Get estimated samples needed to modulate given number of bytes
-size_t nade_fsk_samples_for_bytes(size_t byte_count) {
-    // 4 symbols per byte, FSK_SAMPLES_PER_SYMBOL samples per symbol
-    return byte_count * 4 * FSK_SAMPLES_PER_SYMBOL;
+// Get samples needed to modulate given number of bytes as one burst
+size_t nade_ctx_fsk_samples_for_bytes(nade_ctx_t *ctx, size_t byte_count) {
+    return nade_fsk_burst_samples(atomic_load_explicit(&ctx->fsk_tx_profile, memory_order_acquire),
+                                  byte_count);
 }
 
 // -------------------------------------------------------------------------
 // Reed-Solomon Error Correction Implementation
 // -------------------------------------------------------------------------
 
+static void rs_init_once(void) {
+    rs_init();
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "Reed-Solomon initialized (RS(255,223), t=16)");
+}
+
 static void ensure_rs_initialized(void) {
-    if (!g_rs_initialized) {
-        rs_init();
-        g_rs_initialized = true;
-        __android_log_print(ANDROID_LOG_INFO, TAG, "Reed-Solomon initialized (RS(255,223), t=16)");
-    }
+    pthread_once(&g_rs_init_once, rs_init_once);
 }
 
-int nade_rs_set_enabled(bool enabled) {
+int nade_ctx_rs_set_enabled(nade_ctx_t *ctx, bool enabled) {
     ensure_rs_initialized();
-    pthread_mutex_lock(&g_session_mutex);
-    g_rs_enabled = enabled;
+    pthread_mutex_lock(&ctx->session_mutex);
+    ctx->rs_enabled = enabled;
     // Reset statistics when RS is toggled
-    g_rs_encode_count = 0;
-    g_rs_decode_count = 0;
-    g_rs_errors_corrected = 0;
-    g_rs_uncorrectable = 0;
-    g_rs_clean_frames = 0;
-    pthread_mutex_unlock(&g_session_mutex);
-    __android_log_print(ANDROID_LOG_INFO, TAG, 
-                        "╔══════════════════════════════════════════════════════════╗");
-    __android_log_print(ANDROID_LOG_INFO, TAG, 
-                        "║  Reed-Solomon FEC: %s                              ║",
-                        enabled ? "ENABLED " : "DISABLED");
-    __android_log_print(ANDROID_LOG_INFO, TAG, 
-                        "║  RS(255,223) - Can correct up to 16 byte errors/block   ║");
-    __android_log_print(ANDROID_LOG_INFO, TAG, 
-                        "╚══════════════════════════════════════════════════════════╝");
+    ctx->rs_encode_count = 0;
+    ctx->rs_decode_count = 0;
+    ctx->rs_errors_corrected = 0;
+    ctx->rs_uncorrectable = 0;
+    ctx->rs_clean_frames = 0;
+    link_adaptation_reset_locked(ctx);
+    atomic_store_explicit(&ctx->fsk_rx_reset_pending, true, memory_order_release);
+    capture_settings_locked(ctx);
+    pthread_mutex_unlock(&ctx->session_mutex);
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "Reed-Solomon FEC %s", enabled ? "enabled" : "disabled");
     return 0;
 }
 
-bool nade_rs_is_enabled(void) {
-    pthread_mutex_lock(&g_session_mutex);
-    bool enabled = g_rs_enabled;
-    pthread_mutex_unlock(&g_session_mutex);
+bool nade_ctx_rs_is_enabled(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->session_mutex);
+    bool enabled = ctx->rs_enabled;
+    pthread_mutex_unlock(&ctx->session_mutex);
     return enabled;
 }
 
 size_t nade_rs_encode(const uint8_t *data, size_t len, uint8_t *out, size_t max_out) {
+    // Standalone use is counted against the default context
+    nade_ctx_t *ctx = nade_ctx_default();
     ensure_rs_initialized();
     if (!data || len == 0 || !out) {
         return 0;
     }
     if (len > RS_DATA_SIZE) {
-        __android_log_print(ANDROID_LOG_WARN, TAG, 
-                           "RS encode: data too large (%zu > %d), truncating", len, RS_DATA_SIZE);
+        NADE_LOG(ANDROID_LOG_WARN, TAG, "RS encode: data too large (%zu > %d), truncating",
+                 len, RS_DATA_SIZE);
         len = RS_DATA_SIZE;
     }
     size_t needed = rs_encoded_len(len);
     if (max_out < needed) {
-        __android_log_print(ANDROID_LOG_WARN, TAG,
-                           "RS encode: output buffer too small (%zu < %zu)", max_out, needed);
+        NADE_LOG(ANDROID_LOG_WARN, TAG, "RS encode: output buffer too small (%zu < %zu)",
+                 max_out, needed);
         return 0;
     }
     size_t result = rs_encode(data, len, out);
     if (result > 0) {
-        g_rs_encode_count++;
-        // Log every 50 frames or first 5
-        if (g_rs_encode_count <= 5 || g_rs_encode_count % 50 == 0) {
-            __android_log_print(ANDROID_LOG_INFO, TAG, 
-                "🛡️ RS ENCODE #%llu: %zu data bytes + 32 parity = %zu bytes",
-                (unsigned long long)g_rs_encode_count, len, result);
-        }
+        ctx->rs_encode_count++;
+        NADE_TRACE(NADE_EV_RS_ENCODE, len, result);
     }
     return result;
 }
 
-int nade_rs_decode(uint8_t *codeword, size_t len) {
-    ensure_rs_initialized();
-    if (!codeword || len <= RS_PARITY_SIZE) {
-        return -1;
-    }
-    int errors = rs_decode(codeword, len);
-    g_rs_decode_count++;
-    
-    if (errors > 0) {
-        g_rs_errors_corrected += errors;
-        __android_log_print(ANDROID_LOG_INFO, TAG, 
-            "🔧 RS DECODE #%llu: CORRECTED %d errors! (total corrected: %llu)",
-            (unsigned long long)g_rs_decode_count, errors, 
-            (unsigned long long)g_rs_errors_corrected);
-    } else if (errors < 0) {
-        g_rs_uncorrectable++;
-        __android_log_print(ANDROID_LOG_WARN, TAG, 
-            "❌ RS DECODE #%llu: UNCORRECTABLE (too many errors, >16 bytes)",
-            (unsigned long long)g_rs_decode_count);
-    } else {
-        g_rs_clean_frames++;
-        // Log clean frames less frequently
-        if (g_rs_clean_frames <= 3 || g_rs_clean_frames % 100 == 0) {
-            __android_log_print(ANDROID_LOG_DEBUG, TAG, 
-                "✓ RS DECODE #%llu: Clean frame (no errors) - %llu clean total",
-                (unsigned long long)g_rs_decode_count,
-                (unsigned long long)g_rs_clean_frames);
-        }
-    }
-    
-    // Print summary every 100 decodes
-    if (g_rs_decode_count % 100 == 0) {
-        __android_log_print(ANDROID_LOG_INFO, TAG, 
-            "📊 RS STATS: %llu decoded | %llu clean | %llu errors fixed | %llu uncorrectable",
-            (unsigned long long)g_rs_decode_count,
-            (unsigned long long)g_rs_clean_frames,
-            (unsigned long long)g_rs_errors_corrected,
-            (unsigned long long)g_rs_uncorrectable);
-    }
-    
-    return errors;
+int nade_rs_decode(uint8_t *codeword, size_t len) {
+    // Standalone use is counted against the default context
+    nade_ctx_t *ctx = nade_ctx_default();
+    ensure_rs_initialized();
+    if (!codeword || len <= RS_PARITY_SIZE) {
+        return -1;
+    }
+    int errors = rs_decode(codeword, len);
+    ctx->rs_decode_count++;
+    if (errors > 0) {
+        ctx->rs_errors_corrected += errors;
+    } else if (errors < 0) {
+        ctx->rs_uncorrectable++;
+    } else {
+        ctx->rs_clean_frames++;
+    }
+    NADE_TRACE(NADE_EV_RS_DECODE, errors, len);
+    return errors;
+}
+
+size_t nade_rs_encoded_len(size_t data_len) {
+    return rs_encoded_len(data_len);
+}
+
+size_t nade_rs_data_len(size_t encoded_len) {
+    return rs_data_len(encoded_len);
+}
+
+// -------------------------------------------------------------------------
+// Audio-channel pipeline
+// Frame -> multi-block RS (nade_fec) -> 4-FSK -> little-endian PCM in one native pass,
+// and the reverse for received audio, so the Kotlin loops make a single JNI
+// crossing per direction and never touch intermediate buffers.
+
+static void pcm_to_le_bytes(const int16_t *pcm, size_t samples, uint8_t *out) {
+    for (size_t i = 0; i < samples; ++i) {
+        uint16_t v = (uint16_t)pcm[i];
+        out[i * 2] = (uint8_t)(v & 0xFF);
+        out[i * 2 + 1] = (uint8_t)(v >> 8);
+    }
+}
+
+static size_t le_bytes_to_pcm(const uint8_t *in, size_t len, int16_t *pcm) {
+    size_t samples = len / 2;
+    for (size_t i = 0; i < samples; ++i) {
+        pcm[i] = (int16_t)(uint16_t)(in[i * 2] | (in[i * 2 + 1] << 8));
+    }
+    return samples;
+}
+
+// Build the next transmit burst into arena->tx_pcm, from inside the arena.
+// Returns samples produced.
+static size_t pipeline_tx_modulate(nade_ctx_t *ctx, session_arena_t *arena, size_t max_samples) {
+    if (!nade_ctx_fsk_is_enabled(ctx) || !arena->layout.fsk) {
+        return 0;
+    }
+    bool rs = nade_ctx_rs_is_enabled(ctx);
+    size_t sample_budget = min_size(max_samples, PIPELINE_TX_MAX_SAMPLES);
+    int profile = atomic_load_explicit(&ctx->fsk_tx_profile, memory_order_acquire);
+    size_t coded_budget = nade_fsk_burst_capacity(profile, sample_budget);
+    size_t frame_budget = coded_budget;
+    size_t parity = 0;
+    if (rs) {
+        ensure_rs_initialized();
+        parity = (size_t)atomic_load_explicit(&ctx->fec_tx_parity, memory_order_acquire);
+        frame_budget = nade_fec_max_payload(coded_budget, parity);
+    }
+    if (frame_budget == 0) {
+        return 0;
+    }
+    prepare_outgoing(ctx);
+    // Bursts behind the FEC framer are datagrams; without it the demodulated
+    // bytes carry no boundaries and the frames go as a stream
+    bool datagram = rs && datagram_mtu(ctx) > 0;
+    size_t produced = datagram ? outgoing_take_datagram(ctx, arena->tx_frame, frame_budget) :
+                      outgoing_take(ctx, arena->tx_frame, frame_budget);
+    if (produced == 0) {
+        return 0;
+    }
+    capture_frames(ctx, NADE_CAPTURE_MOD_OUT, arena->tx_frame, produced, datagram);
+    const uint8_t *payload = arena->tx_frame;
+    size_t payload_len = produced;
+    if (rs) {
+        uint64_t start = nade_metrics_now_ns();
+        size_t encoded = nade_fec_encode(arena->tx_frame, produced, parity,
+                                         arena->tx_coded, PIPELINE_MAX_CODED_BYTES);
+        record_stage(ctx, NADE_STAGE_FEC_ENCODE, start);
+        if (encoded > 0) {
+            ctx->rs_encode_count += nade_fec_block_count(produced, parity);
+            payload = arena->tx_coded;
+            payload_len = encoded;
+        }
+    }
+    fsk_tx_apply_reset(ctx);
+    uint64_t start = nade_metrics_now_ns();
+    size_t samples = nade_fsk_modulate_burst(&ctx->fsk_mod, profile, payload, payload_len,
+                                             arena->tx_pcm, sample_budget);
+    record_stage(ctx, NADE_STAGE_FSK_MOD, start);
+    note_tx_airtime(ctx, samples);
+    capture_pcm(ctx, NADE_CAPTURE_LINE_OUT, arena->tx_pcm, samples);
+    return samples;
+}
+
+// Unpack little-endian PCM bytes into arena->rx_pcm, carrying an odd
+// trailing byte over to the next call. Returns samples unpacked.
+static size_t pipeline_rx_unpack(nade_ctx_t *ctx, session_arena_t *arena, const uint8_t *in, size_t len) {
+    capture_bytes(ctx, NADE_CAPTURE_LINE_IN, in, len);
+    fsk_rx_apply_reset(ctx);
+    size_t samples = 0;
+    if (ctx->pipe_rx_has_carry && len > 0) {
+        arena->rx_pcm[samples++] = (int16_t)(uint16_t)(ctx->pipe_rx_carry | (in[0] << 8));
+        ctx->pipe_rx_has_carry = false;
+        in++;
+        len--;
+    }
+    size_t room = PIPELINE_RX_CHUNK_SAMPLES - samples;
+    size_t whole = min_size(len / 2, room);
+    samples += le_bytes_to_pcm(in, whole * 2, arena->rx_pcm + samples);
+    if (len == whole * 2 + 1) {
+        ctx->pipe_rx_carry = in[len - 1];
+        ctx->pipe_rx_has_carry = true;
+    }
+    return samples;
+}
+
+// Run demodulated bytes through the FEC decoder, delivering each completed
+// payload to the parser. Returns the number of frame bytes delivered; a
+// payload the parser refused sets *rejected and decoding carries on past it.
+static int pipeline_rx_fec(nade_ctx_t *ctx, session_arena_t *arena, size_t demodulated, bool *rejected) {
+    if (demodulated == 0) {
+        return 0;
+    }
+    ensure_rs_initialized();
+    nade_fec_stats_t stats = {0};
+    int delivered = 0;
+    size_t offset = 0;
+    while (offset < demodulated) {
+        size_t consumed = 0;
+        uint64_t start = nade_metrics_now_ns();
+        size_t payload = nade_fec_decoder_push(&ctx->pipe_rx_fec, arena->rx_bytes + offset,
+                                               arena->rx_reliability + offset,
+                                               demodulated - offset, &consumed,
+                                               arena->rx_payload, &stats);
+        record_stage(ctx, NADE_STAGE_FEC_DECODE, start);
+        offset += consumed;
+        if (payload == 0) {
+            continue;
+        }
+        if (accept_incoming(ctx, arena->rx_payload, payload, NADE_CAPTURE_DEMOD_IN, datagram_mtu(ctx) > 0) != 0) {
+            *rejected = true;
+            continue;
+        }
+        delivered += (int)payload;
+    }
+    ctx->rs_decode_count += stats.blocks;
+    ctx->rs_clean_frames += stats.clean_blocks;
+    ctx->rs_errors_corrected += stats.errors_corrected;
+    ctx->rs_uncorrectable += stats.uncorrectable;
+    if (stats.uncorrectable > 0) {
+        NADE_TRACE(NADE_EV_FEC_UNCORRECTABLE, stats.uncorrectable, stats.blocks);
+    }
+    if (stats.blocks > 0) {
+        // For the next report to the peer
+        pthread_mutex_lock(&ctx->session_mutex);
+        if (ctx->session.handshake_complete && link_reports_on_locked(ctx)) {
+            nade_link_report_add(&ctx->session.link_rx, &stats);
+        }
+        pthread_mutex_unlock(&ctx->session_mutex);
+    }
+    return delivered;
+}
+
+// Demodulate unpacked samples and hand the recovered frames to the parser.
+// Returns the number of frame bytes delivered. Frames the parser refused set
+// *rejected; the rest of the samples are demodulated all the same, so the
+// modem stays in step with the line.
+static int pipeline_rx_process(nade_ctx_t *ctx, session_arena_t *arena, size_t samples, bool *rejected) {
+    bool rs = nade_ctx_rs_is_enabled(ctx);
+    int delivered = 0;
+    size_t offset = 0;
+    while (offset < samples) {
+        size_t consumed = 0;
+        uint64_t start = nade_metrics_now_ns();
+        size_t demodulated = nade_fsk_demodulate(&ctx->fsk_demod, arena->rx_pcm + offset,
+                                                 samples - offset, &consumed,
+                                                 arena->rx_bytes, arena->rx_reliability,
+                                                 PIPELINE_RX_MAX_BYTES);
+        record_stage(ctx, NADE_STAGE_FSK_DEMOD, start);
+        offset += consumed;
+        if (rs) {
+            delivered += pipeline_rx_fec(ctx, arena, demodulated, rejected);
+        } else if (demodulated > 0) {
+            if (accept_incoming(ctx, arena->rx_bytes, demodulated, NADE_CAPTURE_DEMOD_IN, false) == 0) {
+                delivered += (int)demodulated;
+            } else {
+                *rejected = true;
+            }
+        }
+        // A new burst starts: drop any FEC frame the previous one left unfinished
+        if (ctx->fsk_demod.epoch != ctx->pipe_rx_epoch) {
+            ctx->pipe_rx_epoch = ctx->fsk_demod.epoch;
+            nade_fec_decoder_reset(&ctx->pipe_rx_fec);
+        }
+    }
+    // A rejected datagram may have queued the frames ahead of its damage
+    if (delivered > 0 || *rejected) {
+        process_incoming(ctx);
+    }
+    return delivered;
+}
+
+size_t nade_pipeline_tx_max_bytes(void) {
+    return PIPELINE_TX_MAX_SAMPLES * sizeof(int16_t);
+}
+
+size_t nade_ctx_pipeline_tx_pcm(nade_ctx_t *ctx, uint8_t *out_le_bytes, size_t max) {
+    if (!out_le_bytes || max < 2) {
+        return 0;
+    }
+    session_arena_t *arena = arena_enter(ctx);
+    if (!arena) {
+        return 0;
+    }
+    size_t samples = pipeline_tx_modulate(ctx, arena, max / 2);
+    pcm_to_le_bytes(arena->tx_pcm, samples, out_le_bytes);
+    arena_exit(ctx);
+    return samples * 2;
+}
+
+int nade_ctx_pipeline_rx_pcm(nade_ctx_t *ctx, const uint8_t *in_le_bytes, size_t len) {
+    if (!in_le_bytes || len == 0) {
+        return -1;
+    }
+    if (!nade_ctx_fsk_is_enabled(ctx)) {
+        return -1;
+    }
+    session_arena_t *arena = arena_enter(ctx);
+    if (!arena) {
+        return -1;
+    }
+    int delivered = -1;
+    if (arena->layout.fsk) {
+        delivered = 0;
+        bool rejected = false;
+        size_t offset = 0;
+        while (offset < len) {
+            size_t chunk = min_size(len - offset, PIPELINE_RX_CHUNK_SAMPLES * 2 - 1);
+            size_t samples = pipeline_rx_unpack(ctx, arena, in_le_bytes + offset, chunk);
+            offset += chunk;
+            delivered += pipeline_rx_process(ctx, arena, samples, &rejected);
+        }
+        if (rejected) {
+            delivered = -1;
+        }
+    }
+    arena_exit(ctx);
+    return delivered;
+}
+
+// -------------------------------------------------------------------------
+// Metrics
+
+static nade_ring_t *metrics_ring(nade_ctx_t *ctx, size_t id) {
+    nade_ring_t *rings[NADE_METRICS_RING_COUNT] = {
+        [NADE_METRICS_RING_MIC] = &ctx->mic_ring,
+        [NADE_METRICS_RING_SPK] = &ctx->spk_ring,
+        [NADE_METRICS_RING_OUT] = &ctx->out_ring,
+        [NADE_METRICS_RING_IN] = &ctx->in_ring,
+        [NADE_METRICS_RING_FSK_DEMOD] = &ctx->fsk_demod_ring,
+    };
+    return rings[id];
+}
+
+void nade_ctx_get_metrics(nade_ctx_t *ctx, nade_metrics_t *out) {
+    if (!out) {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+    out->version = NADE_METRICS_VERSION;
+    pthread_mutex_lock(&ctx->jitter_mutex);
+    for (size_t i = 0; i < NADE_METRICS_RING_COUNT; i++) {
+        nade_ring_stats_t now;
+        nade_ring_get_stats(metrics_ring(ctx, i), &now);
+        // Free-running counters: the size_t difference survives wrap-around
+        out->rings[i].pushed = now.pushed - ctx->ring_base[i].pushed;
+        out->rings[i].popped = now.popped - ctx->ring_base[i].popped;
+        out->rings[i].dropped = now.dropped - ctx->ring_base[i].dropped;
+        out->rings[i].high_water = now.high_water;
+    }
+    nade_jitter_stats_t jitter = ctx->jitter_retired;
+    jitter_stats_accumulate(&jitter, &ctx->jitter.stats, &ctx->jitter_base);
+    pthread_mutex_unlock(&ctx->jitter_mutex);
+    out->frames_played = jitter.frames_played;
+    out->frames_concealed = jitter.frames_concealed;
+    out->late_dropped = jitter.late_dropped;
+    out->duplicates = jitter.duplicates;
+    out->rebuffers = jitter.rebuffers;
+    out->expanded = jitter.expanded;
+    out->compressed = jitter.compressed;
+    out->decrypt_failures = atomic_load_explicit(&ctx->decrypt_failures, memory_order_relaxed);
+    out->handshakes = atomic_load_explicit(&ctx->handshakes, memory_order_relaxed);
+    out->handshake_last_ms = atomic_load_explicit(&ctx->handshake_last_ms, memory_order_relaxed);
+    out->handshake_max_ms = atomic_load_explicit(&ctx->handshake_max_ms, memory_order_relaxed);
+    for (size_t i = 0; i < NADE_STAGE_COUNT; i++) {
+        nade_histogram_snapshot(&ctx->stage_hist[i], &out->stages[i]);
+    }
+    nade_histogram_snapshot(&ctx->tx_frame_hist, &out->tx_frame_bytes);
+    nade_histogram_snapshot(&ctx->rx_frame_hist, &out->rx_frame_bytes);
+}
+
+void nade_ctx_reset_metrics(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->jitter_mutex);
+    for (size_t i = 0; i < NADE_METRICS_RING_COUNT; i++) {
+        nade_ring_get_stats(metrics_ring(ctx, i), &ctx->ring_base[i]);
+        nade_ring_reset_high_water(metrics_ring(ctx, i));
+    }
+    memset(&ctx->jitter_retired, 0, sizeof(ctx->jitter_retired));
+    ctx->jitter_base = ctx->jitter.stats;
+    pthread_mutex_unlock(&ctx->jitter_mutex);
+    atomic_store_explicit(&ctx->decrypt_failures, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->handshakes, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->handshake_last_ms, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->handshake_max_ms, 0, memory_order_relaxed);
+    for (size_t i = 0; i < NADE_STAGE_COUNT; i++) {
+        nade_histogram_reset(&ctx->stage_hist[i]);
+    }
+    nade_histogram_reset(&ctx->tx_frame_hist);
+    nade_histogram_reset(&ctx->rx_frame_hist);
+}
+
+// -------------------------------------------------------------------------
+// Capture
+
+int nade_ctx_capture_start(nade_ctx_t *ctx, const char *path, size_t max_bytes, bool line_audio) {
+    void *mem = NULL;
+    // The mic tap keeps its indices on separate cache lines
+    if (posix_memalign(&mem, _Alignof(session_capture_t), sizeof(session_capture_t)) != 0) {
+        return -1;
+    }
+    session_capture_t *cap = (session_capture_t *)mem;
+    // Touches the tap's pages too, so the audio callback never faults them in
+    memset(cap, 0, sizeof(*cap));
+    cap->line_audio = line_audio;
+    nade_ring_init(&cap->mic_tap, cap->mic_tap_storage, CAPTURE_MIC_TAP_SAMPLES, sizeof(int16_t));
+    if (!nade_capture_open(&cap->file, path, max_bytes)) {
+        NADE_LOG(ANDROID_LOG_WARN, TAG, "Cannot open capture %s", path ? path : "(null)");
+        free(cap);
+        return -1;
+    }
+    pthread_mutex_lock(&ctx->capture_mutex);
+    if (atomic_load(&ctx->capture)) {
+        pthread_mutex_unlock(&ctx->capture_mutex);
+        nade_capture_close(&cap->file);
+        free(cap);
+        return -1;
+    }
+    pthread_mutex_lock(&ctx->session_mutex);
+    cap->start_ms = ctx_now_ms(ctx);
+    atomic_store(&ctx->capture, cap);
+    // Where the context stands, so a replay needs nothing from before
+    capture_config_locked(ctx);
+    capture_settings_locked(ctx);
+    if (ctx->session.active) {
+        capture_session_locked(ctx, ctx->session.role == NADE_ROLE_SERVER ? NADE_CAPTURE_ROLE_SERVER :
+                                    NADE_CAPTURE_ROLE_CLIENT, ctx->session.expect_peer_static);
+    }
+    pthread_mutex_unlock(&ctx->session_mutex);
+    pthread_mutex_unlock(&ctx->capture_mutex);
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "Capturing to %s%s", path, line_audio ? " with line audio" : "");
+    return 0;
+}
+
+int nade_ctx_capture_stop(nade_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->capture_mutex);
+    session_capture_t *cap = atomic_exchange(&ctx->capture, NULL);
+    if (!cap) {
+        pthread_mutex_unlock(&ctx->capture_mutex);
+        return -1;
+    }
+    // Records already claimed are still being filled
+    while (atomic_load(&ctx->capture_users) != 0) {
+        sched_yield();
+    }
+    uint32_t dropped = atomic_load_explicit(&cap->file.dropped, memory_order_relaxed);
+    size_t kept = nade_capture_close(&cap->file);
+    free(cap);
+    pthread_mutex_unlock(&ctx->capture_mutex);
+    NADE_LOG(ANDROID_LOG_INFO, TAG, "Capture closed: %zu bytes, %u records dropped", kept, dropped);
+    return 0;
+}
+
+// -------------------------------------------------------------------------
+// Default-context API
+
+int nade_init(const uint8_t *seed32) {
+    return nade_ctx_init(nade_ctx_default(), seed32);
+}
+
+int nade_start_session_server(const uint8_t *peer_pubkey, size_t len) {
+    return nade_ctx_start_session_server(nade_ctx_default(), peer_pubkey, len);
+}
+
+int nade_start_session_client(const uint8_t *peer_pubkey, size_t len) {
+    return nade_ctx_start_session_client(nade_ctx_default(), peer_pubkey, len);
+}
+
+int nade_stop_session(void) {
+    return nade_ctx_stop_session(nade_ctx_default());
+}
+
+int nade_prepare_ephemerals(void) {
+    return nade_ctx_prepare_ephemerals(nade_ctx_default());
+}
+
+int nade_feed_mic_frame(const int16_t *pcm, size_t samples) {
+    return nade_ctx_feed_mic(nade_ctx_default(), pcm, samples);
+}
+
+size_t nade_generate_outgoing_frame(uint8_t *buffer, size_t max_len) {
+    return nade_ctx_generate_outgoing(nade_ctx_default(), buffer, max_len);
+}
+
+int nade_handle_incoming_frame(const uint8_t *data, size_t len) {
+    return nade_ctx_handle_incoming(nade_ctx_default(), data, len);
+}
+
+int nade_pull_speaker_frame(int16_t *out_buf, size_t max_samples) {
+    return nade_ctx_pull_speaker(nade_ctx_default(), out_buf, max_samples);
+}
+
+int nade_wait_outgoing(int timeout_ms) {
+    return nade_ctx_wait_outgoing(nade_ctx_default(), timeout_ms);
+}
+
+int nade_wait_speaker(size_t min_samples, int timeout_ms) {
+    return nade_ctx_wait_speaker(nade_ctx_default(), min_samples, timeout_ms);
+}
+
+int nade_set_config(const char *json) {
+    return nade_ctx_set_config(nade_ctx_default(), json);
+}
+
+int nade_send_hangup_signal(void) {
+    return nade_ctx_send_hangup(nade_ctx_default());
+}
+
+int nade_consume_remote_hangup(void) {
+    return nade_ctx_consume_remote_hangup(nade_ctx_default());
+}
+
+int nade_fsk_set_enabled(bool enabled) {
+    return nade_ctx_fsk_set_enabled(nade_ctx_default(), enabled);
+}
+
+bool nade_fsk_is_enabled(void) {
+    return nade_ctx_fsk_is_enabled(nade_ctx_default());
+}
+
+int nade_fsk_set_shaping(bool shaped) {
+    return nade_ctx_fsk_set_shaping(nade_ctx_default(), shaped);
+}
+
+size_t nade_fsk_modulate(const uint8_t *data, size_t len, int16_t *pcm_out, size_t max_samples) {
+    return nade_ctx_fsk_modulate(nade_ctx_default(), data, len, pcm_out, max_samples);
+}
+
+int nade_fsk_feed_audio(const int16_t *pcm, size_t samples) {
+    return nade_ctx_fsk_feed_audio(nade_ctx_default(), pcm, samples);
+}
+
+size_t nade_fsk_pull_demodulated(uint8_t *out, size_t max_len) {
+    return nade_ctx_fsk_pull_demodulated(nade_ctx_default(), out, max_len);
+}
+
+size_t nade_fsk_samples_for_bytes(size_t byte_count) {
+    return nade_ctx_fsk_samples_for_bytes(nade_ctx_default(), byte_count);
 }
 
-size_t nade_rs_encoded_len(size_t data_len) {
-    return rs_encoded_len(data_len);
+int nade_rs_set_enabled(bool enabled) {
+    return nade_ctx_rs_set_enabled(nade_ctx_default(), enabled);
 }
 
-size_t nade_rs_data_len(size_t encoded_len) {
-    return rs_data_len(encoded_len);
+bool nade_rs_is_enabled(void) {
+    return nade_ctx_rs_is_enabled(nade_ctx_default());
+}
+
+size_t nade_pipeline_tx_pcm(uint8_t *out_le_bytes, size_t max) {
+    return nade_ctx_pipeline_tx_pcm(nade_ctx_default(), out_le_bytes, max);
+}
+
+int nade_pipeline_rx_pcm(const uint8_t *in_le_bytes, size_t len) {
+    return nade_ctx_pipeline_rx_pcm(nade_ctx_default(), in_le_bytes, len);
+}
+
+void nade_get_metrics(nade_metrics_t *out) {
+    nade_ctx_get_metrics(nade_ctx_default(), out);
+}
+
+void nade_reset_metrics(void) {
+    nade_ctx_reset_metrics(nade_ctx_default());
+}
+
+int nade_capture_start(const char *path, size_t max_bytes, bool line_audio) {
+    return nade_ctx_capture_start(nade_ctx_default(), path, max_bytes, line_audio);
+}
+
+int nade_capture_stop(void) {
+    return nade_ctx_capture_stop(nade_ctx_default());
 }
 
+#if NADE_WITH_JNI
+
 // JNI bridge helpers -------------------------------------------------------
 
+JNIEXPORT jbyteArray JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeDerivePublicKey(JNIEnv *env, jobject thiz, jbyteArray seed_array) {
+    if (!seed_array) {
+        return NULL;
+    }
+    jsize len = (*env)->GetArrayLength(env, seed_array);
+    if (len != 32) {
+        return NULL;
+    }
+    uint8_t priv[32];
+    uint8_t pub[32];
+    (*env)->GetByteArrayRegion(env, seed_array, 0, len, (jbyte *)priv);
+    clamp_x25519(priv);
+    if (!derive_public_key(priv, pub)) {
+        memset(priv, 0, sizeof(priv));
+        memset(pub, 0, sizeof(pub));
+        return NULL;
+    }
+    jbyteArray out = (*env)->NewByteArray(env, 32);
+    if (!out) {
+        memset(priv, 0, sizeof(priv));
+        memset(pub, 0, sizeof(pub));
+        return NULL;
+    }
+    (*env)->SetByteArrayRegion(env, out, 0, 32, (const jbyte *)pub);
+    memset(priv, 0, sizeof(priv));
+    memset(pub, 0, sizeof(pub));
+    return out;
+}
+
 JNIEXPORT jint JNICALL
 Java_com_icing_nade_1flutter_NadeCore_nativeInit(JNIEnv *env, jobject thiz, jbyteArray seed) {
     (void)thiz;
@@ -1921,6 +4364,13 @@ Java_com_icing_nade_1flutter_NadeCore_nativeStopSession(JNIEnv *env, jobject thi
     return nade_stop_session();
 }
 
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativePrepareEphemerals(JNIEnv *env, jobject thiz) {
+    (void)env;
+    (void)thiz;
+    return nade_prepare_ephemerals();
+}
+
 JNIEXPORT jint JNICALL
 Java_com_icing_nade_1flutter_NadeCore_nativeFeedMicFrame(JNIEnv *env, jobject thiz,
                                                          jshortArray samples, jint sample_count) {
@@ -1951,12 +4401,26 @@ JNIEXPORT jint JNICALL
 Java_com_icing_nade_1flutter_NadeCore_nativeHandleIncoming(JNIEnv *env, jobject thiz,
                                                            jbyteArray data, jint length) {
     (void)thiz;
+    nade_ctx_t *ctx = nade_ctx_default();
     if (data == NULL) {
         return -1;
     }
-    jbyte *ptr = (*env)->GetByteArrayElements(env, data, NULL);
-    int rc = nade_handle_incoming_frame((const uint8_t *)ptr, (size_t)length);
-    (*env)->ReleaseByteArrayElements(env, data, ptr, JNI_ABORT);
+    if (length <= 0 || length > (*env)->GetArrayLength(env, data)) {
+        return -1;
+    }
+    if (!atomic_load_explicit(&ctx->session_active, memory_order_acquire)) {
+        return -1;
+    }
+    // Pin the array only for the ring copy; parsing and decryption run after release
+    void *ptr = (*env)->GetPrimitiveArrayCritical(env, data, NULL);
+    if (ptr == NULL) {
+        return -1;
+    }
+    int rc = accept_incoming(ctx, (const uint8_t *)ptr, (size_t)length, NADE_CAPTURE_TRANSPORT_IN,
+                             datagram_mtu(ctx) > 0);
+    (*env)->ReleasePrimitiveArrayCritical(env, data, ptr, JNI_ABORT);
+    // A damaged datagram still delivers the frames ahead of the damage
+    process_incoming(ctx);
     return rc;
 }
 
@@ -1964,15 +4428,42 @@ JNIEXPORT jint JNICALL
 Java_com_icing_nade_1flutter_NadeCore_nativeGenerateOutgoing(JNIEnv *env, jobject thiz,
                                                              jbyteArray buffer, jint max_len) {
     (void)thiz;
+    nade_ctx_t *ctx = nade_ctx_default();
     if (buffer == NULL) {
         return 0;
     }
-    jbyte *ptr = (*env)->GetByteArrayElements(env, buffer, NULL);
-    size_t produced = nade_generate_outgoing_frame((uint8_t *)ptr, (size_t)max_len);
-    (*env)->ReleaseByteArrayElements(env, buffer, ptr, 0);
+    if (max_len <= 0 || max_len > (*env)->GetArrayLength(env, buffer)) {
+        return 0;
+    }
+    // Frame building happens unpinned; the array is pinned only for the ring copy
+    prepare_outgoing(ctx);
+    void *ptr = (*env)->GetPrimitiveArrayCritical(env, buffer, NULL);
+    if (ptr == NULL) {
+        return 0;
+    }
+    size_t produced = outgoing_pop(ctx, (uint8_t *)ptr, (size_t)max_len);
+    (*env)->ReleasePrimitiveArrayCritical(env, buffer, ptr, 0);
     return (jint)produced;
 }
 
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeWaitOutgoing(JNIEnv *env, jobject thiz, jint timeout_ms) {
+    (void)env;
+    (void)thiz;
+    return nade_wait_outgoing((int)timeout_ms);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeWaitSpeaker(JNIEnv *env, jobject thiz,
+                                                        jint min_samples, jint timeout_ms) {
+    (void)env;
+    (void)thiz;
+    if (min_samples <= 0) {
+        return 0;
+    }
+    return nade_wait_speaker((size_t)min_samples, (int)timeout_ms);
+}
+
 JNIEXPORT jint JNICALL
 Java_com_icing_nade_1flutter_NadeCore_nativeSendHangupSignal(JNIEnv *env, jobject thiz) {
     (void)env;
@@ -1999,6 +4490,155 @@ Java_com_icing_nade_1flutter_NadeCore_nativeSetConfig(JNIEnv *env, jobject thiz,
     return rc;
 }
 
+// Direct ByteBuffer bridges ------------------------------------------------
+// These take java.nio direct buffers so ART never copies the payload; the
+// Kotlin side keeps one preallocated buffer per real-time loop.
+
+// Resolve a direct buffer to its native address if it holds at least `needed` bytes
+static void *direct_buffer_ptr(JNIEnv *env, jobject buffer, size_t needed) {
+    if (buffer == NULL) {
+        return NULL;
+    }
+    void *ptr = (*env)->GetDirectBufferAddress(env, buffer);
+    jlong capacity = (*env)->GetDirectBufferCapacity(env, buffer);
+    if (ptr == NULL || capacity < 0 || (size_t)capacity < needed) {
+        return NULL;
+    }
+    return ptr;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeFeedMicFrameDirect(JNIEnv *env, jobject thiz,
+                                                               jobject samples, jint sample_count) {
+    (void)thiz;
+    if (sample_count <= 0) {
+        return -1;
+    }
+    void *ptr = direct_buffer_ptr(env, samples, (size_t)sample_count * sizeof(int16_t));
+    if (ptr == NULL) {
+        return -1;
+    }
+    return nade_feed_mic_frame((const int16_t *)ptr, (size_t)sample_count);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativePullSpeakerFrameDirect(JNIEnv *env, jobject thiz,
+                                                                   jobject buffer, jint max_samples) {
+    (void)thiz;
+    if (max_samples <= 0) {
+        return 0;
+    }
+    void *ptr = direct_buffer_ptr(env, buffer, (size_t)max_samples * sizeof(int16_t));
+    if (ptr == NULL) {
+        return 0;
+    }
+    return nade_pull_speaker_frame((int16_t *)ptr, (size_t)max_samples);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeHandleIncomingDirect(JNIEnv *env, jobject thiz,
+                                                                 jobject data, jint length) {
+    (void)thiz;
+    if (length <= 0) {
+        return -1;
+    }
+    void *ptr = direct_buffer_ptr(env, data, (size_t)length);
+    if (ptr == NULL) {
+        return -1;
+    }
+    return nade_handle_incoming_frame((const uint8_t *)ptr, (size_t)length);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeGenerateOutgoingDirect(JNIEnv *env, jobject thiz,
+                                                                   jobject buffer, jint max_len) {
+    (void)thiz;
+    if (max_len <= 0) {
+        return 0;
+    }
+    void *ptr = direct_buffer_ptr(env, buffer, (size_t)max_len);
+    if (ptr == NULL) {
+        return 0;
+    }
+    return (jint)nade_generate_outgoing_frame((uint8_t *)ptr, (size_t)max_len);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeFskModulateDirect(JNIEnv *env, jobject thiz,
+                                                              jobject data, jint data_len,
+                                                              jobject pcm_out, jint max_samples) {
+    (void)thiz;
+    if (data_len <= 0 || max_samples <= 0) {
+        return 0;
+    }
+    void *data_ptr = direct_buffer_ptr(env, data, (size_t)data_len);
+    void *pcm_ptr = direct_buffer_ptr(env, pcm_out, (size_t)max_samples * sizeof(int16_t));
+    if (data_ptr == NULL || pcm_ptr == NULL) {
+        return 0;
+    }
+    return (jint)nade_fsk_modulate((const uint8_t *)data_ptr, (size_t)data_len,
+                                   (int16_t *)pcm_ptr, (size_t)max_samples);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeFskFeedAudioDirect(JNIEnv *env, jobject thiz,
+                                                               jobject pcm, jint samples) {
+    (void)thiz;
+    if (samples <= 0) {
+        return -1;
+    }
+    void *ptr = direct_buffer_ptr(env, pcm, (size_t)samples * sizeof(int16_t));
+    if (ptr == NULL) {
+        return -1;
+    }
+    return nade_fsk_feed_audio((const int16_t *)ptr, (size_t)samples);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeFskPullDemodulatedDirect(JNIEnv *env, jobject thiz,
+                                                                     jobject out, jint max_len) {
+    (void)thiz;
+    if (max_len <= 0) {
+        return 0;
+    }
+    void *ptr = direct_buffer_ptr(env, out, (size_t)max_len);
+    if (ptr == NULL) {
+        return 0;
+    }
+    return (jint)nade_fsk_pull_demodulated((uint8_t *)ptr, (size_t)max_len);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeRsEncodeDirect(JNIEnv *env, jobject thiz,
+                                                           jobject data, jint data_len,
+                                                           jobject out, jint max_out) {
+    (void)thiz;
+    if (data_len <= 0 || max_out <= 0) {
+        return 0;
+    }
+    void *data_ptr = direct_buffer_ptr(env, data, (size_t)data_len);
+    void *out_ptr = direct_buffer_ptr(env, out, (size_t)max_out);
+    if (data_ptr == NULL || out_ptr == NULL) {
+        return 0;
+    }
+    return (jint)nade_rs_encode((const uint8_t *)data_ptr, (size_t)data_len,
+                                (uint8_t *)out_ptr, (size_t)max_out);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeRsDecodeDirect(JNIEnv *env, jobject thiz,
+                                                           jobject codeword, jint len) {
+    (void)thiz;
+    if (len <= 0) {
+        return -1;
+    }
+    void *ptr = direct_buffer_ptr(env, codeword, (size_t)len);
+    if (ptr == NULL) {
+        return -1;
+    }
+    return nade_rs_decode((uint8_t *)ptr, (size_t)len);
+}
+
 // -------------------------------------------------------------------------
 // 4-FSK JNI Bridge
 
@@ -2074,13 +4714,14 @@ Java_com_icing_nade_1flutter_NadeCore_nativeFskSamplesForBytes(JNIEnv *env, jobj
 JNIEXPORT jstring JNICALL
 Java_com_icing_nade_1flutter_NadeCore_nativeRsGetStats(JNIEnv *env, jobject thiz) {
     (void)thiz;
+    nade_ctx_t *ctx = nade_ctx_default();
     char buf[256];
     snprintf(buf, sizeof(buf), "%llu,%llu,%llu,%llu,%llu",
-             (unsigned long long)g_rs_encode_count,
-             (unsigned long long)g_rs_decode_count,
-             (unsigned long long)g_rs_clean_frames,
-             (unsigned long long)g_rs_errors_corrected,
-             (unsigned long long)g_rs_uncorrectable);
+             (unsigned long long)ctx->rs_encode_count,
+             (unsigned long long)ctx->rs_decode_count,
+             (unsigned long long)ctx->rs_clean_frames,
+             (unsigned long long)ctx->rs_errors_corrected,
+             (unsigned long long)ctx->rs_uncorrectable);
     return (*env)->NewStringUTF(env, buf);
 }
 
@@ -2143,3 +4784,191 @@ Java_com_icing_nade_1flutter_NadeCore_nativeRsDataLen(JNIEnv *env, jobject thiz,
     (void)thiz;
     return (jint)nade_rs_data_len((size_t)encoded_len);
 }
+
+// Audio-channel pipeline JNI bridges ---------------------------------------
+// The stream arrays are pinned only for the final PCM pack/unpack; framing,
+// FEC and (de)modulation run on native scratch buffers outside the pin.
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativePipelineTxMaxBytes(JNIEnv *env, jobject thiz) {
+    (void)env;
+    (void)thiz;
+    return (jint)nade_pipeline_tx_max_bytes();
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativePipelineTxPcm(JNIEnv *env, jobject thiz,
+                                                          jbyteArray out, jint max_bytes) {
+    (void)thiz;
+    nade_ctx_t *ctx = nade_ctx_default();
+    if (out == NULL || max_bytes < 2 || max_bytes > (*env)->GetArrayLength(env, out)) {
+        return 0;
+    }
+    session_arena_t *arena = arena_enter(ctx);
+    if (!arena) {
+        return 0;
+    }
+    size_t samples = pipeline_tx_modulate(ctx, arena, (size_t)max_bytes / 2);
+    void *ptr = samples > 0 ? (*env)->GetPrimitiveArrayCritical(env, out, NULL) : NULL;
+    if (ptr == NULL) {
+        arena_exit(ctx);
+        return 0;
+    }
+    pcm_to_le_bytes(arena->tx_pcm, samples, (uint8_t *)ptr);
+    (*env)->ReleasePrimitiveArrayCritical(env, out, ptr, 0);
+    arena_exit(ctx);
+    return (jint)(samples * 2);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativePipelineRxPcm(JNIEnv *env, jobject thiz,
+                                                          jbyteArray data, jint length) {
+    (void)thiz;
+    nade_ctx_t *ctx = nade_ctx_default();
+    if (data == NULL || length <= 0 || length > (*env)->GetArrayLength(env, data)) {
+        return -1;
+    }
+    if (!nade_ctx_fsk_is_enabled(ctx)) {
+        return -1;
+    }
+    session_arena_t *arena = arena_enter(ctx);
+    if (!arena) {
+        return -1;
+    }
+    if (!arena->layout.fsk) {
+        arena_exit(ctx);
+        return -1;
+    }
+    int delivered = 0;
+    bool rejected = false;
+    size_t offset = 0;
+    while (offset < (size_t)length) {
+        size_t chunk = min_size((size_t)length - offset, PIPELINE_RX_CHUNK_SAMPLES * 2 - 1);
+        void *ptr = (*env)->GetPrimitiveArrayCritical(env, data, NULL);
+        if (ptr == NULL) {
+            rejected = true;
+            break;
+        }
+        size_t samples = pipeline_rx_unpack(ctx, arena, (const uint8_t *)ptr + offset, chunk);
+        (*env)->ReleasePrimitiveArrayCritical(env, data, ptr, JNI_ABORT);
+        offset += chunk;
+        delivered += pipeline_rx_process(ctx, arena, samples, &rejected);
+    }
+    arena_exit(ctx);
+    return rejected ? -1 : delivered;
+}
+
+// Metrics JNI bridge -------------------------------------------------------
+// One call returns the flattened snapshot described in nade_metrics.h.
+
+JNIEXPORT jlongArray JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeGetMetrics(JNIEnv *env, jobject thiz, jboolean reset) {
+    (void)thiz;
+    nade_ctx_t *ctx = nade_ctx_default();
+    nade_metrics_t metrics;
+    nade_ctx_get_metrics(ctx, &metrics);
+    if (reset == JNI_TRUE) {
+        nade_ctx_reset_metrics(ctx);
+    }
+    int64_t flat[NADE_METRICS_FLAT_LEN];
+    size_t count = nade_metrics_flatten(&metrics, flat, NADE_METRICS_FLAT_LEN);
+    jlongArray out = (*env)->NewLongArray(env, (jsize)count);
+    if (!out) {
+        return NULL;
+    }
+    (*env)->SetLongArrayRegion(env, out, 0, (jsize)count, (const jlong *)flat);
+    return out;
+}
+
+// Trace JNI bridge ---------------------------------------------------------
+// Returns the trace as (time_ns, event, arg0, arg1) quadruples, oldest first.
+
+JNIEXPORT jlongArray JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeTraceDump(JNIEnv *env, jobject thiz, jboolean clear) {
+    (void)thiz;
+    nade_trace_record_t *records = malloc(NADE_TRACE_CAPACITY * sizeof(*records));
+    jlong *flat = malloc(NADE_TRACE_CAPACITY * 4 * sizeof(*flat));
+    jlongArray out = NULL;
+    if (records && flat) {
+        size_t count = nade_trace_dump(records, NADE_TRACE_CAPACITY);
+        if (clear == JNI_TRUE) {
+            nade_trace_clear();
+        }
+        for (size_t i = 0; i < count; i++) {
+            flat[i * 4] = (jlong)records[i].time_ns;
+            flat[i * 4 + 1] = (jlong)records[i].event;
+            flat[i * 4 + 2] = (jlong)records[i].arg0;
+            flat[i * 4 + 3] = (jlong)records[i].arg1;
+        }
+        out = (*env)->NewLongArray(env, (jsize)(count * 4));
+        if (out) {
+            (*env)->SetLongArrayRegion(env, out, 0, (jsize)(count * 4), flat);
+        }
+    }
+    free(records);
+    free(flat);
+    return out;
+}
+
+// Native audio JNI bridge --------------------------------------------------
+// Lifecycle of the AAudio engine on the default context. Kotlin calls these
+// from one thread and stops using AudioRecord and AudioTrack while it runs.
+
+static nade_audio_t *g_audio;
+
+// Returns the device rate the streams opened at, for "audio_rate", or -1
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeAudioOpen(JNIEnv *env, jobject thiz, jint preferred_rate) {
+    (void)env;
+    (void)thiz;
+    nade_audio_close(g_audio);
+    g_audio = nade_audio_open(nade_ctx_default(), preferred_rate);
+    if (!g_audio) {
+        return -1;
+    }
+    nade_audio_info_t info;
+    nade_audio_get_info(g_audio, &info);
+    return info.sample_rate;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeAudioStart(JNIEnv *env, jobject thiz) {
+    (void)env;
+    (void)thiz;
+    return g_audio ? nade_audio_start(g_audio) : -1;
+}
+
+JNIEXPORT void JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeAudioClose(JNIEnv *env, jobject thiz) {
+    (void)env;
+    (void)thiz;
+    nade_audio_close(g_audio);
+    g_audio = NULL;
+}
+
+// Capture JNI bridge -------------------------------------------------------
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeCaptureStart(JNIEnv *env, jobject thiz, jstring path,
+                                                         jint max_bytes, jboolean line_audio) {
+    (void)thiz;
+    if (path == NULL || max_bytes <= 0) {
+        return -1;
+    }
+    const char *chars = (*env)->GetStringUTFChars(env, path, NULL);
+    if (!chars) {
+        return -1;
+    }
+    int rc = nade_capture_start(chars, (size_t)max_bytes, line_audio == JNI_TRUE);
+    (*env)->ReleaseStringUTFChars(env, path, chars);
+    return rc;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_icing_nade_1flutter_NadeCore_nativeCaptureStop(JNIEnv *env, jobject thiz) {
+    (void)env;
+    (void)thiz;
+    return nade_capture_stop();
+}
+
+#endif // NADE_WITH_JNI
@@ -0,0 +1,99 @@
+/*
+ * Datagram segmentation implementation
+ *
+ * Headers are eight bytes, so the CRC runs bitwise; a table would cost
+ * more cache than it saves at a few segments per datagram.
+ */
+
+#include "nade_datagram.h"
+
+#include <string.h>
+
+// CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF
+static uint16_t crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t nade_dgram_write_segment(uint8_t *dst, uint8_t seq, uint8_t index, uint8_t count,
+                                const uint8_t *payload, size_t len) {
+    dst[0] = NADE_DGRAM_SYNC;
+    dst[1] = seq;
+    dst[2] = index;
+    dst[3] = count;
+    dst[4] = (uint8_t)(len & 0xFF);
+    dst[5] = (uint8_t)((len >> 8) & 0xFF);
+    uint16_t crc = crc16(dst, 6);
+    dst[6] = (uint8_t)(crc & 0xFF);
+    dst[7] = (uint8_t)(crc >> 8);
+    if (len > 0 && dst + NADE_DGRAM_HEADER_LEN != payload) {
+        memmove(dst + NADE_DGRAM_HEADER_LEN, payload, len);
+    }
+    return NADE_DGRAM_HEADER_LEN + len;
+}
+
+size_t nade_dgram_fragment_count(size_t len, size_t fragment_len) {
+    return fragment_len > 0 ? (len + fragment_len - 1) / fragment_len : 0;
+}
+
+bool nade_dgram_next_segment(const uint8_t *datagram, size_t len, size_t *offset, nade_dgram_segment_t *seg) {
+    if (*offset > len || len - *offset < NADE_DGRAM_HEADER_LEN) {
+        return false;
+    }
+    const uint8_t *header = datagram + *offset;
+    size_t payload_len = (size_t)(header[4] | (header[5] << 8));
+    uint16_t crc = (uint16_t)(header[6] | (header[7] << 8));
+    if (header[0] != NADE_DGRAM_SYNC || crc16(header, 6) != crc || header[3] == 0 || header[2] >= header[3] ||
+        payload_len > len - *offset - NADE_DGRAM_HEADER_LEN) {
+        return false;
+    }
+    seg->seq = header[1];
+    seg->index = header[2];
+    seg->count = header[3];
+    seg->payload = header + NADE_DGRAM_HEADER_LEN;
+    seg->len = payload_len;
+    *offset += NADE_DGRAM_HEADER_LEN + payload_len;
+    return true;
+}
+
+void nade_dgram_reassembly_reset(nade_dgram_reassembly_t *r) {
+    r->len = 0;
+    r->next = 0;
+    r->count = 0;
+    r->active = false;
+}
+
+const uint8_t *nade_dgram_reassemble(nade_dgram_reassembly_t *r, const nade_dgram_segment_t *seg,
+                                     size_t *frame_len) {
+    if (seg->count == 1) {
+        *frame_len = seg->len;
+        return seg->payload;
+    }
+    if (seg->index == 0) {
+        r->active = true;
+        r->seq = seg->seq;
+        r->count = seg->count;
+        r->next = 0;
+        r->len = 0;
+    }
+    if (!r->active || seg->seq != r->seq || seg->count != r->count || seg->index != r->next ||
+        seg->len > sizeof(r->frame) - r->len) {
+        nade_dgram_reassembly_reset(r);
+        return NULL;
+    }
+    memcpy(r->frame + r->len, seg->payload, seg->len);
+    r->len += seg->len;
+    r->next++;
+    if (r->next < r->count) {
+        return NULL;
+    }
+    r->active = false;
+    *frame_len = r->len;
+    return r->frame;
+}
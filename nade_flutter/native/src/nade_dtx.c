@@ -0,0 +1,155 @@
+/*
+ * Discontinuous transmission implementation
+ *
+ * The detector keeps a floor that drops quickly to quieter frames and
+ * creeps up slowly under louder ones, so it settles on the background
+ * during the pauses in speech and follows a background that gets louder
+ * without mistaking a long sentence for it. Levels are frame energies in
+ * dB relative to full scale.
+ *
+ * Comfort noise is uniform white noise u through y = pole * y + gain * u.
+ * Its variance is gain^2 / 3 / (1 - pole^2), so the gain for a level is
+ * rms * sqrt(3 * (1 - pole^2)).
+ */
+
+#include "nade_dtx.h"
+
+#include <math.h>
+
+#define SILENCE_DB          -127.0f // Level given to an all-zero frame
+#define SPEECH_MIN_DB       -55.0f  // Quieter frames are never speech
+#define SPEECH_MARGIN_DB    9.0f    // Level above the floor that is speech
+#define FRICATIVE_MARGIN_DB 4.0f    // Smaller margin for frames crossing zero at least
+#define FRICATIVE_CROSSINGS 112     // this often per 40 ms frame, 1.4 kHz at any sample rate
+#define FLOOR_FALL          0.3f    // Share of a drop the floor follows per frame
+#define FLOOR_RISE_DB       0.1f    // Floor creep per frame under louder frames
+#define NOISE_SMOOTHING     0.2f
+#define SID_LEVEL_STEP      3       // dB
+#define SID_TILT_STEP       26      // About 0.2 in reflection coefficient
+#define COMFORT_MAX_POLE    0.9f
+
+static float frame_level_db(const int16_t *pcm, size_t count) {
+    float energy = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        energy += (float)pcm[i] * (float)pcm[i];
+    }
+    if (count == 0 || energy <= 0.0f) {
+        return SILENCE_DB;
+    }
+    float level = 10.0f * log10f(energy / (float)count / (32768.0f * 32768.0f));
+    return level > SILENCE_DB ? level : SILENCE_DB;
+}
+
+static size_t zero_crossings(const int16_t *pcm, size_t count) {
+    size_t crossings = 0;
+    for (size_t i = 1; i < count; i++) {
+        crossings += (pcm[i] >= 0) != (pcm[i - 1] >= 0);
+    }
+    return crossings;
+}
+
+// r1 / r0 of the frame: near 1 for low-pass content, near -1 for high-pass
+static float first_reflection(const int16_t *pcm, size_t count) {
+    float r0 = 0.0f;
+    float r1 = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        r0 += (float)pcm[i] * (float)pcm[i];
+        if (i > 0) {
+            r1 += (float)pcm[i] * (float)pcm[i - 1];
+        }
+    }
+    return r0 > 0.0f ? r1 / r0 : 0.0f;
+}
+
+static int abs_int(int x) {
+    return x < 0 ? -x : x;
+}
+
+// -------------------------------------------------------------------------
+// Voice activity detection
+
+void nade_vad_reset(nade_vad_t *vad) {
+    // Start low, so the first words are sent while the floor learns the room
+    vad->floor_db = SPEECH_MIN_DB;
+    vad->noise_db = SILENCE_DB;
+    vad->tilt = 0.0f;
+    vad->hangover = 0;
+    vad->primed = false;
+}
+
+bool nade_vad_frame(nade_vad_t *vad, const int16_t *pcm, size_t count) {
+    float level = frame_level_db(pcm, count);
+    float margin = level - vad->floor_db;
+    bool speech = level > SPEECH_MIN_DB &&
+                  (margin > SPEECH_MARGIN_DB ||
+                   (margin > FRICATIVE_MARGIN_DB && zero_crossings(pcm, count) >= FRICATIVE_CROSSINGS));
+    if (level < vad->floor_db) {
+        vad->floor_db += (level - vad->floor_db) * FLOOR_FALL;
+    } else {
+        vad->floor_db = fminf(level, vad->floor_db + FLOOR_RISE_DB);
+    }
+    if (speech) {
+        vad->hangover = NADE_DTX_HANGOVER_FRAMES;
+        return true;
+    }
+
+    float tilt = first_reflection(pcm, count);
+    if (!vad->primed) {
+        vad->noise_db = level;
+        vad->tilt = tilt;
+        vad->primed = true;
+    } else {
+        vad->noise_db += (level - vad->noise_db) * NOISE_SMOOTHING;
+        vad->tilt += (tilt - vad->tilt) * NOISE_SMOOTHING;
+    }
+    if (vad->hangover > 0) {
+        vad->hangover--;
+        return true;
+    }
+    return false;
+}
+
+void nade_vad_describe(const nade_vad_t *vad, nade_sid_t *sid) {
+    float level = -vad->noise_db;
+    sid->level = (uint8_t)(level < 0.0f ? 0 : level > 127.0f ? 127 : (int)(level + 0.5f));
+    float tilt = vad->tilt * 127.0f;
+    sid->tilt = (int8_t)(tilt > 127.0f ? 127 : tilt < -127.0f ? -127 : (int)lrintf(tilt));
+}
+
+bool nade_sid_changed(const nade_sid_t *a, const nade_sid_t *b) {
+    return abs_int((int)a->level - (int)b->level) >= SID_LEVEL_STEP ||
+           abs_int((int)a->tilt - (int)b->tilt) >= SID_TILT_STEP;
+}
+
+// -------------------------------------------------------------------------
+// Comfort noise
+
+void nade_comfort_reset(nade_comfort_t *cn) {
+    cn->gain = 0.0f;
+    cn->target_gain = 0.0f;
+    cn->pole = 0.0f;
+    cn->state = 0.0f;
+    cn->seed = 0x2545F491u;
+}
+
+void nade_comfort_update(nade_comfort_t *cn, const nade_sid_t *sid) {
+    float pole = (float)sid->tilt / 127.0f;
+    if (pole > COMFORT_MAX_POLE) pole = COMFORT_MAX_POLE;
+    if (pole < -COMFORT_MAX_POLE) pole = -COMFORT_MAX_POLE;
+    float rms = sid->level >= 127 ? 0.0f : 32768.0f * powf(10.0f, -(float)sid->level / 20.0f);
+    cn->pole = pole;
+    cn->target_gain = rms * sqrtf(3.0f * (1.0f - pole * pole));
+}
+
+void nade_comfort_generate(nade_comfort_t *cn, int16_t *out, size_t count) {
+    float step = count > 0 ? (cn->target_gain - cn->gain) / (float)count : 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        cn->seed = cn->seed * 1664525u + 1013904223u;
+        float u = (float)(int32_t)cn->seed * (1.0f / 2147483648.0f);
+        cn->gain += step;
+        cn->state = cn->pole * cn->state + cn->gain * u;
+        float value = cn->state;
+        out[i] = value > 32767.0f ? 32767 : value < -32768.0f ? -32768 : (int16_t)value;
+    }
+    cn->gain = cn->target_gain;
+}
@@ -0,0 +1,333 @@
+/*
+ * Multi-block Reed-Solomon framing implementation
+ *
+ * Blocks are balanced: a payload of L bytes uses N = ceil(L / (255 - P))
+ * blocks, the first L % N of which carry one extra data byte. Codewords are written
+ * column by column (byte j of every block, then byte j+1, ...), so adjacent
+ * on-air bytes always belong to different codewords.
+ *
+ * The erasure pass erases the least reliable bytes first and always leaves
+ * MIN_FREE_PARITY parity bytes unspent, to catch errors among the rest and
+ * to reject a wrong correction. With fewer, every try is a fresh chance to
+ * land on some other codeword, so the 8-parity code never erases.
+ */
+
+#include "nade_fec.h"
+#include <string.h>
+
+#define LEVEL_SHIFT     14      // Of the parity code in the length word
+#define LENGTH_MASK     0x3FFF
+#define TRUSTED         255     // Reliability of bytes pushed without scores
+#define MIN_FREE_PARITY 12      // Parity bytes never spent on erasures
+#define ERASURE_TRIES   8       // Erasures grow by parity / this per try
+
+// Parity bytes per header code; code 0 is what older senders always used
+static const size_t kParityForCode[4] = {32, 8, 16, 64};
+
+static int parity_code(size_t parity) {
+    for (int code = 0; code < 4; code++) {
+        if (kParityForCode[code] == parity) {
+            return code;
+        }
+    }
+    return -1;
+}
+
+// -------------------------------------------------------------------------
+// Header helpers
+
+// CRC-8, polynomial x^8 + x^2 + x + 1
+static uint8_t crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void write_header_copy(uint8_t *out, size_t payload_len, int code) {
+    size_t word = payload_len | ((size_t)code << LEVEL_SHIFT);
+    out[0] = (uint8_t)((word >> 8) & 0xFF);
+    out[1] = (uint8_t)(word & 0xFF);
+    out[2] = crc8(out, 2);
+}
+
+// Returns the payload length of a valid header copy, or 0
+static size_t parse_header_copy(const uint8_t *in, size_t *parity) {
+    if (crc8(in, 2) != in[2]) {
+        return 0;
+    }
+    size_t word = ((size_t)in[0] << 8) | in[1];
+    size_t payload_len = word & LENGTH_MASK;
+    if (payload_len == 0 || payload_len > NADE_FEC_MAX_PAYLOAD) {
+        return 0;
+    }
+    *parity = kParityForCode[word >> LEVEL_SHIFT];
+    return payload_len;
+}
+
+// The second copy is sent inverted so it can never be mistaken for the first
+// copy of a header starting NADE_FEC_HEADER_COPY bytes later.
+static size_t parse_header(const uint8_t *in, size_t *parity) {
+    size_t payload_len = parse_header_copy(in, parity);
+    if (payload_len == 0) {
+        uint8_t second[NADE_FEC_HEADER_COPY];
+        for (size_t i = 0; i < NADE_FEC_HEADER_COPY; i++) {
+            second[i] = (uint8_t)~in[NADE_FEC_HEADER_COPY + i];
+        }
+        payload_len = parse_header_copy(second, parity);
+    }
+    return payload_len;
+}
+
+// -------------------------------------------------------------------------
+// Block geometry
+
+size_t nade_fec_block_count(size_t payload_len, size_t parity) {
+    size_t data_size = RS_BLOCK_SIZE - parity;
+    return (payload_len + data_size - 1) / data_size;
+}
+
+size_t nade_fec_frame_len(size_t payload_len, size_t parity) {
+    if (payload_len == 0 || payload_len > NADE_FEC_MAX_PAYLOAD || !rs_parity_supported(parity)) {
+        return 0;
+    }
+    return NADE_FEC_HEADER_SIZE + payload_len + nade_fec_block_count(payload_len, parity) * parity;
+}
+
+size_t nade_fec_max_payload(size_t frame_budget, size_t parity) {
+    if (!rs_parity_supported(parity)) {
+        return 0;
+    }
+    size_t data_size = RS_BLOCK_SIZE - parity;
+    size_t best = 0;
+    for (size_t blocks = 1; blocks <= NADE_FEC_MAX_BLOCKS; blocks++) {
+        size_t overhead = NADE_FEC_HEADER_SIZE + blocks * parity;
+        if (frame_budget <= overhead) {
+            break;
+        }
+        size_t payload = frame_budget - overhead;
+        if (payload > blocks * data_size) {
+            payload = blocks * data_size;
+        }
+        if (payload > NADE_FEC_MAX_PAYLOAD) {
+            payload = NADE_FEC_MAX_PAYLOAD;
+        }
+        // Only counts if it actually needs this many blocks
+        if (nade_fec_block_count(payload, parity) == blocks && payload > best) {
+            best = payload;
+        }
+    }
+    return best;
+}
+
+static size_t block_data_len(size_t payload_len, size_t blocks, size_t index) {
+    return payload_len / blocks + (index < payload_len % blocks ? 1 : 0);
+}
+
+// -------------------------------------------------------------------------
+// Encoder
+
+size_t nade_fec_encode(const uint8_t *data, size_t len, size_t parity, uint8_t *out, size_t max_out) {
+    size_t frame_len = nade_fec_frame_len(len, parity);
+    if (!data || !out || frame_len == 0 || max_out < frame_len) {
+        return 0;
+    }
+    write_header_copy(out, len, parity_code(parity));
+    for (size_t i = 0; i < NADE_FEC_HEADER_COPY; i++) {
+        out[NADE_FEC_HEADER_COPY + i] = (uint8_t)~out[i];
+    }
+
+    uint8_t blocks[NADE_FEC_MAX_BLOCKS][RS_BLOCK_SIZE];
+    size_t cw_len[NADE_FEC_MAX_BLOCKS] = {0};
+    size_t count = nade_fec_block_count(len, parity);
+    size_t offset = 0;
+    for (size_t b = 0; b < count; b++) {
+        size_t k = block_data_len(len, count, b);
+        cw_len[b] = rs_encode_parity(data + offset, k, parity, blocks[b]);
+        offset += k;
+    }
+
+    // First block is always the longest
+    size_t pos = NADE_FEC_HEADER_SIZE;
+    for (size_t col = 0; col < cw_len[0]; col++) {
+        for (size_t b = 0; b < count; b++) {
+            if (col < cw_len[b]) {
+                out[pos++] = blocks[b][col];
+            }
+        }
+    }
+    return pos;
+}
+
+// -------------------------------------------------------------------------
+// Streaming decoder
+
+void nade_fec_decoder_reset(nade_fec_decoder_t *dec) {
+    dec->fill = 0;
+    dec->frame_len = 0;
+    dec->payload_len = 0;
+    dec->parity = NADE_FEC_DEFAULT_PARITY;
+}
+
+static void slide_one(nade_fec_decoder_t *dec) {
+    memmove(dec->buf, dec->buf + 1, dec->fill - 1);
+    memmove(dec->reliability, dec->reliability + 1, dec->fill - 1);
+    dec->fill--;
+    dec->frame_len = 0;
+}
+
+// Generalized minimum distance decoding of a codeword that errors-only
+// decoding gave up on: erase its least reliable bytes, a few more on every
+// try. Returns the bytes changed, or -1.
+static int decode_with_erasures(uint8_t *codeword, const uint8_t *reliability, size_t len,
+                                size_t parity) {
+    uint8_t erasures[RS_MAX_PARITY];
+    if (parity <= MIN_FREE_PARITY) {
+        return -1;
+    }
+    size_t max_erasures = parity - MIN_FREE_PARITY;
+    size_t count = 0;
+    // Insertion into a list kept sorted by reliability, dropping the most
+    // reliable once it is full
+    for (size_t i = 0; i < len; i++) {
+        uint8_t r = reliability[i];
+        if (r >= NADE_FEC_ERASE_BELOW || (count == max_erasures && r >= reliability[erasures[count - 1]])) {
+            continue;
+        }
+        size_t at = count < max_erasures ? count++ : count - 1;
+        while (at > 0 && reliability[erasures[at - 1]] > r) {
+            erasures[at] = erasures[at - 1];
+            at--;
+        }
+        erasures[at] = (uint8_t)i;
+    }
+    size_t step = parity / ERASURE_TRIES;
+    for (size_t erased = step; erased < count + step; erased += step) {
+        int changed = rs_decode_erasures(codeword, len, parity, erasures, erased < count ? erased : count);
+        if (changed >= 0) {
+            return changed;
+        }
+    }
+    return -1;
+}
+
+// Decode the buffered frame into out. Returns false if every block failed,
+// which means the header was most likely noise.
+static bool decode_frame(nade_fec_decoder_t *dec, uint8_t *out, nade_fec_stats_t *stats) {
+    size_t len = dec->payload_len;
+    size_t parity = dec->parity;
+    size_t count = nade_fec_block_count(len, parity);
+    size_t cw_len[NADE_FEC_MAX_BLOCKS] = {0};
+    for (size_t b = 0; b < count; b++) {
+        cw_len[b] = block_data_len(len, count, b) + parity;
+    }
+
+    size_t pos = NADE_FEC_HEADER_SIZE;
+    for (size_t col = 0; col < cw_len[0]; col++) {
+        for (size_t b = 0; b < count; b++) {
+            if (col < cw_len[b]) {
+                dec->blocks[b][col] = dec->buf[pos];
+                dec->block_reliability[b][col] = dec->reliability[pos];
+                pos++;
+            }
+        }
+    }
+
+    nade_fec_stats_t local = {0};
+    for (size_t b = 0; b < count; b++) {
+        int errors = rs_decode_parity(dec->blocks[b], cw_len[b], parity);
+        if (errors < 0) {
+            errors = decode_with_erasures(dec->blocks[b], dec->block_reliability[b], cw_len[b], parity);
+            local.erasure_blocks += errors >= 0;
+        }
+        local.blocks++;
+        local.coded_bytes += cw_len[b];
+        if (errors < 0) {
+            local.uncorrectable++;
+            local.errors_seen += parity / 2 + 1;
+        } else if (errors == 0) {
+            local.clean_blocks++;
+        } else {
+            local.errors_corrected += (uint64_t)errors;
+            local.errors_seen += (uint64_t)errors;
+        }
+    }
+    if (local.uncorrectable == count) {
+        stats->rejected_headers++;
+        return false;
+    }
+
+    size_t offset = 0;
+    for (size_t b = 0; b < count; b++) {
+        size_t k = cw_len[b] - parity;
+        memcpy(out + offset, dec->blocks[b], k);
+        offset += k;
+    }
+    stats->frames++;
+    stats->blocks += local.blocks;
+    stats->clean_blocks += local.clean_blocks;
+    stats->errors_corrected += local.errors_corrected;
+    stats->uncorrectable += local.uncorrectable;
+    stats->erasure_blocks += local.erasure_blocks;
+    stats->errors_seen += local.errors_seen;
+    stats->coded_bytes += local.coded_bytes;
+    return true;
+}
+
+size_t nade_fec_decoder_push(nade_fec_decoder_t *dec, const uint8_t *in, const uint8_t *reliability,
+                             size_t len, size_t *consumed, uint8_t *out, nade_fec_stats_t *stats) {
+    size_t used = 0;
+    size_t produced = 0;
+    while (true) {
+        // Hunt over whatever is buffered, one byte at a time
+        while (dec->frame_len == 0 && dec->fill >= NADE_FEC_HEADER_SIZE) {
+            size_t parity = 0;
+            size_t payload_len = parse_header(dec->buf, &parity);
+            if (payload_len > 0) {
+                dec->payload_len = payload_len;
+                dec->parity = parity;
+                dec->frame_len = nade_fec_frame_len(payload_len, parity);
+                break;
+            }
+            slide_one(dec);
+            stats->slipped_bytes++;
+        }
+        if (dec->frame_len > 0 && dec->fill >= dec->frame_len) {
+            if (decode_frame(dec, out, stats)) {
+                produced = dec->payload_len;
+                dec->fill -= dec->frame_len;
+                memmove(dec->buf, dec->buf + dec->frame_len, dec->fill);
+                memmove(dec->reliability, dec->reliability + dec->frame_len, dec->fill);
+                dec->frame_len = 0;
+                break;
+            }
+            slide_one(dec);
+            stats->slipped_bytes++;
+            continue;
+        }
+        if (used == len) {
+            break;
+        }
+        size_t target = dec->frame_len > 0 ? dec->frame_len : NADE_FEC_HEADER_SIZE;
+        size_t take = target - dec->fill;
+        if (take > len - used) {
+            take = len - used;
+        }
+        memcpy(dec->buf + dec->fill, in + used, take);
+        if (reliability) {
+            memcpy(dec->reliability + dec->fill, reliability + used, take);
+        } else {
+            memset(dec->reliability + dec->fill, TRUSTED, take);
+        }
+        dec->fill += take;
+        used += take;
+    }
+    if (consumed) {
+        *consumed = used;
+    }
+    return produced;
+}
@@ -0,0 +1,611 @@
+/*
+ * Multi-profile FSK modem implementation
+ *
+ * Tones come from a 32-bit phase-accumulator NCO per group reading a
+ * 1024-entry Q15 sine table with linear interpolation, so the transmit
+ * path needs no libm and its phase never drifts.
+ *
+ * Tone detection uses the Goertzel filter banks of nade_goertzel.h: a block
+ * bank evaluates every tone of a profile in one pass over a symbol window,
+ * and while hunting a sliding bank tracks the base tones sample by sample
+ * (re-primed from the history every NADE_FSK_REPRIME samples to bound
+ * rounding drift). The receiver keeps a short sample history so it can evaluate windows slightly
+ * before and after the nominal symbol boundary (early-late gate) and so a
+ * sync found on one hunting clock can still be confirmed against the others
+ * before committing to it.
+ */
+
+#include "nade_fsk.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define HISTORY_MASK (NADE_FSK_HISTORY - 1)
+#define NADE_FSK_REPRIME 1024    // Samples between sliding bank re-primes, power of two
+#define SINE_TABLE_BITS 10
+#define SINE_TABLE_SIZE (1 << SINE_TABLE_BITS)
+#define SHAPE_MAX ((NADE_FSK_SAMPLES_PER_SYMBOL + NADE_FSK_SHAPE_DIVISOR - 1) / NADE_FSK_SHAPE_DIVISOR)
+
+_Static_assert((NADE_FSK_HISTORY & HISTORY_MASK) == 0, "history must be a power of two");
+_Static_assert(NADE_FSK_HISTORY >= 2 * NADE_FSK_SAMPLES_PER_SYMBOL + 2 * NADE_FSK_GATE_OFFSET,
+               "history must cover the hunt confirmation delay plus the gate window");
+_Static_assert(NADE_FSK_FREQ_01 - NADE_FSK_FREQ_00 == NADE_FSK_FREQ_10 - NADE_FSK_FREQ_01 &&
+               NADE_FSK_FREQ_11 - NADE_FSK_FREQ_10 == NADE_FSK_FREQ_01 - NADE_FSK_FREQ_00,
+               "base profile tones must be evenly spaced");
+_Static_assert(NADE_FSK_PROFILE_COUNT <= 8, "profile mask must fit in one byte");
+
+enum {
+    DEMOD_HUNT = 0,
+    DEMOD_HEADER,
+    DEMOD_DATA,
+};
+
+// Modulation profiles. Tone t of group g sits at base + (g * 2^bits + t) *
+// spacing; 100 baud profiles use 100 Hz bins, 200 baud profiles 200 Hz bins.
+// The base profile is the original NADE_FSK_FREQ_00..11 tone set.
+static const nade_fsk_profile_t kFskProfiles[NADE_FSK_PROFILE_COUNT] = {
+    [NADE_FSK_PROFILE_4FSK_100]  = {"4fsk-100",  2, 1, 80, NADE_FSK_FREQ_00,
+                                    NADE_FSK_FREQ_01 - NADE_FSK_FREQ_00},
+    [NADE_FSK_PROFILE_8FSK_100]  = {"8fsk-100",  3, 1, 80, 1000, 200},  // 1000-2400 Hz
+    [NADE_FSK_PROFILE_16FSK_100] = {"16fsk-100", 4, 1, 80, 1000, 100},  // 1000-2500 Hz
+    [NADE_FSK_PROFILE_4FSK_200]  = {"4fsk-200",  2, 1, 40, NADE_FSK_FREQ_00,
+                                    NADE_FSK_FREQ_01 - NADE_FSK_FREQ_00},
+    [NADE_FSK_PROFILE_16FSK_200] = {"16fsk-200", 4, 1, 40, 400, 200},   // 400-3400 Hz
+    [NADE_FSK_PROFILE_MT4X4_100] = {"mt4x4-100", 2, 4, 80, 800, 100},   // 800-2300 Hz
+    [NADE_FSK_PROFILE_MT4X4_200] = {"mt4x4-200", 2, 4, 40, 400, 200},   // 400-3400 Hz
+};
+
+// Preamble alternates the outer tones for strong timing transitions
+static const uint8_t kPreambleSymbols[2] = {0, 3};
+
+static float g_goertzel_coeffs[NADE_FSK_PROFILE_COUNT][NADE_FSK_MAX_TONES];
+static float g_base_omegas[NADE_FSK_MAX_TONES];
+static float g_profile_threshold[NADE_FSK_PROFILE_COUNT];
+static bool g_goertzel_initialized = false;
+
+// One sine cycle in Q15 plus a guard entry for interpolation, and the Q16
+// raised-cosine transition weights of each profile's symbol length
+static int16_t g_sine_table[SINE_TABLE_SIZE + 1];
+static uint16_t g_shape[NADE_FSK_PROFILE_COUNT][SHAPE_MAX];
+static bool g_nco_initialized = false;
+
+static int profile_tones(const nade_fsk_profile_t *p) {
+    return 1 << p->bits;
+}
+
+static int profile_freq(const nade_fsk_profile_t *p, int group, int tone) {
+    return p->base_freq + (group * profile_tones(p) + tone) * p->spacing;
+}
+
+static void init_goertzel_coeffs(void) {
+    if (g_goertzel_initialized) return;
+    for (int id = 0; id < NADE_FSK_PROFILE_COUNT; id++) {
+        const nade_fsk_profile_t *p = &kFskProfiles[id];
+        for (int g = 0; g < p->groups; g++) {
+            for (int t = 0; t < profile_tones(p); t++) {
+                float omega = (2.0f * (float)M_PI * (float)profile_freq(p, g, t)) /
+                              (float)NADE_FSK_SAMPLE_RATE;
+                g_goertzel_coeffs[id][g * profile_tones(p) + t] = nade_goertzel_coeff(omega);
+                if (id == NADE_FSK_PROFILE_BASE) {
+                    g_base_omegas[g * profile_tones(p) + t] = omega;
+                }
+            }
+        }
+        // Tone power scales with the window length squared and each of the
+        // parallel tones carries 1/groups of the amplitude.
+        float scale = (float)p->samples_per_symbol / (float)NADE_FSK_SAMPLES_PER_SYMBOL /
+                      (float)p->groups;
+        g_profile_threshold[id] = NADE_FSK_THRESHOLD * scale * scale;
+    }
+    g_goertzel_initialized = true;
+}
+
+static int shape_length(const nade_fsk_profile_t *p) {
+    return p->samples_per_symbol / NADE_FSK_SHAPE_DIVISOR;
+}
+
+static void init_nco_tables(void) {
+    if (g_nco_initialized) return;
+    for (int i = 0; i <= SINE_TABLE_SIZE; i++) {
+        g_sine_table[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * (float)M_PI * (float)i /
+                                                          (float)SINE_TABLE_SIZE));
+    }
+    for (int id = 0; id < NADE_FSK_PROFILE_COUNT; id++) {
+        int length = shape_length(&kFskProfiles[id]);
+        for (int i = 0; i < length; i++) {
+            float w = 0.5f - 0.5f * cosf((float)M_PI * ((float)i + 0.5f) / (float)length);
+            g_shape[id][i] = (uint16_t)lrintf(65535.0f * w);
+        }
+    }
+    g_nco_initialized = true;
+}
+
+// Sync word symbol k (0 = first transmitted), MSB first
+static int sync_symbol(int k) {
+    return (int)((NADE_FSK_SYNC_WORD >> (30 - 2 * k)) & 0x03);
+}
+
+// -------------------------------------------------------------------------
+// Profiles
+
+const nade_fsk_profile_t *nade_fsk_profile(int id) {
+    if (id < 0 || id >= NADE_FSK_PROFILE_COUNT) {
+        return NULL;
+    }
+    return &kFskProfiles[id];
+}
+
+int nade_fsk_profile_bitrate(int id) {
+    const nade_fsk_profile_t *p = nade_fsk_profile(id);
+    if (!p) {
+        return 0;
+    }
+    return p->bits * p->groups * NADE_FSK_SAMPLE_RATE / p->samples_per_symbol;
+}
+
+int nade_fsk_best_profile(uint32_t mask) {
+    int best = NADE_FSK_PROFILE_BASE;
+    for (int id = 0; id < NADE_FSK_PROFILE_COUNT; id++) {
+        if (!(mask & (1u << id))) {
+            continue;
+        }
+        int rate = nade_fsk_profile_bitrate(id);
+        int best_rate = nade_fsk_profile_bitrate(best);
+        if (rate > best_rate ||
+            (rate == best_rate &&
+             kFskProfiles[id].samples_per_symbol > kFskProfiles[best].samples_per_symbol)) {
+            best = id;
+        }
+    }
+    return best;
+}
+
+// -------------------------------------------------------------------------
+// Modulator
+
+// Base-profile samples before the data: preamble, sync and header
+#define LEAD_SAMPLES ((NADE_FSK_PREAMBLE_SYMBOLS + NADE_FSK_SYNC_SYMBOLS + \
+                       NADE_FSK_HEADER_BYTES * 4) * NADE_FSK_SAMPLES_PER_SYMBOL)
+
+static size_t data_symbols(const nade_fsk_profile_t *p, size_t len) {
+    size_t bits = (size_t)(p->bits * p->groups);
+    return (len * 8 + bits - 1) / bits;
+}
+
+size_t nade_fsk_burst_samples(int profile, size_t len) {
+    const nade_fsk_profile_t *p = nade_fsk_profile(profile);
+    if (!p) {
+        return 0;
+    }
+    return LEAD_SAMPLES + (data_symbols(p, len) + NADE_FSK_TAIL_SYMBOLS) * (size_t)p->samples_per_symbol;
+}
+
+size_t nade_fsk_burst_capacity(int profile, size_t max_samples) {
+    const nade_fsk_profile_t *p = nade_fsk_profile(profile);
+    if (!p || max_samples <= LEAD_SAMPLES) {
+        return 0;
+    }
+    size_t symbols = (max_samples - LEAD_SAMPLES) / (size_t)p->samples_per_symbol;
+    if (symbols <= NADE_FSK_TAIL_SYMBOLS) {
+        return 0;
+    }
+    size_t len = (symbols - NADE_FSK_TAIL_SYMBOLS) * (size_t)(p->bits * p->groups) / 8;
+    return len > NADE_FSK_MAX_BURST ? NADE_FSK_MAX_BURST : len;
+}
+
+void nade_fsk_mod_reset(nade_fsk_mod_t *mod) {
+    init_nco_tables();
+    bool shaped = mod->shaped;
+    memset(mod, 0, sizeof(*mod));
+    mod->shaped = shaped;
+}
+
+void nade_fsk_mod_set_shaping(nade_fsk_mod_t *mod, bool shaped) {
+    mod->shaped = shaped;
+}
+
+// NCO phase step of a tone: freq / sample rate of a 2^32 cycle
+static uint32_t tone_increment(int freq) {
+    return (uint32_t)(((uint64_t)freq << 32) / NADE_FSK_SAMPLE_RATE);
+}
+
+// Q15 sine of an NCO phase, linearly interpolated between table entries
+static inline int32_t nco_sine(uint32_t phase) {
+    uint32_t index = phase >> (32 - SINE_TABLE_BITS);
+    int32_t frac = (int32_t)((phase >> (32 - SINE_TABLE_BITS - 15)) & 0x7FFF);
+    int32_t a = g_sine_table[index];
+    int32_t b = g_sine_table[index + 1];
+    return a + (((b - a) * frac) >> 15);
+}
+
+// Modulate a single symbol into PCM samples. Each group sends the tone its
+// bits select; phase is continuous per group to avoid clicks at symbol
+// boundaries, and with shaping the frequency sweeps into the new tone too.
+static int16_t *modulate_symbol(nade_fsk_mod_t *mod, const nade_fsk_profile_t *p,
+                                uint32_t symbol, int16_t *out) {
+    uint32_t increment[NADE_FSK_MAX_GROUPS];
+    int32_t step[NADE_FSK_MAX_GROUPS];      // New minus old increment, during the transition
+    uint32_t mask = (uint32_t)profile_tones(p) - 1u;
+    for (int g = 0; g < p->groups; g++) {
+        int tone = (int)((symbol >> (g * p->bits)) & mask);
+        increment[g] = tone_increment(profile_freq(p, g, tone));
+        // A group that was silent starts on its tone
+        step[g] = g < mod->groups ? (int32_t)(increment[g] - mod->increment[g]) : 0;
+    }
+    int32_t amplitude = NADE_FSK_AMPLITUDE / p->groups;
+    int i = 0;
+    if (mod->shaped) {
+        const uint16_t *shape = g_shape[p - kFskProfiles];
+        for (; i < shape_length(p); i++) {
+            int32_t sample = 0;
+            for (int g = 0; g < p->groups; g++) {
+                sample += nco_sine(mod->phase[g]);
+                int32_t lag = (int32_t)(((int64_t)step[g] * (65535 - shape[i])) >> 16);
+                mod->phase[g] += increment[g] - (uint32_t)lag;
+            }
+            out[i] = (int16_t)((sample * amplitude) >> 15);
+        }
+    }
+    for (; i < p->samples_per_symbol; i++) {
+        int32_t sample = 0;
+        for (int g = 0; g < p->groups; g++) {
+            sample += nco_sine(mod->phase[g]);
+            mod->phase[g] += increment[g];
+        }
+        out[i] = (int16_t)((sample * amplitude) >> 15);
+    }
+    memcpy(mod->increment, increment, (size_t)p->groups * sizeof(uint32_t));
+    mod->groups = p->groups;
+    return out + p->samples_per_symbol;
+}
+
+// Modulate bytes LSB first, zero-padding the final symbol
+static int16_t *modulate_bytes(nade_fsk_mod_t *mod, const nade_fsk_profile_t *p,
+                               const uint8_t *data, size_t len, int16_t *out) {
+    int bits = p->bits * p->groups;
+    uint32_t mask = (1u << bits) - 1u;
+    uint32_t acc = 0;
+    int acc_bits = 0;
+    for (size_t i = 0; i < len; i++) {
+        acc |= (uint32_t)data[i] << acc_bits;
+        acc_bits += 8;
+        while (acc_bits >= bits) {
+            out = modulate_symbol(mod, p, acc & mask, out);
+            acc >>= bits;
+            acc_bits -= bits;
+        }
+    }
+    if (acc_bits > 0) {
+        out = modulate_symbol(mod, p, acc & mask, out);
+    }
+    return out;
+}
+
+size_t nade_fsk_modulate_burst(nade_fsk_mod_t *mod, int profile, const uint8_t *data, size_t len,
+                               int16_t *out, size_t max_samples) {
+    const nade_fsk_profile_t *p = nade_fsk_profile(profile);
+    if (!mod || !p || !data || !out || len == 0 || len > NADE_FSK_MAX_BURST ||
+        nade_fsk_burst_samples(profile, len) > max_samples) {
+        return 0;
+    }
+    init_nco_tables();
+    const nade_fsk_profile_t *base = &kFskProfiles[NADE_FSK_PROFILE_BASE];
+    int16_t *p_out = out;
+    for (int k = 0; k < NADE_FSK_PREAMBLE_SYMBOLS; k++) {
+        p_out = modulate_symbol(mod, base, kPreambleSymbols[k & 1], p_out);
+    }
+    for (int k = 0; k < NADE_FSK_SYNC_SYMBOLS; k++) {
+        p_out = modulate_symbol(mod, base, (uint32_t)sync_symbol(k), p_out);
+    }
+    uint8_t header[NADE_FSK_HEADER_BYTES] = {
+        (uint8_t)(len & 0xFF), (uint8_t)(len >> 8), (uint8_t)profile,
+        (uint8_t)~(len & 0xFF), (uint8_t)~(len >> 8), (uint8_t)~profile,
+    };
+    p_out = modulate_bytes(mod, base, header, sizeof(header), p_out);
+    p_out = modulate_bytes(mod, p, data, len, p_out);
+    for (int k = 0; k < NADE_FSK_TAIL_SYMBOLS; k++) {
+        p_out = modulate_symbol(mod, p, 0, p_out);
+    }
+    return (size_t)(p_out - out);
+}
+
+// -------------------------------------------------------------------------
+// Demodulator
+
+// Contiguous view of the window starting at absolute sample index start
+static const int16_t *window_at(const nade_fsk_demod_t *demod, uint64_t start) {
+    return &demod->history[start & HISTORY_MASK];
+}
+
+// Choose the strongest tone of every group from the profile's tone powers.
+// tones receives the winning coefficient index per group, max_power the
+// mean winning power, quality the winners' share of the total power and
+// margin the smallest 1 - runner-up / winner over the groups.
+static uint32_t pick_symbol(int profile, const float *power, int *tones, float *max_power,
+                            float *quality, float *margin) {
+    const nade_fsk_profile_t *p = &kFskProfiles[profile];
+    int count = profile_tones(p);
+    float total = 0.0f;
+    float winners = 0.0f;
+    float worst = 1.0f;
+    uint32_t symbol = 0;
+    for (int g = 0; g < p->groups; g++) {
+        float best_power = -1.0f;
+        float second_power = -1.0f;
+        int best = 0;
+        for (int tone = 0; tone < count; tone++) {
+            float tone_power = power[g * count + tone];
+            total += tone_power;
+            if (tone_power > best_power) {
+                second_power = best_power;
+                best_power = tone_power;
+                best = tone;
+            } else if (tone_power > second_power) {
+                second_power = tone_power;
+            }
+        }
+        winners += best_power;
+        tones[g] = g * count + best;
+        symbol |= (uint32_t)best << (g * p->bits);
+        float group_margin = best_power > 0.0f ? 1.0f - second_power / best_power : 0.0f;
+        if (group_margin < worst) {
+            worst = group_margin;
+        }
+    }
+    *max_power = winners / (float)p->groups;
+    *quality = total > 0.0f ? winners / total : 0.0f;
+    *margin = worst;
+    return symbol;
+}
+
+// Decide the symbol in the window starting at start. Always returns a
+// symbol; see pick_symbol for the outputs.
+static uint32_t decide_symbol(const nade_fsk_demod_t *demod, int profile, uint64_t start,
+                              int *tones, float *max_power, float *quality, float *margin) {
+    const nade_fsk_profile_t *p = &kFskProfiles[profile];
+    float power[NADE_FSK_MAX_TONES];
+    nade_goertzel_bank(g_goertzel_coeffs[profile], profile_tones(p) * p->groups,
+                       window_at(demod, start), p->samples_per_symbol, power);
+    return pick_symbol(profile, power, tones, max_power, quality, margin);
+}
+
+// Restart the hunting bank on the symbol window ending at sample_index
+static void prime_hunt_bank(nade_fsk_demod_t *demod) {
+    if (demod->sample_index >= NADE_FSK_SAMPLES_PER_SYMBOL) {
+        nade_goertzel_slide_prime(&demod->hunt_bank,
+                                  window_at(demod, demod->sample_index - NADE_FSK_SAMPLES_PER_SYMBOL));
+    }
+}
+
+static int sync_mismatches(uint32_t symbols) {
+    uint32_t diff = symbols ^ NADE_FSK_SYNC_WORD;
+    int count = 0;
+    for (int k = 0; k < NADE_FSK_SYNC_SYMBOLS; k++) {
+        if ((diff >> (2 * k)) & 0x03) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void enter_hunt(nade_fsk_demod_t *demod) {
+    demod->state = DEMOD_HUNT;
+    demod->profile = NADE_FSK_PROFILE_BASE;
+    prime_hunt_bank(demod);
+    memset(demod->phase_symbols, 0, sizeof(demod->phase_symbols));
+    memset(demod->phase_quality, 0, sizeof(demod->phase_quality));
+    demod->have_candidate = false;
+}
+
+void nade_fsk_demod_reset(nade_fsk_demod_t *demod) {
+    init_goertzel_coeffs();
+    memset(demod, 0, sizeof(*demod));
+    nade_goertzel_slide_init(&demod->hunt_bank, g_base_omegas,
+                             profile_tones(&kFskProfiles[NADE_FSK_PROFILE_BASE]),
+                             NADE_FSK_SAMPLES_PER_SYMBOL);
+    enter_hunt(demod);
+}
+
+static void lock_candidate(nade_fsk_demod_t *demod) {
+    demod->state = DEMOD_HEADER;
+    demod->symbol_start = demod->candidate_end;
+    demod->gate_error = 0.0f;
+    demod->weak_run = 0;
+    demod->profile = NADE_FSK_PROFILE_BASE;
+    demod->bits = 0;
+    demod->bit_count = 0;
+    demod->bits_reliability = NADE_FSK_RELIABLE;
+    demod->header_fill = 0;
+    demod->have_candidate = false;
+    demod->epoch++;
+    demod->stats.syncs++;
+}
+
+// One hunting clock finished a symbol window ending at sample_index.
+// Returns true once a candidate has been confirmed and locked.
+static bool hunt_step(nade_fsk_demod_t *demod) {
+    uint64_t end = demod->sample_index;
+    if (end >= NADE_FSK_SAMPLES_PER_SYMBOL) {
+        int phase = (int)((end / NADE_FSK_HUNT_STEP) % NADE_FSK_HUNT_PHASES);
+        int tones[NADE_FSK_MAX_GROUPS];
+        float power[NADE_FSK_MAX_TONES];
+        float max_power, quality, margin;
+        nade_goertzel_slide_power(&demod->hunt_bank, power);
+        uint32_t symbol = pick_symbol(NADE_FSK_PROFILE_BASE, power, tones, &max_power, &quality, &margin);
+        demod->phase_symbols[phase] = (demod->phase_symbols[phase] << 2) | symbol;
+        demod->phase_quality[phase] = 0.75f * demod->phase_quality[phase] + 0.25f * quality;
+        if (max_power >= NADE_FSK_THRESHOLD &&
+            sync_mismatches(demod->phase_symbols[phase]) <= NADE_FSK_SYNC_MAX_ERRORS) {
+            if (!demod->have_candidate) {
+                demod->have_candidate = true;
+                demod->candidate_quality = -1.0f;
+                // Give every other clock one chance to match this sync
+                demod->candidate_deadline = end + NADE_FSK_SAMPLES_PER_SYMBOL - NADE_FSK_HUNT_STEP;
+            }
+            if (demod->phase_quality[phase] > demod->candidate_quality) {
+                demod->candidate_quality = demod->phase_quality[phase];
+                demod->candidate_end = end;
+            }
+        }
+    }
+    if (demod->have_candidate && end >= demod->candidate_deadline) {
+        lock_candidate(demod);
+        return true;
+    }
+    return false;
+}
+
+static void handle_byte(nade_fsk_demod_t *demod, uint8_t byte, uint8_t reliability,
+                        uint8_t *out, uint8_t *reliabilities, size_t max_out, size_t *written) {
+    if (demod->state == DEMOD_HEADER) {
+        demod->header[demod->header_fill++] = byte;
+        if (demod->header_fill < NADE_FSK_HEADER_BYTES) {
+            return;
+        }
+        const uint8_t *h = demod->header;
+        size_t len = (size_t)h[0] | ((size_t)h[1] << 8);
+        if ((h[0] ^ h[3]) != 0xFF || (h[1] ^ h[4]) != 0xFF || (h[2] ^ h[5]) != 0xFF ||
+            len == 0 || len > NADE_FSK_MAX_BURST || h[2] >= NADE_FSK_PROFILE_COUNT) {
+            demod->stats.bad_headers++;
+            enter_hunt(demod);
+            return;
+        }
+        demod->burst_remaining = len;
+        demod->profile = h[2];
+        demod->state = DEMOD_DATA;
+        return;
+    }
+    if (*written < max_out) {
+        if (reliabilities) {
+            reliabilities[*written] = reliability;
+        }
+        out[(*written)++] = byte;
+    } else {
+        demod->stats.dropped_bytes++;
+    }
+    if (--demod->burst_remaining == 0) {
+        demod->stats.bursts++;
+        enter_hunt(demod);
+    }
+}
+
+static int gate_offset(const nade_fsk_profile_t *p) {
+    return p->samples_per_symbol / 8;
+}
+
+// Decide the next locked symbol and advance the symbol clock
+static void locked_step(nade_fsk_demod_t *demod, uint8_t *out, uint8_t *reliabilities, size_t max_out,
+                        size_t *written) {
+    const nade_fsk_profile_t *p = &kFskProfiles[demod->profile];
+    int n = p->samples_per_symbol;
+    uint64_t start = demod->symbol_start;
+    int tones[NADE_FSK_MAX_GROUPS];
+    float max_power, quality, margin;
+    uint32_t symbol = decide_symbol(demod, demod->profile, start, tones, &max_power, &quality, &margin);
+    uint8_t reliability = (uint8_t)(margin * (float)NADE_FSK_RELIABLE + 0.5f);
+
+    // Early-late gate on the decided tones: energy moves toward the side the
+    // true symbol centre lies on. Only transitions produce an error signal.
+    float decided[NADE_FSK_MAX_GROUPS];
+    float early_power[NADE_FSK_MAX_GROUPS], late_power[NADE_FSK_MAX_GROUPS];
+    for (int g = 0; g < p->groups; g++) {
+        decided[g] = g_goertzel_coeffs[demod->profile][tones[g]];
+    }
+    nade_goertzel_bank(decided, p->groups, window_at(demod, start - (uint64_t)gate_offset(p)), n,
+                       early_power);
+    nade_goertzel_bank(decided, p->groups, window_at(demod, start + (uint64_t)gate_offset(p)), n,
+                       late_power);
+    float early = 0.0f, late = 0.0f;
+    for (int g = 0; g < p->groups; g++) {
+        early += early_power[g];
+        late += late_power[g];
+    }
+    float sum = early + late;
+    if (sum > 0.0f) {
+        demod->gate_error = 0.5f * demod->gate_error + (late - early) / sum;
+    }
+    int64_t adjust = 0;
+    if (demod->gate_error > 0.25f) {
+        adjust = 1;
+    } else if (demod->gate_error < -0.25f) {
+        adjust = -1;
+    }
+    if (adjust != 0) {
+        demod->gate_error = 0.0f;
+        demod->stats.timing_adjusts++;
+    }
+    demod->symbol_start = start + (uint64_t)n + (uint64_t)adjust;
+
+    if (max_power < g_profile_threshold[demod->profile]) {
+        // Too weak for the margin to mean anything
+        reliability = 0;
+        demod->stats.weak_symbols++;
+        if (++demod->weak_run >= NADE_FSK_FADE_SYMBOLS) {
+            demod->stats.fades++;
+            enter_hunt(demod);
+            return;
+        }
+    } else {
+        demod->weak_run = 0;
+    }
+
+    // Bits past the last byte of a burst are padding and dropped with the lock.
+    // A byte is as reliable as the least reliable symbol it has bits of;
+    // bits left over after a byte all come from this symbol.
+    demod->bits |= symbol << demod->bit_count;
+    demod->bit_count += p->bits * p->groups;
+    if (reliability < demod->bits_reliability) {
+        demod->bits_reliability = reliability;
+    }
+    while (demod->bit_count >= 8 && demod->state != DEMOD_HUNT) {
+        uint8_t byte = (uint8_t)(demod->bits & 0xFF);
+        uint8_t byte_reliability = demod->bits_reliability;
+        demod->bits >>= 8;
+        demod->bit_count -= 8;
+        demod->bits_reliability = demod->bit_count > 0 ? reliability : NADE_FSK_RELIABLE;
+        handle_byte(demod, byte, byte_reliability, out, reliabilities, max_out, written);
+    }
+}
+
+size_t nade_fsk_demodulate(nade_fsk_demod_t *demod, const int16_t *samples, size_t count,
+                           size_t *consumed, uint8_t *out, uint8_t *reliability, size_t max_out) {
+    size_t written = 0;
+    size_t i = 0;
+    while (i < count) {
+        int16_t sample = samples[i++];
+        demod->history[demod->sample_index & HISTORY_MASK] = sample;
+        demod->history[(demod->sample_index & HISTORY_MASK) + NADE_FSK_HISTORY] = sample;
+        demod->sample_index++;
+
+        if (demod->state == DEMOD_HUNT) {
+            if (demod->sample_index % NADE_FSK_REPRIME == 0) {
+                prime_hunt_bank(demod);
+            } else {
+                // History is zero before the first sample, like the bank's window
+                int16_t leaving = demod->history[(demod->sample_index - 1 - NADE_FSK_SAMPLES_PER_SYMBOL) &
+                                                 HISTORY_MASK];
+                nade_goertzel_slide_step(&demod->hunt_bank, sample, leaving);
+            }
+            if (demod->sample_index % NADE_FSK_HUNT_STEP == 0 && hunt_step(demod)) {
+                // New burst: let the caller see the new epoch before its data
+                break;
+            }
+            continue;
+        }
+        // Locked: decide every symbol whose late-gate window is complete
+        while (demod->state != DEMOD_HUNT &&
+               demod->sample_index >= demod->symbol_start +
+                                      (uint64_t)kFskProfiles[demod->profile].samples_per_symbol +
+                                      (uint64_t)gate_offset(&kFskProfiles[demod->profile])) {
+            locked_step(demod, out, reliability, max_out, &written);
+        }
+    }
+    if (consumed) {
+        *consumed = i;
+    }
+    return written;
+}
@@ -0,0 +1,201 @@
+/*
+ * Goertzel filter bank implementation
+ *
+ * Both banks are written once against a four-lane float vector. On x86 it
+ * maps to SSE, on ARM to NEON, and elsewhere to a plain struct the
+ * compiler is free to vectorize. The lane arithmetic is kept in the same
+ * order as the scalar Goertzel recurrence (no fused multiply-add), so the
+ * bank returns the same powers a per-tone pass would.
+ *
+ * The block bank runs two vectors (eight tones) per pass over the window:
+ * the recurrence is a serial dependency per tone and two independent
+ * chains keep the multiplier busy.
+ *
+ * The sliding bank keeps, per tone, S(t) = sum over the window of
+ * x[i] * e^(j omega (t - i)) and updates it with
+ *     S(t) = x[t] + e^(j omega) * S(t - 1) - e^(j omega n) * x[t - n]
+ * which is exact for any omega, integer bin or not.
+ */
+
+#include "nade_goertzel.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+
+typedef __m128 vf4;
+static inline vf4 vf4_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void vf4_store(float *p, vf4 v) { _mm_storeu_ps(p, v); }
+static inline vf4 vf4_set1(float f) { return _mm_set1_ps(f); }
+static inline vf4 vf4_add(vf4 a, vf4 b) { return _mm_add_ps(a, b); }
+static inline vf4 vf4_sub(vf4 a, vf4 b) { return _mm_sub_ps(a, b); }
+static inline vf4 vf4_mul(vf4 a, vf4 b) { return _mm_mul_ps(a, b); }
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+typedef float32x4_t vf4;
+static inline vf4 vf4_load(const float *p) { return vld1q_f32(p); }
+static inline void vf4_store(float *p, vf4 v) { vst1q_f32(p, v); }
+static inline vf4 vf4_set1(float f) { return vdupq_n_f32(f); }
+static inline vf4 vf4_add(vf4 a, vf4 b) { return vaddq_f32(a, b); }
+static inline vf4 vf4_sub(vf4 a, vf4 b) { return vsubq_f32(a, b); }
+static inline vf4 vf4_mul(vf4 a, vf4 b) { return vmulq_f32(a, b); }
+#else
+typedef struct {
+    float v[NADE_GOERTZEL_LANES];
+} vf4;
+
+static inline vf4 vf4_load(const float *p) {
+    vf4 r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+static inline void vf4_store(float *p, vf4 a) { memcpy(p, a.v, sizeof(a.v)); }
+static inline vf4 vf4_set1(float f) {
+    vf4 r;
+    for (int i = 0; i < NADE_GOERTZEL_LANES; i++) r.v[i] = f;
+    return r;
+}
+static inline vf4 vf4_add(vf4 a, vf4 b) {
+    for (int i = 0; i < NADE_GOERTZEL_LANES; i++) a.v[i] += b.v[i];
+    return a;
+}
+static inline vf4 vf4_sub(vf4 a, vf4 b) {
+    for (int i = 0; i < NADE_GOERTZEL_LANES; i++) a.v[i] -= b.v[i];
+    return a;
+}
+static inline vf4 vf4_mul(vf4 a, vf4 b) {
+    for (int i = 0; i < NADE_GOERTZEL_LANES; i++) a.v[i] *= b.v[i];
+    return a;
+}
+#endif
+
+#define BLOCK_TONES     (2 * NADE_GOERTZEL_LANES)   // Tones per pass over the window
+#define WINDOW_CHUNK    128                          // Samples converted to float at a time
+
+_Static_assert(NADE_GOERTZEL_MAX_TONES % BLOCK_TONES == 0, "bank size must be whole blocks");
+_Static_assert(NADE_GOERTZEL_MAX_SLIDE % NADE_GOERTZEL_LANES == 0, "sliding bank must be whole vectors");
+
+float nade_goertzel_coeff(float omega) {
+    return 2.0f * cosf(omega);
+}
+
+// -------------------------------------------------------------------------
+// Block bank
+
+void nade_goertzel_bank(const float *coeffs, int count, const int16_t *x, int n, float *power) {
+    if (count <= 0) {
+        return;
+    }
+    if (count > NADE_GOERTZEL_MAX_TONES) {
+        count = NADE_GOERTZEL_MAX_TONES;
+    }
+    int padded = (count + BLOCK_TONES - 1) / BLOCK_TONES * BLOCK_TONES;
+    _Alignas(16) float c[NADE_GOERTZEL_MAX_TONES];
+    _Alignas(16) float s1[NADE_GOERTZEL_MAX_TONES];
+    _Alignas(16) float s2[NADE_GOERTZEL_MAX_TONES];
+    _Alignas(16) float window[WINDOW_CHUNK];
+    memcpy(c, coeffs, (size_t)count * sizeof(float));
+    memset(c + count, 0, (size_t)(padded - count) * sizeof(float));
+    memset(s1, 0, (size_t)padded * sizeof(float));
+    memset(s2, 0, (size_t)padded * sizeof(float));
+
+    for (int done = 0; done < n; done += WINDOW_CHUNK) {
+        int len = n - done < WINDOW_CHUNK ? n - done : WINDOW_CHUNK;
+        for (int i = 0; i < len; i++) {
+            window[i] = (float)x[done + i];
+        }
+        for (int t = 0; t < padded; t += BLOCK_TONES) {
+            vf4 ca = vf4_load(c + t);
+            vf4 cb = vf4_load(c + t + NADE_GOERTZEL_LANES);
+            vf4 a1 = vf4_load(s1 + t), a2 = vf4_load(s2 + t);
+            vf4 b1 = vf4_load(s1 + t + NADE_GOERTZEL_LANES), b2 = vf4_load(s2 + t + NADE_GOERTZEL_LANES);
+            for (int i = 0; i < len; i++) {
+                vf4 v = vf4_set1(window[i]);
+                vf4 a0 = vf4_sub(vf4_add(v, vf4_mul(ca, a1)), a2);
+                vf4 b0 = vf4_sub(vf4_add(v, vf4_mul(cb, b1)), b2);
+                a2 = a1;
+                a1 = a0;
+                b2 = b1;
+                b1 = b0;
+            }
+            vf4_store(s1 + t, a1);
+            vf4_store(s2 + t, a2);
+            vf4_store(s1 + t + NADE_GOERTZEL_LANES, b1);
+            vf4_store(s2 + t + NADE_GOERTZEL_LANES, b2);
+        }
+    }
+
+    // Power = s1^2 + s2^2 - coeff * s1 * s2
+    _Alignas(16) float out[NADE_GOERTZEL_MAX_TONES];
+    for (int t = 0; t < padded; t += NADE_GOERTZEL_LANES) {
+        vf4 a1 = vf4_load(s1 + t), a2 = vf4_load(s2 + t), ct = vf4_load(c + t);
+        vf4 p = vf4_sub(vf4_add(vf4_mul(a1, a1), vf4_mul(a2, a2)), vf4_mul(vf4_mul(ct, a1), a2));
+        vf4_store(out + t, p);
+    }
+    memcpy(power, out, (size_t)count * sizeof(float));
+}
+
+// -------------------------------------------------------------------------
+// Sliding bank
+
+static int slide_padded(const nade_goertzel_slide_t *slide) {
+    return (slide->count + NADE_GOERTZEL_LANES - 1) / NADE_GOERTZEL_LANES * NADE_GOERTZEL_LANES;
+}
+
+void nade_goertzel_slide_init(nade_goertzel_slide_t *slide, const float *omegas, int count, int n) {
+    memset(slide, 0, sizeof(*slide));
+    if (count > NADE_GOERTZEL_MAX_SLIDE) {
+        count = NADE_GOERTZEL_MAX_SLIDE;
+    }
+    slide->count = count;
+    slide->n = n;
+    for (int t = 0; t < count; t++) {
+        slide->rot_re[t] = cosf(omegas[t]);
+        slide->rot_im[t] = sinf(omegas[t]);
+        // Reduce omega * n before the trig call: it can be hundreds of radians
+        float tail = fmodf(omegas[t] * (float)n, 2.0f * (float)M_PI);
+        slide->tail_re[t] = cosf(tail);
+        slide->tail_im[t] = sinf(tail);
+    }
+}
+
+void nade_goertzel_slide_step(nade_goertzel_slide_t *slide, int16_t in, int16_t out) {
+    vf4 vin = vf4_set1((float)in);
+    vf4 vout = vf4_set1((float)out);
+    int padded = slide_padded(slide);
+    for (int t = 0; t < padded; t += NADE_GOERTZEL_LANES) {
+        vf4 re = vf4_load(slide->re + t), im = vf4_load(slide->im + t);
+        vf4 rr = vf4_load(slide->rot_re + t), ri = vf4_load(slide->rot_im + t);
+        vf4 nre = vf4_sub(vf4_add(vf4_sub(vf4_mul(rr, re), vf4_mul(ri, im)), vin),
+                          vf4_mul(vf4_load(slide->tail_re + t), vout));
+        vf4 nim = vf4_sub(vf4_add(vf4_mul(rr, im), vf4_mul(ri, re)),
+                          vf4_mul(vf4_load(slide->tail_im + t), vout));
+        vf4_store(slide->re + t, nre);
+        vf4_store(slide->im + t, nim);
+    }
+}
+
+void nade_goertzel_slide_prime(nade_goertzel_slide_t *slide, const int16_t *window) {
+    memset(slide->re, 0, sizeof(slide->re));
+    memset(slide->im, 0, sizeof(slide->im));
+    for (int i = 0; i < slide->n; i++) {
+        nade_goertzel_slide_step(slide, window[i], 0);
+    }
+}
+
+void nade_goertzel_slide_power(const nade_goertzel_slide_t *slide, float *power) {
+    _Alignas(16) float out[NADE_GOERTZEL_MAX_SLIDE];
+    int padded = slide_padded(slide);
+    for (int t = 0; t < padded; t += NADE_GOERTZEL_LANES) {
+        vf4 re = vf4_load(slide->re + t), im = vf4_load(slide->im + t);
+        vf4_store(out + t, vf4_add(vf4_mul(re, re), vf4_mul(im, im)));
+    }
+    memcpy(power, out, (size_t)slide->count * sizeof(float));
+}
@@ -0,0 +1,400 @@
+/*
+ * Adaptive jitter buffer implementation
+ *
+ * Slots are indexed by sequence number modulo NADE_JITTER_SLOTS and carry
+ * their sequence number, so a stale slot is never mistaken for the frame
+ * being played. Concealment follows the spirit of G.711 Appendix I: the
+ * last pitch period is repeated with a linear fade and the first real frame
+ * afterwards is cross-faded in. Time-scale changes remove or repeat one
+ * pitch period of a frame with an overlap-add across the seam. Pitch
+ * limits and the recovery cross-fade are given at the base rate and
+ * scaled with it.
+ *
+ * While in comfort noise, descriptors are applied as they arrive and audio
+ * frames wait in their slots until the spurt has a full prebuffer.
+ */
+
+#include "nade_jitter.h"
+
+#include <string.h>
+
+#define FADE_PER_FRAME      0.3f    // Concealment attenuation per frame
+#define RECOVERY_SAMPLES    40      // Cross-fade from concealment into real audio, at the base rate
+#define STRETCH_COOLDOWN    4       // Frames between two time-scale changes
+#define DEPTH_SMOOTHING     0.1f
+#define JITTER_GAIN         2.0f    // Target delay in units of estimated jitter
+
+static int seq_diff(uint16_t a, uint16_t b) {
+    return (int16_t)(uint16_t)(a - b);
+}
+
+static nade_jitter_slot_t *slot_for(nade_jitter_t *jb, uint16_t seq) {
+    return &jb->slots[seq % NADE_JITTER_SLOTS];
+}
+
+static bool slot_holds(const nade_jitter_t *jb, uint16_t seq) {
+    const nade_jitter_slot_t *slot = &jb->slots[seq % NADE_JITTER_SLOTS];
+    return slot->valid && slot->seq == seq;
+}
+
+static int16_t clamp_sample(float value) {
+    if (value > 32767.0f) return 32767;
+    if (value < -32768.0f) return -32768;
+    return (int16_t)value;
+}
+
+// Best pitch period of x by normalised autocorrelation, limited so that two
+// periods fit in n samples
+static int find_period(const nade_jitter_t *jb, const int16_t *x, size_t n) {
+    int max_lag = NADE_JITTER_PITCH_MAX * jb->rate_scale;
+    if ((size_t)max_lag * 2 > n) {
+        max_lag = (int)(n / 2);
+    }
+    int best_lag = max_lag;
+    float best_score = -1.0f;
+    for (int lag = NADE_JITTER_PITCH_MIN * jb->rate_scale; lag <= max_lag; lag++) {
+        float cross = 0.0f;
+        float energy_a = 0.0f;
+        float energy_b = 0.0f;
+        for (size_t i = 0; i + (size_t)lag < n; i++) {
+            float a = x[i];
+            float b = x[i + (size_t)lag];
+            cross += a * b;
+            energy_a += a * a;
+            energy_b += b * b;
+        }
+        if (energy_a <= 0.0f || energy_b <= 0.0f) {
+            continue;
+        }
+        // Compare squared normalised correlations, keeping the sign
+        float score = cross * (cross < 0.0f ? -cross : cross) / (energy_a * energy_b);
+        if (score > best_score) {
+            best_score = score;
+            best_lag = lag;
+        }
+    }
+    return best_lag;
+}
+
+static void update_target(nade_jitter_t *jb) {
+    float frames = JITTER_GAIN * jb->jitter_ms / (float)NADE_JITTER_FRAME_MS;
+    int target = 1 + (int)(frames + 0.999f);
+    if (target < NADE_JITTER_MIN_TARGET) target = NADE_JITTER_MIN_TARGET;
+    if (target > NADE_JITTER_MAX_TARGET) target = NADE_JITTER_MAX_TARGET;
+    jb->target = target;
+}
+
+void nade_jitter_reset(nade_jitter_t *jb) {
+    int rate = jb->sample_rate > 0 ? jb->sample_rate : NADE_JITTER_BASE_RATE;
+    memset(jb, 0, sizeof(*jb));
+    jb->sample_rate = rate;
+    jb->rate_scale = rate / NADE_JITTER_BASE_RATE;
+    jb->frame_samples = rate * NADE_JITTER_FRAME_MS / 1000;
+    jb->target = NADE_JITTER_MIN_TARGET;
+    nade_comfort_reset(&jb->comfort);
+}
+
+void nade_jitter_set_rate(nade_jitter_t *jb, int sample_rate) {
+    nade_jitter_stats_t stats = jb->stats;
+    jb->sample_rate = sample_rate;
+    nade_jitter_reset(jb);
+    jb->stats = stats;
+}
+
+int nade_jitter_depth(const nade_jitter_t *jb) {
+    if (!jb->started) {
+        return 0;
+    }
+    int depth = seq_diff(jb->newest_seq, jb->next_seq) + 1;
+    return depth > 0 ? depth : 0;
+}
+
+// Arrival bookkeeping shared by audio and descriptors: sequence restarts
+// and the jitter estimate
+static void note_arrival(nade_jitter_t *jb, uint16_t seq, uint64_t now_ms) {
+    if (jb->started && seq_diff(seq, jb->next_seq) < -NADE_JITTER_SLOTS) {
+        // Far behind playout: the sender restarted its sequence numbers
+        nade_jitter_stats_t stats = jb->stats;
+        nade_jitter_reset(jb);
+        jb->stats = stats;
+    }
+    if (!jb->started) {
+        jb->started = true;
+        jb->next_seq = seq;
+        jb->newest_seq = seq;
+    } else {
+        // RFC 3550 interarrival jitter: D = (R_j - R_i) - (S_j - S_i)
+        float transit = (float)(int64_t)(now_ms - jb->last_arrival_ms) -
+                        (float)(seq_diff(seq, jb->last_arrival_seq) * NADE_JITTER_FRAME_MS);
+        if (transit < 0.0f) {
+            transit = -transit;
+        }
+        jb->jitter_ms += (transit - jb->jitter_ms) / 16.0f;
+        update_target(jb);
+    }
+    jb->last_arrival_seq = seq;
+    jb->last_arrival_ms = now_ms;
+}
+
+// Make seq the newest arrival if it is, keeping the playout point within
+// the slots
+static void note_newest(nade_jitter_t *jb, uint16_t seq) {
+    if (seq_diff(seq, jb->next_seq) >= NADE_JITTER_SLOTS) {
+        // Far ahead of playout: keep the newest window, older slots go stale
+        jb->next_seq = (uint16_t)(seq - NADE_JITTER_SLOTS + 1);
+    }
+    if (seq_diff(seq, jb->newest_seq) > 0) {
+        jb->newest_seq = seq;
+    }
+}
+
+// The slot to store seq in, or NULL if it came too late or twice
+static nade_jitter_slot_t *claim_slot(nade_jitter_t *jb, uint16_t seq) {
+    int ahead = seq_diff(seq, jb->next_seq);
+    if (ahead < 0) {
+        // Reordering ahead of the first playout just moves the start back
+        bool nothing_played = jb->stats.frames_played == 0 && jb->stats.frames_concealed == 0;
+        if (jb->playing || !nothing_played || -ahead + nade_jitter_depth(jb) > NADE_JITTER_SLOTS) {
+            jb->stats.late_dropped++;
+            return NULL;
+        }
+        jb->next_seq = seq;
+    }
+    nade_jitter_slot_t *slot = slot_for(jb, seq);
+    if (slot->valid && slot->seq == seq) {
+        jb->stats.duplicates++;
+        return NULL;
+    }
+    note_newest(jb, seq);
+    slot->seq = seq;
+    slot->valid = true;
+    return slot;
+}
+
+void nade_jitter_push(nade_jitter_t *jb, uint16_t seq, const int16_t *pcm, size_t count,
+                      uint64_t now_ms) {
+    if (count > (size_t)jb->frame_samples) {
+        count = (size_t)jb->frame_samples;
+    }
+    note_arrival(jb, seq, now_ms);
+    nade_jitter_slot_t *slot = claim_slot(jb, seq);
+    if (!slot) {
+        return;
+    }
+    memcpy(slot->pcm, pcm, count * sizeof(int16_t));
+    memset(slot->pcm + count, 0, ((size_t)jb->frame_samples - count) * sizeof(int16_t));
+    slot->comfort = false;
+}
+
+void nade_jitter_push_sid(nade_jitter_t *jb, uint16_t seq, const nade_sid_t *sid, uint64_t now_ms) {
+    note_arrival(jb, seq, now_ms);
+    if (jb->in_comfort) {
+        // Already in the pause: the noise follows at once, late or not
+        nade_comfort_update(&jb->comfort, sid);
+        note_newest(jb, seq);
+        return;
+    }
+    nade_jitter_slot_t *slot = claim_slot(jb, seq);
+    if (!slot) {
+        return;
+    }
+    slot->comfort = true;
+    slot->sid = *sid;
+}
+
+// -------------------------------------------------------------------------
+// Concealment and time-scale modification
+
+// Continue the repeated pitch period for count samples, fading as it goes
+static void conceal_samples(nade_jitter_t *jb, int16_t *out, size_t count) {
+    const int16_t *period = jb->history + jb->frame_samples - jb->conceal_period;
+    float fade_step = FADE_PER_FRAME / (float)jb->frame_samples;
+    for (size_t i = 0; i < count; i++) {
+        float gain = jb->conceal_gain > 0.0f ? jb->conceal_gain : 0.0f;
+        out[i] = clamp_sample((float)period[jb->conceal_phase] * gain);
+        jb->conceal_phase = (jb->conceal_phase + 1) % jb->conceal_period;
+        jb->conceal_gain -= fade_step;
+    }
+}
+
+static size_t conceal_frame(nade_jitter_t *jb, int16_t *out) {
+    if (jb->conceal_run == 0) {
+        jb->conceal_period = find_period(jb, jb->history, (size_t)jb->frame_samples);
+        jb->conceal_phase = 0;
+        jb->conceal_gain = 1.0f;
+    }
+    conceal_samples(jb, out, (size_t)jb->frame_samples);
+    jb->conceal_run++;
+    jb->stats.frames_concealed++;
+    return (size_t)jb->frame_samples;
+}
+
+// Remove one pitch period: the first period cross-fades into the second
+static size_t compress_frame(const nade_jitter_t *jb, const int16_t *x, size_t n, int16_t *out) {
+    size_t period = (size_t)find_period(jb, x, n);
+    for (size_t j = 0; j < period; j++) {
+        float w = (float)j / (float)period;
+        out[j] = clamp_sample((float)x[j] * (1.0f - w) + (float)x[j + period] * w);
+    }
+    memcpy(out + period, x + 2 * period, (n - 2 * period) * sizeof(int16_t));
+    return n - period;
+}
+
+// Repeat one pitch period: after the first period, fade from the second back
+// into the first, then play the rest of the frame again from there
+static size_t expand_frame(const nade_jitter_t *jb, const int16_t *x, size_t n, int16_t *out) {
+    size_t period = (size_t)find_period(jb, x, n);
+    memcpy(out, x, period * sizeof(int16_t));
+    for (size_t j = 0; j < period; j++) {
+        float w = (float)j / (float)period;
+        out[period + j] = clamp_sample((float)x[period + j] * (1.0f - w) + (float)x[j] * w);
+    }
+    memcpy(out + 2 * period, x + period, (n - period) * sizeof(int16_t));
+    return n + period;
+}
+
+static void remember_output(nade_jitter_t *jb, const int16_t *out, size_t count) {
+    size_t frame = (size_t)jb->frame_samples;
+    if (count >= frame) {
+        memcpy(jb->history, out + count - frame, frame * sizeof(int16_t));
+        return;
+    }
+    memmove(jb->history, jb->history + count, (frame - count) * sizeof(int16_t));
+    memcpy(jb->history + frame - count, out, count * sizeof(int16_t));
+}
+
+// Advance the playout point to the oldest frame actually held
+static void skip_to_buffered(nade_jitter_t *jb) {
+    while (seq_diff(jb->newest_seq, jb->next_seq) > 0 && !slot_holds(jb, jb->next_seq)) {
+        jb->next_seq++;
+    }
+}
+
+// -------------------------------------------------------------------------
+// Comfort noise
+
+static size_t comfort_frame(nade_jitter_t *jb, int16_t *out) {
+    nade_comfort_generate(&jb->comfort, out, (size_t)jb->frame_samples);
+    remember_output(jb, out, (size_t)jb->frame_samples);
+    return (size_t)jb->frame_samples;
+}
+
+// Play the descriptor slot at the playout point and stay in comfort noise
+static size_t enter_comfort(nade_jitter_t *jb, int16_t *out) {
+    nade_jitter_slot_t *slot = slot_for(jb, jb->next_seq);
+    nade_comfort_update(&jb->comfort, &slot->sid);
+    slot->valid = false;
+    jb->next_seq++;
+    jb->playing = true;
+    jb->in_comfort = true;
+    jb->conceal_run = 0;
+    return comfort_frame(jb, out);
+}
+
+// Move the playout point through a pause: it holds while the depth is at
+// or below the target and otherwise steps over missing slots and
+// descriptors, applying them, up to the first audio frame. Returns true
+// once that frame has a full prebuffer behind it.
+static bool comfort_ends(nade_jitter_t *jb) {
+    for (;;) {
+        int depth = nade_jitter_depth(jb);
+        nade_jitter_slot_t *slot = slot_for(jb, jb->next_seq);
+        bool held = slot_holds(jb, jb->next_seq);
+        if (held && !slot->comfort) {
+            return depth >= jb->target;
+        }
+        if (depth <= jb->target) {
+            return false;
+        }
+        if (held) {
+            nade_comfort_update(&jb->comfort, &slot->sid);
+            slot->valid = false;
+        }
+        jb->next_seq++;
+    }
+}
+
+size_t nade_jitter_pull(nade_jitter_t *jb, int16_t *out) {
+    if (!jb->started) {
+        return 0;
+    }
+    if (jb->in_comfort) {
+        if (!comfort_ends(jb)) {
+            return comfort_frame(jb, out);
+        }
+        jb->in_comfort = false;
+        jb->avg_depth = (float)nade_jitter_depth(jb);
+        jb->stretch_cooldown = STRETCH_COOLDOWN;
+    } else if (!jb->playing) {
+        skip_to_buffered(jb);
+        if (slot_holds(jb, jb->next_seq) && slot_for(jb, jb->next_seq)->comfort) {
+            // A pause needs no prebuffer
+            return enter_comfort(jb, out);
+        }
+        int depth = nade_jitter_depth(jb);
+        if (depth < jb->target || !slot_holds(jb, jb->next_seq)) {
+            return 0;
+        }
+        jb->playing = true;
+        jb->avg_depth = (float)depth;
+        jb->stretch_cooldown = STRETCH_COOLDOWN;
+    }
+
+    int depth = nade_jitter_depth(jb);
+    jb->avg_depth += ((float)depth - jb->avg_depth) * DEPTH_SMOOTHING;
+    if (jb->stretch_cooldown > 0) {
+        jb->stretch_cooldown--;
+    }
+
+    if (!slot_holds(jb, jb->next_seq)) {
+        if (jb->conceal_run >= NADE_JITTER_MAX_CONCEAL) {
+            // Long outage: resume at the next frame held, or refill first
+            skip_to_buffered(jb);
+            if (!slot_holds(jb, jb->next_seq)) {
+                jb->playing = false;
+                jb->conceal_run = 0;
+                jb->stats.rebuffers++;
+                return 0;
+            }
+        } else {
+            size_t produced = conceal_frame(jb, out);
+            jb->next_seq++;
+            return produced;
+        }
+    }
+
+    nade_jitter_slot_t *slot = slot_for(jb, jb->next_seq);
+    if (slot->comfort) {
+        return enter_comfort(jb, out);
+    }
+    int16_t *frame = slot->pcm;
+    if (jb->conceal_run > 0) {
+        int16_t tail[RECOVERY_SAMPLES * (NADE_JITTER_MAX_RATE / NADE_JITTER_BASE_RATE)];
+        size_t recovery = (size_t)(RECOVERY_SAMPLES * jb->rate_scale);
+        conceal_samples(jb, tail, recovery);
+        for (size_t i = 0; i < recovery; i++) {
+            float w = (float)i / (float)recovery;
+            frame[i] = clamp_sample((float)frame[i] * w + (float)tail[i] * (1.0f - w));
+        }
+        jb->conceal_run = 0;
+    }
+
+    size_t produced = (size_t)jb->frame_samples;
+    if (jb->stretch_cooldown == 0 && jb->avg_depth > (float)jb->target + 1.0f &&
+        depth > jb->target) {
+        produced = compress_frame(jb, frame, produced, out);
+        jb->stats.compressed++;
+        jb->stretch_cooldown = STRETCH_COOLDOWN;
+    } else if (jb->stretch_cooldown == 0 && jb->avg_depth < (float)jb->target - 1.0f) {
+        produced = expand_frame(jb, frame, produced, out);
+        jb->stats.expanded++;
+        jb->stretch_cooldown = STRETCH_COOLDOWN;
+    } else {
+        memcpy(out, frame, produced * sizeof(int16_t));
+    }
+    slot->valid = false;
+    jb->next_seq++;
+    jb->stats.frames_played++;
+    remember_output(jb, out, produced);
+    return produced;
+}
@@ -0,0 +1,194 @@
+/*
+ * Link adaptation implementation
+ *
+ * The error rate is the decayed sum of the reported symbol errors over the
+ * decayed sum of the reported codeword bytes, with one error assumed beyond
+ * those seen so that a few clean reports do not claim a perfect link. A
+ * report at more than twice the estimate replaces the history outright:
+ * fades come on faster than the decay would follow.
+ *
+ * Failed codewords only say that more than t symbols were wrong, so they
+ * count as t + 1 errors. Codeword lengths at the other levels are taken
+ * from the payload per codeword seen in the last report.
+ */
+
+#include "nade_link.h"
+
+#include <math.h>
+
+#define DEFAULT_LEVEL   2       // RS_PARITY_SIZE, what older peers use
+#define HISTORY_DECAY   0.5     // Weight of the history per report
+#define ATTACK_RATIO    2.0     // Report rate over the estimate that replaces it
+#define MAX_ERROR_RATE  0.5
+
+_Static_assert((RS_MIN_PARITY << DEFAULT_LEVEL) == RS_PARITY_SIZE, "default level must be RS_PARITY_SIZE");
+
+static uint32_t add_saturated(uint32_t a, uint64_t b) {
+    uint64_t sum = (uint64_t)a + b;
+    return sum > UINT32_MAX ? UINT32_MAX : (uint32_t)sum;
+}
+
+void nade_link_report_add(nade_link_report_t *report, const nade_fec_stats_t *stats) {
+    report->blocks = add_saturated(report->blocks, stats->blocks);
+    report->failed = add_saturated(report->failed, stats->uncorrectable);
+    report->errors = add_saturated(report->errors, stats->errors_seen);
+    report->coded_bytes = add_saturated(report->coded_bytes, stats->coded_bytes);
+}
+
+// Probability that more than t of n symbols are wrong at symbol error rate p.
+// Term k of the binomial distribution follows from term k - 1 by the ratio
+// (n - k + 1) / k * p / (1 - p).
+static double failure_probability(size_t n, double p, size_t t) {
+    if (p <= 0.0 || t >= n) {
+        return 0.0;
+    }
+    double q = 1.0 - p;
+    double term = pow(q, (double)n);
+    double tail = 0.0;
+    for (size_t k = 1; k <= n; k++) {
+        term *= (double)(n - k + 1) / (double)k * p / q;
+        if (k > t) {
+            tail += term;
+        }
+    }
+    return tail;
+}
+
+// Codeword length at a level for the payload bytes per codeword seen last
+static size_t level_block_len(const nade_link_ctl_t *ctl, int level) {
+    size_t len = ctl->block_data + rs_level_parity(level);
+    return len < RS_BLOCK_SIZE ? len : RS_BLOCK_SIZE;
+}
+
+static double level_failure(const nade_link_ctl_t *ctl, int level, double p) {
+    return failure_probability(level_block_len(ctl, level), p, rs_level_parity(level) / 2);
+}
+
+// Payload delivered per byte on air at a level
+static double level_throughput(const nade_link_ctl_t *ctl, int level, double p) {
+    size_t len = level_block_len(ctl, level);
+    size_t parity = rs_level_parity(level);
+    if (len <= parity) {
+        return 0.0;
+    }
+    return (1.0 - level_failure(ctl, level, p)) * (double)(len - parity) / (double)len;
+}
+
+// Strongest level delivering more than the current one at error rate p
+static int stronger_level(const nade_link_ctl_t *ctl, double p) {
+    int best = ctl->level;
+    for (int level = ctl->level + 1; level < RS_PARITY_LEVELS; level++) {
+        if (level_throughput(ctl, level, p) > level_throughput(ctl, best, p)) {
+            best = level;
+        }
+    }
+    return best;
+}
+
+// Lightest level failing at most target often at error rate p; the current
+// one if none lighter does
+static int lighter_level(const nade_link_ctl_t *ctl, double p, double target) {
+    for (int level = 0; level < ctl->level; level++) {
+        if (level_failure(ctl, level, p) <= target) {
+            return level;
+        }
+    }
+    return ctl->level;
+}
+
+// The modulation changed: earlier reports describe a different link, and
+// the next one straddles the change
+static void restart_estimate(nade_link_ctl_t *ctl) {
+    ctl->errors = 0.0;
+    ctl->bytes = 0.0;
+    ctl->calm_reports = 0;
+    ctl->hold_reports = 1;
+}
+
+void nade_link_ctl_reset(nade_link_ctl_t *ctl) {
+    ctl->level = DEFAULT_LEVEL;
+    ctl->rate_backoff = 0;
+    ctl->block_data = RS_BLOCK_SIZE - RS_PARITY_SIZE;
+    restart_estimate(ctl);
+    ctl->hold_reports = 0;
+}
+
+size_t nade_link_ctl_parity(const nade_link_ctl_t *ctl) {
+    return rs_level_parity(ctl->level);
+}
+
+double nade_link_ctl_error_rate(const nade_link_ctl_t *ctl) {
+    if (ctl->bytes <= 0.0) {
+        return 0.0;
+    }
+    double rate = (ctl->errors + 1.0) / (ctl->bytes + 1.0);
+    return rate < MAX_ERROR_RATE ? rate : MAX_ERROR_RATE;
+}
+
+bool nade_link_ctl_update(nade_link_ctl_t *ctl, const nade_link_report_t *report, int max_backoff) {
+    bool changed = false;
+    if (ctl->rate_backoff > max_backoff) {
+        // Fewer profiles in common than when the backoff was taken
+        ctl->rate_backoff = max_backoff > 0 ? max_backoff : 0;
+        changed = true;
+    }
+    if (report->blocks == 0 || report->coded_bytes == 0) {
+        return changed;
+    }
+    if (ctl->hold_reports > 0) {
+        ctl->hold_reports--;
+        return changed;
+    }
+    double sample = (double)report->errors / (double)report->coded_bytes;
+    if (ctl->bytes <= 0.0 || sample > ATTACK_RATIO * ctl->errors / ctl->bytes) {
+        ctl->errors = (double)report->errors;
+        ctl->bytes = (double)report->coded_bytes;
+    } else {
+        ctl->errors = ctl->errors * HISTORY_DECAY + (double)report->errors;
+        ctl->bytes = ctl->bytes * HISTORY_DECAY + (double)report->coded_bytes;
+    }
+    size_t block_len = report->coded_bytes / report->blocks;
+    size_t parity = nade_link_ctl_parity(ctl);
+    ctl->block_data = block_len > parity ? block_len - parity : 1;
+
+    double p = nade_link_ctl_error_rate(ctl);
+    if (level_failure(ctl, RS_PARITY_LEVELS - 1, p) > NADE_LINK_MAX_FAILURE) {
+        // The strongest code is not enough: slow the modulation down
+        ctl->calm_reports = 0;
+        changed |= ctl->level != RS_PARITY_LEVELS - 1;
+        ctl->level = RS_PARITY_LEVELS - 1;
+        if (ctl->rate_backoff < max_backoff) {
+            ctl->rate_backoff++;
+            restart_estimate(ctl);
+            changed = true;
+        }
+        return changed;
+    }
+    int stronger = stronger_level(ctl, p);
+    if (stronger > ctl->level) {
+        ctl->calm_reports = 0;
+        ctl->level = stronger;
+        return true;
+    }
+    int lighter = lighter_level(ctl, p, NADE_LINK_TARGET_FAILURE * NADE_LINK_RELAX_MARGIN);
+    if (lighter < ctl->level) {
+        if (++ctl->calm_reports >= NADE_LINK_RELAX_REPORTS) {
+            ctl->level = lighter;
+            ctl->calm_reports = 0;
+            changed = true;
+        }
+        return changed;
+    }
+    if (ctl->level == 0 && ctl->rate_backoff > 0) {
+        if (++ctl->calm_reports >= NADE_LINK_RATE_UP_REPORTS) {
+            // Try the faster profile again, from the default protection
+            ctl->rate_backoff--;
+            ctl->level = DEFAULT_LEVEL;
+            restart_estimate(ctl);
+            changed = true;
+        }
+        return changed;
+    }
+    ctl->calm_reports = 0;
+    return changed;
+}
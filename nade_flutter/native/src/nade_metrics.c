@@ -0,0 +1,100 @@
+/*
+ * Per-stage latency and throughput metrics implementation
+ *
+ * Recording is a handful of relaxed fetch-adds, cheap enough to leave on in
+ * the real-time paths. The maximum uses a compare-exchange loop that only
+ * retries while a larger value is being published.
+ */
+
+#include "nade_metrics.h"
+
+#include <string.h>
+#include <time.h>
+
+static size_t bucket_for(uint64_t value) {
+    size_t width = 0;
+    while (value != 0 && width < NADE_METRICS_BUCKETS - 1) {
+        value >>= 1;
+        width++;
+    }
+    return width;
+}
+
+void nade_histogram_record(nade_histogram_t *hist, uint64_t value) {
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->total, value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->buckets[bucket_for(value)], 1, memory_order_relaxed);
+    uint64_t seen = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(&hist->max, &seen, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void nade_histogram_snapshot(const nade_histogram_t *hist, nade_histogram_snapshot_t *out) {
+    // The atomics are only read; the casts drop const for older C11 libraries
+    nade_histogram_t *h = (nade_histogram_t *)hist;
+    out->count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    out->total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    out->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (size_t i = 0; i < NADE_METRICS_BUCKETS; i++) {
+        out->buckets[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+}
+
+void nade_histogram_reset(nade_histogram_t *hist) {
+    atomic_store_explicit(&hist->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&hist->total, 0, memory_order_relaxed);
+    atomic_store_explicit(&hist->max, 0, memory_order_relaxed);
+    for (size_t i = 0; i < NADE_METRICS_BUCKETS; i++) {
+        atomic_store_explicit(&hist->buckets[i], 0, memory_order_relaxed);
+    }
+}
+
+uint64_t nade_metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t flatten_histogram(const nade_histogram_snapshot_t *hist, int64_t *out) {
+    out[0] = (int64_t)hist->count;
+    out[1] = (int64_t)hist->total;
+    out[2] = (int64_t)hist->max;
+    for (size_t i = 0; i < NADE_METRICS_BUCKETS; i++) {
+        out[3 + i] = (int64_t)hist->buckets[i];
+    }
+    return NADE_METRICS_HIST_LEN;
+}
+
+size_t nade_metrics_flatten(const nade_metrics_t *metrics, int64_t *out, size_t max) {
+    if (!metrics || !out || max < NADE_METRICS_FLAT_LEN) {
+        return 0;
+    }
+    size_t n = 0;
+    out[n++] = (int64_t)metrics->version;
+    out[n++] = (int64_t)NADE_METRICS_FLAT_LEN;
+    for (size_t i = 0; i < NADE_METRICS_RING_COUNT; i++) {
+        out[n++] = (int64_t)metrics->rings[i].pushed;
+        out[n++] = (int64_t)metrics->rings[i].popped;
+        out[n++] = (int64_t)metrics->rings[i].dropped;
+        out[n++] = (int64_t)metrics->rings[i].high_water;
+    }
+    out[n++] = (int64_t)metrics->decrypt_failures;
+    out[n++] = (int64_t)metrics->handshakes;
+    out[n++] = (int64_t)metrics->handshake_last_ms;
+    out[n++] = (int64_t)metrics->handshake_max_ms;
+    out[n++] = (int64_t)metrics->frames_played;
+    out[n++] = (int64_t)metrics->frames_concealed;
+    out[n++] = (int64_t)metrics->late_dropped;
+    out[n++] = (int64_t)metrics->duplicates;
+    out[n++] = (int64_t)metrics->rebuffers;
+    out[n++] = (int64_t)metrics->expanded;
+    out[n++] = (int64_t)metrics->compressed;
+    for (size_t i = 0; i < NADE_STAGE_COUNT; i++) {
+        n += flatten_histogram(&metrics->stages[i], out + n);
+    }
+    n += flatten_histogram(&metrics->tx_frame_bytes, out + n);
+    n += flatten_histogram(&metrics->rx_frame_bytes, out + n);
+    return n;
+}
@@ -0,0 +1,262 @@
+/*
+ * Polyphase resampler implementation
+ *
+ * Output k sits at k * down on the upsampled time axis, which puts its
+ * newest input at floor(k * down / up) and selects phase k * down mod up:
+ * prototype taps phase, phase + up, phase + 2 up, ... weight that input and
+ * the ones before it. Each phase is stored reversed, oldest input first, so
+ * an output is one dot product over contiguous history.
+ *
+ * The dot product runs on a four-lane float vector (SSE, NEON, or a plain
+ * struct elsewhere, as in nade_goertzel.c) with two accumulators. The
+ * history is kept as float so no conversion sits in the inner loop.
+ */
+
+#include "nade_resample.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+
+typedef __m128 vf4;
+static inline vf4 vf4_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void vf4_store(float *p, vf4 v) { _mm_storeu_ps(p, v); }
+static inline vf4 vf4_zero(void) { return _mm_setzero_ps(); }
+static inline vf4 vf4_add(vf4 a, vf4 b) { return _mm_add_ps(a, b); }
+static inline vf4 vf4_mul(vf4 a, vf4 b) { return _mm_mul_ps(a, b); }
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+typedef float32x4_t vf4;
+static inline vf4 vf4_load(const float *p) { return vld1q_f32(p); }
+static inline void vf4_store(float *p, vf4 v) { vst1q_f32(p, v); }
+static inline vf4 vf4_zero(void) { return vdupq_n_f32(0.0f); }
+static inline vf4 vf4_add(vf4 a, vf4 b) { return vaddq_f32(a, b); }
+static inline vf4 vf4_mul(vf4 a, vf4 b) { return vmulq_f32(a, b); }
+#else
+typedef struct {
+    float v[4];
+} vf4;
+
+static inline vf4 vf4_load(const float *p) {
+    vf4 r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+static inline void vf4_store(float *p, vf4 a) { memcpy(p, a.v, sizeof(a.v)); }
+static inline vf4 vf4_zero(void) {
+    vf4 r = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    return r;
+}
+static inline vf4 vf4_add(vf4 a, vf4 b) {
+    for (int i = 0; i < 4; i++) a.v[i] += b.v[i];
+    return a;
+}
+static inline vf4 vf4_mul(vf4 a, vf4 b) {
+    for (int i = 0; i < 4; i++) a.v[i] *= b.v[i];
+    return a;
+}
+#endif
+
+#define BASE_TAPS       32      // Per phase when upsampling; more when the filter cuts below the input band
+#define PASSBAND        0.9     // Cutoff as a share of the lower Nyquist frequency
+#define KAISER_BETA     7.0     // About 70 dB stopband
+#define HISTORY_LEN     (NADE_RESAMPLE_MAX_TAPS + NADE_RESAMPLE_CHUNK)
+
+static int gcd_int(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Taps per phase for the reduced ratio up / down
+static int phase_taps(int up, int down) {
+    int taps = up >= down ? BASE_TAPS : (BASE_TAPS * down + up - 1) / up;
+    return (taps + 3) & ~3;
+}
+
+static bool reduce_rates(int in_rate, int out_rate, int *up, int *down) {
+    if (in_rate < NADE_RESAMPLE_MIN_RATE || in_rate > NADE_RESAMPLE_MAX_RATE ||
+        out_rate < NADE_RESAMPLE_MIN_RATE || out_rate > NADE_RESAMPLE_MAX_RATE) {
+        return false;
+    }
+    int g = gcd_int(in_rate, out_rate);
+    *up = out_rate / g;
+    *down = in_rate / g;
+    int taps = phase_taps(*up, *down);
+    return taps <= NADE_RESAMPLE_MAX_TAPS && (long)*up * taps <= NADE_RESAMPLE_MAX_COEFFS;
+}
+
+// Zeroth-order modified Bessel function of the first kind, by its series
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double half = x / 2.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+        term *= (half / k) * (half / k);
+        sum += term;
+    }
+    return sum;
+}
+
+static void design_filter(nade_resampler_t *rs) {
+    int up = rs->up;
+    int taps = rs->taps;
+    int length = up * taps;
+    // Cycles per sample at the upsampled rate
+    double cutoff = PASSBAND * 0.5 / (double)(up > rs->down ? up : rs->down);
+    double center = (double)(length - 1) / 2.0;
+    double norm = bessel_i0(KAISER_BETA);
+    double sum = 0.0;
+    for (int n = 0; n < length; n++) {
+        double t = (double)n - center;
+        double x = 2.0 * cutoff * t;
+        double sinc = t == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+        double r = length > 1 ? 2.0 * (double)n / (double)(length - 1) - 1.0 : 0.0;
+        double window = bessel_i0(KAISER_BETA * sqrt(1.0 - r * r)) / norm;
+        double h = 2.0 * cutoff * sinc * window;
+        // Tap n weights the input n / up samples before the newest, in phase n % up
+        int phase = n % up;
+        int age = n / up;
+        rs->coeffs[phase * taps + (taps - 1 - age)] = (float)h;
+        sum += h;
+    }
+    // Unity gain at DC for every phase: the taps of one phase sum to about sum / up
+    float scale = (float)((double)up / sum);
+    for (int i = 0; i < length; i++) {
+        rs->coeffs[i] *= scale;
+    }
+}
+
+bool nade_resampler_supported(int in_rate, int out_rate) {
+    int up;
+    int down;
+    return reduce_rates(in_rate, out_rate, &up, &down);
+}
+
+void nade_resampler_reset(nade_resampler_t *rs) {
+    // Start from silence, so the first output is the first input filtered
+    rs->fill = rs->taps - 1;
+    rs->pos = rs->taps - 1;
+    rs->phase = 0;
+    memset(rs->history, 0, sizeof(rs->history));
+}
+
+bool nade_resampler_init(nade_resampler_t *rs, int in_rate, int out_rate) {
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    int up;
+    int down;
+    bool supported = reduce_rates(in_rate, out_rate, &up, &down);
+    if (!supported || up == down) {
+        rs->up = 1;
+        rs->down = 1;
+        rs->taps = 1;
+        rs->coeffs[0] = 1.0f;
+    } else {
+        rs->up = up;
+        rs->down = down;
+        rs->taps = phase_taps(up, down);
+        design_filter(rs);
+    }
+    nade_resampler_reset(rs);
+    return supported;
+}
+
+bool nade_resampler_matches(const nade_resampler_t *rs, int in_rate, int out_rate) {
+    return rs->in_rate == in_rate && rs->out_rate == out_rate;
+}
+
+size_t nade_resampler_output_len(const nade_resampler_t *rs, size_t count) {
+    if (rs->up == rs->down) {
+        return count;
+    }
+    // Inputs still missing for the next output
+    long needed = (long)rs->pos - rs->fill + 1;
+    if ((long)count < needed) {
+        return 0;
+    }
+    long spare = (long)count - needed;
+    return (size_t)(((spare + 1) * rs->up - rs->phase + rs->down - 1) / rs->down);
+}
+
+size_t nade_resampler_input_len(const nade_resampler_t *rs, size_t count) {
+    if (rs->up == rs->down || count == 0) {
+        return count;
+    }
+    long newest = (long)rs->pos + ((long)rs->phase + (long)(count - 1) * rs->down) / rs->up;
+    long needed = newest - rs->fill + 1;
+    return needed > 0 ? (size_t)needed : 0;
+}
+
+static float dot(const float *a, const float *b, int n) {
+    vf4 acc0 = vf4_zero();
+    vf4 acc1 = vf4_zero();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vf4_add(acc0, vf4_mul(vf4_load(a + i), vf4_load(b + i)));
+        acc1 = vf4_add(acc1, vf4_mul(vf4_load(a + i + 4), vf4_load(b + i + 4)));
+    }
+    if (i < n) {
+        acc0 = vf4_add(acc0, vf4_mul(vf4_load(a + i), vf4_load(b + i)));
+    }
+    float lanes[4];
+    vf4_store(lanes, vf4_add(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+static int16_t to_sample(float value) {
+    if (value > 32767.0f) return 32767;
+    if (value < -32768.0f) return -32768;
+    return (int16_t)lrintf(value);
+}
+
+size_t nade_resampler_process(nade_resampler_t *rs, const int16_t *in, size_t count, int16_t *out) {
+    if (rs->up == rs->down) {
+        memmove(out, in, count * sizeof(int16_t));
+        return count;
+    }
+    const int taps = rs->taps;
+    size_t produced = 0;
+    while (count > 0) {
+        size_t take = (size_t)(HISTORY_LEN - rs->fill);
+        if (take > count) {
+            take = count;
+        }
+        for (size_t i = 0; i < take; i++) {
+            rs->history[rs->fill + (int)i] = (float)in[i];
+        }
+        rs->fill += (int)take;
+        in += take;
+        count -= take;
+
+        while (rs->pos < rs->fill) {
+            const float *h = rs->coeffs + rs->phase * taps;
+            out[produced++] = to_sample(dot(h, rs->history + rs->pos - taps + 1, taps));
+            rs->phase += rs->down;
+            rs->pos += rs->phase / rs->up;
+            rs->phase %= rs->up;
+        }
+
+        // Keep the taps - 1 inputs before the next output's newest one
+        int shift = rs->pos - (taps - 1);
+        if (shift > rs->fill) {
+            shift = rs->fill;
+        }
+        if (shift > 0) {
+            memmove(rs->history, rs->history + shift, (size_t)(rs->fill - shift) * sizeof(float));
+            rs->fill -= shift;
+            rs->pos -= shift;
+        }
+    }
+    return produced;
+}
@@ -0,0 +1,257 @@
+/*
+ * Wait-free single-producer/single-consumer ring buffer implementation
+ *
+ * Memory ordering: the producer publishes data with a release store of
+ * write_idx, the consumer observes it with an acquire load (and vice versa
+ * for read_idx), so element copies never race with index updates.
+ */
+
+#include "nade_ring.h"
+#include <string.h>
+
+// Stands in for the storage of a ring without any, so views still point
+// somewhere; with capacity 0 nothing is ever copied through it
+static uint8_t g_no_storage[1];
+
+static bool valid_storage(const void *storage, size_t capacity) {
+    return storage ? NADE_RING_IS_POW2(capacity) : capacity == 0;
+}
+
+static void set_storage(nade_ring_t *ring, void *storage, size_t capacity) {
+    ring->storage = storage ? (uint8_t *)storage : g_no_storage;
+    ring->capacity = capacity;
+    ring->mask = storage ? capacity - 1 : 0;
+}
+
+bool nade_ring_init(nade_ring_t *ring, void *storage, size_t capacity, size_t elem_size) {
+    if (!ring || elem_size == 0 || !valid_storage(storage, capacity)) {
+        return false;
+    }
+    ring->elem_size = elem_size;
+    set_storage(ring, storage, capacity);
+    atomic_store_explicit(&ring->write_idx, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->dropped, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->high_water, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->read_idx, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->discard_to, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->discard_pending, false, memory_order_release);
+    return true;
+}
+
+bool nade_ring_rebind(nade_ring_t *ring, void *storage, size_t capacity) {
+    if (!ring || !valid_storage(storage, capacity)) {
+        return false;
+    }
+    set_storage(ring, storage, capacity);
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_relaxed);
+    atomic_store_explicit(&ring->read_idx, write, memory_order_relaxed);
+    atomic_store_explicit(&ring->high_water, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->discard_pending, false, memory_order_release);
+    return true;
+}
+
+// Readable start index, taking a posted-but-unapplied discard into account
+static size_t effective_read_idx(nade_ring_t *ring, size_t read, size_t write) {
+    if (!atomic_load_explicit(&ring->discard_pending, memory_order_acquire)) {
+        return read;
+    }
+    size_t mark = atomic_load_explicit(&ring->discard_to, memory_order_relaxed);
+    // Only move forward, and never past the producer
+    if (mark - read <= write - read) {
+        return mark;
+    }
+    return read;
+}
+
+// Consumer-side: apply a pending discard request, return current read index
+static size_t consumer_read_idx(nade_ring_t *ring) {
+    size_t read = atomic_load_explicit(&ring->read_idx, memory_order_relaxed);
+    if (atomic_exchange_explicit(&ring->discard_pending, false, memory_order_acquire)) {
+        size_t mark = atomic_load_explicit(&ring->discard_to, memory_order_relaxed);
+        size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+        if (mark - read <= write - read) {
+            read = mark;
+            atomic_store_explicit(&ring->read_idx, read, memory_order_release);
+        }
+    }
+    return read;
+}
+
+static void copy_out(const nade_ring_t *ring, size_t read, void *dst, size_t count) {
+    size_t es = ring->elem_size;
+    size_t offset = read & ring->mask;
+    size_t first = ring->capacity - offset;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(dst, ring->storage + offset * es, first * es);
+    if (count > first) {
+        memcpy((uint8_t *)dst + first * es, ring->storage, (count - first) * es);
+    }
+}
+
+size_t nade_ring_push(nade_ring_t *ring, const void *src, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_relaxed);
+    size_t read = atomic_load_explicit(&ring->read_idx, memory_order_acquire);
+    size_t space = ring->capacity - (write - read);
+    if (count > space) {
+        atomic_fetch_add_explicit(&ring->dropped, count - space, memory_order_relaxed);
+        count = space;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    size_t es = ring->elem_size;
+    size_t offset = write & ring->mask;
+    size_t first = ring->capacity - offset;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(ring->storage + offset * es, src, first * es);
+    if (count > first) {
+        memcpy(ring->storage, (const uint8_t *)src + first * es, (count - first) * es);
+    }
+    atomic_store_explicit(&ring->write_idx, write + count, memory_order_release);
+    // Only the producer raises the mark, so a plain load/store pair suffices
+    size_t held = write + count - read;
+    if (held > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, held, memory_order_relaxed);
+    }
+    return count;
+}
+
+size_t nade_ring_pop(nade_ring_t *ring, void *dst, size_t max) {
+    size_t read = consumer_read_idx(ring);
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    size_t available = write - read;
+    if (available > max) {
+        available = max;
+    }
+    if (available == 0) {
+        return 0;
+    }
+    copy_out(ring, read, dst, available);
+    atomic_store_explicit(&ring->read_idx, read + available, memory_order_release);
+    return available;
+}
+
+bool nade_ring_peek(nade_ring_t *ring, void *dst, size_t count) {
+    size_t read = consumer_read_idx(ring);
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    if (write - read < count) {
+        return false;
+    }
+    if (count > 0) {
+        copy_out(ring, read, dst, count);
+    }
+    return true;
+}
+
+size_t nade_ring_read_view(nade_ring_t *ring, nade_ring_view_t *view) {
+    size_t read = consumer_read_idx(ring);
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    size_t available = write - read;
+    size_t offset = read & ring->mask;
+    size_t first = ring->capacity - offset;
+    if (first > available) {
+        first = available;
+    }
+    view->first = ring->storage + offset * ring->elem_size;
+    view->first_count = first;
+    view->second = available > first ? ring->storage : NULL;
+    view->second_count = available - first;
+    view->start = read;
+    return available;
+}
+
+void nade_ring_release_view(nade_ring_t *ring, const nade_ring_view_t *view, size_t count) {
+    size_t mapped = view->first_count + view->second_count;
+    if (count > mapped) {
+        count = mapped;
+    }
+    if (count > 0) {
+        atomic_store_explicit(&ring->read_idx, view->start + count, memory_order_release);
+    }
+}
+
+size_t nade_ring_skip(nade_ring_t *ring, size_t count) {
+    size_t read = consumer_read_idx(ring);
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    size_t available = write - read;
+    if (count > available) {
+        count = available;
+    }
+    if (count > 0) {
+        atomic_store_explicit(&ring->read_idx, read + count, memory_order_release);
+    }
+    return count;
+}
+
+size_t nade_ring_write_view(nade_ring_t *ring, nade_ring_view_t *view) {
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_relaxed);
+    size_t read = atomic_load_explicit(&ring->read_idx, memory_order_acquire);
+    size_t space = ring->capacity - (write - read);
+    size_t offset = write & ring->mask;
+    size_t first = ring->capacity - offset;
+    if (first > space) {
+        first = space;
+    }
+    view->first = ring->storage + offset * ring->elem_size;
+    view->first_count = first;
+    view->second = space > first ? ring->storage : NULL;
+    view->second_count = space - first;
+    view->start = write;
+    return space;
+}
+
+void nade_ring_commit_view(nade_ring_t *ring, const nade_ring_view_t *view, size_t count) {
+    size_t mapped = view->first_count + view->second_count;
+    if (count > mapped) {
+        count = mapped;
+    }
+    if (count == 0) {
+        return;
+    }
+    size_t write = view->start + count;
+    atomic_store_explicit(&ring->write_idx, write, memory_order_release);
+    size_t held = ring->capacity - mapped + count;
+    if (held > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, held, memory_order_relaxed);
+    }
+}
+
+void nade_ring_note_dropped(nade_ring_t *ring, size_t count) {
+    atomic_fetch_add_explicit(&ring->dropped, count, memory_order_relaxed);
+}
+
+size_t nade_ring_size(nade_ring_t *ring) {
+    size_t read = atomic_load_explicit(&ring->read_idx, memory_order_acquire);
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    return write - effective_read_idx(ring, read, write);
+}
+
+size_t nade_ring_free(nade_ring_t *ring) {
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    size_t read = atomic_load_explicit(&ring->read_idx, memory_order_acquire);
+    return ring->capacity - (write - read);
+}
+
+void nade_ring_request_discard(nade_ring_t *ring) {
+    size_t write = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    atomic_store_explicit(&ring->discard_to, write, memory_order_relaxed);
+    atomic_store_explicit(&ring->discard_pending, true, memory_order_release);
+}
+
+void nade_ring_get_stats(nade_ring_t *ring, nade_ring_stats_t *stats) {
+    stats->popped = atomic_load_explicit(&ring->read_idx, memory_order_acquire);
+    stats->pushed = atomic_load_explicit(&ring->write_idx, memory_order_acquire);
+    stats->dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+}
+
+void nade_ring_reset_high_water(nade_ring_t *ring) {
+    atomic_store_explicit(&ring->high_water, nade_ring_size(ring), memory_order_relaxed);
+}
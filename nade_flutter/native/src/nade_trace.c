@@ -0,0 +1,86 @@
+/*
+ * Fixed-size binary event trace implementation
+ *
+ * Each slot is a small seqlock. The writer that claimed record n marks the
+ * slot 2n+1 (busy), stores the fields and publishes 2n+2. A reader accepts
+ * a slot only if it sees 2n+2 both before and after copying the fields, so
+ * a record being overwritten by a writer that lapped the ring is skipped
+ * rather than returned torn.
+ */
+
+#include "nade_trace.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+#define TRACE_MASK (NADE_TRACE_CAPACITY - 1)
+
+_Static_assert((NADE_TRACE_CAPACITY & TRACE_MASK) == 0, "trace capacity must be a power of two");
+
+typedef struct {
+    _Atomic uint64_t seq;
+    _Atomic uint64_t time_ns;
+    _Atomic uint32_t event;
+    _Atomic uint32_t arg0;
+    _Atomic uint32_t arg1;
+} trace_slot_t;
+
+static trace_slot_t g_trace[NADE_TRACE_CAPACITY];
+static _Atomic uint64_t g_trace_head;   // Records ever claimed
+static _Atomic uint64_t g_trace_floor;  // Records before this were cleared
+
+static uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void nade_trace_record(uint32_t event, uint32_t arg0, uint32_t arg1) {
+    uint64_t n = atomic_fetch_add_explicit(&g_trace_head, 1, memory_order_relaxed);
+    trace_slot_t *slot = &g_trace[n & TRACE_MASK];
+    atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->time_ns, trace_now_ns(), memory_order_relaxed);
+    atomic_store_explicit(&slot->event, event, memory_order_relaxed);
+    atomic_store_explicit(&slot->arg0, arg0, memory_order_relaxed);
+    atomic_store_explicit(&slot->arg1, arg1, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+}
+
+size_t nade_trace_dump(nade_trace_record_t *out, size_t max) {
+    if (!out || max == 0) {
+        return 0;
+    }
+    uint64_t head = atomic_load_explicit(&g_trace_head, memory_order_acquire);
+    uint64_t start = atomic_load_explicit(&g_trace_floor, memory_order_relaxed);
+    if (head - start > NADE_TRACE_CAPACITY) {
+        start = head - NADE_TRACE_CAPACITY;
+    }
+    if (head - start > max) {
+        start = head - max;
+    }
+    size_t count = 0;
+    for (uint64_t n = start; n < head; n++) {
+        trace_slot_t *slot = &g_trace[n & TRACE_MASK];
+        uint64_t done = 2 * n + 2;
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != done) {
+            continue;   // Still being written, or already overwritten
+        }
+        nade_trace_record_t record;
+        record.time_ns = atomic_load_explicit(&slot->time_ns, memory_order_relaxed);
+        record.event = atomic_load_explicit(&slot->event, memory_order_relaxed);
+        record.arg0 = atomic_load_explicit(&slot->arg0, memory_order_relaxed);
+        record.arg1 = atomic_load_explicit(&slot->arg1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != done) {
+            continue;
+        }
+        out[count++] = record;
+    }
+    return count;
+}
+
+void nade_trace_clear(void) {
+    atomic_store_explicit(&g_trace_floor, atomic_load_explicit(&g_trace_head, memory_order_acquire),
+                          memory_order_relaxed);
+}
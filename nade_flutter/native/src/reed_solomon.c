@@ -5,23 +5,60 @@
  * This is the same field used by CCSDS, DVB, and QR codes.
  * 
  * Can correct up to 16 byte errors per 255-byte block.
- * Supports shortened codes for smaller packets.
+ * Supports shortened codes for smaller packets, and 8, 16 or 64 parity
+ * bytes in place of the default 32.
+ *
+ * Erasures are folded out of the syndromes before Berlekamp-Massey (the
+ * Forney syndromes) and back into its locator afterwards, so the rest of
+ * the decoder runs unchanged on errors and erasures alike.
  */
 
 #include "reed_solomon.h"
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define RS_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || (defined(__ARM_NEON) && defined(__arm__))
+#define RS_HAVE_NEON_KERNEL 1
+#include <arm_neon.h>
+#endif
+
 // Primitive polynomial: x^8 + x^4 + x^3 + x^2 + 1 = 0x11D
 #define RS_PRIMITIVE_POLY   0x11D
 #define RS_FIELD_SIZE       256     // 2^8 elements in GF(2^8)
-#define RS_GENERATOR_ROOT   2       // First consecutive root (alpha^1)
+#define RS_GENERATOR_ROOT   2       // Exponent of the first consecutive root (alpha^2)
 
 // Galois Field lookup tables
 static uint8_t gf_exp[512];     // Anti-log table (extended for easy multiplication)
 static uint8_t gf_log[256];     // Log table
-static uint8_t gf_generator[RS_PARITY_SIZE + 1];  // Generator polynomial coefficients
+// Generator polynomial coefficients per parity level
+static uint8_t gf_generator[RS_PARITY_LEVELS][RS_MAX_PARITY + 1];
 static bool rs_initialized = false;
 
+// Fast-path tables, built by rs_init
+// Encoder rows of level l start at gf_gen_table + 256 * (levels below l).
+// Row f holds the product of feedback byte f and the generator tap that
+// feeds each parity register, so one encoder step is a shift and XOR.
+#define RS_GEN_TABLE_SIZE (256 * RS_MIN_PARITY * ((1 << RS_PARITY_LEVELS) - 1))
+static uint8_t gf_gen_table[RS_GEN_TABLE_SIZE];
+static const uint8_t *gf_gen_rows[RS_PARITY_LEVELS];
+// gf_root_mul[i][x] = x * alpha^(RS_GENERATOR_ROOT + i)
+static uint8_t gf_root_mul[RS_MAX_PARITY][256];
+// gf_step[k][i]: split-nibble tables for x * alpha^((RS_GENERATOR_ROOT + i) << k),
+// the 16 low-nibble products followed by the 16 high-nibble products.
+#define RS_STEP_LEVELS 6
+static uint8_t gf_step[RS_STEP_LEVELS][RS_MAX_PARITY][32];
+
+typedef void (*rs_encode_fn)(const uint8_t *data, size_t data_len, int level, uint8_t *parity);
+typedef void (*rs_syndrome_fn)(const uint8_t *codeword, size_t len, int count, uint8_t *syndromes);
+
+static rs_kernel_t rs_active_kernel = RS_KERNEL_REFERENCE;
+static rs_encode_fn rs_encode_impl;
+static rs_syndrome_fn rs_syndrome_impl;
+
 // -------------------------------------------------------------------------
 // Galois Field GF(2^8) Arithmetic
 // -------------------------------------------------------------------------
@@ -97,16 +134,27 @@ static uint8_t poly_eval(const uint8_t *poly, int degree, int n) {
 }
 
 // -------------------------------------------------------------------------
-// Generator Polynomial
-// g(x) = (x - α^1)(x - α^2)...(x - α^32)
+// Generator Polynomials
+// g(x) = (x - α^2)(x - α^3)...(x - α^(parity+1)), one per parity level
 // -------------------------------------------------------------------------
 
-static void build_generator(void) {
-    memset(gf_generator, 0, sizeof(gf_generator));
-    gf_generator[0] = 1;  // Start with 1
+// Level of a supported parity size, or -1
+static int parity_level(size_t parity) {
+    for (int level = 0; level < RS_PARITY_LEVELS; level++) {
+        if (rs_level_parity(level) == parity) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+static void build_generator(int level, uint8_t *generator) {
+    int parity = (int)rs_level_parity(level);
+    memset(generator, 0, RS_MAX_PARITY + 1);
+    generator[0] = 1;  // Start with 1
     
-    for (int i = 0; i < RS_PARITY_SIZE; i++) {
-        poly_mul_term(gf_generator, i, RS_GENERATOR_ROOT + i);
+    for (int i = 0; i < parity; i++) {
+        poly_mul_term(generator, i, RS_GENERATOR_ROOT + i);
     }
 }
 
@@ -114,87 +162,378 @@ static void build_generator(void) {
 // Reed-Solomon Encoding
 // -------------------------------------------------------------------------
 
-void rs_init(void) {
-    if (rs_initialized) return;
-    gf_init();
-    build_generator();
-    rs_initialized = true;
-}
-
-size_t rs_encode(const uint8_t *data, size_t data_len, uint8_t *out) {
-    if (!rs_initialized) rs_init();
-    if (data_len == 0 || data_len > RS_DATA_SIZE) {
-        return 0;
-    }
-    
-    // Copy data to output
-    memcpy(out, data, data_len);
-    
+// Reference encoder: LFSR division with gf_mul per tap
+static void encode_reference(const uint8_t *data, size_t data_len, int level, uint8_t *parity) {
+    const int n = (int)rs_level_parity(level);
+    const uint8_t *generator = gf_generator[level];
     // Initialize parity bytes to zero
-    memset(out + data_len, 0, RS_PARITY_SIZE);
+    memset(parity, 0, (size_t)n);
     
     // Systematic encoding: divide message polynomial by generator
     // This computes remainder which becomes the parity
     uint8_t feedback;
     for (size_t i = 0; i < data_len; i++) {
-        feedback = out[i] ^ out[data_len];
+        feedback = data[i] ^ parity[0];
         if (feedback != 0) {
-            for (int j = 1; j < RS_PARITY_SIZE; j++) {
-                out[data_len + j - 1] = out[data_len + j] ^ gf_mul(feedback, gf_generator[RS_PARITY_SIZE - j]);
+            for (int j = 1; j < n; j++) {
+                parity[j - 1] = parity[j] ^ gf_mul(feedback, generator[n - j]);
             }
-            out[data_len + RS_PARITY_SIZE - 1] = gf_mul(feedback, gf_generator[0]);
+            parity[n - 1] = gf_mul(feedback, generator[0]);
         } else {
             // Shift parity registers
-            memmove(out + data_len, out + data_len + 1, RS_PARITY_SIZE - 1);
-            out[data_len + RS_PARITY_SIZE - 1] = 0;
+            memmove(parity, parity + 1, (size_t)(n - 1));
+            parity[n - 1] = 0;
+        }
+    }
+}
+
+// Table encoder: one row lookup per input byte, no branches. Inlined once
+// per level so the register shift has a constant length.
+static inline __attribute__((always_inline))
+void encode_rows(const uint8_t *data, size_t data_len, const uint8_t *rows, int n, uint8_t *parity) {
+    uint8_t reg[RS_MAX_PARITY + 1];
+    memset(reg, 0, sizeof(reg));
+    for (size_t i = 0; i < data_len; i++) {
+        const uint8_t *row = rows + (size_t)(data[i] ^ reg[0]) * (size_t)n;
+        for (int j = 0; j < n; j++) {
+            reg[j] = reg[j + 1] ^ row[j];
         }
     }
+    memcpy(parity, reg, (size_t)n);
+}
+
+static void encode_table(const uint8_t *data, size_t data_len, int level, uint8_t *parity) {
+    const uint8_t *rows = gf_gen_rows[level];
+    switch (level) {
+        case 0: encode_rows(data, data_len, rows, 8, parity); break;
+        case 1: encode_rows(data, data_len, rows, 16, parity); break;
+        case 2: encode_rows(data, data_len, rows, 32, parity); break;
+        default: encode_rows(data, data_len, rows, 64, parity); break;
+    }
+}
+
+size_t rs_encode_parity(const uint8_t *data, size_t data_len, size_t parity, uint8_t *out) {
+    if (!rs_initialized) rs_init();
+    int level = parity_level(parity);
+    if (level < 0 || data_len == 0 || data_len > RS_BLOCK_SIZE - parity) {
+        return 0;
+    }
     
-    return data_len + RS_PARITY_SIZE;
+    // Copy data to output
+    memcpy(out, data, data_len);
+    rs_encode_impl(out, data_len, level, out + data_len);
+    
+    return data_len + parity;
+}
+
+size_t rs_encode(const uint8_t *data, size_t data_len, uint8_t *out) {
+    return rs_encode_parity(data, data_len, RS_PARITY_SIZE, out);
 }
 
 // -------------------------------------------------------------------------
-// Reed-Solomon Decoding (Berlekamp-Massey + Forney)
+// Syndrome Kernels
+// The encoder emits codeword[0] as the highest-degree coefficient, so each
+// syndrome is c(alpha^(2+i)) evaluated by Horner's rule in transmit order.
+// Virtual leading zeros of a shortened code contribute nothing.
 // -------------------------------------------------------------------------
 
-// Compute syndromes S_1 through S_32
-static void compute_syndromes(const uint8_t *codeword, size_t len, uint8_t *syndromes) {
-    // For shortened codes, we need to account for virtual leading zeros
-    size_t pad = RS_BLOCK_SIZE - len;
-    
-    for (int i = 0; i < RS_PARITY_SIZE; i++) {
-        uint8_t sum = 0;
-        uint8_t alpha_power = 1;
+// Reference: one gf_mul Horner pass per syndrome
+static void syndromes_reference(const uint8_t *codeword, size_t len, int count, uint8_t *syndromes) {
+    for (int i = 0; i < count; i++) {
         uint8_t alpha = gf_exp[RS_GENERATOR_ROOT + i];
-        
-        // Account for shortened code (virtual leading zeros)
-        for (size_t j = 0; j < pad; j++) {
-            alpha_power = gf_mul(alpha_power, alpha);
-        }
-        
-        // Evaluate at alpha^(i+1)
+        uint8_t sum = 0;
         for (size_t j = 0; j < len; j++) {
-            sum ^= gf_mul(codeword[j], alpha_power);
-            alpha_power = gf_mul(alpha_power, alpha);
+            sum = gf_mul(sum, alpha) ^ codeword[j];
         }
         syndromes[i] = sum;
     }
 }
 
+// Table: a single pass over the codeword updating all syndromes
+static void syndromes_table(const uint8_t *codeword, size_t len, int count, uint8_t *syndromes) {
+    uint8_t s[RS_MAX_PARITY];
+    memset(s, 0, sizeof(s));
+    for (size_t j = 0; j < len; j++) {
+        uint8_t c = codeword[j];
+        for (int i = 0; i < count; i++) {
+            s[i] = gf_root_mul[i][s[i]] ^ c;
+        }
+    }
+    memcpy(syndromes, s, (size_t)count);
+}
+
+// The vector kernels run Horner over width-byte blocks: lane l accumulates
+// every width-th byte with step alpha_i^width, which is the same constant in
+// every lane and so maps onto a split-nibble table lookup. Lane l then still
+// needs a factor alpha_i^(width-1-l); halving the lanes with
+// lane[l] = lane[l] * alpha_i^(width/2) ^ lane[l + width/2] folds them down to
+// lane 0 in log2(width) more lookups. A short leading block is zero-padded on
+// the left, which Horner treats as extra leading zeros.
+static size_t load_head_block(const uint8_t *codeword, size_t len, size_t width, uint8_t *head) {
+    size_t partial = len % width;
+    memset(head, 0, width);
+    if (partial > 0) {
+        memcpy(head + width - partial, codeword, partial);
+    }
+    return partial;
+}
+
+#if RS_HAVE_X86_KERNELS
+
+__attribute__((target("ssse3")))
+static inline __m128i gf_mul_ssse3(__m128i v, const uint8_t *tab) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i lo = _mm_loadu_si128((const __m128i *)tab);
+    const __m128i hi = _mm_loadu_si128((const __m128i *)(tab + 16));
+    return _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(v, nibble)),
+                         _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(v, 4), nibble)));
+}
+
+__attribute__((target("ssse3")))
+static inline uint8_t fold16_ssse3(__m128i acc, int i) {
+    acc = _mm_xor_si128(gf_mul_ssse3(acc, gf_step[3][i]), _mm_srli_si128(acc, 8));
+    acc = _mm_xor_si128(gf_mul_ssse3(acc, gf_step[2][i]), _mm_srli_si128(acc, 4));
+    acc = _mm_xor_si128(gf_mul_ssse3(acc, gf_step[1][i]), _mm_srli_si128(acc, 2));
+    acc = _mm_xor_si128(gf_mul_ssse3(acc, gf_step[0][i]), _mm_srli_si128(acc, 1));
+    return (uint8_t)_mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("ssse3")))
+static void syndromes_ssse3(const uint8_t *codeword, size_t len, int count, uint8_t *syndromes) {
+    uint8_t head[16];
+    size_t partial = load_head_block(codeword, len, 16, head);
+    const uint8_t *body = codeword + partial;
+    size_t blocks = len / 16;
+    for (int i = 0; i < count; i++) {
+        const uint8_t *step = gf_step[4][i];
+        __m128i acc = _mm_loadu_si128((const __m128i *)head);
+        for (size_t b = 0; b < blocks; b++) {
+            acc = _mm_xor_si128(gf_mul_ssse3(acc, step),
+                                _mm_loadu_si128((const __m128i *)(body + b * 16)));
+        }
+        syndromes[i] = fold16_ssse3(acc, i);
+    }
+}
+
+__attribute__((target("avx2")))
+static void syndromes_avx2(const uint8_t *codeword, size_t len, int count, uint8_t *syndromes) {
+    uint8_t head[32];
+    size_t partial = load_head_block(codeword, len, 32, head);
+    const uint8_t *body = codeword + partial;
+    size_t blocks = len / 32;
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    for (int i = 0; i < count; i++) {
+        const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)gf_step[5][i]));
+        const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(gf_step[5][i] + 16)));
+        __m256i acc = _mm256_loadu_si256((const __m256i *)head);
+        for (size_t b = 0; b < blocks; b++) {
+            __m256i prod = _mm256_xor_si256(
+                _mm256_shuffle_epi8(lo, _mm256_and_si256(acc, nibble)),
+                _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(acc, 4), nibble)));
+            acc = _mm256_xor_si256(prod, _mm256_loadu_si256((const __m256i *)(body + b * 32)));
+        }
+        // Lanes 0-15 are the higher-degree half
+        __m128i upper = _mm256_castsi256_si128(acc);
+        __m128i lower = _mm256_extracti128_si256(acc, 1);
+        syndromes[i] = fold16_ssse3(_mm_xor_si128(gf_mul_ssse3(upper, gf_step[4][i]), lower), i);
+    }
+}
+
+#endif // RS_HAVE_X86_KERNELS
+
+#if RS_HAVE_NEON_KERNEL
+
+static inline uint8x16_t neon_lookup16(uint8x16_t table, uint8x16_t idx) {
+#if defined(__aarch64__)
+    return vqtbl1q_u8(table, idx);
+#else
+    uint8x8x2_t t = {{vget_low_u8(table), vget_high_u8(table)}};
+    return vcombine_u8(vtbl2_u8(t, vget_low_u8(idx)), vtbl2_u8(t, vget_high_u8(idx)));
+#endif
+}
+
+static inline uint8x16_t gf_mul_neon(uint8x16_t v, const uint8_t *tab) {
+    return veorq_u8(neon_lookup16(vld1q_u8(tab), vandq_u8(v, vdupq_n_u8(0x0F))),
+                    neon_lookup16(vld1q_u8(tab + 16), vshrq_n_u8(v, 4)));
+}
+
+static void syndromes_neon(const uint8_t *codeword, size_t len, int count, uint8_t *syndromes) {
+    uint8_t head[16];
+    size_t partial = load_head_block(codeword, len, 16, head);
+    const uint8_t *body = codeword + partial;
+    size_t blocks = len / 16;
+    const uint8x16_t zero = vdupq_n_u8(0);
+    for (int i = 0; i < count; i++) {
+        const uint8_t *step = gf_step[4][i];
+        uint8x16_t acc = vld1q_u8(head);
+        for (size_t b = 0; b < blocks; b++) {
+            acc = veorq_u8(gf_mul_neon(acc, step), vld1q_u8(body + b * 16));
+        }
+        acc = veorq_u8(gf_mul_neon(acc, gf_step[3][i]), vextq_u8(acc, zero, 8));
+        acc = veorq_u8(gf_mul_neon(acc, gf_step[2][i]), vextq_u8(acc, zero, 4));
+        acc = veorq_u8(gf_mul_neon(acc, gf_step[1][i]), vextq_u8(acc, zero, 2));
+        acc = veorq_u8(gf_mul_neon(acc, gf_step[0][i]), vextq_u8(acc, zero, 1));
+        syndromes[i] = vgetq_lane_u8(acc, 0);
+    }
+}
+
+#endif // RS_HAVE_NEON_KERNEL
+
+// -------------------------------------------------------------------------
+// Kernel Selection
+// -------------------------------------------------------------------------
+
+static void build_fast_tables(void) {
+    uint8_t *rows = gf_gen_table;
+    for (int level = 0; level < RS_PARITY_LEVELS; level++) {
+        int n = (int)rs_level_parity(level);
+        const uint8_t *generator = gf_generator[level];
+        gf_gen_rows[level] = rows;
+        for (int f = 0; f < 256; f++) {
+            for (int j = 0; j < n; j++) {
+                rows[f * n + j] = gf_mul((uint8_t)f, generator[n - 1 - j]);
+            }
+        }
+        rows += 256 * n;
+    }
+    for (int i = 0; i < RS_MAX_PARITY; i++) {
+        uint8_t root = gf_exp[RS_GENERATOR_ROOT + i];
+        for (int x = 0; x < 256; x++) {
+            gf_root_mul[i][x] = gf_mul((uint8_t)x, root);
+        }
+        for (int k = 0; k < RS_STEP_LEVELS; k++) {
+            uint8_t step = gf_pow(root, 1 << k);
+            for (int x = 0; x < 16; x++) {
+                gf_step[k][i][x] = gf_mul((uint8_t)x, step);
+                gf_step[k][i][16 + x] = gf_mul((uint8_t)(x << 4), step);
+            }
+        }
+    }
+}
+
+static bool kernel_supported(rs_kernel_t kernel) {
+    switch (kernel) {
+        case RS_KERNEL_REFERENCE:
+        case RS_KERNEL_TABLE:
+            return true;
+#if RS_HAVE_X86_KERNELS
+        case RS_KERNEL_SSSE3:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3");
+        case RS_KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#if RS_HAVE_NEON_KERNEL
+        case RS_KERNEL_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static rs_kernel_t best_kernel(void) {
+    static const rs_kernel_t preference[] = {
+        RS_KERNEL_AVX2, RS_KERNEL_NEON, RS_KERNEL_SSSE3, RS_KERNEL_TABLE,
+    };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        if (kernel_supported(preference[i])) {
+            return preference[i];
+        }
+    }
+    return RS_KERNEL_REFERENCE;
+}
+
+static void install_kernel(rs_kernel_t kernel) {
+    rs_active_kernel = kernel;
+    rs_encode_impl = kernel == RS_KERNEL_REFERENCE ? encode_reference : encode_table;
+    switch (kernel) {
+#if RS_HAVE_X86_KERNELS
+        case RS_KERNEL_SSSE3:
+            rs_syndrome_impl = syndromes_ssse3;
+            break;
+        case RS_KERNEL_AVX2:
+            rs_syndrome_impl = syndromes_avx2;
+            break;
+#endif
+#if RS_HAVE_NEON_KERNEL
+        case RS_KERNEL_NEON:
+            rs_syndrome_impl = syndromes_neon;
+            break;
+#endif
+        case RS_KERNEL_TABLE:
+            rs_syndrome_impl = syndromes_table;
+            break;
+        default:
+            rs_syndrome_impl = syndromes_reference;
+            break;
+    }
+}
+
+bool rs_set_kernel(rs_kernel_t kernel) {
+    if (!rs_initialized) rs_init();
+    if (kernel == RS_KERNEL_AUTO) {
+        kernel = best_kernel();
+    }
+    if (!kernel_supported(kernel)) {
+        return false;
+    }
+    install_kernel(kernel);
+    return true;
+}
+
+rs_kernel_t rs_get_kernel(void) {
+    if (!rs_initialized) rs_init();
+    return rs_active_kernel;
+}
+
+const char *rs_kernel_name(rs_kernel_t kernel) {
+    switch (kernel) {
+        case RS_KERNEL_AUTO: return "auto";
+        case RS_KERNEL_REFERENCE: return "reference";
+        case RS_KERNEL_TABLE: return "table";
+        case RS_KERNEL_SSSE3: return "ssse3";
+        case RS_KERNEL_AVX2: return "avx2";
+        case RS_KERNEL_NEON: return "neon";
+    }
+    return "unknown";
+}
+
+void rs_init(void) {
+    if (rs_initialized) return;
+    gf_init();
+    for (int level = 0; level < RS_PARITY_LEVELS; level++) {
+        build_generator(level, gf_generator[level]);
+    }
+    build_fast_tables();
+    install_kernel(best_kernel());
+    rs_initialized = true;
+}
+
+// -------------------------------------------------------------------------
+// Reed-Solomon Decoding (Berlekamp-Massey + Forney)
+// -------------------------------------------------------------------------
+
+// Compute the first count syndromes at the generator roots
+static void compute_syndromes(const uint8_t *codeword, size_t len, int count, uint8_t *syndromes) {
+    rs_syndrome_impl(codeword, len, count, syndromes);
+}
+
 // Check if all syndromes are zero (no errors)
-static bool syndromes_zero(const uint8_t *syndromes) {
-    for (int i = 0; i < RS_PARITY_SIZE; i++) {
+static bool syndromes_zero(const uint8_t *syndromes, int count) {
+    for (int i = 0; i < count; i++) {
         if (syndromes[i] != 0) return false;
     }
     return true;
 }
 
-// Berlekamp-Massey algorithm to find error locator polynomial
-// Returns degree of error locator, or -1 on failure
-static int berlekamp_massey(const uint8_t *syndromes, uint8_t *sigma) {
-    uint8_t C[RS_PARITY_SIZE + 1];    // Error locator polynomial
-    uint8_t B[RS_PARITY_SIZE + 1];    // Previous polynomial
-    uint8_t T[RS_PARITY_SIZE + 1];    // Temporary
+// Berlekamp-Massey algorithm to find error locator polynomial from
+// two_t syndromes. Returns degree of error locator, or -1 on failure
+static int berlekamp_massey(const uint8_t *syndromes, int two_t, uint8_t *sigma) {
+    uint8_t C[RS_MAX_PARITY + 1];    // Error locator polynomial
+    uint8_t B[RS_MAX_PARITY + 1];    // Previous polynomial
+    uint8_t T[RS_MAX_PARITY + 1];    // Temporary
     
     memset(C, 0, sizeof(C));
     memset(B, 0, sizeof(B));
@@ -205,7 +544,7 @@ static int berlekamp_massey(const uint8_t *syndromes, uint8_t *sigma) {
     int m = 1;      // Shift amount
     uint8_t b = 1;  // Previous discrepancy
     
-    for (int n = 0; n < RS_PARITY_SIZE; n++) {
+    for (int n = 0; n < two_t; n++) {
         // Compute discrepancy
         uint8_t d = syndromes[n];
         for (int i = 1; i <= L; i++) {
@@ -220,7 +559,7 @@ static int berlekamp_massey(const uint8_t *syndromes, uint8_t *sigma) {
             
             // C(x) = C(x) - d*b^-1 * x^m * B(x)
             uint8_t coef = gf_mul(d, gf_inv(b));
-            for (int i = 0; i + m <= RS_PARITY_SIZE; i++) {
+            for (int i = 0; i + m <= two_t; i++) {
                 C[i + m] ^= gf_mul(coef, B[i]);
             }
             
@@ -231,7 +570,7 @@ static int berlekamp_massey(const uint8_t *syndromes, uint8_t *sigma) {
         } else {
             // C(x) = C(x) - d*b^-1 * x^m * B(x)
             uint8_t coef = gf_mul(d, gf_inv(b));
-            for (int i = 0; i + m <= RS_PARITY_SIZE; i++) {
+            for (int i = 0; i + m <= two_t; i++) {
                 C[i + m] ^= gf_mul(coef, B[i]);
             }
             m++;
@@ -243,18 +582,14 @@ static int berlekamp_massey(const uint8_t *syndromes, uint8_t *sigma) {
 }
 
 // Chien search to find error positions
-// Returns number of roots found, positions stored in error_pos
+// Byte i of an n-byte codeword has locator X = alpha^(n-1-i); it is in error
+// when sigma(X^-1) == 0. Returns number of roots found, positions in error_pos.
 static int chien_search(const uint8_t *sigma, int degree, size_t n, int *error_pos) {
     int count = 0;
-    size_t pad = RS_BLOCK_SIZE - n;
     
-    // Evaluate sigma at alpha^-i for i = 0 to n-1
     for (size_t i = 0; i < n; i++) {
-        // Position in full 255-byte block
-        size_t full_pos = pad + i;
-        
-        // Evaluate sigma at alpha^-(255 - full_pos)
-        int exp = 255 - full_pos;
+        // X^-1 = alpha^(255 - (n-1-i))
+        int exp = (int)((255 - (n - 1 - i) % 255) % 255);
         uint8_t sum = sigma[0];
         for (int j = 1; j <= degree; j++) {
             sum ^= gf_mul(sigma[j], gf_exp[(exp * j) % 255]);
@@ -270,36 +605,34 @@ static int chien_search(const uint8_t *sigma, int degree, size_t n, int *error_p
 }
 
 // Forney algorithm to compute error values
-static void forney_algorithm(const uint8_t *syndromes, const uint8_t *sigma, int sigma_deg,
+// With first consecutive root alpha^b (b = 2): e_i = X_i^(1-b) * omega(X_i^-1) / sigma'(X_i^-1)
+static void forney_algorithm(const uint8_t *syndromes, int two_t, const uint8_t *sigma, int sigma_deg,
                               const int *error_pos, int error_count, size_t n, uint8_t *error_val) {
     // Compute error evaluator polynomial omega(x) = S(x) * sigma(x) mod x^(2t)
-    uint8_t omega[RS_PARITY_SIZE];
+    uint8_t omega[RS_MAX_PARITY];
     memset(omega, 0, sizeof(omega));
     
-    for (int i = 0; i < RS_PARITY_SIZE; i++) {
+    for (int i = 0; i < two_t; i++) {
         for (int j = 0; j <= sigma_deg && j <= i; j++) {
             omega[i] ^= gf_mul(syndromes[i - j], sigma[j]);
         }
     }
     
     // Compute sigma'(x) (formal derivative)
-    uint8_t sigma_prime[RS_PARITY_SIZE + 1];
+    uint8_t sigma_prime[RS_MAX_PARITY + 1];
     memset(sigma_prime, 0, sizeof(sigma_prime));
     for (int i = 1; i <= sigma_deg; i += 2) {  // Only odd powers contribute in GF(2^m)
         sigma_prime[i - 1] = sigma[i];
     }
     
-    size_t pad = RS_BLOCK_SIZE - n;
-    
     // Compute error magnitudes
     for (int i = 0; i < error_count; i++) {
         size_t pos = error_pos[i];
-        size_t full_pos = pad + pos;
-        int X_inv_exp = full_pos;  // alpha^full_pos is X_i, so X_i^-1 = alpha^(-full_pos)
+        int X_inv_exp = (int)((255 - (n - 1 - pos) % 255) % 255);
         
         // Evaluate omega at X_i^-1
         uint8_t omega_val = 0;
-        for (int j = 0; j < RS_PARITY_SIZE; j++) {
+        for (int j = 0; j < two_t; j++) {
             omega_val ^= gf_mul(omega[j], gf_exp[(X_inv_exp * j) % 255]);
         }
         
@@ -312,72 +645,135 @@ static void forney_algorithm(const uint8_t *syndromes, const uint8_t *sigma, int
         if (sigma_prime_val == 0) {
             error_val[i] = 0;  // Shouldn't happen
         } else {
-            // e_i = X_i * omega(X_i^-1) / sigma'(X_i^-1)
-            // But we need X_i which is alpha^(255-full_pos)
-            uint8_t X_i = gf_exp[(255 - full_pos) % 255];
-            error_val[i] = gf_mul(gf_mul(X_i, omega_val), gf_inv(sigma_prime_val));
+            error_val[i] = gf_mul(gf_exp[X_inv_exp], gf_div(omega_val, sigma_prime_val));
         }
     }
 }
 
-int rs_decode(uint8_t *codeword, size_t len) {
-    if (!rs_initialized) rs_init();
-    if (len <= RS_PARITY_SIZE || len > RS_BLOCK_SIZE) {
-        return -1;
+// Locator exponent of byte pos in an n-byte codeword: X = alpha^(n-1-pos)
+static int locator_exp(size_t n, size_t pos) {
+    return (int)((n - 1 - pos) % 255);
+}
+
+// Forney syndromes: fold each erasure out of the syndromes, one fewer per
+// erasure. S'_i = X * S_i + S_(i+1) has no term for X, so Berlekamp-Massey
+// on what is left finds only the errors at unknown positions.
+static int forney_syndromes(const uint8_t *syndromes, int two_t, const uint8_t *erasures,
+                            int erasure_count, size_t n, uint8_t *out) {
+    memcpy(out, syndromes, (size_t)two_t);
+    int count = two_t;
+    for (int e = 0; e < erasure_count; e++) {
+        uint8_t x = gf_exp[locator_exp(n, erasures[e])];
+        for (int i = 0; i + 1 < count; i++) {
+            out[i] = gf_mul(out[i], x) ^ out[i + 1];
+        }
+        count--;
     }
-    
-    uint8_t syndromes[RS_PARITY_SIZE];
-    compute_syndromes(codeword, len, syndromes);
+    return count;
+}
+
+// Multiply locator poly (degree deg) by (1 + X x) for every erasure.
+// Returns the new degree.
+static int add_erasures(uint8_t *poly, int deg, const uint8_t *erasures, int erasure_count, size_t n) {
+    for (int e = 0; e < erasure_count; e++) {
+        uint8_t x = gf_exp[locator_exp(n, erasures[e])];
+        for (int i = deg + 1; i > 0; i--) {
+            poly[i] ^= gf_mul(poly[i - 1], x);
+        }
+        deg++;
+    }
+    return deg;
+}
+
+// Errors-and-erasures decode: 2 * errors + erasures <= two_t. Leaves the
+// codeword as it was on failure.
+static int decode_core(uint8_t *codeword, size_t len, int two_t, const uint8_t *erasures,
+                       int erasure_count) {
+    uint8_t syndromes[RS_MAX_PARITY];
+    compute_syndromes(codeword, len, two_t, syndromes);
     
     // No errors?
-    if (syndromes_zero(syndromes)) {
+    if (syndromes_zero(syndromes, two_t)) {
         return 0;
     }
     
-    // Find error locator polynomial
-    uint8_t sigma[RS_PARITY_SIZE + 1];
+    // Find the locator of the errors at unknown positions, then fold in
+    // the erasures
+    uint8_t modified[RS_MAX_PARITY];
+    int free_syndromes = forney_syndromes(syndromes, two_t, erasures, erasure_count, len, modified);
+    uint8_t sigma[RS_MAX_PARITY + 1];
     memset(sigma, 0, sizeof(sigma));
-    int num_errors = berlekamp_massey(syndromes, sigma);
+    int num_errors = berlekamp_massey(modified, free_syndromes, sigma);
     
-    if (num_errors > RS_CORRECT_CAPABLE) {
+    if (num_errors < 0 || 2 * num_errors > free_syndromes) {
         return -1;  // Too many errors
     }
+    int degree = add_erasures(sigma, num_errors, erasures, erasure_count, len);
     
     // Find error positions
-    int error_pos[RS_CORRECT_CAPABLE];
-    int roots_found = chien_search(sigma, num_errors, len, error_pos);
+    int error_pos[RS_MAX_PARITY];
+    int roots_found = chien_search(sigma, degree, len, error_pos);
     
-    if (roots_found != num_errors) {
+    if (roots_found != degree) {
         return -1;  // Decoding failure
     }
     
     // Compute error values
-    uint8_t error_val[RS_CORRECT_CAPABLE];
-    forney_algorithm(syndromes, sigma, num_errors, error_pos, num_errors, len, error_val);
+    uint8_t error_val[RS_MAX_PARITY];
+    forney_algorithm(syndromes, two_t, sigma, degree, error_pos, degree, len, error_val);
     
-    // Correct errors
-    for (int i = 0; i < num_errors; i++) {
-        if (error_pos[i] < (int)len) {
-            codeword[error_pos[i]] ^= error_val[i];
-        }
+    // Correct errors; an erased byte may have been right all along
+    int corrected = 0;
+    for (int i = 0; i < degree; i++) {
+        codeword[error_pos[i]] ^= error_val[i];
+        corrected += error_val[i] != 0;
     }
     
     // Verify correction
-    compute_syndromes(codeword, len, syndromes);
-    if (!syndromes_zero(syndromes)) {
+    compute_syndromes(codeword, len, two_t, syndromes);
+    if (!syndromes_zero(syndromes, two_t)) {
+        for (int i = 0; i < degree; i++) {
+            codeword[error_pos[i]] ^= error_val[i];
+        }
         return -1;  // Correction failed
     }
     
-    return num_errors;
+    return corrected;
 }
 
-bool rs_check(const uint8_t *codeword, size_t len) {
+int rs_decode_parity(uint8_t *codeword, size_t len, size_t parity) {
+    return rs_decode_erasures(codeword, len, parity, NULL, 0);
+}
+
+int rs_decode_erasures(uint8_t *codeword, size_t len, size_t parity, const uint8_t *erasures,
+                       size_t erasure_count) {
+    if (!rs_initialized) rs_init();
+    if (parity_level(parity) < 0 || len <= parity || len > RS_BLOCK_SIZE || erasure_count > parity) {
+        return -1;
+    }
+    for (size_t e = 0; e < erasure_count; e++) {
+        if (erasures[e] >= len) {
+            return -1;
+        }
+    }
+    return decode_core(codeword, len, (int)parity, erasures, (int)erasure_count);
+}
+
+int rs_decode(uint8_t *codeword, size_t len) {
+    return rs_decode_parity(codeword, len, RS_PARITY_SIZE);
+}
+
+bool rs_check_parity(const uint8_t *codeword, size_t len, size_t parity) {
     if (!rs_initialized) rs_init();
-    if (len <= RS_PARITY_SIZE || len > RS_BLOCK_SIZE) {
+    if (parity_level(parity) < 0 || len <= parity || len > RS_BLOCK_SIZE) {
         return false;
     }
     
-    uint8_t syndromes[RS_PARITY_SIZE];
-    compute_syndromes(codeword, len, syndromes);
-    return syndromes_zero(syndromes);
+    uint8_t syndromes[RS_MAX_PARITY];
+    compute_syndromes(codeword, len, (int)parity, syndromes);
+    return syndromes_zero(syndromes, (int)parity);
+}
+
+bool rs_check(const uint8_t *codeword, size_t len) {
+    return rs_check_parity(codeword, len, RS_PARITY_SIZE);
 }
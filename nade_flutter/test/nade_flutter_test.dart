@@ -5,4 +5,21 @@ void main() {
   test('setEventHandler stores callback', () {
     expect(() => Nade.setEventHandler((_) {}), returnsNormally);
   });
+
+  test('NadeMetrics parses the flattened layout', () {
+    const len = 2 + 5 * 4 + 4 + 7 + 10 * 27;
+    final values = List<int>.filled(len, 0);
+    values[0] = 2;
+    values[1] = len;
+    values[2] = 320; // mic pushed
+    values[22] = 2; // decrypt failures
+    values[33] = 5; // codec_encode count
+    final metrics = NadeMetrics.fromValues(values);
+    expect(metrics, isNotNull);
+    expect(metrics!.rings['mic']!.pushed, 320);
+    expect(metrics.decryptFailures, 2);
+    expect(metrics.stageNanos['codec_encode']!.count, 5);
+    expect(NadeMetrics.fromValues([1, len]), isNull);
+  });
 }
+